@@ -53,10 +53,6 @@
 #include "track_process.h"
 #endif
 
-/* Global variables */
-int bfd_vrrp_event_pipe[2] = { -1, -1};
-int bfd_checker_event_pipe[2] = { -1, -1};
-
 /* Local variables */
 static const char *bfd_syslog_ident;
 
@@ -95,6 +91,10 @@ stop_bfd(int status)
 	else
 		log_message(LOG_INFO, "Stopped");
 
+#ifdef _WITH_ASYNC_LOG_
+	stop_log_writer();
+#endif
+
 #ifdef ENABLE_LOG_TO_FILE
 	if (log_file_name)
 		close_log_file();
@@ -112,29 +112,6 @@ stop_bfd(int status)
 	exit(status);
 }
 
-/* Daemon init sequence */
-bool
-open_bfd_pipes(void)
-{
-#ifdef _WITH_VRRP_
-	/* Open BFD VRRP control pipe */
-	if (open_pipe(bfd_vrrp_event_pipe) == -1) {
-		log_message(LOG_ERR, "Unable to create BFD vrrp event pipe: %m");
-		return false;
-	}
-#endif
-
-#ifdef _WITH_LVS_
-	/* Open BFD checker control pipe */
-	if (open_pipe(bfd_checker_event_pipe) == -1) {
-		log_message(LOG_ERR, "Unable to create BFD checker event pipe: %m");
-		return false;
-	}
-#endif
-
-	return true;
-}
-
 /* Daemon init sequence */
 static void
 start_bfd(__attribute__((unused)) data_t *prev_global_data)
@@ -164,6 +141,9 @@ start_bfd(__attribute__((unused)) data_t *prev_global_data)
 	/* If we are just testing the configuration, then we terminate now */
 	if (__test_bit(CONFIG_TEST_BIT, &debug))
 		return;
+
+	/* Select the scheduler's timer queue implementation */
+	thread_set_timer_wheel(master, global_data->timer_wheel);
 	bfd_complete_init();
 
 	/* Post initializations */
@@ -358,16 +338,10 @@ start_bfd_child(void)
 
 	prog_type = PROG_TYPE_BFD;
 
-	/* Close the read end of the event notification pipes, and the track_process fd */
-#ifdef _WITH_VRRP_
-	close(bfd_vrrp_event_pipe[0]);
-#ifdef _WITH_CN_PROC_
+	/* Close the track_process fd */
+#if defined _WITH_VRRP_ && defined _WITH_CN_PROC_
 	close_track_processes();
 #endif
-#endif
-#ifdef _WITH_LVS_
-	close(bfd_checker_event_pipe[0]);
-#endif
 
 	initialise_debug_options();
 
@@ -404,6 +378,10 @@ start_bfd_child(void)
 
 	free_parent_mallocs_startup(true);
 
+#ifdef _WITH_ASYNC_LOG_
+	start_log_writer();
+#endif
+
 	/* Clear any child finder functions set in parent */
 	set_child_finder_name(NULL);
 
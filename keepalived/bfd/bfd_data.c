@@ -25,11 +25,13 @@
 #include "bfd.h"
 #include "global_data.h"
 #include "bfd_data.h"
+#include "bfd_event.h"
 #include "logger.h"
 #include "parser.h"
 #include "memory.h"
 #include "utils.h"
 #include "main.h"
+#include "jhash.h"
 #include "assert_debug.h"
 
 /* Global vars */
@@ -80,12 +82,12 @@ alloc_bfd(const char *name)
 
 	/* Initialize internal variables */
 	bfd->fd_out = -1;
-	bfd->thread_out = NULL;
 	bfd->thread_exp = NULL;
 	bfd->thread_rst = NULL;
 	bfd->sands_out = TIMER_NEVER;
 	bfd->sands_exp = TIMER_NEVER;
 	bfd->sands_rst = TIMER_NEVER;
+	bfd->event_slot = BFD_EVENT_NO_SLOT;
 
 	list_add(bfd_data->bfd, bfd);
 
@@ -158,14 +160,21 @@ dump_bfd(FILE *fp, const void *data)
 #endif
 	/* If this is not at startup time, write some state variables */
 	if (fp) {
-		conf_write(fp, "   fd_out %d", bfd->fd_out);
-		conf_write(fp, "   thread_out 0x%p", bfd->thread_out);
+		conf_write(fp, "   fd_out %d, source port %u", bfd->fd_out, bfd->src_port);
+		if (bfd->tx_queued)
+			conf_write_sands(fp, "tx_due", bfd->tx_due);
+		else
+			conf_write(fp, "   tx_due = [not queued]");
 		conf_write_sands(fp, "sands_out", bfd->sands_out);
 		conf_write(fp, "   thread_exp 0x%p", bfd->thread_exp);
 		conf_write_sands(fp, "sands_exp", bfd->sands_exp);
 		conf_write(fp, "   thread_rst 0x%p", bfd->thread_rst);
 		conf_write_sands(fp, "sands_rst", bfd->sands_rst);
 		conf_write(fp, "   send error = %s", bfd->send_error ? "true" : "false");
+		if (bfd->event_slot == BFD_EVENT_NO_SLOT)
+			conf_write(fp, "   event slot = [none]");
+		else
+			conf_write(fp, "   event slot = %u", bfd->event_slot);
 		conf_write(fp, "   local state = %s", BFD_STATE_STR(bfd->local_state));
 		conf_write(fp, "   remote state = %s", BFD_STATE_STR(bfd->remote_state));
 		conf_write(fp, "   local discriminator = 0x%x", bfd->local_discr);
@@ -188,6 +197,12 @@ dump_bfd(FILE *fp, const void *data)
 			ctime_r(&bfd->last_seen.tv_sec, time_str);
 			conf_write(fp, "   last seen = %ld.%6.6ld (%.24s.%6.6ld)", bfd->last_seen.tv_sec, bfd->last_seen.tv_usec, time_str, bfd->last_seen.tv_usec);
 		}
+		if (global_data->bfd_rx_timestamps)
+			conf_write(fp, "   rx latency <10us:%" PRIu64 " <100us:%" PRIu64 " <1ms:%" PRIu64
+				       " <10ms:%" PRIu64 " <100ms:%" PRIu64 " >=100ms:%" PRIu64 ", max %" PRIu32 " usec",
+				   bfd->rx_latency_hist[0], bfd->rx_latency_hist[1], bfd->rx_latency_hist[2],
+				   bfd->rx_latency_hist[3], bfd->rx_latency_hist[4], bfd->rx_latency_hist[5],
+				   bfd->rx_latency_max);
 	}
 }
 
@@ -242,6 +257,9 @@ alloc_bfd_data(void)
 	/* Initialize internal variables */
 	data->thread_in = NULL;
 	data->fd_in = -1;
+	data->thread_out = NULL;
+	data->tx_queue = RB_ROOT_CACHED;
+	data->tx_sock[0].fd = data->tx_sock[1].fd = -1;
 
 	return data;
 }
@@ -252,9 +270,73 @@ free_bfd_data(bfd_data_t * data)
 	assert(data);
 
 	free_list(&data->bfd);
+	FREE_PTR(data->discr_hash);
+	FREE_PTR(data->addr_hash);
 	FREE(data);
 }
 
+static void
+dump_bfd_tx(FILE *fp, const bfd_data_t *data)
+{
+	const bfd_tx_sock_t *sock;
+	unsigned i;
+
+	conf_write(fp, " thread_out = 0x%p", data->thread_out);
+	for (i = 0; i < 2; i++) {
+		sock = &data->tx_sock[i];
+		if (sock->fd != -1)
+			conf_write(fp, " tx socket %s: fd %d, %u sessions", i ? "IPv6" : "IPv4",
+				   sock->fd, sock->sessions);
+	}
+	conf_write(fp, " tx packets = %" PRIu64 ", batches = %" PRIu64 ", send calls = %" PRIu64 ", %.2f packets per call",
+		   data->tx_packets, data->tx_batches, data->tx_calls,
+		   data->tx_calls ? (double)data->tx_packets / data->tx_calls : 0);
+}
+
+static void
+dump_bfd_rx(FILE *fp, const bfd_data_t *data)
+{
+	char buf[128];
+	size_t len = 0;
+	unsigned i;
+
+	conf_write(fp, " rx packets = %" PRIu64 ", receive calls = %" PRIu64 ", %.2f packets per call, %" PRIu64 " full batches",
+		   data->rx_packets, data->rx_calls,
+		   data->rx_calls ? (double)data->rx_packets / data->rx_calls : 0,
+		   data->rx_full_batches);
+
+	for (i = 0; i < BFD_RX_HIST_BUCKETS; i++)
+		len += (size_t)snprintf(buf + len, sizeof(buf) - len, " %u%s:%" PRIu64,
+					1U << i, i == BFD_RX_HIST_BUCKETS - 1 ? "+" : "", data->rx_batch_hist[i]);
+	conf_write(fp, " rx batch sizes =%s", buf);
+}
+
+static void
+dump_bfd_hash(FILE *fp, const bfd_data_t *data)
+{
+	unsigned i, len, max_discr = 0, max_addr = 0;
+	const bfd_t *bfd;
+	uint64_t lookups = data->discr_lookups + data->addr_lookups;
+
+	if (!data->hash_size)
+		return;
+
+	for (i = 0; i < data->hash_size; i++) {
+		for (len = 0, bfd = data->discr_hash[i]; bfd; bfd = bfd->discr_next)
+			len++;
+		if (len > max_discr)
+			max_discr = len;
+		for (len = 0, bfd = data->addr_hash[i]; bfd; bfd = bfd->addr_next)
+			len++;
+		if (len > max_addr)
+			max_addr = len;
+	}
+
+	conf_write(fp, " lookup hash buckets = %u, longest chain discriminator %u, address %u", data->hash_size, max_discr, max_addr);
+	conf_write(fp, " lookups = %" PRIu64 " by discriminator, %" PRIu64 " by address, %.2f sessions compared per lookup",
+		   data->discr_lookups, data->addr_lookups, lookups ? (double)data->hash_probes / lookups : 0);
+}
+
 void
 dump_bfd_data(FILE *fp, const bfd_data_t *data)
 {
@@ -266,12 +348,23 @@ dump_bfd_data(FILE *fp, const bfd_data_t *data)
 		conf_write(fp, "------< BFD Data >------");
 		conf_write(fp, " fd_in = %d", data->fd_in);
 		conf_write(fp, " thread_in = 0x%p", data->thread_in);
+		dump_bfd_tx(fp, data);
+		dump_bfd_rx(fp, data);
+		dump_bfd_hash(fp, data);
+		dump_bfd_event_channels(fp);
 	}
 
 	if (!LIST_ISEMPTY(data->bfd)) {
 		conf_write(fp, "------< BFD Topology >------");
 		dump_list(fp, data->bfd);
 	}
+
+	if (fp) {
+		dump_mem_slabs(fp);
+#ifdef _WITH_ASYNC_LOG_
+		dump_log_async(fp);
+#endif
+	}
 }
 
 void
@@ -290,6 +383,138 @@ bfd_print_data(void)
 	fclose(file);
 }
 
+/*
+ * Lookup hash tables
+ */
+static inline uint32_t
+bfd_addr_hashval(const struct sockaddr_storage *addr, uint32_t initval)
+{
+	if (addr->ss_family == AF_INET)
+		return jhash_1word(((const struct sockaddr_in *)addr)->sin_addr.s_addr, initval);
+	if (addr->ss_family == AF_INET6) {
+		const uint32_t *a = ((const struct sockaddr_in6 *)addr)->sin6_addr.s6_addr32;
+		return jhash_3words(a[0], a[1], a[2], jhash_1word(a[3], initval));
+	}
+
+	return initval;
+}
+
+/* An instance configured without a source address is hashed with an
+ * unspecified source address, which is also tried on lookup. */
+static inline unsigned
+bfd_addr_bucket(const bfd_data_t *data, const struct sockaddr_storage *nbr_addr, const struct sockaddr_storage *src_addr)
+{
+	return bfd_addr_hashval(src_addr, bfd_addr_hashval(nbr_addr, 0)) & (data->hash_size - 1);
+}
+
+static inline unsigned
+bfd_discr_bucket(const bfd_data_t *data, uint32_t discr)
+{
+	return jhash_1word(discr, 0) & (data->hash_size - 1);
+}
+
+static void
+bfd_alloc_hash(bfd_data_t *data)
+{
+	unsigned size = 16;
+
+	/* Keep the load factor at or below 0.5 */
+	while (size < 2 * LIST_SIZE(data->bfd))
+		size <<= 1;
+
+	data->hash_size = size;
+	data->discr_hash = MALLOC(size * sizeof(*data->discr_hash));
+	data->addr_hash = MALLOC(size * sizeof(*data->addr_hash));
+}
+
+static void
+bfd_hash_discr(bfd_data_t *data, bfd_t *bfd)
+{
+	unsigned bucket = bfd_discr_bucket(data, bfd->local_discr);
+
+	bfd->discr_next = data->discr_hash[bucket];
+	data->discr_hash[bucket] = bfd;
+}
+
+static void
+bfd_unhash_discr(bfd_data_t *data, bfd_t *bfd)
+{
+	bfd_t **p;
+
+	for (p = &data->discr_hash[bfd_discr_bucket(data, bfd->local_discr)]; *p; p = &(*p)->discr_next) {
+		if (*p == bfd) {
+			*p = bfd->discr_next;
+			bfd->discr_next = NULL;
+			return;
+		}
+	}
+}
+
+static void
+bfd_hash_addr(bfd_data_t *data, bfd_t *bfd)
+{
+	unsigned bucket = bfd_addr_bucket(data, &bfd->nbr_addr, &bfd->src_addr);
+
+	bfd->addr_next = data->addr_hash[bucket];
+	data->addr_hash[bucket] = bfd;
+}
+
+/* Instances carried over on reload keep their event slot, so the
+ * consumers' cached lookups remain valid. The slots are grown if there
+ * are more instances than slots, new instances are given the lowest free
+ * slots, and slots no longer used are cleared. */
+static void
+bfd_assign_event_slots(bfd_data_t *data)
+{
+	bool *used;
+	bfd_t *bfd;
+	element e;
+	uint32_t needed = LIST_SIZE(data->bfd);
+	uint32_t num_slots;
+	uint32_t slot = 0;
+
+	LIST_FOREACH(data->bfd, bfd, e) {
+		if (bfd->event_slot != BFD_EVENT_NO_SLOT && bfd->event_slot >= needed)
+			needed = bfd->event_slot + 1;
+	}
+
+	num_slots = bfd_event_alloc_slots(needed);
+	used = MALLOC(num_slots * sizeof(*used));
+
+	LIST_FOREACH(data->bfd, bfd, e) {
+		if (bfd->event_slot == BFD_EVENT_NO_SLOT)
+			continue;
+		if (bfd->event_slot < num_slots)
+			used[bfd->event_slot] = true;
+		else
+			bfd->event_slot = BFD_EVENT_NO_SLOT;
+	}
+
+	LIST_FOREACH(data->bfd, bfd, e) {
+		if (bfd->event_slot != BFD_EVENT_NO_SLOT)
+			continue;
+
+		while (slot < num_slots && used[slot])
+			slot++;
+		if (slot == num_slots) {
+			log_message(LOG_INFO, "BFD_Instance(%s) no event slot available - its state changes will be counted as dropped",
+				    bfd->iname);
+			continue;
+		}
+
+		bfd->event_slot = slot;
+		used[slot] = true;
+		bfd_event_set_name(slot, bfd->iname);
+	}
+
+	for (slot = 0; slot < num_slots; slot++) {
+		if (!used[slot])
+			bfd_event_clear_name(slot);
+	}
+
+	FREE(used);
+}
+
 void
 bfd_complete_init(void)
 {
@@ -299,7 +524,11 @@ bfd_complete_init(void)
 	assert(bfd_data);
 	assert(bfd_data->bfd);
 
-	/* Build configuration */
+	bfd_alloc_hash(bfd_data);
+
+	/* Build configuration. Instances carried over from the old
+	 * configuration are done first, so that their discriminators are
+	 * hashed before any new random discriminators are allocated. */
 	LIST_FOREACH(bfd_data->bfd, bfd, e) {
 		/* If there was an old instance with the same name
 		   copy its state and thread sands during reload */
@@ -308,10 +537,22 @@ bfd_complete_init(void)
 			bfd_copy_sands(bfd, bfd_old);
 			if (bfd_cmp_timers(bfd_old, bfd))
 				bfd_set_poll(bfd);
-		} else
+			bfd_hash_discr(bfd_data, bfd);
+			bfd->event_slot = bfd_old->event_slot;
+			bfd->src_port = bfd_old->src_port;
+		}
+		bfd_hash_addr(bfd_data, bfd);
+	}
+
+	LIST_FOREACH(bfd_data->bfd, bfd, e) {
+		if (!bfd->local_discr) {
 			bfd_init_state(bfd);
+			bfd_hash_discr(bfd_data, bfd);
+		}
 	}
 
+	bfd_assign_event_slots(bfd_data);
+
 	/* Copy old input fd on reload */
 	if (reload)
 		bfd_data->fd_in = old_bfd_data->fd_in;
@@ -340,14 +581,11 @@ free_bfd_buffer(void)
 /* Looks up bfd instance by neighbor address, and optional local address.
  * If local address is not set, then it is a configuration time check and
  * the bfd instance is configured without a local address. */
-bfd_t * __attribute__ ((pure))
-find_bfd_by_addr(const struct sockaddr_storage *nbr_addr, const struct sockaddr_storage *local_addr)
+static bfd_t * __attribute__ ((pure))
+find_bfd_by_addr_list(const struct sockaddr_storage *nbr_addr, const struct sockaddr_storage *local_addr)
 {
 	element e;
 	bfd_t *bfd;
-	assert(nbr_addr);
-	assert(local_addr);
-	assert(bfd_data);
 
 	LIST_FOREACH(bfd_data->bfd, bfd, e) {
 		if (&bfd->nbr_addr == nbr_addr)
@@ -372,18 +610,67 @@ find_bfd_by_addr(const struct sockaddr_storage *nbr_addr, const struct sockaddr_
 	return NULL;
 }
 
+static bfd_t *
+find_bfd_by_addr_hash(const struct sockaddr_storage *nbr_addr, const struct sockaddr_storage *src_addr)
+{
+	bfd_t *bfd;
+
+	for (bfd = bfd_data->addr_hash[bfd_addr_bucket(bfd_data, nbr_addr, src_addr)]; bfd; bfd = bfd->addr_next) {
+		bfd_data->hash_probes++;
+		if (!inet_sockaddrcmp(&bfd->nbr_addr, nbr_addr) &&
+		    bfd->src_addr.ss_family == src_addr->ss_family &&
+		    !inet_sockaddrcmp(&bfd->src_addr, src_addr))
+			return bfd;
+	}
+
+	return NULL;
+}
+
+bfd_t *
+find_bfd_by_addr(const struct sockaddr_storage *nbr_addr, const struct sockaddr_storage *local_addr)
+{
+	static const struct sockaddr_storage no_addr = { .ss_family = AF_UNSPEC };
+	bfd_t *bfd;
+
+	assert(nbr_addr);
+	assert(local_addr);
+	assert(bfd_data);
+
+	/* Before the hash tables are built, or for a configuration time
+	 * check without a local address, scan the list. */
+	if (!bfd_data->hash_size || !local_addr->ss_family)
+		return find_bfd_by_addr_list(nbr_addr, local_addr);
+
+	bfd_data->addr_lookups++;
+
+	if ((bfd = find_bfd_by_addr_hash(nbr_addr, local_addr)))
+		return bfd;
+
+	return find_bfd_by_addr_hash(nbr_addr, &no_addr);
+}
+
 /* Looks up bfd instance by local discriminator */
-bfd_t * __attribute__ ((pure))
-find_bfd_by_discr(const uint32_t discr)
+static bfd_t * __attribute__ ((pure))
+find_bfd_by_discr_list(const bfd_data_t *data, const uint32_t discr)
 {
 	element e;
 	bfd_t *bfd;
 
-	if (LIST_ISEMPTY(bfd_data->bfd))
-		return NULL;
+	LIST_FOREACH(data->bfd, bfd, e) {
+		if (bfd->local_discr == discr)
+			return bfd;
+	}
 
-	for (e = LIST_HEAD(bfd_data->bfd); e; ELEMENT_NEXT(e)) {
-		bfd = ELEMENT_DATA(e);
+	return NULL;
+}
+
+static bfd_t *
+find_bfd_by_discr_hash(bfd_data_t *data, const uint32_t discr)
+{
+	bfd_t *bfd;
+
+	for (bfd = data->discr_hash[bfd_discr_bucket(data, discr)]; bfd; bfd = bfd->discr_next) {
+		data->hash_probes++;
 		if (bfd->local_discr == discr)
 			return bfd;
 	}
@@ -391,6 +678,19 @@ find_bfd_by_discr(const uint32_t discr)
 	return NULL;
 }
 
+bfd_t *
+find_bfd_by_discr(const uint32_t discr)
+{
+	assert(bfd_data);
+
+	if (!bfd_data->hash_size)
+		return find_bfd_by_discr_list(bfd_data, discr);
+
+	bfd_data->discr_lookups++;
+
+	return find_bfd_by_discr_hash(bfd_data, discr);
+}
+
 /*
  * Utility functions
  */
@@ -416,9 +716,8 @@ rand_intv(uint32_t min, uint32_t max)
 uint32_t
 bfd_get_random_discr(bfd_data_t *data)
 {
-	bfd_t *bfd;
 	uint32_t discr;
-	element e;
+	bool collision;
 
 	assert(data);
 
@@ -428,13 +727,27 @@ bfd_get_random_discr(bfd_data_t *data)
 		discr = (rand_intv(1, UINT32_MAX) & ~1) | (time_now.tv_sec & 1);
 
 		/* Check for collisions */
-		LIST_FOREACH(data->bfd, bfd, e) {
-			if (bfd->local_discr == discr) {
-				discr = 0;
-				break;
-			}
-		}
-	} while (!discr);
+		if (data->hash_size)
+			collision = !!find_bfd_by_discr_hash(data, discr);
+		else
+			collision = !!find_bfd_by_discr_list(data, discr);
+	} while (!discr || collision);
 
 	return discr;
 }
+
+/* Allocates a new local discriminator for an active instance */
+void
+bfd_set_random_discr(bfd_t *bfd)
+{
+	assert(bfd_data);
+
+	if (!bfd_data->hash_size) {
+		bfd->local_discr = bfd_get_random_discr(bfd_data);
+		return;
+	}
+
+	bfd_unhash_discr(bfd_data, bfd);
+	bfd->local_discr = bfd_get_random_discr(bfd_data);
+	bfd_hash_discr(bfd_data, bfd);
+}
@@ -22,7 +22,11 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <inttypes.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
 
 #include "bfd.h"
 #include "bfd_event.h"
@@ -35,11 +39,257 @@
 #include "global_data.h"
 #include "assert_debug.h"
 
+/* Number of attempts to read a name the BFD process is updating */
+#define BFD_EVENT_NAME_TRIES	100
+
+#define BFD_EVENT_ALIGN(x)	(((x) + SPSC_RING_CACHELINE - 1) & ~((size_t)SPSC_RING_CACHELINE - 1))
+
+/* Global variables */
+#ifdef _WITH_VRRP_
+bfd_event_chan_t bfd_vrrp_event_chan = { .index = BFD_EVENT_VRRP, .fd = -1 };
+#endif
+#ifdef _WITH_LVS_
+bfd_event_chan_t bfd_checker_event_chan = { .index = BFD_EVENT_CHECKER, .fd = -1 };
+#endif
+
+/* Local variables */
+static uint32_t *bfd_event_num_slots;		/* Shared, only written by the BFD process */
+static bfd_event_slot_t *bfd_event_slots;
+static uint32_t bfd_event_mapped_slots;
+#ifdef HAVE_MEMFD_CREATE
+static int bfd_event_slots_fd = -1;
+#endif
+
+static size_t
+bfd_event_queue_size(void)
+{
+	return BFD_EVENT_ALIGN(sizeof(bfd_event_queue_t)) +
+	       BFD_EVENT_ALIGN(spsc_ring_size(BFD_EVENT_RING_SIZE, sizeof(uint32_t)));
+}
+
+static bool
+open_bfd_event_channel(bfd_event_chan_t *chan, char *base, const char *name)
+{
+	chan->queue = (bfd_event_queue_t *)base;
+	chan->ring = (spsc_ring_t *)(base + BFD_EVENT_ALIGN(sizeof(bfd_event_queue_t)));
+	spsc_ring_init(chan->ring, BFD_EVENT_RING_SIZE, sizeof(uint32_t));
+
+	if ((chan->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		log_message(LOG_ERR, "Unable to create BFD %s event fd: %m", name);
+		return false;
+	}
+
+	return true;
+}
+
+#ifdef HAVE_MEMFD_CREATE
+/* Map all the slots the BFD process has allocated so far. The mapping is
+ * only ever replaced by a larger one. */
+static bool
+bfd_event_map_slots(void)
+{
+	uint32_t num_slots = __atomic_load_n(bfd_event_num_slots, __ATOMIC_ACQUIRE);
+	void *slots;
+
+	if (num_slots <= bfd_event_mapped_slots)
+		return true;
+
+	slots = mmap(NULL, num_slots * sizeof(bfd_event_slot_t), PROT_READ | PROT_WRITE, MAP_SHARED, bfd_event_slots_fd, 0);
+	if (slots == MAP_FAILED) {
+		log_message(LOG_ERR, "Unable to map %u BFD event slots: %m", num_slots);
+		return false;
+	}
+
+	if (bfd_event_slots)
+		munmap(bfd_event_slots, bfd_event_mapped_slots * sizeof(bfd_event_slot_t));
+	bfd_event_slots = slots;
+	bfd_event_mapped_slots = num_slots;
+
+	return true;
+}
+#else
+static inline bool
+bfd_event_map_slots(void)
+{
+	return true;
+}
+#endif
+
+/* Called by the BFD process when the configuration is loaded, so that
+ * there is a slot for each instance. Returns the number of slots. */
+uint32_t
+bfd_event_alloc_slots(uint32_t needed)
+{
+#ifdef HAVE_MEMFD_CREATE
+	uint32_t num_slots;
+
+	/* The BFD process may have been restarted after growing the slots */
+	bfd_event_map_slots();
+
+	if (needed <= bfd_event_mapped_slots)
+		return bfd_event_mapped_slots;
+
+	for (num_slots = bfd_event_mapped_slots; num_slots < needed; num_slots *= 2);
+
+	if (ftruncate(bfd_event_slots_fd, (off_t)(num_slots * sizeof(bfd_event_slot_t))) == -1) {
+		log_message(LOG_ERR, "Unable to grow BFD event slots to %u: %m", num_slots);
+		return bfd_event_mapped_slots;
+	}
+
+	/* The consumers map the new slots when they first see an index
+	 * beyond the ones they have mapped */
+	__atomic_store_n(bfd_event_num_slots, num_slots, __ATOMIC_RELEASE);
+	bfd_event_map_slots();
+#endif
+
+	return bfd_event_mapped_slots;
+}
+
+/* Create the shared memory and eventfds. Must be called before the
+ * BFD, VRRP and checker processes are started, so that they all
+ * inherit them. */
+bool
+open_bfd_event_channels(void)
+{
+	size_t size = BFD_EVENT_ALIGN(sizeof(*bfd_event_num_slots));
+	char *base;
+
+#ifdef _WITH_VRRP_
+	size += bfd_event_queue_size();
+#endif
+#ifdef _WITH_LVS_
+	size += bfd_event_queue_size();
+#endif
+#ifndef HAVE_MEMFD_CREATE
+	size += BFD_EVENT_MAX_SLOTS * sizeof(bfd_event_slot_t);
+#endif
+
+	base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		log_message(LOG_ERR, "Unable to create BFD event shared memory: %m");
+		return false;
+	}
+
+	bfd_event_num_slots = (uint32_t *)base;
+	base += BFD_EVENT_ALIGN(sizeof(*bfd_event_num_slots));
+
+#ifdef _WITH_VRRP_
+	if (!open_bfd_event_channel(&bfd_vrrp_event_chan, base, "vrrp"))
+		return false;
+	base += bfd_event_queue_size();
+#endif
+
+#ifdef _WITH_LVS_
+	if (!open_bfd_event_channel(&bfd_checker_event_chan, base, "checker"))
+		return false;
+	base += bfd_event_queue_size();
+#endif
+
+#ifdef HAVE_MEMFD_CREATE
+	/* The slots are in a separate file so that they can be grown */
+	bfd_event_slots_fd = memfd_create("keepalived_bfd_events", MFD_CLOEXEC);
+	if (bfd_event_slots_fd == -1 ||
+	    ftruncate(bfd_event_slots_fd, BFD_EVENT_MIN_SLOTS * sizeof(bfd_event_slot_t)) == -1) {
+		log_message(LOG_ERR, "Unable to create BFD event slots: %m");
+		return false;
+	}
+	*bfd_event_num_slots = BFD_EVENT_MIN_SLOTS;
+
+	return bfd_event_map_slots();
+#else
+	bfd_event_slots = (bfd_event_slot_t *)base;
+	*bfd_event_num_slots = bfd_event_mapped_slots = BFD_EVENT_MAX_SLOTS;
+
+	return true;
+#endif
+}
+
+/* Called by processes that neither produce nor consume on the channel */
+void
+bfd_event_close_channel(bfd_event_chan_t *chan)
+{
+	if (chan->fd != -1) {
+		close(chan->fd);
+		chan->fd = -1;
+	}
+}
+
+static void
+bfd_event_clear_pending(uint32_t slot)
+{
+	unsigned i;
+
+	for (i = 0; i < BFD_EVENT_CHANNELS; i++)
+		__atomic_store_n(&bfd_event_slots[slot].chan[i].pending, 0, __ATOMIC_RELAXED);
+}
+
+/* Set the instance name for a slot. Any event still pending for a
+ * previous user of the slot is discarded. */
+void
+bfd_event_set_name(uint32_t slot, const char *iname)
+{
+	bfd_event_name_t *name = &bfd_event_slots[slot].name;
+	uint32_t gen = name->gen;
+
+	bfd_event_clear_pending(slot);
+
+	__atomic_store_n(&name->gen, gen | 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	strcpy_safe(name->iname, iname);
+	__atomic_store_n(&name->gen, (gen | 1) + 1, __ATOMIC_RELEASE);
+}
+
+void
+bfd_event_clear_name(uint32_t slot)
+{
+	if (bfd_event_slots[slot].name.iname[0])
+		bfd_event_set_name(slot, "");
+}
+
+static void
+bfd_event_queue(bfd_event_chan_t *chan, const bfd_t *bfd, uint32_t state, timeval_t sent_time)
+{
+	bfd_event_queue_t *queue = chan->queue;
+	bfd_event_state_t *slot;
+	uint32_t index = bfd->event_slot;
+	uint64_t val = 1;
+
+	/* The instance has no slot, so the consumer can't be told */
+	if (index == BFD_EVENT_NO_SLOT) {
+		queue->dropped++;
+		return;
+	}
+
+	slot = &bfd_event_slots[index].chan[chan->index];
+
+	__atomic_store_n(&slot->state, state, __ATOMIC_RELAXED);
+	slot->sent_time = sent_time;
+
+	/* If the consumer hasn't taken the previous state yet, it will see this one instead */
+	if (__atomic_exchange_n(&slot->pending, 1, __ATOMIC_ACQ_REL)) {
+		queue->coalesced++;
+		return;
+	}
+
+	queue->sent++;
+
+	if (!spsc_ring_push(chan->ring, &index)) {
+		/* The pending flag remains set, so the consumer finds the
+		 * event when it rescans all the slots */
+		queue->overflows++;
+		if (!__atomic_exchange_n(&queue->resync, 1, __ATOMIC_ACQ_REL))
+			log_message(LOG_INFO, "BFD_Instance(%s) event ring full - consumer will rescan", bfd->iname);
+	}
+
+	if (write(chan->fd, &val, sizeof(val)) == -1 && errno != EAGAIN && __test_bit(LOG_DETAIL_BIT, &debug))
+		log_message(LOG_ERR, "BFD_Instance(%s) event fd write() error %m", bfd->iname);
+}
+
 void
 bfd_event_send(bfd_t *bfd)
 {
-	bfd_event_t evt;
-	int ret;
+	uint32_t state;
+	timeval_t sent_time;
 #ifdef _WITH_VRRP_
 	bool vrrp_running = running_vrrp();
 #endif
@@ -49,7 +299,7 @@ bfd_event_send(bfd_t *bfd)
 
 	assert(bfd);
 
-	/* If there is no VRRP process running, don't write to the pipe */
+	/* If there is no VRRP or checker process running, don't queue anything */
 	if (true
 #ifdef _WITH_VRRP_
 	    && !vrrp_running
@@ -60,26 +310,172 @@ bfd_event_send(bfd_t *bfd)
 		)
 		return;
 
-	memset(&evt, 0, sizeof evt);
-	strcpy(evt.iname, bfd->iname);
-	evt.state = bfd->local_state == BFD_STATE_UP ? BFD_STATE_UP : BFD_STATE_DOWN;
-	evt.sent_time = timer_now();
+	state = bfd->local_state == BFD_STATE_UP ? BFD_STATE_UP : BFD_STATE_DOWN;
+	sent_time = timer_now();
 
 #ifdef _WITH_VRRP_
-	if (vrrp_running && bfd->vrrp) {
-		ret = write(bfd_vrrp_event_pipe[1], &evt, sizeof evt);
-		if (ret == -1 && __test_bit(LOG_DETAIL_BIT, &debug))
-			log_message(LOG_ERR, "BFD_Instance(%s) vrrp pipe write() error %m",
-				    bfd->iname);
-	}
+	if (vrrp_running && bfd->vrrp)
+		bfd_event_queue(&bfd_vrrp_event_chan, bfd, state, sent_time);
 #endif
 
 #ifdef _WITH_LVS_
-	if (checker_running && bfd->checker) {
-		ret = write(bfd_checker_event_pipe[1], &evt, sizeof evt);
-		if (ret == -1 && __test_bit(LOG_DETAIL_BIT, &debug))
-			log_message(LOG_ERR, "BFD_Instance(%s) checker pipe write() error %m",
-				    bfd->iname);
+	if (checker_running && bfd->checker)
+		bfd_event_queue(&bfd_checker_event_chan, bfd, state, sent_time);
+#endif
+}
+
+void
+bfd_event_consumer_init(bfd_event_chan_t *chan)
+{
+	bfd_event_map_slots();
+
+	if (chan->cache && chan->cache_size == bfd_event_mapped_slots) {
+		memset(chan->cache, 0, chan->cache_size * sizeof(*chan->cache));
+		return;
+	}
+
+	FREE_PTR(chan->cache);
+	chan->cache = MALLOC(bfd_event_mapped_slots * sizeof(*chan->cache));
+	chan->cache_size = bfd_event_mapped_slots;
+}
+
+/* The tracking objects are freed on reload, so the cache must go with them */
+void
+bfd_event_consumer_release(bfd_event_chan_t *chan)
+{
+	if (chan->cache) {
+		FREE(chan->cache);
+		chan->cache = NULL;
+		chan->cache_size = 0;
+	}
+}
+
+/* Read the name of a slot, returns the generation or 1 if it could not be read */
+static uint32_t
+bfd_event_read_name(uint32_t slot, char *iname)
+{
+	const bfd_event_name_t *name = &bfd_event_slots[slot].name;
+	uint32_t gen;
+	unsigned i;
+
+	for (i = 0; i < BFD_EVENT_NAME_TRIES; i++) {
+		gen = __atomic_load_n(&name->gen, __ATOMIC_ACQUIRE);
+		if (gen & 1)
+			continue;
+		memcpy(iname, name->iname, BFD_INAME_MAX);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&name->gen, __ATOMIC_RELAXED) == gen) {
+			iname[BFD_INAME_MAX - 1] = '\0';
+			return gen;
+		}
+	}
+
+	return 1;
+}
+
+static void *
+bfd_event_resolve(bfd_event_chan_t *chan, uint32_t slot, bfd_event_lookup_t lookup)
+{
+	bfd_event_cache_t *cache;
+	char iname[BFD_INAME_MAX];
+	uint32_t gen;
+	void *obj;
+
+	/* The slots have been grown since the cache was allocated */
+	if (chan->cache && slot >= chan->cache_size) {
+		chan->cache = REALLOC(chan->cache, bfd_event_mapped_slots * sizeof(*chan->cache));
+		memset(chan->cache + chan->cache_size, 0, (bfd_event_mapped_slots - chan->cache_size) * sizeof(*chan->cache));
+		chan->cache_size = bfd_event_mapped_slots;
+	}
+	cache = chan->cache ? &chan->cache[slot] : NULL;
+
+	if (cache && cache->valid &&
+	    cache->gen == __atomic_load_n(&bfd_event_slots[slot].name.gen, __ATOMIC_ACQUIRE))
+		return cache->obj;
+
+	if ((gen = bfd_event_read_name(slot, iname)) & 1)
+		return NULL;
+
+	obj = iname[0] ? lookup(iname) : NULL;
+
+	if (cache) {
+		cache->gen = gen;
+		cache->obj = obj;
+		cache->valid = true;
+	}
+
+	return obj;
+}
+
+static void
+bfd_event_deliver(bfd_event_chan_t *chan, uint32_t index, bfd_event_lookup_t lookup, bfd_event_handler_t handler)
+{
+	bfd_event_state_t *slot;
+	bfd_event_t evt;
+	void *obj;
+
+	/* The BFD process has grown the slots */
+	if (index >= bfd_event_mapped_slots &&
+	    (!bfd_event_map_slots() || index >= bfd_event_mapped_slots))
+		return;
+
+	slot = &bfd_event_slots[index].chan[chan->index];
+
+	/* Already delivered by a rescan */
+	if (!__atomic_exchange_n(&slot->pending, 0, __ATOMIC_ACQ_REL))
+		return;
+
+	evt.state = (u_char)__atomic_load_n(&slot->state, __ATOMIC_RELAXED);
+	evt.sent_time = slot->sent_time;
+	chan->queue->received++;
+
+	if ((obj = bfd_event_resolve(chan, index, lookup)))
+		handler(obj, &evt);
+}
+
+void
+bfd_event_receive(bfd_event_chan_t *chan, bfd_event_lookup_t lookup, bfd_event_handler_t handler)
+{
+	uint64_t val;
+	uint32_t index;
+
+	if (read(chan->fd, &val, sizeof(val)) == -1 && errno != EAGAIN)
+		log_message(LOG_INFO, "BFD event fd read error - %d (%m)", errno);
+
+	while (spsc_ring_pop(chan->ring, &index))
+		bfd_event_deliver(chan, index, lookup, handler);
+
+	/* The ring overflowed, so look for events that weren't queued */
+	if (__atomic_exchange_n(&chan->queue->resync, 0, __ATOMIC_ACQ_REL)) {
+		bfd_event_map_slots();
+		for (index = 0; index < bfd_event_mapped_slots; index++) {
+			if (__atomic_load_n(&bfd_event_slots[index].chan[chan->index].pending, __ATOMIC_RELAXED))
+				bfd_event_deliver(chan, index, lookup, handler);
+		}
 	}
+}
+
+static void
+dump_bfd_event_channel(FILE *fp, const bfd_event_chan_t *chan, const char *name)
+{
+	const bfd_event_queue_t *queue = chan->queue;
+
+	if (!queue)
+		return;
+
+	conf_write(fp, " %s events: queued = %" PRIu64 ", coalesced = %" PRIu64 ", overflows = %" PRIu64 ", dropped = %" PRIu64 ", received = %" PRIu64,
+		   name, queue->sent, queue->coalesced, queue->overflows, queue->dropped, queue->received);
+}
+
+void
+dump_bfd_event_channels(FILE *fp)
+{
+	if (bfd_event_num_slots)
+		conf_write(fp, " event slots = %u", bfd_event_mapped_slots);
+#ifdef _WITH_VRRP_
+	dump_bfd_event_channel(fp, &bfd_vrrp_event_chan, "vrrp");
+#endif
+#ifdef _WITH_LVS_
+	dump_bfd_event_channel(fp, &bfd_checker_event_chan, "checker");
 #endif
 }
@@ -29,11 +29,15 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <netinet/udp.h>
+#include <linux/filter.h>
 
 #include "bfd.h"
 #include "bfd_data.h"
 #include "bfd_scheduler.h"
 #include "bfd_event.h"
+#include "global_data.h"
 #include "parser.h"
 #include "logger.h"
 #include "memory.h"
@@ -47,7 +51,7 @@
 #define	BFD_MIN_PORT	49152
 #define	BFD_MAX_PORT	65535
 
-static int bfd_send_packet(int, bfdpkt_t *, bool);
+static int bfd_send_packet(const bfd_t *, bfdpkt_t *);
 static void bfd_sender_schedule(bfd_t *);
 
 static void bfd_state_down(bfd_t *, u_char diag);
@@ -55,13 +59,6 @@ static void bfd_state_admindown(bfd_t *);
 static void bfd_state_up(bfd_t *);
 static void bfd_dump_timers(FILE *fp, bfd_t *);
 
-/*
- * Session sender thread
- *
- * Runs every local_tx_intv, or after reception of a packet
- * with Poll bit set
- */
-
 inline static unsigned long
 thread_time_to_wakeup(thread_ref_t thread)
 {
@@ -77,25 +74,131 @@ thread_time_to_wakeup(thread_ref_t thread)
 	return timer_long(tmp_time);
 }
 
-/* Sends one BFD control packet and reschedules itself if needed */
-static int
-bfd_sender_thread(thread_ref_t thread)
+/*
+ * Session transmit engine
+ *
+ * All instances waiting to send are kept in one queue ordered by the
+ * jittered time of their next packet, and a single timer runs
+ * bfd_tx_thread when the first is due. Instances due within the
+ * batch window are sent together, with one sendmmsg() call per shared
+ * socket. Immediate sends (e.g. a reply to a poll) are still sent by
+ * bfd_sender_thread as an event.
+ */
+
+/* Instances due within this time of the first are sent in the same batch */
+#define BFD_TX_WINDOW	(2 * TIMER_HZ / 1000)
+
+/* Maximum number of packets sent in one batch */
+#define BFD_TX_BATCH	64
+
+/* Space for IP_PKTINFO/IPV6_PKTINFO and IP_TTL/IPV6_HOPLIMIT */
+#define BFD_TX_CBUF_SIZE	(CMSG_SPACE(sizeof(struct in6_pktinfo)) + CMSG_SPACE(sizeof(int)))
+
+static bool bfd_tx_running;
+
+/* Adds the source address and TTL ancillary data for an instance. The
+ * shared sockets are not bound, and have the default TTL/hop limit set. */
+static void
+bfd_build_ancillary_data(struct msghdr *msg, char *cbuf, const bfd_t *bfd)
 {
-	bfd_t *bfd;
-	bfdpkt_t pkt;
+	struct cmsghdr *cmsg;
+	struct in_pktinfo *pktinfo;
+	struct in6_pktinfo *pktinfo6;
+	size_t len = 0;
+	int ttl = bfd->ttl;
+
+	memset(cbuf, 0, BFD_TX_CBUF_SIZE);
+	msg->msg_control = cbuf;
+	msg->msg_controllen = BFD_TX_CBUF_SIZE;
+	cmsg = CMSG_FIRSTHDR(msg);
+
+	if (bfd->src_addr.ss_family == AF_INET) {
+		cmsg->cmsg_level = IPPROTO_IP;
+		cmsg->cmsg_type = IP_PKTINFO;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+		pktinfo = (struct in_pktinfo *)CMSG_DATA(cmsg);
+		pktinfo->ipi_spec_dst = ((const struct sockaddr_in *)&bfd->src_addr)->sin_addr;
+		len += CMSG_SPACE(sizeof(struct in_pktinfo));
+		cmsg = CMSG_NXTHDR(msg, cmsg);
+	} else if (bfd->src_addr.ss_family == AF_INET6) {
+		cmsg->cmsg_level = IPPROTO_IPV6;
+		cmsg->cmsg_type = IPV6_PKTINFO;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+		pktinfo6 = (struct in6_pktinfo *)CMSG_DATA(cmsg);
+		pktinfo6->ipi6_addr = ((const struct sockaddr_in6 *)&bfd->src_addr)->sin6_addr;
+		len += CMSG_SPACE(sizeof(struct in6_pktinfo));
+		cmsg = CMSG_NXTHDR(msg, cmsg);
+	}
 
-	assert(thread);
-	bfd = THREAD_ARG(thread);
-	assert(bfd);
-	assert(!BFD_ISADMINDOWN(bfd));
+	if (bfd->ttl != (bfd->nbr_addr.ss_family == AF_INET ? BFD_CONTROL_TTL : BFD_CONTROL_HOPLIMIT)) {
+		cmsg->cmsg_level = bfd->nbr_addr.ss_family == AF_INET ? IPPROTO_IP : IPPROTO_IPV6;
+		cmsg->cmsg_type = bfd->nbr_addr.ss_family == AF_INET ? IP_TTL : IPV6_HOPLIMIT;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(ttl));
+		memcpy(CMSG_DATA(cmsg), &ttl, sizeof(ttl));
+		len += CMSG_SPACE(sizeof(ttl));
+	}
 
-	if (thread->type != THREAD_EVENT)
-		bfd->thread_out = NULL;
+	msg->msg_controllen = len;
+	if (!len)
+		msg->msg_control = NULL;
+}
 
-	bfd_build_packet(&pkt, bfd, bfd_buffer, BFD_BUFFER_SIZE);
-	if (bfd_send_packet(bfd->fd_out, &pkt, !bfd->send_error) == -1) {
+/* Builds the UDP header, since the shared sockets are raw sockets, and
+ * moves the destination port into it, since a raw socket requires the
+ * port in the address to be 0. The kernel calculates the IPv6 checksum
+ * (IPV6_CHECKSUM). The IPv4 checksum is optional, and can only be
+ * calculated here if we know the source address. */
+static void
+bfd_build_udp_header(struct udphdr *udph, const bfd_t *bfd, bfdpkt_t *pkt)
+{
+	struct sockaddr_in *dst4 = (struct sockaddr_in *)&pkt->dst_addr;
+	struct sockaddr_in6 *dst6 = (struct sockaddr_in6 *)&pkt->dst_addr;
+	const struct sockaddr_in *src4 = (const struct sockaddr_in *)&bfd->src_addr;
+	struct {
+		struct in_addr src;
+		struct in_addr dst;
+		uint8_t zero;
+		uint8_t proto;
+		uint16_t len;
+	} pseudo_hdr;
+	uint32_t acc;
+
+	udph->source = htons(bfd->src_port);
+	udph->len = htons((uint16_t)(sizeof(*udph) + pkt->len));
+	udph->check = 0;
+
+	if (pkt->dst_addr.ss_family == AF_INET6) {
+		udph->dest = dst6->sin6_port;
+		dst6->sin6_port = 0;
+		return;
+	}
+
+	udph->dest = dst4->sin_port;
+	dst4->sin_port = 0;
+
+	if (bfd->src_addr.ss_family != AF_INET || src4->sin_addr.s_addr == INADDR_ANY)
+		return;
+
+	pseudo_hdr.src = src4->sin_addr;
+	pseudo_hdr.dst = dst4->sin_addr;
+	pseudo_hdr.zero = 0;
+	pseudo_hdr.proto = IPPROTO_UDP;
+	pseudo_hdr.len = udph->len;
+
+	in_csum((const uint16_t *)&pseudo_hdr, sizeof(pseudo_hdr), 0, &acc);
+	in_csum((const uint16_t *)udph, sizeof(*udph), acc, &acc);
+	udph->check = in_csum((const uint16_t *)pkt->buf, pkt->len, acc, NULL);
+	if (!udph->check)
+		udph->check = 0xffff;
+}
+
+/* Records the result of sending a packet for an instance */
+static void
+bfd_sent(bfd_t *bfd, bool error)
+{
+	if (error) {
 		if (!bfd->send_error) {
-			log_message(LOG_ERR, "BFD_Instance(%s) Error sending packet", bfd->iname);
+			log_message(LOG_ERR, "BFD_Instance(%s) Error sending packet (%m)", bfd->iname);
 			bfd->send_error = true;
 		}
 	} else
@@ -103,10 +206,212 @@ bfd_sender_thread(thread_ref_t thread)
 
 	/* Reset final flag if set */
 	bfd->final = 0;
+}
 
-	/* Schedule next run if not called as an event thread */
-	if (thread->type != THREAD_EVENT)
-		bfd_sender_schedule(bfd);
+static int
+bfd_tx_cmp(const bfd_t *bfd1, const bfd_t *bfd2)
+{
+	if (bfd1->tx_due < bfd2->tx_due)
+		return -1;
+	if (bfd1->tx_due > bfd2->tx_due)
+		return 1;
+	return 0;
+}
+
+static int bfd_tx_thread(thread_ref_t);
+
+/* Sets the transmit timer for the first instance in the queue */
+static void
+bfd_tx_timer_update(void)
+{
+	bfd_t *bfd;
+	unsigned long now, timeout;
+
+	if (!bfd_data->tx_queue.rb_root.rb_node) {
+		if (bfd_data->thread_out) {
+			thread_cancel(bfd_data->thread_out);
+			bfd_data->thread_out = NULL;
+		}
+		return;
+	}
+
+	bfd = rb_entry(rb_first_cached(&bfd_data->tx_queue), bfd_t, tx_n);
+	now = timer_long(time_now);
+	timeout = bfd->tx_due > now ? bfd->tx_due - now : 0;
+
+	if (bfd_data->thread_out)
+		timer_thread_update_timeout(bfd_data->thread_out, timeout);
+	else
+		bfd_data->thread_out = thread_add_timer(master, bfd_tx_thread, bfd_data, timeout);
+}
+
+/* Queues an instance to send in timeout usecs */
+static void
+bfd_tx_queue(bfd_t *bfd, unsigned long timeout)
+{
+	unsigned long now = timer_long(time_now);
+
+	assert(!bfd->tx_queued);
+
+	bfd->tx_due = now + timeout;
+
+	/* RFC5880 allows the interval to be reduced by up to 25%, so the
+	 * packet can be sent early as part of a batch, but no earlier. */
+	bfd->tx_earliest = now + bfd->local_tx_intv - bfd->local_tx_intv / 4;
+	if (bfd->tx_earliest > bfd->tx_due)
+		bfd->tx_earliest = bfd->tx_due;
+
+	rb_insert_sort_cached(&bfd_data->tx_queue, bfd, tx_n, bfd_tx_cmp);
+	bfd->tx_queued = true;
+
+	if (!bfd_tx_running && rb_first_cached(&bfd_data->tx_queue) == &bfd->tx_n)
+		bfd_tx_timer_update();
+}
+
+static void
+bfd_tx_dequeue(bfd_t *bfd)
+{
+	assert(bfd->tx_queued);
+
+	rb_erase_cached(&bfd->tx_n, &bfd_data->tx_queue);
+	bfd->tx_queued = false;
+}
+
+/* Sends a batch of packets, with one sendmmsg() call per socket */
+static void
+bfd_tx_send_batch(bfd_t **batch, unsigned num)
+{
+	static char bufs[BFD_TX_BATCH][BFD_BUFFER_SIZE];
+	static char cbufs[BFD_TX_BATCH][BFD_TX_CBUF_SIZE];
+	static struct mmsghdr mmsg[BFD_TX_BATCH];
+	static struct iovec iov[BFD_TX_BATCH][2];
+	static struct udphdr udph[BFD_TX_BATCH];
+	static bfdpkt_t pkt[BFD_TX_BATCH];
+	static bfd_t *order[BFD_TX_BATCH];
+	unsigned i, k, n = 0;
+	unsigned start, sent;
+	int fd, ret;
+
+	/* Group the packets by socket */
+	for (i = 0; i < 2; i++) {
+		fd = bfd_data->tx_sock[i].fd;
+		if (fd == -1)
+			continue;
+		for (k = 0; k < num; k++) {
+			if (batch[k]->fd_out == fd)
+				order[n++] = batch[k];
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		bfd_build_packet(&pkt[i], order[i], bufs[i], BFD_BUFFER_SIZE);
+		bfd_build_udp_header(&udph[i], order[i], &pkt[i]);
+
+		memset(&mmsg[i], 0, sizeof(mmsg[i]));
+		iov[i][0].iov_base = &udph[i];
+		iov[i][0].iov_len = sizeof(udph[i]);
+		iov[i][1].iov_base = bufs[i];
+		iov[i][1].iov_len = pkt[i].len;
+		mmsg[i].msg_hdr.msg_iov = iov[i];
+		mmsg[i].msg_hdr.msg_iovlen = 2;
+		mmsg[i].msg_hdr.msg_name = &pkt[i].dst_addr;
+		mmsg[i].msg_hdr.msg_namelen = pkt[i].dst_addr.ss_family == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+		bfd_build_ancillary_data(&mmsg[i].msg_hdr, cbufs[i], order[i]);
+	}
+
+	for (start = 0; start < n; start = i) {
+		fd = order[start]->fd_out;
+		for (i = start + 1; i < n && order[i]->fd_out == fd; i++);
+
+		/* If a send fails, sendmmsg() returns the number sent before the
+		 * failure, and the next call reports the error for the failing
+		 * packet. */
+		for (sent = start; sent < i; ) {
+#ifdef HAVE_SENDMMSG
+			ret = sendmmsg(fd, &mmsg[sent], i - sent, 0);
+#else
+			ret = sendmsg(fd, &mmsg[sent].msg_hdr, 0) == -1 ? -1 : 1;
+#endif
+			bfd_data->tx_calls++;
+			if (ret > 0) {
+				for (k = sent; k < sent + (unsigned)ret; k++)
+					bfd_sent(order[k], false);
+				sent += (unsigned)ret;
+				continue;
+			}
+
+			if (ret == -1 && check_EINTR(errno))
+				continue;
+
+			bfd_sent(order[sent], true);
+			sent++;
+		}
+	}
+
+	bfd_data->tx_packets += n;
+	bfd_data->tx_batches++;
+}
+
+/* Sends all the packets that are due, and reschedules the instances */
+static int
+bfd_tx_thread(thread_ref_t thread)
+{
+	bfd_data_t *data = THREAD_ARG(thread);
+	bfd_t *batch[BFD_TX_BATCH];
+	bfd_t *bfd, *bfd_tmp;
+	unsigned long now, limit;
+	unsigned num, i;
+
+	data->thread_out = NULL;
+	bfd_tx_running = true;
+
+	now = timer_long(time_now);
+	limit = now + BFD_TX_WINDOW;
+
+	do {
+		num = 0;
+		rb_for_each_entry_safe_cached(bfd, bfd_tmp, &data->tx_queue, tx_n) {
+			if (bfd->tx_due > limit || num == BFD_TX_BATCH)
+				break;
+
+			/* Sending now would shorten the interval too much */
+			if (bfd->tx_earliest > now)
+				continue;
+
+			assert(!BFD_ISADMINDOWN(bfd));
+			bfd_tx_dequeue(bfd);
+			batch[num++] = bfd;
+		}
+
+		if (!num)
+			break;
+
+		bfd_tx_send_batch(batch, num);
+
+		for (i = 0; i < num; i++)
+			bfd_sender_schedule(batch[i]);
+	} while (num == BFD_TX_BATCH);
+
+	bfd_tx_running = false;
+	bfd_tx_timer_update();
+
+	return 0;
+}
+
+/* Sends one BFD control packet immediately */
+static int
+bfd_sender_thread(thread_ref_t thread)
+{
+	bfd_t *bfd;
+	bfdpkt_t pkt;
+
+	assert(thread);
+	bfd = THREAD_ARG(thread);
+	assert(bfd);
+	assert(!BFD_ISADMINDOWN(bfd));
+
+	bfd_build_packet(&pkt, bfd, bfd_buffer, BFD_BUFFER_SIZE);
+	bfd_sent(bfd, bfd_send_packet(bfd, &pkt) == -1);
 
 	return 0;
 }
@@ -136,71 +441,70 @@ get_jitter(bfd_t * bfd)
 	return rand_intv(min_jitter, bfd->local_tx_intv / 4);	/* 25% <=> / 4 */
 }
 
-/* Schedules bfd_sender_thread to run in local_tx_intv minus applied jitter */
+/* Queues the instance to send in local_tx_intv minus applied jitter */
 static void
 bfd_sender_schedule(bfd_t *bfd)
 {
 	assert(bfd);
-	assert(!bfd->thread_out);
+	assert(!bfd->tx_queued);
 
-	bfd->thread_out =
-	    thread_add_timer(master, bfd_sender_thread, bfd,
-			     bfd->local_tx_intv - get_jitter(bfd));
+	bfd_tx_queue(bfd, bfd->local_tx_intv - get_jitter(bfd));
 }
 
-/* Cancels bfd_sender_thread run */
+/* Removes the instance from the transmit queue */
 static void
 bfd_sender_cancel(bfd_t *bfd)
 {
 	assert(bfd);
-	assert(bfd->thread_out);
+	assert(bfd->tx_queued);
 
-	thread_cancel(bfd->thread_out);
-	bfd->thread_out = NULL;
+	bfd_tx_dequeue(bfd);
 }
 
-/* Reschedules bfd_sender_thread run (usually after local_tx_intv change) */
+/* Requeues the instance (usually after local_tx_intv change) */
 static void
 bfd_sender_reschedule(bfd_t *bfd)
 {
 	assert(bfd);
-	assert(bfd->thread_out);
+	assert(bfd->tx_queued);
 
-	timer_thread_update_timeout(bfd->thread_out, bfd->local_tx_intv - get_jitter(bfd));
+	bfd_tx_dequeue(bfd);
+	bfd_tx_queue(bfd, bfd->local_tx_intv - get_jitter(bfd));
 }
 
-/* Returns 1 if bfd_sender_thread is scheduled to run, 0 otherwise */
+/* Returns 1 if the instance is queued to send, 0 otherwise */
 static int __attribute__ ((pure))
 bfd_sender_scheduled(bfd_t *bfd)
 {
 	assert(bfd);
 
-	return bfd->thread_out != NULL;
+	return bfd->tx_queued;
 }
 
-/* Suspends sender thread. Needs freshly updated time_now */
+/* Suspends sender. Needs freshly updated time_now */
 static void
 bfd_sender_suspend(bfd_t * bfd)
 {
+	unsigned long now = timer_long(time_now);
+
 	assert(bfd);
-	assert(bfd->thread_out);
+	assert(bfd->tx_queued);
 	assert(bfd->sands_out == TIMER_NEVER);
 
-	bfd->sands_out = thread_time_to_wakeup(bfd->thread_out);
+	bfd->sands_out = bfd->tx_due > now ? bfd->tx_due - now : 1;
 	bfd_sender_cancel(bfd);
 }
 
-/* Resumes sender thread */
+/* Resumes sender */
 static void
 bfd_sender_resume(bfd_t *bfd)
 {
 	assert(bfd);
-	assert(!bfd->thread_out);
+	assert(!bfd->tx_queued);
 	assert(bfd->sands_out != TIMER_NEVER);
 
 	if (!bfd->passive || bfd->local_state == BFD_STATE_UP)
-		bfd->thread_out =
-		    thread_add_timer(master, bfd_sender_thread, bfd, bfd->sands_out);
+		bfd_tx_queue(bfd, bfd->sands_out);
 	bfd->sands_out = TIMER_NEVER;
 }
 
@@ -295,14 +599,20 @@ bfd_expire_cancel(bfd_t *bfd)
 	bfd->thread_exp = NULL;
 }
 
-/* Reschedules bfd_expire_thread run (usually after control packet receipt) */
+/* Reschedules bfd_expire_thread run (usually after control packet receipt).
+ * The detection time runs from when the last packet was received. */
 static void
 bfd_expire_reschedule(bfd_t *bfd)
 {
+	unsigned long expire, now;
+
 	assert(bfd);
 	assert(bfd->thread_exp);
 
-	timer_thread_update_timeout(bfd->thread_exp, bfd->local_detect_time);
+	expire = timer_long(bfd->last_seen) + bfd->local_detect_time;
+	now = timer_long(time_now);
+
+	timer_thread_update_timeout(bfd->thread_exp, expire > now ? expire - now : 1);
 }
 
 /* Returns 1 if bfd_expire_thread is scheduled to run, 0 otherwise */
@@ -492,7 +802,7 @@ bfd_state_down(bfd_t *bfd, u_char diag)
 	int old_state = bfd->local_state;
 
 	if (bfd->local_state == BFD_STATE_UP)
-		bfd->local_discr = bfd_get_random_discr(bfd_data);
+		bfd_set_random_discr(bfd);
 
 	if (bfd->local_state == BFD_STATE_UP ||
 	    __test_bit(LOG_EXTRA_DETAIL_BIT, &debug))
@@ -614,28 +924,77 @@ bfd_dump_timers(FILE *fp, bfd_t *bfd)
 /* Sends a control packet to the neighbor (called from bfd_sender_thread)
    returns -1 on error */
 static int
-bfd_send_packet(int fd, bfdpkt_t *pkt, bool log_error)
+bfd_send_packet(const bfd_t *bfd, bfdpkt_t *pkt)
 {
+	struct msghdr msg;
+	struct iovec iov[2];
+	struct udphdr udph;
+	char cbuf[BFD_TX_CBUF_SIZE];
 	int ret;
-	socklen_t dstlen;
 
-	assert(fd >= 0);
+	assert(bfd->fd_out >= 0);
 	assert(pkt);
 
+	bfd_build_udp_header(&udph, bfd, pkt);
+
+	memset(&msg, 0, sizeof(msg));
+	iov[0].iov_base = &udph;
+	iov[0].iov_len = sizeof(udph);
+	iov[1].iov_base = no_const_char_p(pkt->buf);
+	iov[1].iov_len = pkt->len;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	msg.msg_name = &pkt->dst_addr;
 	if (pkt->dst_addr.ss_family == AF_INET)
-		dstlen = sizeof (struct sockaddr_in);
+		msg.msg_namelen = sizeof (struct sockaddr_in);
 	else
-		dstlen = sizeof (struct sockaddr_in6);
+		msg.msg_namelen = sizeof (struct sockaddr_in6);
+	bfd_build_ancillary_data(&msg, cbuf, bfd);
 
-	ret =
-	    sendto(fd, pkt->buf, pkt->len, 0,
-		   (struct sockaddr *) &pkt->dst_addr, dstlen);
-	if (ret == -1 && log_error)
-		log_message(LOG_ERR, "sendto() error (%m)");
+	while ((ret = sendmsg(bfd->fd_out, &msg, 0)) == -1 && check_EINTR(errno));
+
+	bfd_data->tx_calls++;
+	if (ret != -1)
+		bfd_data->tx_packets++;
 
 	return ret;
 }
 
+/* Sets the time the last packet was received. If the kernel receive time
+ * is known, the time the packet waited to be processed is recorded, and
+ * excluded from the last seen time. */
+static void
+bfd_set_last_seen(bfd_t *bfd, const bfdpkt_t *pkt)
+{
+	struct timespec rt_now;
+	int64_t latency;
+	unsigned bucket;
+	uint32_t limit;
+	timeval_t latency_tv;
+
+	bfd->last_seen = timer_now();
+
+	if (!pkt->rx_ts.tv_sec)
+		return;
+
+	/* The kernel time is CLOCK_REALTIME, so compare it with that */
+	clock_gettime(CLOCK_REALTIME, &rt_now);
+	latency = (int64_t)(rt_now.tv_sec - pkt->rx_ts.tv_sec) * TIMER_HZ + (rt_now.tv_nsec - pkt->rx_ts.tv_nsec) / 1000;
+
+	/* Ignore the timestamp if the clock has been stepped */
+	if (latency < 0 || latency >= TIMER_HZ)
+		return;
+
+	for (bucket = 0, limit = 10; bucket < BFD_RX_LATENCY_BUCKETS - 1 && latency >= limit; bucket++, limit *= 10);
+	bfd->rx_latency_hist[bucket]++;
+	if ((uint32_t)latency > bfd->rx_latency_max)
+		bfd->rx_latency_max = (uint32_t)latency;
+
+	latency_tv.tv_sec = 0;
+	latency_tv.tv_usec = (suseconds_t)latency;
+	timersub(&bfd->last_seen, &latency_tv, &bfd->last_seen);
+}
+
 /* Handles incoming control packet (called from bfd_receiver_thread) and
    processes it through a BFD state machine. */
 static void
@@ -803,7 +1162,7 @@ bfd_handle_packet(bfdpkt_t *pkt)
 	}
 
 	/* Update last seen timer */
-	bfd->last_seen = timer_now();
+	bfd_set_last_seen(bfd, pkt);
 
 	/* Delay expiration if scheduled */
 	if (bfd->local_state == BFD_STATE_UP &&
@@ -811,50 +1170,53 @@ bfd_handle_packet(bfdpkt_t *pkt)
 		bfd_expire_reschedule(bfd);
 }
 
-/* Reads one packet from input socket */
+/* Space for IPV6_PKTINFO, IP_TTL/IPV6_HOPLIMIT and SCM_TIMESTAMPNS */
+#define BFD_RX_CBUF_SIZE	(CMSG_SPACE(sizeof (struct in6_pktinfo)) + CMSG_SPACE(sizeof(unsigned int)) + CMSG_SPACE(sizeof(struct timespec)))
+
+#ifdef HAVE_RECVMMSG
+/* Maximum number of packets read by one recvmmsg() call */
+#define BFD_RX_BATCH		32
+
+/* Maximum number of recvmmsg() calls before returning to the scheduler */
+#define BFD_RX_MAX_LOOPS	4
+#endif
+
+static void
+bfd_init_rx_msg(struct msghdr *msg, struct iovec *iov, bfdpkt_t *pkt, char *buf, size_t bufsz, char *cbuf)
+{
+	iov->iov_base = buf;
+	iov->iov_len = bufsz;
+
+	msg->msg_name = &pkt->src_addr;
+	msg->msg_namelen = sizeof (pkt->src_addr);
+	msg->msg_iov = iov;
+	msg->msg_iovlen = 1;
+	msg->msg_control = cbuf;
+	msg->msg_controllen = BFD_RX_CBUF_SIZE;
+	msg->msg_flags = 0;	/* Unnecessary, but keep coverity happy */
+
+	pkt->rx_ts.tv_sec = 0;
+	pkt->rx_ts.tv_nsec = 0;
+}
+
+/* Fills in pkt from a received message */
 static int
-bfd_receive_packet(bfdpkt_t *pkt, int fd, char *buf, ssize_t bufsz)
+bfd_parse_rx_msg(bfdpkt_t *pkt, struct msghdr *msg, size_t len, char *buf)
 {
-	ssize_t len;
 	unsigned int ttl = 0;
-	struct msghdr msg;
 	struct cmsghdr *cmsg = NULL;
-	char cbuf[CMSG_SPACE(sizeof (struct in6_pktinfo)) + CMSG_SPACE(sizeof(ttl))];
-	struct iovec iov[1];
 	struct in6_pktinfo *pktinfo;
 
-	assert(pkt);
-	assert(fd >= 0);
-	assert(buf);
-	assert(bufsz);
-
-	iov[0].iov_base = buf;
-	iov[0].iov_len = bufsz;
-
-	msg.msg_name = &pkt->src_addr;
-	msg.msg_namelen = sizeof (pkt->src_addr);
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 1;
-	msg.msg_control = cbuf;
-	msg.msg_controllen = sizeof (cbuf);
-	msg.msg_flags = 0;	/* Unnecessary, but keep coverity happy */
-
-	len = recvmsg(fd, &msg, MSG_DONTWAIT);
-	if (len == -1) {
-		log_message(LOG_ERR, "recvmsg() error (%m)");
-		return 1;
-	}
-
-	if (msg.msg_flags & MSG_TRUNC) {
+	if (msg->msg_flags & MSG_TRUNC) {
 		log_message(LOG_WARNING, "recvmsg() message truncated");
 		return 1;
 	}
 
-	if (msg.msg_flags & MSG_CTRUNC)
+	if (msg->msg_flags & MSG_CTRUNC)
 		log_message(LOG_WARNING, "recvmsg() control message truncated");
 
-	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
-	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(msg, cmsg)) {
 		if ((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TTL) ||
 		    (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_HOPLIMIT))
 			ttl = *CMSG_DATA(cmsg);
@@ -868,6 +1230,8 @@ bfd_receive_packet(bfdpkt_t *pkt, int fd, char *buf, ssize_t bufsz)
 				pkt->dst_addr.ss_family = AF_INET6;
 			}
 		}
+		else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+			memcpy(&pkt->rx_ts, CMSG_DATA(cmsg), sizeof(pkt->rx_ts));
 		else
 			log_message(LOG_WARNING, "recvmsg() received"
 				    " unexpected control message (level %d type %d)",
@@ -890,6 +1254,82 @@ bfd_receive_packet(bfdpkt_t *pkt, int fd, char *buf, ssize_t bufsz)
 	return 0;
 }
 
+#ifdef HAVE_RECVMMSG
+/* Reads up to BFD_RX_BATCH packets from the input socket, and handles
+ * them. Returns the number of packets read. */
+static unsigned
+bfd_receive_batch(bfd_data_t *data, int fd)
+{
+	static char bufs[BFD_RX_BATCH][BFD_BUFFER_SIZE];
+	static char cbufs[BFD_RX_BATCH][BFD_RX_CBUF_SIZE];
+	static struct mmsghdr mmsg[BFD_RX_BATCH];
+	static struct iovec iov[BFD_RX_BATCH];
+	static bfdpkt_t pkt[BFD_RX_BATCH];
+	unsigned i, bucket;
+	int ret;
+
+	for (i = 0; i < BFD_RX_BATCH; i++) {
+		bfd_init_rx_msg(&mmsg[i].msg_hdr, &iov[i], &pkt[i], bufs[i], BFD_BUFFER_SIZE, cbufs[i]);
+		mmsg[i].msg_len = 0;
+	}
+
+	while ((ret = recvmmsg(fd, mmsg, BFD_RX_BATCH, MSG_DONTWAIT, NULL)) == -1 && check_EINTR(errno));
+
+	data->rx_calls++;
+
+	if (ret == -1) {
+		if (!check_EAGAIN(errno))
+			log_message(LOG_ERR, "recvmmsg() error (%m)");
+		return 0;
+	}
+
+	if (!ret)
+		return 0;
+
+	data->rx_packets += (unsigned)ret;
+	if (ret == BFD_RX_BATCH)
+		data->rx_full_batches++;
+	for (bucket = 0; bucket < BFD_RX_HIST_BUCKETS - 1 && (2U << bucket) <= (unsigned)ret; bucket++);
+	data->rx_batch_hist[bucket]++;
+
+	for (i = 0; i < (unsigned)ret; i++) {
+		if (!bfd_parse_rx_msg(&pkt[i], &mmsg[i].msg_hdr, mmsg[i].msg_len, bufs[i]))
+			bfd_handle_packet(&pkt[i]);
+	}
+
+	return (unsigned)ret;
+}
+#else
+/* Reads one packet from input socket */
+static int
+bfd_receive_packet(bfdpkt_t *pkt, int fd, char *buf, ssize_t bufsz)
+{
+	ssize_t len;
+	struct msghdr msg;
+	char cbuf[BFD_RX_CBUF_SIZE];
+	struct iovec iov[1];
+
+	assert(pkt);
+	assert(fd >= 0);
+	assert(buf);
+	assert(bufsz);
+
+	bfd_init_rx_msg(&msg, iov, pkt, buf, bufsz, cbuf);
+
+	len = recvmsg(fd, &msg, MSG_DONTWAIT);
+	if (len == -1) {
+		log_message(LOG_ERR, "recvmsg() error (%m)");
+		return 1;
+	}
+
+	bfd_data->rx_calls++;
+	bfd_data->rx_packets++;
+	bfd_data->rx_batch_hist[0]++;
+
+	return bfd_parse_rx_msg(pkt, &msg, len, buf);
+}
+#endif
+
 /*
  * Reciever thread
  */
@@ -899,7 +1339,11 @@ static int
 bfd_receiver_thread(thread_ref_t thread)
 {
 	bfd_data_t *data;
+#ifdef HAVE_RECVMMSG
+	unsigned loops;
+#else
 	bfdpkt_t pkt;
+#endif
 	int fd;
 
 	assert(thread);
@@ -914,8 +1358,16 @@ bfd_receiver_thread(thread_ref_t thread)
 
 	/* Ignore THREAD_READ_TIMEOUT */
 	if (thread->type == THREAD_READY_READ_FD) {
+#ifdef HAVE_RECVMMSG
+		/* Drain the socket, but don't starve other threads */
+		for (loops = 0; loops < BFD_RX_MAX_LOOPS; loops++) {
+			if (bfd_receive_batch(data, fd) < BFD_RX_BATCH)
+				break;
+		}
+#else
 		if (!bfd_receive_packet(&pkt, fd, bfd_buffer, BFD_BUFFER_SIZE))
 			bfd_handle_packet(&pkt);
+#endif
 	}
 
 	data->thread_in =
@@ -1004,98 +1456,123 @@ read_local_port_range(uint32_t port_limits[2])
 	return true;
 }
 
-/* Prepares UDP socket for sending data to neighbor */
+/* Source ports allocated to instances, indexed from BFD_MIN_PORT */
+static unsigned long bfd_ports_used[(BFD_MAX_PORT - BFD_MIN_PORT + 1) / BIT_PER_LONG];
+
+static void
+bfd_src_port_range(uint32_t port_limits[2])
+{
+	/* Use the local port range, within the range allowed by RFC5881 */
+	read_local_port_range(port_limits);
+	if (port_limits[0] < BFD_MIN_PORT)
+		port_limits[0] = BFD_MIN_PORT;
+	if (port_limits[1] > BFD_MAX_PORT)
+		port_limits[1] = BFD_MAX_PORT;
+
+	/* Ensure we have a range of at least 1024 ports (an arbitrary number)
+	 * to choose from. */
+	if (port_limits[0] + 1023 > port_limits[1]) {
+		/* Just use the BFD defaults */
+		port_limits[0] = BFD_MIN_PORT;
+		port_limits[1] = BFD_MAX_PORT;
+	}
+}
+
+/* RFC5881 requires all the packets of a session to have the same source
+ * port, and the port SHOULD be unique among all sessions. A port is only
+ * shared if all the ports in the range are in use. */
+static void
+bfd_alloc_src_port(bfd_t *bfd, const uint32_t port_limits[2])
+{
+	uint16_t orig_port, port;
+
+	orig_port = port = (uint16_t)rand_intv(port_limits[0], port_limits[1]);
+	while (__test_bit(port - BFD_MIN_PORT, bfd_ports_used)) {
+		if (++port > port_limits[1])
+			port = (uint16_t)port_limits[0];
+		if (port == orig_port)
+			break;
+	}
+
+	__set_bit(port - BFD_MIN_PORT, bfd_ports_used);
+	bfd->src_port = port;
+}
+
+/* Prepares a shared raw UDP socket for sending data to neighbors. The
+ * UDP header is built for each packet, so that each instance has its own
+ * source port, and the source address is set with IP_PKTINFO/IPV6_PKTINFO.
+ * A raw UDP socket would be given a copy of every UDP packet received, so
+ * a filter that drops them all is attached. */
 static int
-bfd_open_fd_out(bfd_t *bfd)
+bfd_open_tx_sock(bfd_tx_sock_t *sock, int family)
 {
+	struct sock_filter drop_all[] = { BPF_STMT(BPF_RET | BPF_K, 0) };
+	struct sock_fprog fprog = { .len = 1, .filter = drop_all };
+	int csum_offset = offsetof(struct udphdr, check);
 	int ttl;
 	int ret;
-	uint32_t port_limits[2];
-	uint16_t orig_port, port;
 
-	assert(bfd);
-	assert(bfd->fd_out == -1);
+	assert(sock->fd == -1);
 
-	bfd->fd_out = socket(bfd->nbr_addr.ss_family, SOCK_DGRAM, IPPROTO_UDP);
-	if (bfd->fd_out == -1) {
-		log_message(LOG_ERR, "BFD_Instance(%s) socket() error (%m)",
-			    bfd->iname);
+	sock->fd = socket(family, SOCK_RAW, IPPROTO_UDP);
+	if (sock->fd == -1) {
+		log_message(LOG_ERR, "BFD transmit socket() error (%m)");
 		return 1;
 	}
 
-	if (bfd->src_addr.ss_family) {
-		/* Generate a random port number within the valid range */
-		read_local_port_range(port_limits);
-		if (port_limits[0] < BFD_MIN_PORT)
-			port_limits[0] = BFD_MIN_PORT;
-		if (port_limits[1] > BFD_MAX_PORT)
-			port_limits[1] = BFD_MAX_PORT;
-
-		/* Ensure we have a range of at least 1024 ports (an arbitrary number)
-		 * to try. */
-		if (port_limits[0] + 1023 > port_limits[1]) {
-			/* Just use the BFD defaults */
-			port_limits[0] = BFD_MIN_PORT;
-			port_limits[1] = BFD_MAX_PORT;
-		}
-
-		orig_port = port = rand_intv(port_limits[0], port_limits[1]);
-		do {
-			/* Try binding socket to the address until we find one available */
-			if (bfd->src_addr.ss_family == AF_INET)
-				((struct sockaddr_in *)&bfd->src_addr)->sin_port = htons(port);
-			else
-				((struct sockaddr_in6 *)&bfd->src_addr)->sin6_port = htons(port);
-
-			ret = bind(bfd->fd_out, (struct sockaddr *) &bfd->src_addr,
-				   sizeof (struct sockaddr));
-
-			if (ret == -1 && errno == EADDRINUSE) {
-				/* Port already in use, try next */
-				if (++port > port_limits[1])
-					port = port_limits[0];
-				if (port == orig_port)
-					break;
-				continue;
-			}
+	if (setsockopt(sock->fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) == -1) {
+		log_message(LOG_ERR, "BFD transmit socket setsockopt(SO_ATTACH_FILTER) error (%m)");
+		return 1;
+	}
 
-			break;
-		} while (true);
+	if (family == AF_INET6 &&
+	    setsockopt(sock->fd, IPPROTO_IPV6, IPV6_CHECKSUM, &csum_offset, sizeof(csum_offset)) == -1) {
+		log_message(LOG_ERR, "BFD transmit socket setsockopt(IPV6_CHECKSUM) error (%m)");
+		return 1;
+	}
 
-		if (ret == -1) {
-			log_message(LOG_ERR,
-				    "BFD_Instance(%s) bind() error (%m)",
-				    bfd->iname);
-			return 1;
-		}
+	/* Instances with a different TTL/hop limit set it per packet */
+	if (family == AF_INET) {
+		ttl = BFD_CONTROL_TTL;
+		ret = setsockopt(sock->fd, IPPROTO_IP, IP_TTL, &ttl, sizeof (ttl));
 	} else {
-		/* We have a problem here - we do not have a source address, and so
-		 * cannot bind the socket. That means that we will get a system allocated
-		 * port, which may be outside the range [49152, 65535], as specified in
-		 * RFC5881. */
+		ttl = BFD_CONTROL_HOPLIMIT;
+		ret = setsockopt(sock->fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &ttl, sizeof (ttl));
 	}
 
-	ttl = bfd->ttl;
-	if (bfd->nbr_addr.ss_family == AF_INET)
-		ret = setsockopt(bfd->fd_out, IPPROTO_IP, IP_TTL, &ttl, sizeof (ttl));
-	else
-		ret = setsockopt(bfd->fd_out, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &ttl, sizeof (ttl));
-
 	if (ret == -1) {
-		log_message(LOG_ERR, "BFD_Instance(%s) setsockopt() "
-			    " error (%m)", bfd->iname);
+		log_message(LOG_ERR, "BFD transmit socket setsockopt() error (%m)");
 		return 1;
 	}
 
 	return 0;
 }
 
+static void
+bfd_close_tx_socks(bfd_data_t *data)
+{
+	bfd_tx_sock_t *sock;
+	unsigned i;
+
+	for (i = 0; i < 2; i++) {
+		sock = &data->tx_sock[i];
+		if (sock->fd != -1) {
+			close(sock->fd);
+			sock->fd = -1;
+		}
+		sock->sessions = 0;
+	}
+}
+
 /* Opens all needed sockets */
 static int
 bfd_open_fds(bfd_data_t *data)
 {
 	bfd_t *bfd;
 	element e;
+	bfd_tx_sock_t *sock;
+	uint32_t port_limits[2];
+	int timestamps;
 
 	assert(data);
 	assert(data->bfd);
@@ -1110,16 +1587,46 @@ bfd_open_fds(bfd_data_t *data)
 		}
 	}
 
+	/* This may have changed on reload */
+	timestamps = global_data->bfd_rx_timestamps;
+	if (setsockopt(data->fd_in, SOL_SOCKET, SO_TIMESTAMPNS, &timestamps, sizeof(timestamps)) == -1)
+		log_message(LOG_INFO, "setsockopt(SO_TIMESTAMPNS) error %d (%m)", errno);
+
+	/* Instances carried over from the old configuration keep their
+	 * source port, and new instances are given unused ones */
+	memset(bfd_ports_used, 0, sizeof(bfd_ports_used));
+	bfd_src_port_range(port_limits);
+	for (e = LIST_HEAD(data->bfd); e; ELEMENT_NEXT(e)) {
+		bfd = ELEMENT_DATA(e);
+		if (bfd->src_port >= BFD_MIN_PORT &&
+		    __test_and_set_bit(bfd->src_port - BFD_MIN_PORT, bfd_ports_used))
+			bfd->src_port = 0;
+	}
+
+	/* All the instances of each family share a socket */
 	for (e = LIST_HEAD(data->bfd); e; ELEMENT_NEXT(e)) {
 		bfd = ELEMENT_DATA(e);
 		assert(bfd);
 
-		if (bfd_open_fd_out(bfd)) {
+		sock = &data->tx_sock[bfd->nbr_addr.ss_family == AF_INET6];
+
+		if (sock->fd == -1 && bfd_open_tx_sock(sock, bfd->nbr_addr.ss_family)) {
+			if (sock->fd != -1) {
+				close(sock->fd);
+				sock->fd = -1;
+			}
 			log_message(LOG_ERR, "BFD_Instance(%s) Unable to"
 				    " open output socket, disabling instance",
 				    bfd->iname);
 			bfd_state_admindown(bfd);
+			continue;
 		}
+
+		if (bfd->src_port < BFD_MIN_PORT)
+			bfd_alloc_src_port(bfd, port_limits);
+
+		bfd->fd_out = sock->fd;
+		sock->sessions++;
 	}
 
 	return 0;
@@ -1215,12 +1722,15 @@ bfd_dispatcher_release(bfd_data_t *data)
 		if (bfd_reset_scheduled(bfd))
 			bfd_reset_suspend(bfd);
 
-		assert(bfd->fd_out != -1);
-
-		close(bfd->fd_out);
 		bfd->fd_out = -1;
 	}
 
+	if (data->thread_out) {
+		thread_cancel(data->thread_out);
+		data->thread_out = NULL;
+	}
+	bfd_close_tx_socks(data);
+
 	cancel_signal_read_thread();
 }
 
@@ -1247,6 +1757,7 @@ void
 register_bfd_scheduler_addresses(void)
 {
 	register_thread_address("bfd_sender_thread", bfd_sender_thread);
+	register_thread_address("bfd_tx_thread", bfd_tx_thread);
 	register_thread_address("bfd_expire_thread", bfd_expire_thread);
 	register_thread_address("bfd_reset_thread", bfd_reset_thread);
 	register_thread_address("bfd_receiver_thread", bfd_receiver_thread);
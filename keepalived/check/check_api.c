@@ -25,6 +25,8 @@
 #include <dlfcn.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
 #include <arpa/inet.h>
 
 #include "check_api.h"
@@ -52,6 +54,17 @@
 #include "bfd_daemon.h"
 #endif
 #include "track_file.h"
+#include "notify.h"
+#ifdef _WITH_CHECKER_WORKERS_
+#include "check_worker.h"
+#endif
+
+/* The checkers of the configuration being replaced by a reload, sorted
+ * so that the checker a thread is running can be found */
+typedef struct _reload_checker {
+	checker_t		*checker;
+	bool			has_thread;
+} reload_checker_t;
 
 /* Global vars */
 list checkers_queue;
@@ -59,6 +72,11 @@ list checkers_queue;
 bool do_checker_debug;
 #endif
 
+/* Local vars */
+static reload_checker_t *reload_checkers;
+static size_t num_reload_checkers;
+static list_head_t reload_threads = LIST_HEAD_INIT(reload_threads);
+
 /* free checker data */
 static void
 free_checker(void *data)
@@ -518,6 +536,105 @@ free_checkers_queue(void)
 	free_list(&checkers_queue);
 }
 
+static int
+reload_checker_cmp(const void *a, const void *b)
+{
+	const reload_checker_t *rc_a = a;
+	const reload_checker_t *rc_b = b;
+
+	if (rc_a->checker == rc_b->checker)
+		return 0;
+
+	return (uintptr_t)rc_a->checker < (uintptr_t)rc_b->checker ? -1 : 1;
+}
+
+static reload_checker_t * __attribute__ ((pure))
+find_reload_checker(void *arg)
+{
+	reload_checker_t key = { .checker = arg };
+
+	return bsearch(&key, reload_checkers, num_reload_checkers, sizeof(*reload_checkers), reload_checker_cmp);
+}
+
+static bool __attribute__ ((pure))
+is_checker_thread(thread_ref_t thread)
+{
+	return !!find_reload_checker(thread->arg);
+}
+
+/* Called before the threads are cleaned up for a reload. The threads
+ * of the checkers are set aside, so that those of the checkers of
+ * unchanged virtual servers can carry on running after the reload. */
+void
+park_checker_threads(void)
+{
+	checker_t *checker;
+	element e;
+
+	if (LIST_ISEMPTY(checkers_queue))
+		return;
+
+	reload_checkers = MALLOC(LIST_SIZE(checkers_queue) * sizeof(*reload_checkers));
+	num_reload_checkers = 0;
+	LIST_FOREACH(checkers_queue, checker, e) {
+		/* Set by clear_diff_services() if the checker is kept */
+		checker->reloaded = false;
+#ifdef _WITH_CHECKER_WORKERS_
+		/* The workers have stopped, and the main thread has their states */
+		checker->worker = NULL;
+#endif
+		reload_checkers[num_reload_checkers++].checker = checker;
+	}
+
+	qsort(reload_checkers, num_reload_checkers, sizeof(*reload_checkers), reload_checker_cmp);
+
+	thread_park(master, is_checker_thread, &reload_threads);
+}
+
+static bool
+keep_checker_thread(thread_ref_t thread)
+{
+	reload_checker_t *rc = find_reload_checker(thread->arg);
+
+	if (!rc)
+		return false;
+
+	if (rc->checker->reloaded) {
+		rc->has_thread = true;
+		return true;
+	}
+
+	/* The checker has gone, so there is no-one to wait for its script */
+	if (thread->type == THREAD_CHILD || thread->type == THREAD_CHILD_TIMEOUT)
+		script_kill(thread, SIGTERM);
+
+	return false;
+}
+
+/* Called once clear_diff_services() has decided which checkers are kept.
+ * Their threads are requeued, and the others' are destroyed. */
+void
+unpark_checker_threads(void)
+{
+	size_t i;
+
+	if (!reload_checkers)
+		return;
+
+	thread_unpark(master, &reload_threads, keep_checker_thread);
+
+	/* A kept checker without a thread, such as one that was run by a
+	 * worker, or whose script the script runner had yet to start,
+	 * is launched again */
+	for (i = 0; i < num_reload_checkers; i++) {
+		if (!reload_checkers[i].has_thread)
+			reload_checkers[i].checker->reloaded = false;
+	}
+
+	FREE(reload_checkers);
+	num_reload_checkers = 0;
+}
+
 /* register checkers to the global I/O scheduler */
 void
 register_checkers_thread(void)
@@ -526,8 +643,13 @@ register_checkers_thread(void)
 	element e;
 	unsigned long warmup;
 
+#ifdef _WITH_CHECKER_WORKERS_
+	init_checker_workers();
+#endif
+
 	LIST_FOREACH(checkers_queue, checker, e) {
-		if (checker->launch)
+		/* A checker kept over a reload is still running */
+		if (checker->launch && !checker->reloaded)
 		{
 			if (checker->vs->ha_suspend && !checker->vs->ha_suspend_addr_count)
 				checker->enabled = false;
@@ -544,11 +666,20 @@ register_checkers_thread(void)
 				/* coverity[dont_call] */
 				warmup = warmup * (unsigned)random() / RAND_MAX;
 			}
+#ifdef _WITH_CHECKER_WORKERS_
+			thread_add_timer(checker_thread_master(checker), checker->launch, checker,
+					 BOOTSTRAP_DELAY + warmup);
+#else
 			thread_add_timer(master, checker->launch, checker,
 					 BOOTSTRAP_DELAY + warmup);
+#endif
 		}
 	}
 
+#ifdef _WITH_CHECKER_WORKERS_
+	start_checker_workers();
+#endif
+
 #ifdef _WITH_BFD_
 	log_message(LOG_INFO, "Activating BFD healthchecker");
 
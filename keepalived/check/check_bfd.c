@@ -94,7 +94,7 @@ bfd_check_compare(const checker_t *old_c, const checker_t *new_c)
 }
 
 static checker_tracked_bfd_t * __attribute__ ((pure))
-find_checker_tracked_bfd_by_name(char *name)
+find_checker_tracked_bfd_by_name(const char *name)
 {
 	element e;
 	checker_tracked_bfd_t *bfd;
@@ -231,14 +231,20 @@ install_bfd_check_keyword(void)
 	install_sublevel_end();
 }
 
+static void *
+bfd_check_lookup(const char *name)
+{
+	return find_checker_tracked_bfd_by_name(name);
+}
+
 static void
-bfd_check_handle_event(bfd_event_t * evt)
+bfd_check_handle_event(void *obj, const bfd_event_t *evt)
 {
-	element e, e1;
+	element e;
 	struct timeval cur_time;
 	struct timeval timer_tmp;
 	uint32_t delivery_time;
-	checker_tracked_bfd_t *cbfd;
+	checker_tracked_bfd_t *cbfd = obj;
 	checker_t *checker;
 	char message[80];
 	bool checker_was_up;
@@ -250,51 +256,42 @@ bfd_check_handle_event(bfd_event_t * evt)
 		delivery_time = timer_long(timer_tmp);
 		log_message(LOG_INFO, "Received BFD event: instance %s is in"
 			    " state %s (delivered in %" PRIu32 " usec)",
-			    evt->iname, BFD_STATE_STR(evt->state), delivery_time);
+			    cbfd->bname, BFD_STATE_STR(evt->state), delivery_time);
 	}
 
-	LIST_FOREACH(check_data->track_bfds, cbfd, e) {
-		if (strcmp(cbfd->bname, evt->iname))
+	/* We can't assume the state of the bfd instance up state
+	 * matches the checker up state due to the potential of
+	 * alpha state for some checkers and not others */
+	LIST_FOREACH(cbfd->tracking_rs, checker, e) {
+		if ((evt->state == BFD_STATE_UP) == checker->is_up &&
+		    checker->has_run)
 			continue;
 
-		/* We can't assume the state of the bfd instance up state
-		 * matches the checker up state due to the potential of
-		 * alpha state for some checkers and not others */
-		LIST_FOREACH(cbfd->tracking_rs, checker, e1) {
-			if ((evt->state == BFD_STATE_UP) == checker->is_up &&
-			    checker->has_run)
-				continue;
-
-			log_message(LOG_INFO, "BFD check of [%s] RS(%s) is %s",
-				    evt->iname, FMT_RS(checker->rs, checker->vs), evt->state == BFD_STATE_UP ? "UP" : "DOWN");
-
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(evt->state == BFD_STATE_UP ? UP : DOWN, checker);
-			if (checker->rs->smtp_alert &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails) &&
-			    (evt->state == BFD_STATE_UP) != checker_was_up) {
-				snprintf(message, sizeof(message), "=> BFD CHECK %s %s on service <=", evt->iname, evt->state == BFD_STATE_UP ? "succeeded" : "failed");
-				smtp_alert(SMTP_MSG_RS, checker, NULL, message);
-			}
+		log_message(LOG_INFO, "BFD check of [%s] RS(%s) is %s",
+			    cbfd->bname, FMT_RS(checker->rs, checker->vs), evt->state == BFD_STATE_UP ? "UP" : "DOWN");
+
+		checker_was_up = checker->is_up;
+		rs_was_alive = checker->rs->alive;
+		update_svr_checker_state(evt->state == BFD_STATE_UP ? UP : DOWN, checker);
+		if (checker->rs->smtp_alert &&
+		    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails) &&
+		    (evt->state == BFD_STATE_UP) != checker_was_up) {
+			snprintf(message, sizeof(message), "=> BFD CHECK %s %s on service <=", cbfd->bname, evt->state == BFD_STATE_UP ? "succeeded" : "failed");
+			smtp_alert(SMTP_MSG_RS, checker, NULL, message);
 		}
-		break;
 	}
 }
 
 static int
 bfd_check_thread(thread_ref_t thread)
 {
-	bfd_event_t evt;
-
 	bfd_thread = thread_add_read(master, bfd_check_thread, NULL,
 				     thread->u.f.fd, TIMER_NEVER, false);
 
 	if (thread->type != THREAD_READY_READ_FD)
 		return 0;
 
-	while (read(thread->u.f.fd, &evt, sizeof(bfd_event_t)) != -1)
-		bfd_check_handle_event(&evt);
+	bfd_event_receive(&bfd_checker_event_chan, bfd_check_lookup, bfd_check_handle_event);
 
 	return 0;
 }
@@ -302,7 +299,8 @@ bfd_check_thread(thread_ref_t thread)
 void
 start_bfd_monitoring(thread_master_t *thread_master)
 {
-	thread_add_read(thread_master, bfd_check_thread, NULL, bfd_checker_event_pipe[0], TIMER_NEVER, false);
+	bfd_event_consumer_init(&bfd_checker_event_chan);
+	bfd_thread = thread_add_read(thread_master, bfd_check_thread, NULL, bfd_checker_event_chan.fd, TIMER_NEVER, false);
 }
 
 void
@@ -310,6 +308,7 @@ checker_bfd_dispatcher_release(void)
 {
 	thread_cancel(bfd_thread);
 	bfd_thread = NULL;
+	bfd_event_consumer_release(&bfd_checker_event_chan);
 }
 
 #ifdef THREAD_DUMP
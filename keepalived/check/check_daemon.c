@@ -67,13 +67,18 @@
 #include "utils.h"
 #ifdef _WITH_BFD_
 #include "bfd_daemon.h"
+#include "bfd_event.h"
 #include "check_bfd.h"
 #endif
 #include "timer.h"
 #include "track_file.h"
+#include "script_runner.h"
 #ifdef _WITH_CN_PROC_
 #include "track_process.h"
 #endif
+#ifdef _WITH_CHECKER_WORKERS_
+#include "check_worker.h"
+#endif
 
 /* Global variables */
 bool using_ha_suspend;
@@ -139,6 +144,7 @@ checker_terminate_phase2(void)
 
 	/* Destroy master thread */
 	checker_dispatcher_release();
+	script_runner_stop();
 	thread_destroy_master(master);
 	master = NULL;
 	free_checkers_queue();
@@ -172,6 +178,10 @@ checker_terminate_phase2(void)
 	else
 		log_message(LOG_INFO, "Stopped");
 
+#ifdef _WITH_ASYNC_LOG_
+	stop_log_writer();
+#endif
+
 #ifdef ENABLE_LOG_TO_FILE
 	if (log_file_name)
 		close_log_file();
@@ -216,6 +226,10 @@ checker_shutdown_backstop_thread(thread_ref_t thread)
 static void
 checker_terminate_phase1(bool schedule_next_thread)
 {
+#ifdef _WITH_CHECKER_WORKERS_
+	stop_checker_workers();
+#endif
+
 	if (using_ha_suspend || __test_bit(LOG_ADDRESS_CHANGES, &debug))
 		kernel_netlink_close();
 
@@ -325,6 +339,11 @@ start_check(list old_checkers_queue, data_t *prev_global_data)
 	if (__test_bit(CONFIG_TEST_BIT, &debug))
 		return;
 
+	/* Select the scheduler's timer queue implementation */
+	thread_set_timer_wheel(master, global_data->timer_wheel);
+
+	script_runner_init(master, global_data->script_runner);
+
 	/* Initialize sub-system if any virtual servers are configured */
 	if ((!LIST_ISEMPTY(check_data->vs) || (reload && !LIST_ISEMPTY(old_check_data->vs))) &&
 	    ipvs_start() != IPVS_SUCCESS) {
@@ -363,6 +382,7 @@ start_check(list old_checkers_queue, data_t *prev_global_data)
 	/* Processing differential configuration parsing */
 	if (reload) {
 		clear_diff_services(old_checkers_queue);
+		unpark_checker_threads();
 		check_new_rs_state();
 	}
 
@@ -420,6 +440,14 @@ reload_check_thread(__attribute__((unused)) thread_ref_t thread)
 
 	log_message(LOG_INFO, "Got SIGHUP, reloading checker configuration");
 
+#ifdef _WITH_CHECKER_WORKERS_
+	stop_checker_workers();
+#endif
+
+	/* Set aside the checker threads, including their scripts, in case
+	 * their virtual servers are unchanged */
+	park_checker_threads();
+
 	/* Terminate all script process */
 	script_killall(master, SIGTERM, false);
 
@@ -609,12 +637,9 @@ start_check_child(void)
 	initialise_debug_options();
 
 #ifdef _WITH_BFD_
-	/* Close the write end of the BFD checker event notification pipe and the track_process fd */
-	close(bfd_checker_event_pipe[1]);
-
 #ifdef _WITH_VRRP_
-	close(bfd_vrrp_event_pipe[0]);
-	close(bfd_vrrp_event_pipe[1]);
+	/* Close the BFD vrrp event notification fd */
+	bfd_event_close_channel(&bfd_vrrp_event_chan);
 #endif
 #endif
 #ifdef _WITH_CN_PROC_
@@ -654,6 +679,10 @@ start_check_child(void)
 
 	free_parent_mallocs_startup(true);
 
+#ifdef _WITH_ASYNC_LOG_
+	start_log_writer();
+#endif
+
 	/* Clear any child finder functions set in parent */
 	set_child_finder_name(NULL);
 
@@ -40,6 +40,9 @@
 #include "libipvs.h"
 #include "keepalived_magic.h"
 #include "track_file.h"
+#ifdef _WITH_CHECKER_WORKERS_
+#include "check_worker.h"
+#endif
 #ifdef _WITH_BFD_
 #include "check_bfd.h"
 #endif
@@ -52,7 +55,11 @@ check_data_t *old_check_data = NULL;
 ssl_data_t *
 alloc_ssl(void)
 {
-	return (ssl_data_t *) MALLOC(sizeof(ssl_data_t));
+	ssl_data_t *ssl = (ssl_data_t *) MALLOC(sizeof(ssl_data_t));
+
+	ssl->session_lifetime = SSL_SESSION_LIFETIME_DEFAULT;
+
+	return ssl;
 }
 void
 free_ssl(void)
@@ -77,6 +84,11 @@ dump_ssl(FILE *fp)
 {
 	ssl_data_t *ssl = check_data->ssl;
 
+	if (ssl->session_lifetime)
+		conf_write(fp, " Session lifetime : %u seconds", ssl->session_lifetime);
+	else
+		conf_write(fp, " Session resumption disabled");
+
 	if (!ssl->password && !ssl->cafile && !ssl->certfile && !ssl->keyfile) {
 		conf_write(fp, " Using autogen SSL context");
 		return;
@@ -745,6 +757,9 @@ dump_check_data(FILE *fp, const check_data_t *data)
 		dump_list(fp, data->vs);
 	}
 	dump_checkers_queue(fp);
+#ifdef _WITH_CHECKER_WORKERS_
+	dump_checker_workers(fp);
+#endif
 
 	if (!LIST_ISEMPTY(data->track_files)) {
 		conf_write(fp, "------< Checker track files >------");
@@ -765,13 +780,20 @@ dump_data_check(FILE *fp)
 	dump_global_data(fp, global_data);
 
 	dump_check_data(fp, check_data);
+
+	if (fp) {
+		dump_mem_slabs(fp);
+#ifdef _WITH_ASYNC_LOG_
+		dump_log_async(fp);
+#endif
+	}
 }
 
 const char *
 format_vs(const virtual_server_t *vs)
 {
 	/* alloc large buffer because of unknown length of vs->vsgname */
-	static char ret[512];
+	static __thread char ret[512];
 
 	if (vs->vsgname)
 		snprintf (ret, sizeof (ret) - 1, "[%s]:%d"
@@ -790,7 +812,7 @@ const char *
 format_vsge(const virtual_server_group_entry_t *vsge)
 {
 	/* alloc large buffer because of unknown length of vs->vsgname */
-	static char ret[INET6_ADDRSTRLEN + 1 + 4 + 1 + 5]; /* IPv6 addr + -abcd:ppppp */
+	static __thread char ret[INET6_ADDRSTRLEN + 1 + 4 + 1 + 5]; /* IPv6 addr + -abcd:ppppp */
 	uint16_t start;
 
 	if (vsge->is_fwmark)
@@ -814,7 +836,7 @@ format_vsge(const virtual_server_group_entry_t *vsge)
 const char *
 format_rs(const real_server_t *rs, const virtual_server_t *vs)
 {
-	static char buf[SOCKADDRTRIO_STR_LEN];
+	static __thread char buf[SOCKADDRTRIO_STR_LEN];
 
 	inet_sockaddrtotrio_r(&rs->addr, vs->service_type, buf);
 
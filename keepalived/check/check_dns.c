@@ -106,8 +106,6 @@ dns_final(thread_ref_t thread, bool error, const char *fmt, ...)
 	char buf[MAX_LOG_MSG];
 	va_list args;
 	int len;
-	bool checker_was_up;
-	bool rs_was_alive;
 
 	checker_t *checker = THREAD_ARG(thread);
 
@@ -121,7 +119,7 @@ dns_final(thread_ref_t thread, bool error, const char *fmt, ...)
 		thread_close_fd(thread);
 
 	if (error) {
-		if (checker->is_up || !checker->has_run) {
+		if (CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) {
 			if (fmt &&
 			    (global_data->checker_log_all_failures ||
 			     checker->log_all_failures ||
@@ -129,35 +127,23 @@ dns_final(thread_ref_t thread, bool error, const char *fmt, ...)
 				va_start(args, fmt);
 				len = vsnprintf(buf, sizeof (buf), fmt, args);
 				va_end(args);
-				if (checker->has_run && checker->retry_it >= checker->retry && !checker->has_run)
+				if (CHECKER_HAS_RUN(checker) && checker->retry_it >= checker->retry && !CHECKER_HAS_RUN(checker))
 					snprintf(buf + len, sizeof(buf) - len, " after %u retries", checker->retry);
 				dns_log_message(thread, LOG_INFO, "%s", buf);
 			}
 			if (checker->retry_it < checker->retry) {
 				checker->retry_it++;
-				checker->has_run = true;
+				CHECKER_SET_HAS_RUN(checker);
 				thread_add_timer(thread->master,
 						 dns_connect_thread, checker,
 						 checker->delay_before_retry);
 				return 0;
 			}
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(DOWN, checker);
-			if (checker_was_up && checker->rs->smtp_alert &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> DNS_CHECK: failed on service <=");
+			update_svr_checker_state_alert(DOWN, checker, "=> DNS_CHECK: failed on service <=");
 		}
 	} else {
-		if (!checker->is_up || !checker->has_run) {
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(UP, checker);
-			if (!checker_was_up && checker->rs->smtp_alert &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> DNS_CHECK: succeed on service <=");
+		if (!CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) {
+			update_svr_checker_state_alert(UP, checker, "=> DNS_CHECK: succeed on service <=");
 		}
 	}
 
@@ -26,9 +26,11 @@
 #include <openssl/err.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <ctype.h>
 
 #ifdef _WITH_REGEX_CHECK_
 #define PCRE2_CODE_UNIT_WIDTH 8
@@ -137,6 +139,19 @@ static const char *request_template_ipv6 =
 static int http_connect_thread(thread_ref_t);
 
 #ifdef _WITH_REGEX_CHECK_
+#ifdef _WITH_REGEX_TIMERS_
+static void
+regex_time_add(struct timespec *total, const struct timespec *t)
+{
+	total->tv_sec += t->tv_sec;
+	total->tv_nsec += t->tv_nsec;
+	if (total->tv_nsec >= 1000000000L) {
+		total->tv_sec += total->tv_nsec / 1000000000L;
+		total->tv_nsec %= 1000000000L;
+	}
+}
+#endif
+
 static void
 free_regex(void *data)
 {
@@ -148,12 +163,7 @@ free_regex(void *data)
 	pcre2_match_data_free(regex->pcre2_match_data);
 
 #ifdef _WITH_REGEX_TIMERS_
-	total_regex_times.tv_sec += regex->regex_time.tv_sec;
-	total_regex_times.tv_nsec += regex->regex_time.tv_nsec;
-	if (total_regex_times.tv_nsec >= 1000000000L) {
-		total_regex_times.tv_sec += total_regex_times.tv_nsec / 1000000000L;
-		total_regex_times.tv_nsec %= 1000000000L;
-	}
+	regex_time_add(&total_regex_times, &regex->regex_time);
 	total_num_matches += regex->num_match_calls;
 	total_regex_urls += regex->num_regex_urls;
 #endif
@@ -278,21 +288,38 @@ dump_url(FILE *fp, const void *data)
 #ifndef PCRE2_DONT_USE_JIT
 		if (url->regex_use_stack)
 			conf_write(fp, "     Regex stack start %zu, max %zu", jit_stack_start, jit_stack_max);
+#endif
+#ifdef _WITH_REGEX_TIMERS_
+		conf_write(fp, "     Regex checks = %u, match calls = %u, partial matches = %u", url->num_regex_checks, url->num_match_calls, url->num_partial_matches);
+		conf_write(fp, "     Regex time = %ld.%9.9ld, max per check = %ld.%9.9ld", url->regex_time.tv_sec, url->regex_time.tv_nsec, url->regex_max_time.tv_sec, url->regex_max_time.tv_nsec);
 #endif
 	}
 #endif
 }
 
+/* Free the checker's request, returning its buffer to the checker, and
+ * keeping the request itself for the next connection */
 static void
-free_http_request(request_t *req)
+free_http_request(http_checker_t *http_get_chk)
 {
+	request_t *req = http_get_chk->req;
+
 	if(!req)
 		return;
 	if (req->ssl)
 		SSL_free(req->ssl);
-	if (req->buffer)
-		FREE(req->buffer);
-	FREE(req);
+	if (req->context)
+		EVP_MD_CTX_free(req->context);
+	if (req->buffer) {
+		http_get_chk->buffer = req->buffer;
+		http_get_chk->buffer_size = req->buffer_size;
+	}
+	if (!http_get_chk->spare_req) {
+		memset(req, 0, sizeof(*req));
+		http_get_chk->spare_req = req;
+	} else
+		FREE(req);
+	http_get_chk->req = NULL;
 }
 
 static void
@@ -301,7 +328,13 @@ free_http_get_check(checker_t *checker)
 	http_checker_t *http_get_chk = checker->data;
 
 	free_list(&http_get_chk->url);
-	free_http_request(http_get_chk->req);
+	free_http_request(http_get_chk);
+	FREE_PTR(http_get_chk->spare_req);
+	FREE_PTR(http_get_chk->buffer);
+	FREE_PTR(http_get_chk->request);
+	if (http_get_chk->conn_fd != -1)
+		close(http_get_chk->conn_fd);
+	ssl_clear_session(http_get_chk);
 	FREE_CONST_PTR(http_get_chk->virtualhost);
 	FREE_PTR(http_get_chk);
 	FREE(checker->co);
@@ -324,6 +357,15 @@ dump_http_get_check(FILE *fp, const checker_t *checker)
 	conf_write(fp, "   Enable SNI %sset", http_get_chk->enable_sni ? "" : "un");
 #endif
  	conf_write(fp, "   Fast recovery %sset", http_get_chk->fast_recovery ? "" : "un");
+	if (http_get_chk->persistent)
+		conf_write(fp, "   Persistent connection set, %" PRIu64 " connections, %" PRIu64 " reused",
+				http_get_chk->connections, http_get_chk->conn_reuses);
+	else
+		conf_write(fp, "   Persistent connection unset");
+	if (http_get_chk->proto == PROTO_SSL)
+		conf_write(fp, "   SSL handshakes = %" PRIu64 ", resumed = %" PRIu64 " (%" PRIu64 "%%)",
+				http_get_chk->ssl_handshakes, http_get_chk->ssl_resumed,
+				http_get_chk->ssl_handshakes ? http_get_chk->ssl_resumed * 100 / http_get_chk->ssl_handshakes : 0);
 	dump_list(fp, http_get_chk->url);
 	if (http_get_chk->failed_url)
 		conf_write(fp, "   Failed URL = %s", http_get_chk->failed_url->path);
@@ -339,6 +381,7 @@ alloc_http_get(const char *proto)
 	http_get_chk->http_protocol = HTTP_PROTOCOL_1_0;
 	http_get_chk->url = alloc_list(free_url, dump_url);
 	http_get_chk->virtualhost = NULL;
+	http_get_chk->conn_fd = -1;
 
 	if (http_get_chk->proto == PROTO_SSL)
 		check_data->ssl_required = true;
@@ -414,6 +457,12 @@ http_get_handler(const vector_t *strvec)
 		      http_connect_thread, http_get_check_compare,
 		      http_get_chk, CHECKER_NEW_CO(), true);
 	checker->default_delay_before_retry = 3 * TIMER_HZ;
+
+#if defined _WITH_CHECKER_WORKERS_ && OPENSSL_VERSION_NUMBER < 0x10100000L
+	/* OpenSSL before 1.1.0 isn't thread safe without locking callbacks */
+	if (http_get_chk->proto == PROTO_SSL)
+		checker->main_thread_only = true;
+#endif
 }
 
 static void
@@ -457,6 +506,12 @@ http_get_check_end(void)
 
 	if (!check_conn_opts(CHECKER_GET_CO())) {
 		dequeue_new_checker();
+		return;
+	}
+
+	if (http_get_chk->persistent && http_get_chk->http_protocol != HTTP_PROTOCOL_1_1) {
+		report_config_error(CONFIG_GENERAL_ERROR, "HTTP/SSL_GET persistent_connection requires http_protocol 1.1 - setting");
+		http_get_chk->http_protocol = HTTP_PROTOCOL_1_1;
 	}
 }
 
@@ -730,6 +785,11 @@ prepare_regex(url_t *url)
 	if (!LIST_EXISTS(regexs))
 		regexs = alloc_list(free_regex, NULL);
 
+#ifdef _WITH_CHECKER_WORKERS_
+	/* The match data and JIT stack are shared between checkers */
+	((checker_t *)CHECKER_GET_CURRENT())->main_thread_only = true;
+#endif
+
 	/* See if this regex has already been specified */
 	LIST_FOREACH(regexs, r, e) {
 		if (r->pcre2_options == conf_regex_options &&
@@ -813,6 +873,22 @@ fast_recovery_handler(const vector_t *strvec)
 	http_get_chk->fast_recovery = res;
 }
 
+static void
+persistent_connection_handler(const vector_t *strvec)
+{
+	http_checker_t *http_get_chk = CHECKER_GET();
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec, 1));
+		if (res == -1) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid persistent_connection parameter %s", strvec_slot(strvec, 1));
+			return;
+		}
+	}
+	http_get_chk->persistent = res;
+}
+
 static void
 url_check(void)
 {
@@ -877,6 +953,7 @@ install_http_ssl_check_keyword(const char *keyword)
 	install_keyword("enable_sni", &enable_sni_handler);
 #endif
 	install_keyword("fast_recovery", &fast_recovery_handler);
+	install_keyword("persistent_connection", &persistent_connection_handler);
 	install_keyword("url", &url_handler);
 	install_sublevel();
 	install_keyword("path", &path_handler);
@@ -951,8 +1028,6 @@ epilog(thread_ref_t thread, register_checker_t method)
 	http_checker_t *http_get_check = CHECKER_ARG(checker);
 	request_t *req = http_get_check->req;
 	unsigned long delay = 0;
-	bool checker_was_up;
-	bool rs_was_alive;
 
 	if (method == REGISTER_CHECKER_NEW) {
 		ELEMENT_NEXT(http_get_check->url_it);
@@ -964,19 +1039,10 @@ epilog(thread_ref_t thread, register_checker_t method)
 		/* Check completed. All the url have been successfully checked.
 		 * check if server is currently alive.
 		 */
-		if (!checker->is_up || !checker->has_run) {
+		if (!CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) {
 			log_message(LOG_INFO, "Remote Web server %s succeed on service."
 					    , FMT_CHK(checker));
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(UP, checker);
-			if (!checker_was_up && checker->rs->smtp_alert &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> CHECK succeed on service <=");
-
-			/* We have done all the checks, so mark as has run */
-			checker->has_run = true;
+			update_svr_checker_state_alert(UP, checker, "=> CHECK succeed on service <=");
 		}
 
 		/* Reset it counters */
@@ -990,8 +1056,8 @@ epilog(thread_ref_t thread, register_checker_t method)
 	 * servers.
 	 */
 	else if (method == REGISTER_CHECKER_RETRY && checker->retry_it > checker->retry) {
-		if (checker->is_up || !checker->has_run) {
-			if (checker->has_run && checker->retry)
+		if (CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) {
+			if (CHECKER_HAS_RUN(checker) && checker->retry)
 				log_message(LOG_INFO
 				   , "HTTP_CHECK on service %s failed after %u retry."
 				   , FMT_CHK(checker)
@@ -1000,14 +1066,8 @@ epilog(thread_ref_t thread, register_checker_t method)
 				log_message(LOG_INFO
 				   , "HTTP_CHECK on service %s failed."
 				   , FMT_CHK(checker));
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(DOWN, checker);
-			if (checker_was_up && checker->rs->smtp_alert &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> CHECK failed on service"
-					   " : HTTP request failed <=");
+			update_svr_checker_state_alert(DOWN, checker,
+					"=> CHECK failed on service : HTTP request failed <=");
 		}
 
 		/* Mark we have a failed URL */
@@ -1023,7 +1083,7 @@ epilog(thread_ref_t thread, register_checker_t method)
 	/* register next timer thread */
 	if (method == REGISTER_CHECKER_NEW) {
 		delay = checker->delay_loop;
-		if (!checker->has_run)
+		if (!CHECKER_HAS_RUN(checker))
 			checker->retry_it = checker->retry;
 	}
 	else if (http_get_check->failed_url)
@@ -1032,9 +1092,13 @@ epilog(thread_ref_t thread, register_checker_t method)
 		delay = checker->delay_before_retry;
 
 	/* If req == NULL, fd is not created */
-	if (req) {
-		free_http_request(req);
-		http_get_check->req = NULL;
+	if (req && req->keep_conn) {
+		/* Leave the connection idle until the next request */
+		thread_del_read(thread);
+		thread_del_write(thread);
+		http_get_check->conn_fd = thread->u.f.fd;
+	} else if (req) {
+		free_http_request(http_get_check);
 		thread_close_fd(thread);
 	}
 
@@ -1042,8 +1106,8 @@ epilog(thread_ref_t thread, register_checker_t method)
 	 * If the checker is not up, but we are not aware of any failure,
 	 * don't delay the checks if fast_recovery option specified. */
 	if (http_get_check->fast_recovery &&
-	    (!checker->has_run ||
-	     (!checker->is_up && !http_get_check->failed_url)))
+	    (!CHECKER_HAS_RUN(checker) ||
+	     (!CHECKER_IS_UP(checker) && !http_get_check->failed_url)))
 		thread_add_event(thread->master, http_connect_thread, checker, 0);
 	else
 		thread_add_timer(thread->master, http_connect_thread, checker, delay);
@@ -1051,18 +1115,39 @@ epilog(thread_ref_t thread, register_checker_t method)
 	return 0;
 }
 
+/* The server closed a persistent connection before responding to the
+ * request sent on it. Retry on a new connection. */
+static int
+http_reconnect(thread_ref_t thread)
+{
+	checker_t *checker = THREAD_ARG(thread);
+	http_checker_t *http_get_check = CHECKER_ARG(checker);
+
+	free_http_request(http_get_check);
+	thread_close_fd(thread);
+
+	thread_add_event(thread->master, http_connect_thread, checker, 0);
+
+	return 0;
+}
+
 int
 timeout_epilog(thread_ref_t thread, const char *debug_msg)
 {
 	checker_t *checker = THREAD_ARG(thread);
+	http_checker_t *http_get_check = CHECKER_ARG(checker);
+	request_t *req = http_get_check->req;
+
+	if (req && req->reused && !req->extracted)
+		return http_reconnect(thread);
 
 	/* check if server is currently alive */
-	if (checker->is_up || !checker->has_run) {
+	if (CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) {
 		if (global_data->checker_log_all_failures || checker->log_all_failures)
 			log_message(LOG_INFO, "%s server %s."
 					    , debug_msg
 					    , FMT_CHK(checker));
-		checker->has_run = true;
+		CHECKER_SET_HAS_RUN(checker);
 		return epilog(thread, REGISTER_CHECKER_RETRY);
 	}
 
@@ -1078,6 +1163,35 @@ fetch_next_url(http_checker_t * http_get_check)
 }
 
 #ifdef _WITH_REGEX_CHECK_
+/* Keep the last keep bytes of the buffer for the next match attempt,
+ * which will start at offset start into the kept data */
+static void
+regex_preserve(request_t *req, size_t keep, size_t start)
+{
+	size_t discard = req->len - keep;
+
+	if (discard) {
+		memmove(req->buffer, req->buffer + discard, keep);
+		req->len = keep;
+		req->regex_subject_offset += discard;
+	}
+	req->start_offset = start;
+}
+
+/* The amount of data before the next match start position that needs
+ * to be kept for any lookbehind assertion. */
+static inline size_t
+regex_lookbehind_keep(const url_t *url, const request_t *req)
+{
+	size_t keep = url->regex->pcre2_max_lookbehind;
+
+	/* Always leave room in the buffer for new data */
+	if (keep > req->buffer_size / 2)
+		keep = req->buffer_size / 2;
+
+	return keep < req->len ? keep : req->len;
+}
+
 /* Returns true to indicate buffer must be preserved */
 static bool
 check_regex(url_t *url, request_t *req)
@@ -1108,20 +1222,24 @@ check_regex(url_t *url, request_t *req)
 		return false;
 
 	/* If the end of the current buffer doesn't reach the start offset specified,
-	 * then skip the check */
+	 * then skip the check, but keep what a lookbehind may need */
 	if (url->regex_min_offset) {
-		if (req->regex_subject_offset + req->len < url->regex_min_offset - url->regex->pcre2_max_lookbehind) {
-			req->regex_subject_offset += req->len;
-			return false;
+		if (req->regex_subject_offset + req->len <= url->regex_min_offset) {
+			keep = regex_lookbehind_keep(url, req);
+			regex_preserve(req, keep, keep);
+			return true;
 		}
 
 		if (req->regex_subject_offset < url->regex_min_offset)
 			start_offset = url->regex_min_offset - req->regex_subject_offset;
 	}
 
+	if (req->start_offset > start_offset)
+		start_offset = req->start_offset;
+
 	/* If we are beyond the end of where we want to check, then don't try matching */
 	if (url->regex_max_offset &&
-	    req->regex_subject_offset + req->start_offset >= url->regex_max_offset) {
+	    req->regex_subject_offset + start_offset >= url->regex_max_offset) {
 		req->regex_subject_offset += req->len;
 		return false;
 	}
@@ -1134,9 +1252,6 @@ check_regex(url_t *url, request_t *req)
 	}
 #endif
 
-	if (req->start_offset > start_offset)
-		start_offset = req->start_offset;
-
 #ifdef _WITH_REGEX_TIMERS_
 	struct timespec time_before, time_after;
 	clock_gettime(CLOCK_MONOTONIC_RAW, &time_before);
@@ -1167,6 +1282,9 @@ check_regex(url_t *url, request_t *req)
 	if (req->req_time.tv_nsec >= 1000000000L) {
 		req->req_time.tv_sec += req->req_time.tv_nsec / 1000000000L;
 		req->req_time.tv_nsec %= 1000000000L;
+	} else if (req->req_time.tv_nsec < 0) {
+		req->req_time.tv_sec--;
+		req->req_time.tv_nsec += 1000000000L;
 	}
 	req->num_match_calls++;
 #endif
@@ -1178,36 +1296,48 @@ check_regex(url_t *url, request_t *req)
 		if (do_regex_debug)
 			log_message(LOG_INFO, "Partial returned, ovector %zu, max_lookbehind %u", ovector[0], url->regex->pcre2_max_lookbehind);
 #endif
-		if ((keep = ovector[0] - url->regex->pcre2_max_lookbehind) <= 0)
-			keep = 0;
-
-		if (keep) {
-			req->start_offset = url->regex->pcre2_max_lookbehind;
-			req->len -= keep;
-			memmove(req->buffer, req->buffer + keep, req->len);
-			req->regex_subject_offset += keep;
-		} else if (req->len == MAX_BUFFER_LENGTH - 1) {
+#ifdef _WITH_REGEX_TIMERS_
+		req->num_partial_matches++;
+#endif
+
+		/* Keep the partially matched text, and what a lookbehind may need.
+		 * The next match attempt resumes at the start of the partial match. */
+		keep = ovector[0] > url->regex->pcre2_max_lookbehind ? ovector[0] - url->regex->pcre2_max_lookbehind : 0;
+
+		if (!keep && req->len == req->buffer_size - 1) {
+			/* The partial match fills the buffer, so make room for more data */
+			if (req->buffer_size < REGEX_MAX_BUFFER_LENGTH) {
+				req->buffer_size *= 2;
+				req->buffer = REALLOC(req->buffer, req->buffer_size);
+				req->start_offset = ovector[0];
+				return true;
+			}
+
 			req->regex_subject_offset += req->len;
 			log_message(LOG_INFO, "Regex partial match preserve too large - discarding");
 			return false;
 		}
 
+		regex_preserve(req, req->len - keep, ovector[0] - keep);
+
 		return true;
 	}
 
 	/* Report what happened in the pcre2_match call. */
 	if(pcreExecRet < 0) {
-		req->regex_subject_offset += req->len;
-
 		switch(pcreExecRet)
 		{
 		case PCRE2_ERROR_NOMATCH:
-			/* This is not an error while doing partial matches */
+			/* This is not an error while doing partial matches. No match
+			 * can start in the data received so far, so only keep what
+			 * a lookbehind may need. */
 #ifdef _REGEX_DEBUG_
 			if (do_regex_debug)
 				log_message(LOG_INFO, "String did not match the regex pattern");
 #endif
-			break;
+			keep = regex_lookbehind_keep(url, req);
+			regex_preserve(req, keep, keep);
+			return true;
 		case PCRE2_ERROR_NULL:
 			log_message(LOG_INFO, "Something was null in regex match");
 			break;
@@ -1225,6 +1355,8 @@ check_regex(url_t *url, request_t *req)
 			break;
 		}
 
+		req->regex_subject_offset += req->len;
+
 		return false;
 	}
 
@@ -1300,14 +1432,18 @@ http_handle_response(thread_ref_t thread, unsigned char digest[MD5_DIGEST_LENGTH
 	/* Did a regex match? */
 	if (url->regex) {
 #ifdef _WITH_REGEX_TIMERS_
-		url->regex->regex_time.tv_sec += req->req_time.tv_sec;
-		url->regex->regex_time.tv_nsec += req->req_time.tv_nsec;
-		if (url->regex->regex_time.tv_nsec >= 1000000000L) {
-			url->regex->regex_time.tv_sec += url->regex->regex_time.tv_nsec / 1000000000L;
-			url->regex->regex_time.tv_nsec %= 1000000000L;
-		}
+		regex_time_add(&url->regex->regex_time, &req->req_time);
 		url->regex->num_match_calls += req->num_match_calls;
 		url->regex->num_regex_urls++;
+
+		regex_time_add(&url->regex_time, &req->req_time);
+		if (req->req_time.tv_sec > url->regex_max_time.tv_sec ||
+		    (req->req_time.tv_sec == url->regex_max_time.tv_sec &&
+		     req->req_time.tv_nsec > url->regex_max_time.tv_nsec))
+			url->regex_max_time = req->req_time;
+		url->num_match_calls += req->num_match_calls;
+		url->num_partial_matches += req->num_partial_matches;
+		url->num_regex_checks++;
 #endif
 
 		if (req->regex_matched == url->regex_no_match)
@@ -1316,7 +1452,7 @@ http_handle_response(thread_ref_t thread, unsigned char digest[MD5_DIGEST_LENGTH
 	}
 #endif
 
-	if (!checker->is_up) {
+	if (!CHECKER_IS_UP(checker)) {
 		log_message(LOG_INFO,
 			"%s success to %s url(%s)", msg
 			, FMT_CHK(checker)
@@ -1327,6 +1463,114 @@ http_handle_response(thread_ref_t thread, unsigned char digest[MD5_DIGEST_LENGTH
 	return epilog(thread, REGISTER_CHECKER_NEW) + 1;
 }
 
+/* Check the response headers to see how the end of the response
+ * will be identified, and whether the connection can be reused */
+static void
+http_response_headers(request_t *req)
+{
+	size_t hdr_len = (size_t)(req->extracted - req->buffer);
+
+	/* An HTTP/1.0 server closes the connection unless it says otherwise */
+	if (!strncmp(req->buffer, "HTTP/1.0", 8))
+		req->keep_conn = extract_header_token(req->buffer, hdr_len, "Connection", "keep-alive");
+	else
+		req->keep_conn = !extract_header_token(req->buffer, hdr_len, "Connection", "close");
+
+	if (req->status_code == 204 || req->status_code == 304)
+		req->content_len = 0;
+	else if (extract_header_token(req->buffer, hdr_len, "Transfer-Encoding", "chunked")) {
+		req->chunked = true;
+		req->content_len = SIZE_MAX;
+	} else if (req->content_len == SIZE_MAX) {
+		/* The end of the response is indicated by closing the connection */
+		req->keep_conn = false;
+	}
+}
+
+/* Track the chunked transfer coding (rfc7230.4.1) of the response body.
+ * Returns true once the last chunk and the trailer have been received. */
+static bool
+http_chunked_progress(request_t *req, const char *data, size_t len)
+{
+	const char *end = data + len;
+	size_t n;
+	char c;
+
+	while (data < end) {
+		switch (req->chunk_state) {
+		case CHUNK_SIZE:
+			c = *data++;
+			if (isxdigit((unsigned char)c)) {
+				if (req->chunk_remaining > SIZE_MAX >> 4) {
+					req->chunk_state = CHUNK_ERROR;
+					break;
+				}
+				req->chunk_remaining = (req->chunk_remaining << 4) |
+					(size_t)(isdigit((unsigned char)c) ? c - '0' : tolower((unsigned char)c) - 'a' + 10);
+				break;
+			}
+			if (c != '\n') {
+				req->chunk_state = CHUNK_EXT;
+				break;
+			}
+			/* Fall through */
+		case CHUNK_EXT:
+			if (req->chunk_state == CHUNK_EXT && *data++ != '\n')
+				break;
+			req->chunk_state = req->chunk_remaining ? CHUNK_DATA : CHUNK_TRAILER;
+			break;
+		case CHUNK_DATA:
+			n = (size_t)(end - data) < req->chunk_remaining ? (size_t)(end - data) : req->chunk_remaining;
+			data += n;
+			if (!(req->chunk_remaining -= n))
+				req->chunk_state = CHUNK_DATA_END;
+			break;
+		case CHUNK_DATA_END:
+			if (*data++ == '\n')
+				req->chunk_state = CHUNK_SIZE;
+			break;
+		case CHUNK_TRAILER:
+			/* chunk_remaining is the length of the current trailer line */
+			c = *data++;
+			if (c == '\n') {
+				if (!req->chunk_remaining)
+					req->chunk_state = CHUNK_DONE;
+				req->chunk_remaining = 0;
+			} else if (c != '\r')
+				req->chunk_remaining++;
+			break;
+		case CHUNK_DONE:
+			/* Unexpected data after the end of the response */
+			req->keep_conn = false;
+			return true;
+		case CHUNK_ERROR:
+			req->keep_conn = false;
+			return false;
+		}
+	}
+
+	return req->chunk_state == CHUNK_DONE;
+}
+
+/* Check if the whole response has been received, after receiving len
+ * more bytes of the body */
+static void
+http_response_progress(request_t *req, const char *data, size_t len)
+{
+	if (req->chunked) {
+		if (!http_chunked_progress(req, data, len))
+			return;
+	} else if (req->content_len != SIZE_MAX) {
+		if (req->rx_bytes < req->content_len)
+			return;
+		if (req->rx_bytes > req->content_len)
+			req->keep_conn = false;
+	} else
+		return;
+
+	req->complete = true;
+}
+
 /* Handle response stream performing MD5 updates */
 void
 http_process_response(request_t *req, size_t r, url_t *url)
@@ -1339,15 +1583,19 @@ http_process_response(request_t *req, size_t r, url_t *url)
 	if (!req->extracted) {
 		if ((req->extracted = extract_html(req->buffer, req->len))) {
 			req->status_code = extract_status_code(req->buffer, req->len);
-			req->content_len = extract_content_length(req->buffer, req->len);
+			req->content_len = extract_content_length(req->buffer, (size_t)(req->extracted - req->buffer));
+			if (req->persistent)
+				http_response_headers(req);
 			r = req->len - (size_t)(req->extracted - req->buffer);
 			if (r && url->digest) {
 				if (req->content_len == SIZE_MAX || req->content_len > req->rx_bytes)
-					MD5_Update(&req->context, req->extracted,
+					EVP_DigestUpdate(req->context, req->extracted,
 						   req->content_len == SIZE_MAX || req->content_len >= req->rx_bytes + r ? r : req->content_len - req->rx_bytes);
 			}
 
 			req->rx_bytes = r;
+			if (req->persistent)
+				http_response_progress(req, req->extracted, r);
 #ifdef _WITH_REGEX_CHECK_
 			if (!r || !url->regex || !check_regex(url, req))
 #endif
@@ -1356,11 +1604,13 @@ http_process_response(request_t *req, size_t r, url_t *url)
 	} else if (req->len) {
 		if (url->digest &&
 		    (req->content_len == SIZE_MAX || req->content_len > req->rx_bytes)) {
-			MD5_Update(&req->context, req->buffer + old_req_len,
+			EVP_DigestUpdate(req->context, req->buffer + old_req_len,
 				   req->content_len == SIZE_MAX || req->content_len >= req->rx_bytes + r ? r : req->content_len - req->rx_bytes);
 		}
 
-		req->rx_bytes += req->len;
+		req->rx_bytes += r;
+		if (req->persistent)
+			http_response_progress(req, req->buffer + old_req_len, r);
 #ifdef _WITH_REGEX_CHECK_
 		if (!url->regex || !check_regex(url, req))
 #endif
@@ -1386,7 +1636,7 @@ http_read_thread(thread_ref_t thread)
 
 	/* read the HTTP stream */
 	r = read(thread->u.f.fd, req->buffer + req->len,
-		 MAX_BUFFER_LENGTH - 1 - req->len);	/* Allow space for adding '\0' */
+		 req->buffer_size - 1 - req->len);	/* Allow space for adding '\0' */
 
 	/* Test if data are ready */
 	if (r == -1 && (check_EAGAIN(errno) || check_EINTR(errno))) {
@@ -1401,7 +1651,7 @@ http_read_thread(thread_ref_t thread)
 	if (r <= 0) {	/* -1:error , 0:EOF */
 		/* All the HTTP stream has been parsed */
 		if (url->digest)
-			MD5_Final(digest, &req->context);
+			EVP_DigestFinal_ex(req->context, digest, NULL);
 
 		if (r == -1) {
 			/* We have encountered a real read error */
@@ -1414,6 +1664,18 @@ http_read_thread(thread_ref_t thread)
 		/* Handle response stream */
 		http_process_response(req, (size_t)r, url);
 
+		/* There is no point waiting for the rest of a broken response */
+		if (req->chunk_state == CHUNK_ERROR)
+			return timeout_epilog(thread, "Invalid chunked response from");
+
+		/* A persistent connection isn't closed at the end of the response */
+		if (req->complete) {
+			if (url->digest)
+				EVP_DigestFinal_ex(req->context, digest, NULL);
+			http_handle_response(thread, digest, false);
+			return 0;
+		}
+
 		/*
 		 * Register next http stream reader.
 		 * Register itself to not perturbe global I/O multiplexer.
@@ -1442,20 +1704,41 @@ http_response_thread(thread_ref_t thread)
 	if (thread->type == THREAD_READ_TIMEOUT)
 		return timeout_epilog(thread, "Timeout WEB read");
 
-	/* Allocate & clean the get buffer */
-	req->buffer = (char *) MALLOC(MAX_BUFFER_LENGTH);
+	/* Use the checker's buffer, allocating it on first use */
+	if (!req->buffer) {
+		if (http_get_check->buffer) {
+			req->buffer = http_get_check->buffer;
+			req->buffer_size = http_get_check->buffer_size;
+			http_get_check->buffer = NULL;
+		} else {
+			req->buffer = (char *) MALLOC(MAX_BUFFER_LENGTH);
+			req->buffer_size = MAX_BUFFER_LENGTH;
+		}
+	}
 	req->extracted = NULL;
 	req->len = 0;
 	req->error = 0;
+	req->complete = false;
+	req->keep_conn = false;
+	req->chunked = false;
+	req->chunk_state = CHUNK_SIZE;
+	req->chunk_remaining = 0;
 #ifdef _WITH_REGEX_CHECK_
 	req->regex_matched = false;
 	req->regex_subject_offset = 0;
+	req->start_offset = 0;
 #ifdef _WITH_REGEX_TIMERS_
+	req->req_time.tv_sec = 0;
+	req->req_time.tv_nsec = 0;
 	req->num_match_calls = 0;
+	req->num_partial_matches = 0;
 #endif
 #endif
-	if (url->digest)
-		MD5_Init(&req->context);
+	if (url->digest) {
+		if (!req->context)
+			req->context = EVP_MD_CTX_new();
+		EVP_DigestInit_ex(req->context, EVP_md5(), NULL);
+	}
 
 	/* Register asynchronous http/ssl read thread */
 	if (http_get_check->proto == PROTO_SSL)
@@ -1487,8 +1770,10 @@ http_request_thread(thread_ref_t thread)
 	if (thread->type == THREAD_WRITE_TIMEOUT)
 		return timeout_epilog(thread, "Timeout WEB write");
 
-	/* Allocate & clean the GET string */
-	str_request = (char *) MALLOC(GET_BUFFER_LENGTH);
+	/* The GET string buffer is allocated on first use, and kept */
+	if (!http_get_check->request)
+		http_get_check->request = (char *) MALLOC(GET_BUFFER_LENGTH);
+	str_request = http_get_check->request;
 
 	fetched_url = fetch_next_url(http_get_check);
 
@@ -1518,7 +1803,8 @@ http_request_thread(thread_ref_t thread)
 	snprintf(str_request, GET_BUFFER_LENGTH, (addr->ss_family == AF_INET6 && !vhost) ? request_template_ipv6 : request_template,
 			fetched_url->path,
 			http_get_check->http_protocol == HTTP_PROTOCOL_1_1 ? 1 : 0,
-			http_get_check->http_protocol == HTTP_PROTOCOL_1_0C || http_get_check->http_protocol == HTTP_PROTOCOL_1_1 ? "Connection: close\r\n" : "",
+			http_get_check->http_protocol == HTTP_PROTOCOL_1_0C ||
+			  (http_get_check->http_protocol == HTTP_PROTOCOL_1_1 && !http_get_check->persistent) ? "Connection: close\r\n" : "",
 			request_host, request_host_port);
 
 #ifdef _CHECKER_DEBUG_
@@ -1532,11 +1818,12 @@ http_request_thread(thread_ref_t thread)
 	else
 		ret = (send(thread->u.f.fd, str_request, strlen(str_request), 0) != -1);
 
-	FREE(str_request);
-
 	if (!ret)
 		return timeout_epilog(thread, "Cannot send get request to");
 
+	if (req->reused)
+		http_get_check->conn_reuses++;
+
 	/* Register read timeouted thread */
 	thread_add_read(thread->master, http_response_thread, checker,
 			thread->u.f.fd, timeout, true);
@@ -1572,7 +1859,13 @@ http_check_thread(thread_ref_t thread)
 
 	case connect_success:
 		if (!http_get_check->req) {
-			http_get_check->req = (request_t *) MALLOC(sizeof (request_t));
+			if (http_get_check->spare_req) {
+				http_get_check->req = http_get_check->spare_req;
+				http_get_check->spare_req = NULL;
+			} else
+				http_get_check->req = (request_t *) MALLOC(sizeof (request_t));
+			http_get_check->req->persistent = http_get_check->persistent;
+			http_get_check->connections++;
 			new_req = true;
 		} else
 			new_req = false;
@@ -1613,6 +1906,9 @@ http_check_thread(thread_ref_t thread)
 		}
 
 		if (ret) {
+			if (http_get_check->proto == PROTO_SSL)
+				ssl_connected(http_get_check);
+
 			/* Remote WEB server is connected.
 			 * Register the next step thread ssl_request_thread.
 			 */
@@ -1633,6 +1929,9 @@ http_check_thread(thread_ref_t thread)
 			if (http_get_check->proto == PROTO_SSL)
 				ssl_printerr(SSL_get_error (http_get_check->req->ssl, ret));
 #endif
+			/* Don't try resuming a session that may be the cause of the failure */
+			if (http_get_check->proto == PROTO_SSL)
+				ssl_clear_session(http_get_check);
 			return timeout_epilog(thread, "SSL handshake/communication error"
 						 " connecting to");
 		}
@@ -1642,6 +1941,16 @@ http_check_thread(thread_ref_t thread)
 	return 0;
 }
 
+/* Nothing should be received on an idle connection. Data or EOF
+ * (e.g. a TLS close_notify alert) mean the server has closed it. */
+static bool
+http_conn_usable(int fd)
+{
+	char c;
+
+	return recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == -1 && check_EAGAIN(errno);
+}
+
 static int
 http_connect_thread(thread_ref_t thread)
 {
@@ -1667,6 +1976,23 @@ http_connect_thread(thread_ref_t thread)
 	if (!fetched_url)
 		return epilog(thread, REGISTER_CHECKER_NEW) + 1;
 
+	/* Send the request on the idle persistent connection, if it is still open */
+	if (http_get_check->conn_fd != -1) {
+		fd = http_get_check->conn_fd;
+		http_get_check->conn_fd = -1;
+
+		if (http_conn_usable(fd)) {
+			http_get_check->req->reused = true;
+			http_get_check->req->keep_conn = false;
+			thread_add_write(thread->master, http_request_thread, checker,
+					 fd, co->connection_to, true);
+			return 0;
+		}
+
+		close(fd);
+		free_http_request(http_get_check);
+	}
+
 	/* Create the socket */
 	if ((fd = socket(co->dst.ss_family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, IPPROTO_TCP)) == -1) {
 		log_message(LOG_INFO, "WEB connection fail to create socket. Rescheduling.");
@@ -106,6 +106,11 @@ misc_check_handler(__attribute__((unused)) const vector_t *strvec)
 
 	/* Set non-standard default value */
 	checker->default_retry = 0;
+
+#ifdef _WITH_CHECKER_WORKERS_
+	/* Scripts are run as child processes of the main thread */
+	checker->main_thread_only = true;
+#endif
 }
 
 static void
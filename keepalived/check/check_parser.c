@@ -120,6 +120,21 @@ sslkey_handler(const vector_t *strvec)
 	}
 	check_data->ssl->keyfile = set_value(strvec);
 }
+static void
+sslsessionlifetime_handler(const vector_t *strvec)
+{
+	unsigned lifetime;
+
+	if (vector_size(strvec) < 2) {
+		report_config_error(CONFIG_GENERAL_ERROR, "SSL session_lifetime missing");
+		return;
+	}
+	if (!read_unsigned_strvec(strvec, 1, &lifetime, 0, 86400, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "SSL session_lifetime '%s' must be in [0, 86400] - ignoring", strvec_slot(strvec, 1));
+		return;
+	}
+	check_data->ssl->session_lifetime = lifetime;
+}
 
 /* Virtual Servers handlers */
 static void
@@ -163,6 +178,8 @@ vs_end_handler(void)
 	element e;
 	bool mixed_af;
 
+	vs->config_hash = get_config_block_hash();
+
 	/* If the real (sorry) server uses tunnel forwarding, the address family
 	 * does not have to match the address family of the virtual server */
 	if (vs->s_svr
@@ -951,6 +968,7 @@ init_check_keywords(bool active)
 	install_keyword("ca", &sslca_handler);
 	install_keyword("certificate", &sslcert_handler);
 	install_keyword("key", &sslkey_handler);
+	install_keyword("session_lifetime", &sslsessionlifetime_handler);
 
 	/* Virtual server mapping */
 	install_keyword_root("virtual_server_group", &vsg_handler, active);
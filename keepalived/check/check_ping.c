@@ -271,28 +271,20 @@ icmp_epilog(thread_ref_t thread, bool is_success)
 {
 	checker_t *checker;
 	unsigned long delay;
-	bool checker_was_up;
-	bool rs_was_alive;
 
 	checker = THREAD_ARG(thread);
 
 	delay = checker->delay_loop;
-	if (is_success || ((checker->is_up || !checker->has_run) && checker->retry_it >= checker->retry)) {
+	if (is_success || ((CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) && checker->retry_it >= checker->retry)) {
 		checker->retry_it = 0;
 
-		if (is_success && (!checker->is_up || !checker->has_run)) {
+		if (is_success && (!CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker))) {
 			log_message(LOG_INFO, "ICMP connection to %s success."
 					, FMT_CHK(checker));
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(UP, checker);
-			if (checker->rs->smtp_alert && !checker_was_up &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> ICMP CHECK succeed on service <=");
+			update_svr_checker_state_alert(UP, checker, "=> ICMP CHECK succeed on service <=");
 		} else if (!is_success &&
-			   (checker->is_up || !checker->has_run)) {
-			if (checker->retry && checker->has_run)
+			   (CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker))) {
+			if (checker->retry && CHECKER_HAS_RUN(checker))
 				log_message(LOG_INFO
 				    , "ICMP CHECK on service %s of %s failed after %u retries."
 				    , FMT_CHK(checker), FMT_VS(checker->vs)
@@ -301,20 +293,14 @@ icmp_epilog(thread_ref_t thread, bool is_success)
 				log_message(LOG_INFO
 				    , "ICMP CHECK on service %s failed."
 				    , FMT_CHK(checker));
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(DOWN, checker);
-			if (checker->rs->smtp_alert && checker_was_up &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> ICMP CHECK failed on service <=");
+			update_svr_checker_state_alert(DOWN, checker, "=> ICMP CHECK failed on service <=");
 		}
-	} else if (checker->is_up) {
+	} else if (CHECKER_IS_UP(checker)) {
 		delay = checker->delay_before_retry;
 		++checker->retry_it;
 	}
 
-	checker->has_run = true;
+	CHECKER_SET_HAS_RUN(checker);
 
 	thread_add_timer(thread->master, icmp_connect_thread, checker, delay);
 }
@@ -326,7 +312,7 @@ icmp_check_thread(thread_ref_t thread)
 	int status;
 
 	if (thread->type == THREAD_READ_TIMEOUT) {
-		if (checker->is_up &&
+		if (CHECKER_IS_UP(checker) &&
 		    (global_data->checker_log_all_failures || checker->log_all_failures))
 			log_message(LOG_INFO, "ICMP connection to address %s Timeout.", FMT_CHK(checker));
 		status = connect_error;
@@ -344,7 +330,7 @@ icmp_check_thread(thread_ref_t thread)
 	if (status == connect_success)
 		icmp_epilog(thread, 1);
 	else if (status == connect_error) {
-		if (checker->is_up &&
+		if (CHECKER_IS_UP(checker) &&
 		    thread->type != THREAD_READ_TIMEOUT &&
 		    (global_data->checker_log_all_failures || checker->log_all_failures))
 			log_message(LOG_INFO, "ICMP connection to %s of %s failed."
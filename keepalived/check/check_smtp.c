@@ -311,8 +311,6 @@ smtp_final(thread_ref_t thread, const char *format, ...)
 	char error_buff[512];
 	char smtp_buff[542];
 	va_list varg_list;
-	bool checker_was_up;
-	bool rs_was_alive;
 
 	/* Error or no error we should always have to close the socket */
 	if (thread->type != THREAD_TIMER)
@@ -320,7 +318,7 @@ smtp_final(thread_ref_t thread, const char *format, ...)
 
 	if (format) {
 		/* Always syslog the error when the real server is up */
-		if ((checker->is_up || !checker->has_run) &&
+		if ((CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) &&
 		    (global_data->checker_log_all_failures ||
 		     checker->log_all_failures ||
 		     checker->retry_it >= checker->retry)) {
@@ -350,23 +348,17 @@ smtp_final(thread_ref_t thread, const char *format, ...)
 		 * be noted that smtp_alert makes a copy of the string arguments, so
 		 * we don't have to keep them statically allocated.
 		 */
-		if (checker->is_up || !checker->has_run) {
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(DOWN, checker);
-			if (checker->rs->smtp_alert && checker_was_up &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails)) {
-				if (format != NULL) {
-					snprintf(error_buff, sizeof(error_buff), "=> CHECK failed on service : %s <=", format);
-					va_start(varg_list, format);
-					vsnprintf(smtp_buff, sizeof(smtp_buff), error_buff, varg_list);
-					va_end(varg_list);
-				} else
-					strncpy(smtp_buff, "=> CHECK failed on service <=", sizeof(smtp_buff));
-
-				smtp_buff[sizeof(smtp_buff) - 1] = '\0';
-				smtp_alert(SMTP_MSG_RS, checker, NULL, smtp_buff);
-			}
+		if (CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) {
+			if (format != NULL) {
+				snprintf(error_buff, sizeof(error_buff), "=> CHECK failed on service : %s <=", format);
+				va_start(varg_list, format);
+				vsnprintf(smtp_buff, sizeof(smtp_buff), error_buff, varg_list);
+				va_end(varg_list);
+			} else
+				strncpy(smtp_buff, "=> CHECK failed on service <=", sizeof(smtp_buff));
+
+			smtp_buff[sizeof(smtp_buff) - 1] = '\0';
+			update_svr_checker_state_alert(DOWN, checker, smtp_buff);
 		}
 
 		/* Reschedule the main thread using the configured delay loop */
@@ -390,20 +382,14 @@ smtp_final(thread_ref_t thread, const char *format, ...)
 	 * and insert the delay loop. When we get scheduled again the host list
 	 * will be reset and we will continue on checking them one by one.
 	 */
-	if (!checker->is_up || !checker->has_run) {
+	if (!CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) {
 		log_message(LOG_INFO, "Remote SMTP server %s succeed on service."
 				    , FMT_CHK(checker));
 
-		checker_was_up = checker->is_up;
-		rs_was_alive = checker->rs->alive;
-		update_svr_checker_state(UP, checker);
-		if (checker->rs->smtp_alert && !checker_was_up &&
-		    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-			smtp_alert(SMTP_MSG_RS, checker, NULL,
-				   "=> CHECK succeed on service <=");
+		update_svr_checker_state_alert(UP, checker, "=> CHECK succeed on service <=");
 	}
 
-	checker->has_run = true;
+	CHECKER_SET_HAS_RUN(checker);
 
 	thread_add_timer(thread->master, smtp_start_check_thread, checker, checker->delay_loop);
 
@@ -26,6 +26,7 @@
 #include "config.h"
 
 #include <fcntl.h>
+#include <time.h>
 #include <openssl/err.h>
 
 #include "check_ssl.h"
@@ -61,6 +62,34 @@ password_cb(char *buf, int num, __attribute__((unused)) int rwflag, void *userda
 	return (int)plen;
 }
 
+/* Called by OpenSSL when a session which can be resumed has been
+ * established. With TLS 1.3 this happens when a session ticket is
+ * received after the handshake, possibly more than once. */
+static int
+new_session_cb(SSL *ssl, SSL_SESSION *session)
+{
+	checker_t *checker = SSL_get_app_data(ssl);
+	http_checker_t *http_get_check;
+	long timeout;
+
+	if (!checker)
+		return 0;
+
+	http_get_check = CHECKER_ARG(checker);
+
+	/* Don't keep the session longer than the configured lifetime */
+	timeout = SSL_SESSION_get_timeout(session);
+	if (timeout <= 0 || timeout > (long)check_data->ssl->session_lifetime)
+		SSL_SESSION_set_timeout(session, (long)check_data->ssl->session_lifetime);
+
+	if (http_get_check->ssl_session)
+		SSL_SESSION_free(http_get_check->ssl_session);
+	http_get_check->ssl_session = session;
+
+	/* We have taken ownership of the session */
+	return 1;
+}
+
 /* Inititalize global SSL context */
 static bool
 build_ssl_ctx(void)
@@ -83,7 +112,7 @@ build_ssl_ctx(void)
 #endif
 
 	if (!check_data->ssl)
-		ssl = (ssl_data_t *) MALLOC(sizeof(ssl_data_t));
+		ssl = alloc_ssl();
 	else
 		ssl = check_data->ssl;
 
@@ -147,6 +176,14 @@ build_ssl_ctx(void)
 	SSL_CTX_set_verify_depth(ssl->ctx, 1);
 #endif
 
+	/* Each checker keeps its own session, so OpenSSL doesn't need to
+	 * store them, just tell us about them */
+	if (ssl->session_lifetime) {
+		SSL_CTX_set_session_cache_mode(ssl->ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(ssl->ctx, new_session_cb);
+	} else
+		SSL_CTX_set_session_cache_mode(ssl->ctx, SSL_SESS_CACHE_OFF);
+
 	return true;
 }
 
@@ -223,6 +260,19 @@ ssl_connect(thread_ref_t thread, int new_req)
 			return 0;
 		}
 
+		if (check_data->ssl->session_lifetime) {
+			SSL_set_app_data(req->ssl, checker);
+
+			/* Try to resume the session from the previous check */
+			if (http_get_check->ssl_session) {
+				if ((time_t)SSL_SESSION_get_time(http_get_check->ssl_session) +
+				    SSL_SESSION_get_timeout(http_get_check->ssl_session) <= time(NULL))
+					ssl_clear_session(http_get_check);
+				else
+					SSL_set_session(req->ssl, http_get_check->ssl_session);
+			}
+		}
+
 		if (!(req->bio = BIO_new_socket(thread->u.f.fd, BIO_NOCLOSE))) {
 			log_message(LOG_INFO, "Unable to establish ssl connection - BIO_new_socket() failed");
 			return 0;
@@ -257,6 +307,25 @@ ssl_connect(thread_ref_t thread, int new_req)
 	return ret;
 }
 
+/* Called when the handshake has completed */
+void
+ssl_connected(http_checker_t *http_get_check)
+{
+	http_get_check->ssl_handshakes++;
+	if (SSL_session_reused(http_get_check->req->ssl))
+		http_get_check->ssl_resumed++;
+}
+
+/* Forget the saved session, so the next check does a full handshake */
+void
+ssl_clear_session(http_checker_t *http_get_check)
+{
+	if (http_get_check->ssl_session) {
+		SSL_SESSION_free(http_get_check->ssl_session);
+		http_get_check->ssl_session = NULL;
+	}
+}
+
 bool
 ssl_send_request(SSL * ssl, const char *str_request, int request_len)
 {
@@ -293,19 +362,36 @@ ssl_read_thread(thread_ref_t thread)
 	if (thread->type == THREAD_READ_TIMEOUT && !req->extracted)
 		return timeout_epilog(thread, "Timeout SSL read");
 
-	/* read the SSL stream - allow for terminating the data with '\0 */
-	r = SSL_read(req->ssl, req->buffer + req->len, (int)(MAX_BUFFER_LENGTH - 1 - req->len));
+	do {
+		/* read the SSL stream - allow for terminating the data with '\0 */
+		r = SSL_read(req->ssl, req->buffer + req->len, (int)(req->buffer_size - 1 - req->len));
+
+		req->error = SSL_get_error(req->ssl, r);
+
+		if (r <= 0 || req->error)
+			break;
+
+		/* Handle response stream */
+		http_process_response(req, (size_t)r, url);
+
+		/* The rest of the response may already have been decrypted, in
+		 * which case there won't be another read event for it, since a
+		 * persistent connection isn't closed at the end of the response */
+	} while (req->persistent && !req->complete && req->chunk_state != CHUNK_ERROR && SSL_pending(req->ssl));
 
-	req->error = SSL_get_error(req->ssl, r);
+	/* There is no point waiting for the rest of a broken response */
+	if (req->chunk_state == CHUNK_ERROR)
+		return timeout_epilog(thread, "Invalid chunked response from");
 
-	if (req->error == SSL_ERROR_WANT_READ) {
+	if (req->complete) {
+		if (url->digest)
+			EVP_DigestFinal_ex(req->context, digest, NULL);
+		http_handle_response(thread, digest, false);
+	} else if (req->error == SSL_ERROR_WANT_READ) {
 		 /* async read unfinished */
 		thread_add_read(thread->master, ssl_read_thread, checker,
 				thread->u.f.fd, timeout, false);
 	} else if (r > 0 && req->error == 0) {
-		/* Handle response stream */
-		http_process_response(req, (size_t)r, url);
-
 		/*
 		 * Register next ssl stream reader.
 		 * Register itself to not perturbe global I/O multiplexer.
@@ -316,7 +402,7 @@ ssl_read_thread(thread_ref_t thread)
 
 		/* All the SSL streal has been parsed */
 		if (url->digest)
-			MD5_Final(digest, &req->context);
+			EVP_DigestFinal_ex(req->context, digest, NULL);
 		SSL_set_quiet_shutdown(req->ssl, 1);
 
 		r = (req->error == SSL_ERROR_ZERO_RETURN) ? SSL_shutdown(req->ssl) : 0;
@@ -95,8 +95,6 @@ tcp_epilog(thread_ref_t thread, bool is_success)
 {
 	checker_t *checker;
 	unsigned long delay;
-	bool checker_was_up;
-	bool rs_was_alive;
 
 	checker = THREAD_ARG(thread);
 
@@ -104,19 +102,13 @@ tcp_epilog(thread_ref_t thread, bool is_success)
 		delay = checker->delay_loop;
 		checker->retry_it = 0;
 
-		if (is_success && (!checker->is_up || !checker->has_run)) {
+		if (is_success && (!CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker))) {
 			log_message(LOG_INFO, "TCP connection to %s success."
 					, FMT_CHK(checker));
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(UP, checker);
-			if (checker->rs->smtp_alert && !checker_was_up &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> TCP CHECK succeed on service <=");
+			update_svr_checker_state_alert(UP, checker, "=> TCP CHECK succeed on service <=");
 		} else if (!is_success && 
-			   (checker->is_up || !checker->has_run)) {
-			if (checker->retry && checker->has_run)
+			   (CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker))) {
+			if (checker->retry && CHECKER_HAS_RUN(checker))
 				log_message(LOG_INFO
 				    , "TCP_CHECK on service %s failed after %u retries."
 				    , FMT_CHK(checker)
@@ -125,20 +117,14 @@ tcp_epilog(thread_ref_t thread, bool is_success)
 				log_message(LOG_INFO
 				    , "TCP_CHECK on service %s failed."
 				    , FMT_CHK(checker));
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(DOWN, checker);
-			if (checker->rs->smtp_alert && checker_was_up &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> TCP CHECK failed on service <=");
+			update_svr_checker_state_alert(DOWN, checker, "=> TCP CHECK failed on service <=");
 		}
 	} else {
 		delay = checker->delay_before_retry;
 		++checker->retry_it;
 	}
 
-	checker->has_run = true;
+	CHECKER_SET_HAS_RUN(checker);
 
 	/* Register next timer checker */
 	thread_add_timer(thread->master, tcp_connect_thread, checker, delay);
@@ -164,14 +150,14 @@ tcp_check_thread(thread_ref_t thread)
 		tcp_epilog(thread, true);
 		break;
 	case connect_timeout:
-		if (checker->is_up &&
+		if (CHECKER_IS_UP(checker) &&
 		    (global_data->checker_log_all_failures || checker->log_all_failures))
 			log_message(LOG_INFO, "TCP connection to %s timedout."
 					, FMT_CHK(checker));
 		tcp_epilog(thread, false);
 		break;
 	default:
-		if (checker->is_up &&
+		if (CHECKER_IS_UP(checker) &&
 		    (global_data->checker_log_all_failures || checker->log_all_failures))
 			log_message(LOG_INFO, "TCP connection to %s failed."
 					, FMT_CHK(checker));
@@ -109,28 +109,20 @@ udp_epilog(thread_ref_t thread, bool is_success)
 {
 	checker_t *checker;
 	unsigned long delay;
-	bool checker_was_up;
-	bool rs_was_alive;
 
 	checker = THREAD_ARG(thread);
 
 	delay = checker->delay_loop;
-	if (is_success || ((checker->is_up || !checker->has_run) && checker->retry_it >= checker->retry)) {
+	if (is_success || ((CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker)) && checker->retry_it >= checker->retry)) {
 		checker->retry_it = 0;
 
-		if (is_success && (!checker->is_up || !checker->has_run)) {
+		if (is_success && (!CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker))) {
 			log_message(LOG_INFO, "UDP connection to %s success."
 					, FMT_CHK(checker));
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(UP, checker);
-			if (checker->rs->smtp_alert && !checker_was_up &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> UDP CHECK succeed on service <=");
+			update_svr_checker_state_alert(UP, checker, "=> UDP CHECK succeed on service <=");
 		} else if (!is_success && 
-			   (checker->is_up || !checker->has_run)) {
-			if (checker->retry && checker->has_run)
+			   (CHECKER_IS_UP(checker) || !CHECKER_HAS_RUN(checker))) {
+			if (checker->retry && CHECKER_HAS_RUN(checker))
 				log_message(LOG_INFO
 				    , "UDP_CHECK on service %s failed after %u retries."
 				    , FMT_CHK(checker)
@@ -139,20 +131,14 @@ udp_epilog(thread_ref_t thread, bool is_success)
 				log_message(LOG_INFO
 				    , "UDP_CHECK on service %s failed."
 				    , FMT_CHK(checker));
-			checker_was_up = checker->is_up;
-			rs_was_alive = checker->rs->alive;
-			update_svr_checker_state(DOWN, checker);
-			if (checker->rs->smtp_alert && checker_was_up &&
-			    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
-				smtp_alert(SMTP_MSG_RS, checker, NULL,
-					   "=> UDP CHECK failed on service <=");
+			update_svr_checker_state_alert(DOWN, checker, "=> UDP CHECK failed on service <=");
 		}
-	} else if (checker->is_up) {
+	} else if (CHECKER_IS_UP(checker)) {
 		delay = checker->delay_before_retry;
 		++checker->retry_it;
 	}
 
-	checker->has_run = true;
+	CHECKER_SET_HAS_RUN(checker);
 
 	thread_add_timer(thread->master, udp_connect_thread, checker, delay);
 }
@@ -171,7 +157,7 @@ udp_check_thread(thread_ref_t thread)
 	if (status == connect_success)
 		udp_epilog(thread, true);
 	else {
-		if (checker->is_up &&
+		if (CHECKER_IS_UP(checker) &&
 		    (global_data->checker_log_all_failures || checker->log_all_failures))
 			log_message(LOG_INFO, "UDP connection to %s failed."
 					, FMT_CHK(checker));
@@ -0,0 +1,350 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Checker worker threads. Checkers are sharded by real
+ *              server across a number of threads, each running its own
+ *              scheduler. State changes are passed back through a
+ *              lock-free ring to the main checker thread, which is the
+ *              only thread that updates IPVS and quorum state.
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2020 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "check_worker.h"
+#include "check_data.h"
+#include "ipwrapper.h"
+#include "global_data.h"
+#include "memory.h"
+#include "logger.h"
+#include "jhash.h"
+
+/* How long to wait for a worker to terminate before emptying its ring again */
+#define CHECKER_WORKER_JOIN_WAIT	(10 * 1000 * 1000)	/* nanoseconds */
+
+/* A state change passed from a worker to the main thread */
+typedef struct _checker_worker_msg {
+	checker_t			*checker;
+	char				*message;	/* Email alert subject */
+	bool				alive;
+} checker_worker_msg_t;
+
+static checker_worker_t *checker_workers;
+static unsigned num_checker_workers;
+
+/* The worker the current thread is running, NULL in the main thread */
+static __thread checker_worker_t *current_worker;
+
+static void
+checker_worker_process_states(checker_worker_t *worker)
+{
+	checker_worker_msg_t msg;
+
+	while (spsc_ring_pop(worker->ring, &msg)) {
+		update_svr_checker_state_alert(msg.alive, msg.checker, msg.message);
+		if (msg.message)
+			FREE(msg.message);
+	}
+}
+
+static int
+checker_worker_notify_thread(thread_ref_t thread)
+{
+	checker_worker_t *worker = THREAD_ARG(thread);
+	uint64_t val;
+
+	if (read(worker->notify_fd, &val, sizeof(val)) == -1 && errno != EAGAIN)
+		log_message(LOG_INFO, "Checker worker %u notify read error - %d (%m)", worker->index, errno);
+
+	checker_worker_process_states(worker);
+
+	thread_add_read(thread->master, checker_worker_notify_thread, worker, worker->notify_fd, TIMER_NEVER, false);
+
+	return 0;
+}
+
+static int
+checker_worker_stop_thread(thread_ref_t thread)
+{
+	thread_add_terminate_event(thread->master);
+
+	return 0;
+}
+
+static void *
+checker_worker_main(void *arg)
+{
+	checker_worker_t *worker = arg;
+
+	current_worker = worker;
+
+	set_time_now();
+	process_threads(worker->master);
+
+	return NULL;
+}
+
+/* Called from the checker code in a worker thread. Returns false if
+ * not running in a worker, in which case the caller should update
+ * the state itself. */
+bool
+checker_worker_queue_state(bool alive, checker_t *checker, const char *message)
+{
+	checker_worker_t *worker = current_worker;
+	checker_worker_msg_t msg;
+	uint64_t val = 1;
+
+	if (!worker)
+		return false;
+
+	msg.checker = checker;
+	msg.alive = alive;
+	msg.message = message ? STRDUP(message) : NULL;
+
+	while (!spsc_ring_push(worker->ring, &msg)) {
+		/* The main thread has fallen behind. Make sure it is
+		 * woken up, and wait for it to make space. When stopping
+		 * the workers, the main thread empties the rings while
+		 * waiting for the workers to terminate. */
+		worker->ring_full++;
+		if (write(worker->notify_fd, &val, sizeof(val)) == -1 && errno != EAGAIN) {
+			log_message(LOG_INFO, "Checker worker %u notify write error - %d (%m), state change lost", worker->index, errno);
+			if (msg.message)
+				FREE(msg.message);
+			return true;
+		}
+		sched_yield();
+	}
+
+	/* The main thread owns checker->is_up and has_run, so the worker
+	 * keeps its own record of what it has reported */
+	checker->reported_up = alive;
+	checker->reported_run = true;
+	worker->state_changes++;
+
+	if (write(worker->notify_fd, &val, sizeof(val)) == -1 && errno != EAGAIN)
+		log_message(LOG_INFO, "Checker worker %u notify write error - %d (%m)", worker->index, errno);
+
+	return true;
+}
+
+thread_master_t *
+checker_thread_master(const checker_t *checker)
+{
+	return checker->worker ? checker->worker->master : master;
+}
+
+static void
+free_checker_worker(checker_worker_t *worker)
+{
+	if (worker->master)
+		thread_destroy_master(worker->master);
+	if (worker->notify_fd != -1)
+		close(worker->notify_fd);
+	if (worker->stop_fd != -1)
+		close(worker->stop_fd);
+	if (worker->ring)
+		FREE(worker->ring);
+}
+
+/* Create the workers, and assign checkers to them. This must be
+ * called before the checker threads are added. */
+void
+init_checker_workers(void)
+{
+	checker_worker_t *worker;
+	checker_t *checker;
+	element e;
+	unsigned i, j;
+
+	if (!global_data->checker_workers)
+		return;
+
+#ifdef _MEM_CHECK_
+	log_message(LOG_INFO, "checker_workers is not supported with memory checking - ignoring");
+	return;
+#endif
+
+	num_checker_workers = global_data->checker_workers;
+	checker_workers = MALLOC(num_checker_workers * sizeof(*checker_workers));
+
+	for (i = 0; i < num_checker_workers; i++) {
+		worker = &checker_workers[i];
+		worker->index = i;
+		worker->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		worker->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		worker->master = thread_make_worker_master();
+		if (worker->notify_fd == -1 || worker->stop_fd == -1 || !worker->master) {
+			log_message(LOG_INFO, "Unable to create checker worker %u - %d (%m)", i, errno);
+			break;
+		}
+
+		worker->ring = MALLOC(spsc_ring_size(CHECKER_WORKER_RING_SIZE, sizeof(checker_worker_msg_t)));
+		spsc_ring_init(worker->ring, CHECKER_WORKER_RING_SIZE, sizeof(checker_worker_msg_t));
+
+		thread_set_timer_wheel(worker->master, global_data->timer_wheel);
+		thread_add_read(worker->master, checker_worker_stop_thread, worker, worker->stop_fd, TIMER_NEVER, false);
+	}
+
+	if (i < num_checker_workers) {
+		for (j = 0; j <= i; j++)
+			free_checker_worker(&checker_workers[j]);
+		FREE(checker_workers);
+		num_checker_workers = 0;
+		return;
+	}
+
+	/* All the checkers for a real server are run by the same worker.
+	 * A checker kept over a reload carries on in the main thread. */
+	LIST_FOREACH(checkers_queue, checker, e) {
+		if (!checker->launch || checker->main_thread_only || checker->reloaded)
+			continue;
+
+		worker = &checker_workers[jhash(&checker->rs->addr, sizeof(checker->rs->addr), 0) % num_checker_workers];
+		checker->worker = worker;
+		worker->num_checkers++;
+	}
+}
+
+void
+start_checker_workers(void)
+{
+	checker_worker_t *worker;
+	checker_t *checker;
+	element e;
+	sigset_t sigset, cursigset;
+	unsigned i;
+	int ret;
+
+	if (!num_checker_workers)
+		return;
+
+	/* Once the workers are running, they only look at the state they
+	 * have reported themselves */
+	LIST_FOREACH(checkers_queue, checker, e) {
+		if (!checker->worker)
+			continue;
+		checker->reported_up = checker->is_up;
+		checker->reported_run = checker->has_run;
+	}
+
+	/* Block signals (all) we don't want the new threads to process */
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_SETMASK, &sigset, &cursigset);
+
+	for (i = 0; i < num_checker_workers; i++) {
+		worker = &checker_workers[i];
+
+		thread_add_read(master, checker_worker_notify_thread, worker, worker->notify_fd, TIMER_NEVER, false);
+
+		if ((ret = pthread_create(&worker->thread, NULL, checker_worker_main, worker))) {
+			log_message(LOG_ERR, "Unable to start checker worker %u, its checkers will not run - %d", i, ret);
+			continue;
+		}
+		worker->running = true;
+	}
+
+	/* Reenable our signals */
+	pthread_sigmask(SIG_SETMASK, &cursigset, NULL);
+
+	log_message(LOG_INFO, "Started %u checker worker threads", num_checker_workers);
+}
+
+void
+stop_checker_workers(void)
+{
+	checker_worker_t *worker;
+	struct timespec ts;
+	uint64_t val = 1;
+	unsigned i;
+	int ret;
+
+	if (!num_checker_workers)
+		return;
+
+	for (i = 0; i < num_checker_workers; i++) {
+		worker = &checker_workers[i];
+		if (!worker->running)
+			continue;
+
+		if (write(worker->stop_fd, &val, sizeof(val)) == -1)
+			log_message(LOG_INFO, "Checker worker %u stop write error - %d (%m)", i, errno);
+	}
+
+	/* A worker whose ring is full waits for us to empty it, so keep
+	 * applying state changes until the workers have terminated. */
+	for (i = 0; i < num_checker_workers; i++) {
+		worker = &checker_workers[i];
+		if (!worker->running)
+			continue;
+
+		do {
+			checker_worker_process_states(worker);
+			clock_gettime(CLOCK_REALTIME, &ts);
+			if (ts.tv_nsec < NSEC_PER_SEC - CHECKER_WORKER_JOIN_WAIT)
+				ts.tv_nsec += CHECKER_WORKER_JOIN_WAIT;
+			else {
+				ts.tv_sec++;
+				ts.tv_nsec -= NSEC_PER_SEC - CHECKER_WORKER_JOIN_WAIT;
+			}
+		} while ((ret = pthread_timedjoin_np(worker->thread, NULL, &ts)) == ETIMEDOUT);
+
+		if (ret)
+			log_message(LOG_INFO, "Checker worker %u join error - %d", i, ret);
+		worker->running = false;
+	}
+
+	for (i = 0; i < num_checker_workers; i++) {
+		worker = &checker_workers[i];
+
+		/* Apply any state changes the main thread hasn't seen yet */
+		checker_worker_process_states(worker);
+
+		log_message(LOG_INFO, "Checker worker %u stopped - %u checkers, %" PRIu64 " state changes, %" PRIu64 " ring full"
+				    , i, worker->num_checkers, worker->state_changes, worker->ring_full);
+
+		free_checker_worker(worker);
+	}
+
+	FREE(checker_workers);
+	num_checker_workers = 0;
+}
+
+void
+dump_checker_workers(FILE *fp)
+{
+	checker_worker_t *worker;
+	unsigned i;
+
+	if (!num_checker_workers)
+		return;
+
+	conf_write(fp, "------< Checker workers >------");
+	for (i = 0; i < num_checker_workers; i++) {
+		worker = &checker_workers[i];
+		conf_write(fp, " Worker %u: %s, %u checkers, %" PRIu64 " state changes, %" PRIu64 " ring full"
+			     , i, worker->running ? "running" : "stopped", worker->num_checkers
+			     , worker->state_changes, worker->ring_full);
+	}
+}
@@ -42,8 +42,35 @@
 #include "logger.h"
 #include "libipvs.h"
 #include "main.h"
+#ifdef _WITH_SNMP_CHECKER_
+#include "list_head.h"
+#include "jhash.h"
+#endif
+
+#ifdef LIBIPVS_USE_NL
+/* What a command queued in a batch changed, assuming it would succeed,
+ * so that it can be undone if the kernel rejects the command */
+typedef struct _ipvs_batch_cmd {
+	int				cmd;
+	virtual_server_t		*vs;
+	real_server_t			*rs;
+	virtual_server_group_entry_t	*vsge;	/* Alive count updated */
+	bool				vs_alive;	/* States before the command */
+	bool				rs_alive;
+	bool				rs_set;
+	bool				failed;
+	list_head_t			e_list;
+} ipvs_batch_cmd_t;
+#endif
 
 static bool no_ipvs = false;
+#ifdef LIBIPVS_USE_NL
+static unsigned ipvs_batch_depth;
+static bool ipvs_batching;
+static bool ipvs_batch_failed;
+static ipvs_batch_cmd_t ipvs_batch_cur;
+static list_head_t ipvs_batch_cmds = LIST_HEAD_INIT(ipvs_batch_cmds);
+#endif
 
 static const char * __attribute__((pure))
 ipvs_cmd_str(int cmd)
@@ -66,6 +93,13 @@ ipvs_cmd_str(int cmd)
 	return "(unknown)";
 }
 
+#ifdef _WITH_SNMP_CHECKER_
+static void ipvs_free_stats_snapshot(void);
+#endif
+#ifdef LIBIPVS_USE_NL
+static void update_vsge_alive_count(virtual_server_group_entry_t *, const virtual_server_t *, bool);
+#endif
+
 /* fetch virtual server group from group name */
 virtual_server_group_t * __attribute__ ((pure))
 ipvs_get_group_by_name(const char *gname, list l)
@@ -104,6 +138,10 @@ ipvs_stop(void)
 	if (no_ipvs)
 		return;
 
+#ifdef _WITH_SNMP_CHECKER_
+	ipvs_free_stats_snapshot();
+#endif
+
 	ipvs_close();
 }
 
@@ -123,6 +161,22 @@ ipvs_set_timeouts(int tcp_timeout, int tcpfin_timeout, int udp_timeout)
 		log_message(LOG_INFO, "Failed to set ipvs timeouts");
 }
 
+static int
+ipvs_talk_error(int cmd, int err)
+{
+	int result = -1;
+
+	if (err == EEXIST &&
+		(cmd == IP_VS_SO_SET_ADD || cmd == IP_VS_SO_SET_ADDDEST))
+		result = 0;
+	else if (err == ENOENT &&
+		(cmd == IP_VS_SO_SET_DEL || cmd == IP_VS_SO_SET_DELDEST))
+		result = 0;
+	log_message(LOG_INFO, "IPVS cmd %s(%d) error: %s(%d)", ipvs_cmd_str(cmd), cmd, ipvs_strerror(err), err);
+
+	return result;
+}
+
 /* Send user rules to IPVS module */
 static int
 ipvs_talk(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule, ipvs_daemon_t *daemonrule, bool ignore_error)
@@ -171,18 +225,136 @@ ipvs_talk(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule, ipvs_daemon_t *dae
 
 	if (ignore_error)
 		result = 0;
-	else if (result) {
-		if (errno == EEXIST &&
-			(cmd == IP_VS_SO_SET_ADD || cmd == IP_VS_SO_SET_ADDDEST))
-			result = 0;
-		else if (errno == ENOENT &&
-			(cmd == IP_VS_SO_SET_DEL || cmd == IP_VS_SO_SET_DELDEST))
-			result = 0;
-		log_message(LOG_INFO, "IPVS cmd %s(%d) error: %s(%d)", ipvs_cmd_str(cmd), cmd, ipvs_strerror(errno), errno);
-	}
+	else if (result)
+		result = ipvs_talk_error(cmd, errno);
+
 	return result;
 }
 
+/* Save the state of vs/rs before ipvs_cmd() changes it */
+static void
+ipvs_batch_save(__attribute__((unused)) virtual_server_t *vs, __attribute__((unused)) real_server_t *rs)
+{
+#ifdef LIBIPVS_USE_NL
+	if (!ipvs_batching)
+		return;
+
+	ipvs_batch_cur.vs = vs;
+	ipvs_batch_cur.rs = rs;
+	ipvs_batch_cur.vs_alive = vs->alive;
+	if (rs) {
+		ipvs_batch_cur.rs_alive = rs->alive;
+		ipvs_batch_cur.rs_set = rs->set;
+	}
+#endif
+}
+
+/* Record the saved state for the commands about to be queued for cmd.
+ * vsge is set if its alive count is updated for the command. */
+static void
+ipvs_batch_record(__attribute__((unused)) int cmd, __attribute__((unused)) virtual_server_group_entry_t *vsge)
+{
+#ifdef LIBIPVS_USE_NL
+	ipvs_batch_cmd_t *bc;
+
+	if (!ipvs_batching)
+		return;
+
+	PMALLOC(bc);
+	*bc = ipvs_batch_cur;
+	bc->cmd = cmd;
+	bc->vsge = vsge;
+	list_add_tail(&bc->e_list, &ipvs_batch_cmds);
+
+	ipvs_batch_set_data(bc);
+#endif
+}
+
+/* Commands queued from now on don't change any state */
+static void
+ipvs_batch_record_end(void)
+{
+#ifdef LIBIPVS_USE_NL
+	if (ipvs_batching)
+		ipvs_batch_set_data(NULL);
+#endif
+}
+
+#ifdef LIBIPVS_USE_NL
+/* Undo the changes made for a command the kernel rejected. A command for a
+ * group entry range is several messages, but is only undone once. */
+static void
+ipvs_batch_rollback(ipvs_batch_cmd_t *bc)
+{
+	if (bc->failed)
+		return;
+	bc->failed = true;
+
+	if (bc->vsge && (bc->cmd == IP_VS_SO_SET_ADDDEST || bc->cmd == IP_VS_SO_SET_DELDEST))
+		update_vsge_alive_count(bc->vsge, bc->vs, bc->cmd == IP_VS_SO_SET_DELDEST);
+
+	if (bc->rs) {
+		bc->rs->alive = bc->rs_alive;
+		bc->rs->set = bc->rs_set;
+	} else
+		bc->vs->alive = bc->vs_alive;
+}
+
+/* Report an error for a command that was sent as part of a batch */
+static void
+ipvs_batch_error(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule, int err, void *data)
+{
+	if (cmd == IP_VS_SO_SET_EDITDEST && err == ENOENT) {
+		if (!ipvs_talk(IP_VS_SO_SET_ADDDEST, srule, drule, NULL, false))
+			return;
+	}
+	else if (!ipvs_talk_error(cmd, err))
+		return;
+
+	ipvs_batch_failed = true;
+	if (data)
+		ipvs_batch_rollback(data);
+}
+
+/* Queue IPVS commands and send them to the kernel together when the
+ * outermost ipvs_batch_end() is called. Without netlink the commands
+ * are sent immediately. */
+void
+ipvs_batch_begin(void)
+{
+	if (no_ipvs)
+		return;
+
+	if (!ipvs_batch_depth++)
+		ipvs_batching = ipvs_batch_start(ipvs_batch_error);
+}
+
+/* Returns -1 if the outermost batch is ended and any of its commands
+ * failed. The state changed for the failed commands has been undone. */
+int
+ipvs_batch_end(void)
+{
+	ipvs_batch_cmd_t *bc, *bc_tmp;
+	int ret;
+
+	if (!ipvs_batch_depth || --ipvs_batch_depth)
+		return 0;
+
+	ipvs_batch_flush();
+	ipvs_batching = false;
+
+	list_for_each_entry_safe(bc, bc_tmp, &ipvs_batch_cmds, e_list) {
+		list_head_del(&bc->e_list);
+		FREE(bc);
+	}
+
+	ret = ipvs_batch_failed ? -1 : 0;
+	ipvs_batch_failed = false;
+
+	return ret;
+}
+#endif
+
 #ifdef _WITH_VRRP_
 /* Note: This function is called in the context of the vrrp child process, not the checker process */
 void
@@ -254,10 +426,13 @@ ipvs_group_range_cmd(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule, virtual
 	srule->user.netmask = (srule->af == AF_INET6) ? 128 : ((uint32_t) 0xffffffff);
 
 	/* Process the whole range */
+	ipvs_batch_begin();
 	for (i = 0; i <= vsg_entry->range; i++) {
 		/* Talk to the IPVS channel */
-		if (ipvs_talk(cmd, srule, drule, NULL, false))
+		if (ipvs_talk(cmd, srule, drule, NULL, false)) {
+			ipvs_batch_end();
 			return -1;
+		}
 
 		if (srule->af == AF_INET)
 			srule->nf_addr.ip += htonl(1);
@@ -265,7 +440,8 @@ ipvs_group_range_cmd(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule, virtual
 			srule->nf_addr.in6.s6_addr16[7] = htons(ntohs(srule->nf_addr.in6.s6_addr16[7]) + 1);
 	}
 
-	return 0;
+	/* If this is the outermost batch, any errors are reported now */
+	return ipvs_batch_end();
 }
 
 /* set IPVS group rules */
@@ -377,6 +553,7 @@ ipvs_group_cmd(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule, virtual_serve
 					drule->user.port = inet_sockaddrport(&rs->addr);
 			}
 
+			ipvs_batch_record(cmd, vsg_entry);
 			if (ipvs_group_range_cmd(cmd, srule, drule, vsg_entry))
 				return -1;
 		}
@@ -407,6 +584,7 @@ ipvs_group_cmd(int cmd, ipvs_service_t *srule, ipvs_dest_t *drule, virtual_serve
 
 		/* Talk to the IPVS channel */
 		if (ipvs_change_needed(cmd, vsg_entry, vs, rs)) {
+			ipvs_batch_record(cmd, vsg_entry);
 			if (ipvs_talk(cmd, srule, drule, NULL, false))
 				return -1;
 		}
@@ -480,6 +658,10 @@ ipvs_cmd(int cmd, virtual_server_t *vs, real_server_t *rs)
 {
 	ipvs_service_t srule;
 	ipvs_dest_t drule;
+	int ret;
+
+	/* In case the command is queued and fails */
+	ipvs_batch_save(vs, rs);
 
 	/* Allocate the room */
 	ipvs_set_srule(cmd, &srule, vs);
@@ -505,8 +687,11 @@ ipvs_cmd(int cmd, virtual_server_t *vs, real_server_t *rs)
 	}
 
 	/* Set vs rule and send to kernel */
-	if (vs->vsg)
-		return ipvs_group_cmd(cmd, &srule, &drule, vs, rs);
+	if (vs->vsg) {
+		ret = ipvs_group_cmd(cmd, &srule, &drule, vs, rs);
+		ipvs_batch_record_end();
+		return ret;
+	}
 
 	if (vs->vfwmark) {
 		srule.user.fwmark = vs->vfwmark;
@@ -523,7 +708,11 @@ ipvs_cmd(int cmd, virtual_server_t *vs, real_server_t *rs)
 	}
 
 	/* Talk to the IPVS channel */
-	return ipvs_talk(cmd, &srule, &drule, NULL, false);
+	ipvs_batch_record(cmd, NULL);
+	ret = ipvs_talk(cmd, &srule, &drule, NULL, false);
+	ipvs_batch_record_end();
+
+	return ret;
 }
 
 /* at reload, add alive destinations to the newly created vsge */
@@ -602,38 +791,199 @@ ipvs_group_remove_entry(virtual_server_t *vs, virtual_server_group_entry_t *vsge
 }
 
 #ifdef _WITH_SNMP_CHECKER_
-static inline bool
-vsd_equal(real_server_t *rs, struct ip_vs_dest_entry_app *entry)
+/*
+ * Statistics snapshot.
+ *
+ * Rather than asking the kernel for each service of each virtual server
+ * as SNMP walks the MIB, the whole service table is dumped once per
+ * refresh period and indexed by (af, protocol, addr, port, fwmark). The
+ * destinations of a service are fetched the first time the service is
+ * looked up after a refresh, and sorted so that real servers can be
+ * found with a binary search.
+ */
+typedef struct _ipvs_stats_key {
+	uint32_t		fwmark;
+	uint16_t		af;
+	uint16_t		protocol;
+	uint16_t		port;
+	union nf_inet_addr	addr;
+} ipvs_stats_key_t;
+
+typedef struct _ipvs_stats_svc {
+	ipvs_stats_key_t	key;
+	ipvs_service_entry_t	*entry;
+	struct ip_vs_get_dests_app *dests;
+	bool			dests_fetched;
+	hlist_node_t		hnode;
+} ipvs_stats_svc_t;
+
+static struct {
+	struct ip_vs_get_services_app *services;
+	ipvs_stats_svc_t	*svcs;
+	hlist_head_t		*hash;
+	unsigned		hash_size;
+	time_t			updated;
+} stats_snap;
+
+static void
+ipvs_stats_set_key(ipvs_stats_key_t *key, uint32_t fwmark, uint16_t af, uint16_t protocol,
+		   const union nf_inet_addr *addr, uint16_t port)
+{
+	memset(key, 0, sizeof(*key));
+	key->af = af;
+
+	if (fwmark) {
+		key->fwmark = fwmark;
+		return;
+	}
+
+	key->protocol = protocol;
+	key->port = port;
+	if (af == AF_INET6)
+		key->addr.in6 = addr->in6;
+	else
+		key->addr.ip = addr->ip;
+}
+
+static inline unsigned
+ipvs_stats_hash(const ipvs_stats_key_t *key)
 {
-	if (entry->af != AF_INET && entry->af != AF_INET6)
-		return false;
+	return jhash(key, sizeof(*key), 0) & (stats_snap.hash_size - 1);
+}
 
-	if (rs->addr.ss_family != entry->af)
-		return false;
+static void
+ipvs_free_stats_snapshot(void)
+{
+	unsigned i;
 
-	if (!inaddr_equal(entry->af, &entry->nf_addr,
-			entry->af == AF_INET ? (void *)&((struct sockaddr_in *)&rs->addr)->sin_addr
-					     : (void *)&((struct sockaddr_in6 *)&rs->addr)->sin6_addr))
-		return false;
+	if (!stats_snap.services)
+		return;
 
-	if (entry->user.port != (entry->af == AF_INET ? ((struct sockaddr_in *)&rs->addr)->sin_port
-						      : ((struct sockaddr_in6 *)&rs->addr)->sin6_port))
-		return false;
+	for (i = 0; i < stats_snap.services->user.num_services; i++) {
+		if (stats_snap.svcs[i].dests)
+			FREE(stats_snap.svcs[i].dests);
+	}
 
-	return true;
+	FREE(stats_snap.svcs);
+	FREE(stats_snap.hash);
+	FREE(stats_snap.services);
+}
+
+static void
+ipvs_refresh_stats_snapshot(time_t cur_time)
+{
+	ipvs_service_entry_t *entry;
+	ipvs_stats_svc_t *svc;
+	unsigned num, i;
+
+	ipvs_free_stats_snapshot();
+	stats_snap.updated = cur_time;
+
+	if (no_ipvs || !(stats_snap.services = ipvs_get_services()))
+		return;
+
+	num = stats_snap.services->user.num_services;
+	for (stats_snap.hash_size = 16; stats_snap.hash_size < num; stats_snap.hash_size <<= 1);
+	stats_snap.hash = MALLOC(stats_snap.hash_size * sizeof(*stats_snap.hash));
+	stats_snap.svcs = MALLOC((num ? num : 1) * sizeof(*stats_snap.svcs));
+
+	for (i = 0; i < num; i++) {
+		entry = &stats_snap.services->user.entrytable[i];
+		svc = &stats_snap.svcs[i];
+
+		svc->entry = entry;
+		ipvs_stats_set_key(&svc->key, entry->user.fwmark, entry->af, entry->user.protocol,
+				   &entry->nf_addr, entry->user.port);
+		hlist_add_head(&svc->hnode, &stats_snap.hash[ipvs_stats_hash(&svc->key)]);
+	}
+}
+
+static ipvs_stats_svc_t *
+ipvs_stats_find_svc(uint32_t fwmark, uint16_t af, uint16_t protocol, const union nf_inet_addr *addr, uint16_t port)
+{
+	ipvs_stats_key_t key;
+	ipvs_stats_svc_t *svc;
+	hlist_node_t *pos;
+
+	if (!stats_snap.services)
+		return NULL;
+
+	ipvs_stats_set_key(&key, fwmark, af, protocol, addr, port);
+
+	hlist_for_each_entry(svc, pos, &stats_snap.hash[ipvs_stats_hash(&key)], hnode) {
+		if (!memcmp(&svc->key, &key, sizeof(key)))
+			return svc;
+	}
+
+	return NULL;
+}
+
+static int
+ipvs_dest_entry_cmp(const void *a, const void *b)
+{
+	const ipvs_dest_entry_t *da = a;
+	const ipvs_dest_entry_t *db = b;
+	int ret;
+
+	if (da->af != db->af)
+		return da->af < db->af ? -1 : 1;
+	if ((ret = memcmp(&da->nf_addr, &db->nf_addr, da->af == AF_INET6 ? sizeof(da->nf_addr.in6) : sizeof(da->nf_addr.ip))))
+		return ret;
+	if (da->user.port != db->user.port)
+		return da->user.port < db->user.port ? -1 : 1;
+
+	return 0;
+}
+
+static ipvs_dest_entry_t *
+ipvs_stats_find_dest(struct ip_vs_get_dests_app *dests, real_server_t *rs)
+{
+	ipvs_dest_entry_t key;
+
+	if (rs->addr.ss_family != AF_INET && rs->addr.ss_family != AF_INET6)
+		return NULL;
+
+	memset(&key, 0, sizeof(key));
+	key.af = rs->addr.ss_family;
+	if (key.af == AF_INET6)
+		inet_sockaddrip6(&rs->addr, &key.nf_addr.in6);
+	else
+		key.nf_addr.ip = inet_sockaddrip4(&rs->addr);
+	key.user.port = inet_sockaddrport(&rs->addr);
+
+	return bsearch(&key, dests->user.entrytable, dests->user.num_dests, sizeof(key), ipvs_dest_entry_cmp);
+}
+
+static void
+ipvs_add_rs_stats(real_server_t *rs, const ipvs_dest_entry_t *dest)
+{
+	rs->activeconns		+= dest->user.activeconns;
+	rs->inactconns		+= dest->user.inactconns;
+	rs->persistconns	+= dest->user.persistconns;
+	rs->stats.conns		+= dest->stats.conns;
+	rs->stats.inpkts	+= dest->stats.inpkts;
+	rs->stats.outpkts	+= dest->stats.outpkts;
+	rs->stats.inbytes	+= dest->stats.inbytes;
+	rs->stats.outbytes	+= dest->stats.outbytes;
+	rs->stats.cps		+= dest->stats.cps;
+	rs->stats.inpps		+= dest->stats.inpps;
+	rs->stats.outpps	+= dest->stats.outpps;
+	rs->stats.inbps		+= dest->stats.inbps;
+	rs->stats.outbps	+= dest->stats.outbps;
 }
 
 static void
 ipvs_update_vs_stats(virtual_server_t *vs, uint32_t fwmark, union nf_inet_addr *nfaddr, uint16_t port)
 {
 	element e;
-	struct ip_vs_get_dests_app *dests = NULL;
 	real_server_t *rs;
-	unsigned int i;
+	ipvs_stats_svc_t *svc;
 	ipvs_service_entry_t *serv;
+	ipvs_dest_entry_t *dest;
 
-	if (!(serv = ipvs_get_service(fwmark, vs->af, vs->service_type, nfaddr, port)))
+	if (!(svc = ipvs_stats_find_svc(fwmark, vs->af, vs->service_type, nfaddr, port)))
 		return;
+	serv = svc->entry;
 
 	/* Update virtual server stats */
 	vs->stats.conns		+= serv->stats.conns;
@@ -648,45 +998,25 @@ ipvs_update_vs_stats(virtual_server_t *vs, uint32_t fwmark, union nf_inet_addr *
 	vs->stats.outbps	+= serv->stats.outbps;
 
 	/* Get real servers */
-	dests = ipvs_get_dests(serv);
-	FREE(serv);
-	if (!dests)
+	if (!svc->dests_fetched) {
+		svc->dests_fetched = true;
+		if ((svc->dests = ipvs_get_dests(serv)))
+			qsort(svc->dests->user.entrytable, svc->dests->user.num_dests,
+			      sizeof(*svc->dests->user.entrytable), ipvs_dest_entry_cmp);
+	}
+	if (!svc->dests)
 		return;
 
-	for (i = 0; i < dests->user.num_dests; i++) {
-		rs = NULL;
-
-		/* Is it the sorry server? */
-		if (vs->s_svr && vsd_equal(vs->s_svr, &dests->user.entrytable[i]))
-			rs = vs->s_svr;
-		else {
-			/* Search for a match in the list of real servers */
-			for (e = LIST_HEAD(vs->rs); e; ELEMENT_NEXT(e)) {
-				rs = ELEMENT_DATA(e);
-				if (vsd_equal(rs, &dests->user.entrytable[i]))
-					break;
-			}
-			if (!e)
-				rs = NULL;
-		}
+	/* The sorry server takes precedence over a real server with the same address */
+	if (vs->s_svr && (dest = ipvs_stats_find_dest(svc->dests, vs->s_svr)))
+		ipvs_add_rs_stats(vs->s_svr, dest);
 
-		if (rs) {
-			rs->activeconns		+= dests->user.entrytable[i].user.activeconns;
-			rs->inactconns		+= dests->user.entrytable[i].user.inactconns;
-			rs->persistconns	+= dests->user.entrytable[i].user.persistconns;
-			rs->stats.conns		+= dests->user.entrytable[i].stats.conns;
-			rs->stats.inpkts	+= dests->user.entrytable[i].stats.inpkts;
-			rs->stats.outpkts	+= dests->user.entrytable[i].stats.outpkts;
-			rs->stats.inbytes	+= dests->user.entrytable[i].stats.inbytes;
-			rs->stats.outbytes	+= dests->user.entrytable[i].stats.outbytes;
-			rs->stats.cps		+= dests->user.entrytable[i].stats.cps;
-			rs->stats.inpps		+= dests->user.entrytable[i].stats.inpps;
-			rs->stats.outpps	+= dests->user.entrytable[i].stats.outpps;
-			rs->stats.inbps		+= dests->user.entrytable[i].stats.inbps;
-			rs->stats.outbps	+= dests->user.entrytable[i].stats.outbps;
-		}
+	LIST_FOREACH(vs->rs, rs, e) {
+		if (vs->s_svr && sockstorage_equal(&rs->addr, &vs->s_svr->addr))
+			continue;
+		if ((dest = ipvs_stats_find_dest(svc->dests, rs)))
+			ipvs_add_rs_stats(rs, dest);
 	}
-	FREE(dests);
 }
 
 /* Update statistics for a given virtual server. This includes
@@ -704,9 +1034,13 @@ ipvs_update_stats(virtual_server_t *vs)
 	real_server_t *rs;
 	time_t cur_time = time(NULL);
 
-	if (cur_time - vs->lastupdated < STATS_REFRESH)
+	if (cur_time - stats_snap.updated >= global_data->lvs_stats_refresh)
+		ipvs_refresh_stats_snapshot(cur_time);
+
+	/* Already up to date with the current snapshot */
+	if (vs->lastupdated == stats_snap.updated)
 		return;
-	vs->lastupdated = cur_time;
+	vs->lastupdated = stats_snap.updated;
 
 	/* Reset stats */
 	memset(&vs->stats, 0, sizeof(vs->stats));
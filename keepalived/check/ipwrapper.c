@@ -37,6 +37,10 @@
 #include "smtp.h"
 #include "check_daemon.h"
 #include "track_file.h"
+#include "jhash.h"
+#ifdef _WITH_CHECKER_WORKERS_
+#include "check_worker.h"
+#endif
 
 static bool __attribute((pure))
 vs_iseq(const virtual_server_t *vs_a, const virtual_server_t *vs_b)
@@ -80,6 +84,194 @@ vsge_iseq(const virtual_server_group_entry_t *vsge_a, const virtual_server_group
 	return true;
 }
 
+/* On a reload, the old virtual servers, real servers and checkers are
+ * matched with the new ones using the following indexes, rather than by
+ * searching lists. */
+struct _vs_index {
+	unsigned mask;
+	virtual_server_t *slot[];
+};
+
+struct _rs_index {
+	unsigned mask;
+	real_server_t *slot[];
+};
+
+/* Checkers sorted by real server, and then by their order in the queue */
+typedef struct _checker_index_ent {
+	const real_server_t *rs;
+	size_t seq;
+	checker_t *checker;
+	element e;		/* The checker's element in the queue */
+} checker_index_ent_t;
+
+typedef struct _checker_index {
+	checker_index_ent_t *ents;
+	size_t num;
+} checker_index_t;
+
+/* A virtual server kept over a reload, and the new one it replaces */
+typedef struct _kept_vs {
+	virtual_server_t *new_vs;
+	virtual_server_t *old_vs;
+} kept_vs_t;
+
+/* Counts for the reload summary */
+typedef struct _reload_counts {
+	unsigned vs_kept;
+	unsigned vs_changed;
+	unsigned vs_removed;
+	unsigned rs_kept;
+	unsigned rs_changed;
+	unsigned rs_removed;
+} reload_counts_t;
+
+static uint32_t __attribute__ ((pure))
+sockstorage_hash(const struct sockaddr_storage *addr, uint32_t initval)
+{
+	if (addr->ss_family == AF_INET) {
+		const struct sockaddr_in *addr4 = (const struct sockaddr_in *) addr;
+		return jhash_2words(addr4->sin_addr.s_addr, addr4->sin_port, initval);
+	}
+	if (addr->ss_family == AF_INET6) {
+		const struct sockaddr_in6 *addr6 = (const struct sockaddr_in6 *) addr;
+		const uint32_t *a = addr6->sin6_addr.s6_addr32;
+		return jhash_3words(a[0], a[1], a[2], jhash_2words(a[3], addr6->sin6_port, initval));
+	}
+
+	return initval;
+}
+
+/* This must be consistent with vs_iseq(). Virtual servers using a virtual
+ * server group are only hashed on the port, since there are few of them. */
+static uint32_t __attribute__ ((pure))
+vs_hash(const virtual_server_t *vs)
+{
+	if (vs->vsgname)
+		return jhash_1word(inet_sockaddrport(&vs->addr), 1);
+	if (vs->vfwmark)
+		return jhash_2words(vs->vfwmark, vs->af, 2);
+	return sockstorage_hash(&vs->addr, vs->service_type);
+}
+
+static unsigned __attribute__ ((const))
+alloc_index_size(unsigned num)
+{
+	unsigned size = 4;
+
+	while (size < num * 2)
+		size <<= 1;
+
+	return size;
+}
+
+vs_index_t *
+alloc_vs_index(list l)
+{
+	vs_index_t *index;
+	virtual_server_t *vs;
+	element e;
+	unsigned size = alloc_index_size(LIST_SIZE(l));
+	unsigned slot;
+
+	index = MALLOC(sizeof(*index) + size * sizeof(index->slot[0]));
+	index->mask = size - 1;
+
+	LIST_FOREACH(l, vs, e) {
+		for (slot = vs_hash(vs) & index->mask;
+		     index->slot[slot];
+		     slot = (slot + 1) & index->mask) {
+			if (vs_iseq(index->slot[slot], vs))
+				break;
+		}
+		if (!index->slot[slot])
+			index->slot[slot] = vs;
+	}
+
+	return index;
+}
+
+static rs_index_t *
+alloc_rs_index(list l)
+{
+	rs_index_t *index;
+	real_server_t *rs;
+	element e;
+	unsigned size = alloc_index_size(LIST_SIZE(l));
+	unsigned slot;
+
+	index = MALLOC(sizeof(*index) + size * sizeof(index->slot[0]));
+	index->mask = size - 1;
+
+	LIST_FOREACH(l, rs, e) {
+		for (slot = sockstorage_hash(&rs->addr, 0) & index->mask;
+		     index->slot[slot];
+		     slot = (slot + 1) & index->mask) {
+			if (rs_iseq(index->slot[slot], rs))
+				break;
+		}
+		if (!index->slot[slot])
+			index->slot[slot] = rs;
+	}
+
+	return index;
+}
+
+static int
+checker_index_cmp(const void *a, const void *b)
+{
+	const checker_index_ent_t *ent_a = a;
+	const checker_index_ent_t *ent_b = b;
+
+	if (ent_a->rs != ent_b->rs)
+		return (uintptr_t)ent_a->rs < (uintptr_t)ent_b->rs ? -1 : 1;
+
+	return ent_a->seq < ent_b->seq ? -1 : ent_a->seq > ent_b->seq;
+}
+
+static void
+alloc_checker_index(checker_index_t *index, list l)
+{
+	checker_t *checker;
+	element e;
+
+	index->num = 0;
+	index->ents = MALLOC((LIST_SIZE(l) + 1) * sizeof(*index->ents));
+
+	LIST_FOREACH(l, checker, e) {
+		index->ents[index->num].rs = checker->rs;
+		index->ents[index->num].seq = index->num;
+		index->ents[index->num].checker = checker;
+		index->ents[index->num].e = e;
+		index->num++;
+	}
+
+	qsort(index->ents, index->num, sizeof(*index->ents), checker_index_cmp);
+}
+
+/* Returns the first checker of the real server, and sets *num to the number of them */
+static checker_index_ent_t *
+checker_index_find(const checker_index_t *index, const real_server_t *rs, size_t *num)
+{
+	size_t low = 0, high = index->num, mid;
+	size_t first;
+
+	/* Find the first entry for rs */
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if ((uintptr_t)index->ents[mid].rs < (uintptr_t)rs)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (first = low; low < index->num && index->ents[low].rs == rs; low++);
+
+	*num = low - first;
+
+	return &index->ents[first];
+}
+
 /* Returns the sum of all alive RS weight in a virtual server. */
 static unsigned long __attribute__ ((pure))
 weigh_live_realservers(virtual_server_t * vs)
@@ -334,12 +526,14 @@ clear_services(void)
 	if (!check_data || !check_data->vs)
 		return;
 
+	ipvs_batch_begin();
 	LIST_FOREACH(check_data->vs, vs, e) {
 		/* Remove the real servers, and clear the vs unless it is
 		 * using a VS group and it is not the last vs of the same
 		 * protocol or address family using the group. */
 		clear_service_vs(vs, true);
 	}
+	ipvs_batch_end();
 }
 
 /* Set a realserver IPVS rules */
@@ -392,7 +586,8 @@ init_service_rs(virtual_server_t * vs)
 		 */
 		if ((!rs->num_failed_checkers && !ISALIVE(rs)) ||
 		    (rs->inhibit && !rs->set)) {
-			ipvs_cmd(LVS_CMD_ADD_DEST, vs, rs);
+			if (ipvs_cmd(LVS_CMD_ADD_DEST, vs, rs))
+				return false;
 			if (!rs->num_failed_checkers) {
 				SET_ALIVE(rs);
 				if (global_data->rs_init_notifies)
@@ -446,6 +641,7 @@ perform_quorum_state(virtual_server_t *vs, bool add)
 	log_message(LOG_INFO, "%s the pool for VS %s"
 			    , add?"Adding alive servers to":"Removing alive servers from"
 			    , FMT_VS(vs));
+	ipvs_batch_begin();
 	LIST_FOREACH(vs->rs, rs, e) {
 		if (!ISALIVE(rs)) /* We only handle alive servers */
 			continue;
@@ -455,6 +651,7 @@ perform_quorum_state(virtual_server_t *vs, bool add)
 		ipvs_cmd(add?LVS_CMD_ADD_DEST:LVS_CMD_DEL_DEST, vs, rs);
 		rs->alive = true;
 	}
+	ipvs_batch_end();
 }
 
 void
@@ -591,7 +788,8 @@ init_service_vs(virtual_server_t * vs)
 {
 	/* Init the VS root */
 	if (!ISALIVE(vs) || vs->vsg) {
-		ipvs_cmd(LVS_CMD_ADD, vs, NULL);
+		if (ipvs_cmd(LVS_CMD_ADD, vs, NULL))
+			return false;
 		SET_ALIVE(vs);
 	}
 
@@ -631,13 +829,21 @@ init_services(void)
 {
 	element e;
 	virtual_server_t *vs;
+	bool ret = true;
 
+	ipvs_batch_begin();
 	LIST_FOREACH(check_data->vs, vs, e) {
-		if (!init_service_vs(vs))
-			return false;
+		if (!init_service_vs(vs)) {
+			ret = false;
+			break;
+		}
 	}
 
-	return true;
+	/* Commands that are queued report their errors when sent */
+	if (ipvs_batch_end())
+		ret = false;
+
+	return ret;
 }
 
 /* Store new weight in real_server struct and then update kernel. */
@@ -722,6 +928,28 @@ update_svr_checker_state(bool alive, checker_t *checker)
 	set_checker_state(checker, alive);
 }
 
+/* Update checker's state, and send an email alert with the given subject
+ * if the checker's state has changed. If running in a checker worker
+ * thread, the update is passed to the main checker thread. */
+void
+update_svr_checker_state_alert(bool alive, checker_t *checker, const char *message)
+{
+	bool checker_was_up;
+	bool rs_was_alive;
+
+#ifdef _WITH_CHECKER_WORKERS_
+	if (checker_worker_queue_state(alive, checker, message))
+		return;
+#endif
+
+	checker_was_up = checker->is_up;
+	rs_was_alive = checker->rs->alive;
+	update_svr_checker_state(alive, checker);
+	if (checker->rs->smtp_alert && checker_was_up != alive &&
+	    (rs_was_alive != checker->rs->alive || !global_data->no_checker_emails))
+		smtp_alert(SMTP_MSG_RS, checker, NULL, message);
+}
+
 /* Check if a vsg entry is in new data */
 static virtual_server_group_entry_t * __attribute__ ((pure))
 vsge_exist(virtual_server_group_entry_t *vsg_entry, list l)
@@ -814,15 +1042,16 @@ clear_diff_vsg(virtual_server_t * old_vs, virtual_server_t * new_vs)
 }
 
 /* Check if a vs exist in new data and returns pointer to it */
-static virtual_server_t* __attribute__ ((pure))
-vs_exist(virtual_server_t * old_vs)
+virtual_server_t * __attribute__ ((pure))
+vs_exist(const virtual_server_t *old_vs, const vs_index_t *index)
 {
-	element e;
-	virtual_server_t *vs;
+	unsigned slot;
 
-	LIST_FOREACH(check_data->vs, vs, e) {
-		if (vs_iseq(old_vs, vs))
-			return vs;
+	for (slot = vs_hash(old_vs) & index->mask;
+	     index->slot[slot];
+	     slot = (slot + 1) & index->mask) {
+		if (vs_iseq(old_vs, index->slot[slot]))
+			return index->slot[slot];
 	}
 
 	return NULL;
@@ -830,63 +1059,95 @@ vs_exist(virtual_server_t * old_vs)
 
 /* Check if rs is in new vs data */
 static real_server_t * __attribute__ ((pure))
-rs_exist(real_server_t * old_rs, list l)
+rs_exist(const real_server_t *old_rs, const rs_index_t *index)
 {
-	element e;
-	real_server_t *rs;
-
-	if (LIST_ISEMPTY(l))
-		return NULL;
+	unsigned slot;
 
-	LIST_FOREACH(l, rs, e) {
-		if (rs_iseq(rs, old_rs))
-			return rs;
+	for (slot = sockstorage_hash(&old_rs->addr, 0) & index->mask;
+	     index->slot[slot];
+	     slot = (slot + 1) & index->mask) {
+		if (rs_iseq(index->slot[slot], old_rs))
+			return index->slot[slot];
 	}
 
 	return NULL;
 }
 
+/* If the configuration block of the vs hasn't changed, the real servers
+ * will normally be in the same order, so they are paired by position,
+ * and the index is only built if that turns out not to be the case. */
+void
+rs_matcher_init(rs_matcher_t *matcher, const virtual_server_t *old_vs, const virtual_server_t *new_vs)
+{
+	matcher->new_rs = new_vs->rs;
+	matcher->next = old_vs->config_hash == new_vs->config_hash ? LIST_HEAD(new_vs->rs) : NULL;
+	matcher->index = NULL;
+}
+
+/* The old real servers must be passed in list order */
+real_server_t *
+rs_matcher_find(rs_matcher_t *matcher, const real_server_t *old_rs)
+{
+	real_server_t *new_rs;
+
+	if (matcher->next && rs_iseq(old_rs, ELEMENT_DATA(matcher->next))) {
+		new_rs = ELEMENT_DATA(matcher->next);
+		ELEMENT_NEXT(matcher->next);
+		return new_rs;
+	}
+
+	matcher->next = NULL;
+	if (!matcher->index)
+		matcher->index = alloc_rs_index(matcher->new_rs);
+
+	return rs_exist(old_rs, matcher->index);
+}
+
+void
+rs_matcher_free(rs_matcher_t *matcher)
+{
+	FREE_PTR(matcher->index);
+}
+
 static void
-migrate_checkers(virtual_server_t *vs, real_server_t *old_rs, real_server_t *new_rs, list old_checkers_queue)
+migrate_checkers(virtual_server_t *vs, real_server_t *old_rs, real_server_t *new_rs,
+		 const checker_index_t *old_checkers, const checker_index_t *new_checkers)
 {
-	list l;
-	element e, e1;
+	checker_index_ent_t *old_ents, *new_ents;
+	size_t num_old, num_new;
+	size_t i, j;
 	checker_t *old_c, *new_c;
 	checker_t dummy_checker;
 	bool a_checker_has_run = false;
 
-	l = alloc_list(NULL, NULL);
-	LIST_FOREACH(old_checkers_queue, old_c, e) {
-		if (old_c->rs == old_rs)
-			list_add(l, old_c);
-	}
+	old_ents = checker_index_find(old_checkers, old_rs, &num_old);
+	new_ents = checker_index_find(new_checkers, new_rs, &num_new);
 
-	if (!LIST_ISEMPTY(l)) {
-		LIST_FOREACH(checkers_queue, new_c, e) {
-			if (new_c->rs != new_rs || !new_c->compare)
-				continue;
-			LIST_FOREACH(l, old_c, e1) {
-				if (old_c->compare == new_c->compare && new_c->compare(old_c, new_c)) {
-					/* Update status if different */
-					if (old_c->has_run && old_c->is_up != new_c->is_up)
-						set_checker_state(new_c, old_c->is_up);
-
-					/* Transfer some other state flags */
-					new_c->has_run = old_c->has_run;
+	for (i = 0; i < num_new && num_old; i++) {
+		new_c = new_ents[i].checker;
+		if (!new_c->compare)
+			continue;
+		for (j = 0; j < num_old; j++) {
+			old_c = old_ents[j].checker;
+			if (old_c->compare == new_c->compare && new_c->compare(old_c, new_c)) {
+				/* Update status if different */
+				if (old_c->has_run && old_c->is_up != new_c->is_up)
+					set_checker_state(new_c, old_c->is_up);
+
+				/* Transfer some other state flags */
+				new_c->has_run = old_c->has_run;
 // retry_it needs fixing -  if retry changes, we may already have exceeded count
-					new_c->retry_it = old_c->retry_it;
+				new_c->retry_it = old_c->retry_it;
 
-					break;
-				}
+				break;
 			}
 		}
 	}
 
 	/* Find out how many checkers are really failed */
 	new_rs->num_failed_checkers = 0;
-	LIST_FOREACH(checkers_queue, new_c, e) {
-		if (new_c->rs != new_rs)
-			continue;
+	for (i = 0; i < num_new; i++) {
+		new_c = new_ents[i].checker;
 		if (new_c->has_run && !new_c->is_up)
 			new_rs->num_failed_checkers++;
 		if (new_c->has_run)
@@ -896,9 +1157,8 @@ migrate_checkers(virtual_server_t *vs, real_server_t *old_rs, real_server_t *new
 	/* If a checker has failed, set new alpha checkers to be down until
 	 * they have run. */
 	if (new_rs->num_failed_checkers || (!new_rs->alive && !a_checker_has_run)) {
-		LIST_FOREACH(checkers_queue, new_c, e) {
-			if (new_c->rs != new_rs)
-				continue;
+		for (i = 0; i < num_new; i++) {
+			new_c = new_ents[i].checker;
 			if (!new_c->has_run) {
 				if (new_c->alpha)
 					set_checker_state(new_c, false);
@@ -915,31 +1175,35 @@ migrate_checkers(virtual_server_t *vs, real_server_t *old_rs, real_server_t *new
 		perform_svr_state(true, &dummy_checker);
 	} else if (new_rs->num_failed_checkers && new_rs->set != new_rs->inhibit)
 		ipvs_cmd(new_rs->inhibit ? IP_VS_SO_SET_ADDDEST : IP_VS_SO_SET_DELDEST, vs, new_rs);
-
-	free_list(&l);
 }
 
 /* Clear the diff rs of the old vs */
 static void
-clear_diff_rs(virtual_server_t *old_vs, virtual_server_t *new_vs, list old_checkers_queue)
+clear_diff_rs(virtual_server_t *old_vs, virtual_server_t *new_vs,
+	      const checker_index_t *old_checkers, const checker_index_t *new_checkers,
+	      reload_counts_t *counts)
 {
 	element e;
 	real_server_t *rs, *new_rs;
 	list rs_to_remove;
+	rs_matcher_t matcher;
 
 	/* If old vs didn't own rs then nothing return */
 	if (LIST_ISEMPTY(old_vs->rs))
 		return;
 
+	rs_matcher_init(&matcher, old_vs, new_vs);
+
 	/* remove RS from old vs which are not found in new vs */
 	rs_to_remove = alloc_list (NULL, NULL);
 	LIST_FOREACH(old_vs->rs, rs, e) {
-		new_rs = rs_exist(rs, new_vs->rs);
+		new_rs = rs_matcher_find(&matcher, rs);
 		if (!new_rs) {
 			log_message(LOG_INFO, "service %s no longer exist"
 					    , FMT_RS(rs, old_vs));
 
 			list_add (rs_to_remove, rs);
+			counts->rs_removed++;
 		} else {
 			/*
 			 * We reflect the previous alive
@@ -961,7 +1225,7 @@ clear_diff_rs(virtual_server_t *old_vs, virtual_server_t *new_vs, list old_check
 			 * For alpha mode checkers, if it was up, we don't need another
 			 * success to say it is now up.
 			 */
-			migrate_checkers(new_vs, rs, new_rs, old_checkers_queue);
+			migrate_checkers(new_vs, rs, new_rs, old_checkers, new_checkers);
 
 			/* Do we need to update the RS configuration? */
 			if (false ||
@@ -974,10 +1238,13 @@ clear_diff_rs(virtual_server_t *old_vs, virtual_server_t *new_vs, list old_check
 #endif
 			    rs->forwarding_method != new_rs->forwarding_method)
 				ipvs_cmd(LVS_CMD_EDIT_DEST, new_vs, new_rs);
+			counts->rs_changed++;
 		}
 	}
 	clear_service_rs(old_vs, rs_to_remove, false);
 	free_list(&rs_to_remove);
+
+	rs_matcher_free(&matcher);
 }
 
 /* clear sorry server, but only if changed */
@@ -1013,21 +1280,169 @@ clear_diff_s_srv(virtual_server_t *old_vs, real_server_t *new_rs)
 
 }
 
+static bool
+rs_can_be_kept(const real_server_t *rs)
+{
+	/* The files and BFD sessions tracked are defined outside the block */
+	if (!LIST_ISEMPTY(rs->track_files))
+		return false;
+#ifdef _WITH_BFD_
+	if (!LIST_ISEMPTY(rs->tracked_bfds))
+		return false;
+#endif
+
+	return true;
+}
+
+/* Do the real servers have the same checkers, all run by their own threads? */
+static bool __attribute__ ((pure))
+rs_checkers_unchanged(const real_server_t *old_rs, const real_server_t *new_rs,
+		      const checker_index_t *old_checkers, const checker_index_t *new_checkers)
+{
+	checker_index_ent_t *old_ents, *new_ents;
+	size_t num_old, num_new;
+	size_t i;
+
+	old_ents = checker_index_find(old_checkers, old_rs, &num_old);
+	new_ents = checker_index_find(new_checkers, new_rs, &num_new);
+
+	if (num_old != num_new)
+		return false;
+
+	for (i = 0; i < num_old; i++) {
+		if (!old_ents[i].checker->launch ||
+		    old_ents[i].checker->launch != new_ents[i].checker->launch)
+			return false;
+	}
+
+	return true;
+}
+
+/* A virtual server whose configuration block is unchanged is kept as it
+ * is, with its checkers still running, unless it refers to something
+ * defined outside its block. */
+static bool __attribute__ ((pure))
+vs_unchanged(const virtual_server_t *old_vs, const virtual_server_t *new_vs,
+	     const checker_index_t *old_checkers, const checker_index_t *new_checkers)
+{
+	element e, new_e;
+	real_server_t *rs;
+
+	if (old_vs->config_hash != new_vs->config_hash ||
+	    old_vs->vsgname ||
+	    LIST_SIZE(old_vs->rs) != LIST_SIZE(new_vs->rs) ||
+	    !old_vs->s_svr != !new_vs->s_svr)
+		return false;
+
+	/* A duplicate of a virtual server that has already been matched */
+	if (new_vs->reloaded)
+		return false;
+
+	/* With the same block, the real servers are in the same order */
+	new_e = LIST_HEAD(new_vs->rs);
+	LIST_FOREACH(old_vs->rs, rs, e) {
+		if (!rs_iseq(rs, ELEMENT_DATA(new_e)) ||
+		    !rs_can_be_kept(rs) ||
+		    !rs_checkers_unchanged(rs, ELEMENT_DATA(new_e), old_checkers, new_checkers))
+			return false;
+		ELEMENT_NEXT(new_e);
+	}
+
+	if (old_vs->s_svr &&
+	    (!rs_iseq(old_vs->s_svr, new_vs->s_svr) ||
+	     !rs_can_be_kept(old_vs->s_svr) ||
+	     !rs_checkers_unchanged(old_vs->s_svr, new_vs->s_svr, old_checkers, new_checkers)))
+		return false;
+
+	return true;
+}
+
+static void
+keep_rs(real_server_t *old_rs, const real_server_t *new_rs,
+	const checker_index_t *old_checkers, const checker_index_t *new_checkers)
+{
+	checker_index_ent_t *old_ents, *new_ents;
+	size_t num, i;
+
+	old_rs->reloaded = true;
+	old_rs->pweight = old_rs->iweight;
+
+	/* The old checkers go in the new queue, and the new ones are
+	 * freed with the old queue */
+	old_ents = checker_index_find(old_checkers, old_rs, &num);
+	new_ents = checker_index_find(new_checkers, new_rs, &num);
+	for (i = 0; i < num; i++) {
+		ELEMENT_DATA(old_ents[i].e) = new_ents[i].checker;
+		ELEMENT_DATA(new_ents[i].e) = old_ents[i].checker;
+		old_ents[i].checker->reloaded = true;
+	}
+}
+
+/* Keep the old virtual server, its real servers and checkers, in place
+ * of the new ones */
+static void
+keep_vs(virtual_server_t *old_vs, virtual_server_t *new_vs,
+	const checker_index_t *old_checkers, const checker_index_t *new_checkers,
+	reload_counts_t *counts)
+{
+	element e, new_e;
+	real_server_t *rs;
+
+	old_vs->reloaded = true;
+	new_vs->reloaded = true;
+
+	new_e = LIST_HEAD(new_vs->rs);
+	LIST_FOREACH(old_vs->rs, rs, e) {
+		keep_rs(rs, ELEMENT_DATA(new_e), old_checkers, new_checkers);
+		ELEMENT_NEXT(new_e);
+		counts->rs_kept++;
+	}
+
+	if (old_vs->s_svr)
+		keep_rs(old_vs->s_svr, new_vs->s_svr, old_checkers, new_checkers);
+}
+
+static int
+kept_vs_cmp(const void *a, const void *b)
+{
+	const kept_vs_t *kept_a = a;
+	const kept_vs_t *kept_b = b;
+
+	if (kept_a->new_vs == kept_b->new_vs)
+		return 0;
+
+	return (uintptr_t)kept_a->new_vs < (uintptr_t)kept_b->new_vs ? -1 : 1;
+}
+
 /* When reloading configuration, remove negative diff entries
- * and copy status of existing entries to the new ones */
+ * and copy status of existing entries to the new ones. Virtual servers
+ * whose configuration is unchanged are kept, rather than the new ones. */
 void
 clear_diff_services(list old_checkers_queue)
 {
-	element e;
+	element e, e1;
 	virtual_server_t *vs, *new_vs;
+	real_server_t *rs;
+	vs_index_t *vs_index;
+	checker_index_t old_checkers, new_checkers;
+	kept_vs_t *kept, *found, key;
+	size_t num_kept = 0;
+	reload_counts_t counts = { 0 };
+	unsigned vs_added = 0, rs_added = 0;
+
+	vs_index = alloc_vs_index(check_data->vs);
+	alloc_checker_index(&old_checkers, old_checkers_queue);
+	alloc_checker_index(&new_checkers, checkers_queue);
+	kept = MALLOC((LIST_SIZE(old_check_data->vs) + 1) * sizeof(*kept));
 
 	/* Remove diff entries from previous IPVS rules */
+	ipvs_batch_begin();
 	LIST_FOREACH(old_check_data->vs, vs, e) {
 		/*
 		 * Try to find this vs into the new conf data
 		 * reloaded.
 		 */
-		new_vs = vs_exist(vs);
+		new_vs = vs_exist(vs, vs_index);
 		if (!new_vs) {
 			if (vs->vsgname)
 				log_message(LOG_INFO, "Removing Virtual Server Group [%s]", vs->vsgname);
@@ -1036,7 +1451,19 @@ clear_diff_services(list old_checkers_queue)
 
 			/* Clear VS entry */
 			clear_service_vs(vs, false);
+			counts.vs_removed++;
+		} else if (vs_unchanged(vs, new_vs, &old_checkers, &new_checkers)) {
+			/* Nothing needs doing in IPVS, and the new vs is freed
+			 * with the old configuration */
+			keep_vs(vs, new_vs, &old_checkers, &new_checkers, &counts);
+			ELEMENT_DATA(e) = new_vs;
+			kept[num_kept].new_vs = new_vs;
+			kept[num_kept].old_vs = vs;
+			num_kept++;
+			counts.vs_kept++;
 		} else {
+			counts.vs_changed++;
+
 			/* copy status fields from old VS */
 			new_vs->alive = vs->alive;
 			new_vs->quorum_state_up = vs->quorum_state_up;
@@ -1061,12 +1488,41 @@ clear_diff_services(list old_checkers_queue)
 			}
 
 			vs->omega = true;
-			clear_diff_rs(vs, new_vs, old_checkers_queue);
+			clear_diff_rs(vs, new_vs, &old_checkers, &new_checkers, &counts);
 			clear_diff_s_srv(vs, new_vs->s_svr);
 
 			update_alive_counts(vs, new_vs);
 		}
 	}
+	ipvs_batch_end();
+
+	/* Put the kept virtual servers in place of the new ones */
+	qsort(kept, num_kept, sizeof(*kept), kept_vs_cmp);
+	LIST_FOREACH(check_data->vs, new_vs, e) {
+		key.new_vs = new_vs;
+		if (num_kept &&
+		    (found = bsearch(&key, kept, num_kept, sizeof(*kept), kept_vs_cmp))) {
+			ELEMENT_DATA(e) = found->old_vs;
+			continue;
+		}
+
+		if (!new_vs->reloaded)
+			vs_added++;
+		LIST_FOREACH(new_vs->rs, rs, e1) {
+			if (!rs->reloaded)
+				rs_added++;
+		}
+	}
+
+	log_message(LOG_INFO, "Reload: virtual servers %u kept, %u changed, %u added, %u removed;"
+			      " real servers %u kept, %u changed, %u added, %u removed"
+			    , counts.vs_kept, counts.vs_changed, vs_added, counts.vs_removed
+			    , counts.rs_kept, counts.rs_changed, rs_added, counts.rs_removed);
+
+	FREE(kept);
+	FREE(vs_index);
+	FREE(old_checkers.ents);
+	FREE(new_checkers.ents);
 }
 
 /* This is only called during a reload. Any new real server with
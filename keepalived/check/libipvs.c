@@ -27,6 +27,7 @@
 #include <stdbool.h>
 
 #ifdef LIBIPVS_USE_NL
+#include <linux/netlink.h>
 #include <netlink/netlink.h>
 #include <netlink/genl/genl.h>
 #include <netlink/genl/ctrl.h>
@@ -294,6 +295,225 @@ fail_genl:
 }
 #endif
 
+#ifdef LIBIPVS_USE_NL
+/*
+ * Batched netlink transactions.
+ *
+ * While a batch is open, service and destination commands are not sent
+ * one at a time with ipvs_nl_send_message(), but are packed into a
+ * buffer which is sent to the kernel with a single sendto(). Each message
+ * carries NLM_F_ACK and its own sequence number, so after the send the
+ * ACKs are drained and any error can be attributed to the command that
+ * caused it. The buffer is sent whenever it fills, so the memory used
+ * is bounded however many commands are queued. The caller can attach
+ * its own data to the commands it queues, which is passed back with any
+ * error, so that it can undo what it did on the assumption that the
+ * command would succeed.
+ */
+#define IPVS_BATCH_MAX_MSGS	128
+#define IPVS_BATCH_BUF_SIZE	(64 * 1024)
+
+typedef struct ipvs_batch_entry_s {
+	int		cmd;
+	void		*func;
+	uint32_t	seq;
+	int		err;
+	ipvs_service_t	svc;
+	ipvs_dest_t	dest;
+	bool		have_dest;
+	void		*data;
+} ipvs_batch_entry_t;
+
+static bool batch_active;
+static bool batch_in_callback;
+static ipvs_batch_error_fn batch_error_fn;
+static void *batch_data;
+static int batch_fd = -1;
+static uint32_t batch_seq;
+static char *batch_buf;
+static size_t batch_len;
+static ipvs_batch_entry_t *batch_entries;
+static unsigned batch_num;
+
+static int ipvs_nl_batch_open(void)
+{
+	struct sockaddr_nl snl = { .nl_family = AF_NETLINK };
+#ifdef NETLINK_CAP_ACK
+	int one = 1;
+#endif
+
+	if ((batch_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC)) == -1)
+		return -1;
+
+#if !HAVE_DECL_SOCK_CLOEXEC
+	set_sock_flags(batch_fd, F_SETFD, FD_CLOEXEC);
+#endif
+
+	if (bind(batch_fd, (struct sockaddr *)&snl, sizeof(snl))) {
+		close(batch_fd);
+		batch_fd = -1;
+		return -1;
+	}
+
+#ifdef NETLINK_CAP_ACK
+	/* We only need the header of a failed message echoed back */
+	setsockopt(batch_fd, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+#endif
+
+	return 0;
+}
+
+static void ipvs_nl_batch_send(void)
+{
+	struct sockaddr_nl snl = { .nl_family = AF_NETLINK };
+	char rbuf[8192] __attribute__((aligned(__alignof__(struct nlmsghdr))));
+	struct nlmsghdr *nlh;
+	struct nlmsgerr *nlerr;
+	ipvs_batch_entry_t *entry;
+	unsigned acked = 0;
+	unsigned i;
+	ssize_t len;
+	int err = 0;
+
+	if (!batch_num)
+		return;
+
+	if (batch_fd == -1 && ipvs_nl_batch_open())
+		err = errno;
+	else if (sendto(batch_fd, batch_buf, batch_len, 0, (struct sockaddr *)&snl, sizeof(snl)) == -1)
+		err = errno;
+
+	/* The kernel processes all the messages within the sendto() call,
+	 * so all the ACKs are already queued on the socket. */
+	while (!err && acked < batch_num) {
+		len = recv(batch_fd, rbuf, sizeof(rbuf), 0);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			err = errno;
+			break;
+		}
+
+		for (nlh = (struct nlmsghdr *)rbuf; NLMSG_OK(nlh, (size_t)len); nlh = NLMSG_NEXT(nlh, len)) {
+			if (nlh->nlmsg_type != NLMSG_ERROR)
+				continue;
+
+			i = nlh->nlmsg_seq - batch_entries[0].seq;
+			if (i >= batch_num)
+				continue;
+
+			nlerr = NLMSG_DATA(nlh);
+			batch_entries[i].err = -nlerr->error;
+			acked++;
+		}
+	}
+
+	/* Report errors per entry. If we failed to get the ACKs, everything
+	 * not yet acknowledged is reported with the socket error. Commands
+	 * issued from the callback are sent synchronously. */
+	batch_in_callback = true;
+	for (i = 0, entry = batch_entries; i < batch_num; i++, entry++) {
+		if (err && entry->err == -1)
+			entry->err = err;
+		if (entry->err <= 0 || !batch_error_fn)
+			continue;
+
+		ipvs_func = entry->func;
+		batch_error_fn(entry->cmd, &entry->svc, entry->have_dest ? &entry->dest : NULL, entry->err, entry->data);
+	}
+	batch_in_callback = false;
+
+	batch_len = 0;
+	batch_num = 0;
+}
+
+static int ipvs_nl_batch_queue(struct nl_msg *msg, int cmd, ipvs_service_t *svc, ipvs_dest_t *dest)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	size_t msg_len = NLMSG_ALIGN(nlh->nlmsg_len);
+	ipvs_batch_entry_t *entry;
+
+	if (msg_len > IPVS_BATCH_BUF_SIZE) {
+		nlmsg_free(msg);
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	if (batch_num == IPVS_BATCH_MAX_MSGS ||
+	    batch_len + msg_len > IPVS_BATCH_BUF_SIZE)
+		ipvs_nl_batch_send();
+
+	entry = &batch_entries[batch_num];
+	entry->cmd = cmd;
+	entry->func = ipvs_func;
+	entry->seq = ++batch_seq;
+	entry->err = -1;
+	entry->svc = *svc;
+	if ((entry->have_dest = !!dest))
+		entry->dest = *dest;
+	entry->data = batch_data;
+
+	nlh->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+	nlh->nlmsg_seq = entry->seq;
+	nlh->nlmsg_pid = 0;
+	memcpy(batch_buf + batch_len, nlh, nlh->nlmsg_len);
+	memset(batch_buf + batch_len + nlh->nlmsg_len, 0, msg_len - nlh->nlmsg_len);
+	batch_len += msg_len;
+	batch_num++;
+
+	nlmsg_free(msg);
+
+	return 0;
+}
+
+/* Send a service/dest command now, or add it to the open batch */
+static int ipvs_nl_send_cmd(struct nl_msg *msg, int cmd, ipvs_service_t *svc, ipvs_dest_t *dest)
+{
+	if (batch_active && !batch_in_callback)
+		return ipvs_nl_batch_queue(msg, cmd, svc, dest);
+
+	return ipvs_nl_send_message(msg, ipvs_nl_noop_cb, NULL);
+}
+
+bool ipvs_batch_start(ipvs_batch_error_fn error_fn)
+{
+	if (!try_nl || batch_active)
+		return false;
+
+	if (!batch_buf) {
+		batch_buf = MALLOC(IPVS_BATCH_BUF_SIZE);
+		batch_entries = MALLOC(IPVS_BATCH_MAX_MSGS * sizeof(*batch_entries));
+	}
+
+	batch_error_fn = error_fn;
+	batch_data = NULL;
+	batch_active = true;
+
+	return true;
+}
+
+void ipvs_batch_set_data(void *data)
+{
+	batch_data = data;
+}
+
+void ipvs_batch_flush(void)
+{
+	if (!batch_active)
+		return;
+
+	ipvs_nl_batch_send();
+	batch_active = false;
+	batch_error_fn = NULL;
+	batch_data = NULL;
+
+	if (batch_fd != -1) {
+		close(batch_fd);
+		batch_fd = -1;
+	}
+}
+#endif
+
 #ifdef LIBIPVS_USE_NL
 static int ipvs_getinfo_parse_cb(struct nl_msg *msg, __attribute__((unused)) void *arg)
 {
@@ -435,7 +655,7 @@ int ipvs_add_service(ipvs_service_t *svc)
 			nlmsg_free(msg);
 			return -1;
 		}
-		return ipvs_nl_send_message(msg, ipvs_nl_noop_cb, NULL);
+		return ipvs_nl_send_cmd(msg, IP_VS_SO_SET_ADD, svc, NULL);
 	}
 #endif
 
@@ -458,7 +678,7 @@ int ipvs_update_service(ipvs_service_t *svc)
 			nlmsg_free(msg);
 			return -1;
 		}
-		return ipvs_nl_send_message(msg, ipvs_nl_noop_cb, NULL);
+		return ipvs_nl_send_cmd(msg, IP_VS_SO_SET_EDIT, svc, NULL);
 	}
 #endif
 	CHECK_COMPAT_SVC(svc, -1);
@@ -480,7 +700,7 @@ int ipvs_del_service(ipvs_service_t *svc)
 			nlmsg_free(msg);
 			return -1;
 		}
-		return ipvs_nl_send_message(msg, ipvs_nl_noop_cb, NULL);
+		return ipvs_nl_send_cmd(msg, IP_VS_SO_SET_DEL, svc, NULL);
 	}
 #endif
 	CHECK_COMPAT_SVC(svc, -1);
@@ -569,7 +789,7 @@ int ipvs_add_dest(ipvs_service_t *svc, ipvs_dest_t *dest)
 			goto nla_put_failure;
 		if (ipvs_nl_fill_dest_attr(msg, dest))
 			goto nla_put_failure;
-		return ipvs_nl_send_message(msg, ipvs_nl_noop_cb, NULL);
+		return ipvs_nl_send_cmd(msg, IP_VS_SO_SET_ADDDEST, svc, dest);
 
 nla_put_failure:
 		nlmsg_free(msg);
@@ -601,7 +821,7 @@ int ipvs_update_dest(ipvs_service_t *svc, ipvs_dest_t *dest)
 			goto nla_put_failure;
 		if (ipvs_nl_fill_dest_attr(msg, dest))
 			goto nla_put_failure;
-		return ipvs_nl_send_message(msg, ipvs_nl_noop_cb, NULL);
+		return ipvs_nl_send_cmd(msg, IP_VS_SO_SET_EDITDEST, svc, dest);
 
 nla_put_failure:
 		nlmsg_free(msg);
@@ -632,7 +852,7 @@ int ipvs_del_dest(ipvs_service_t *svc, ipvs_dest_t *dest)
 			goto nla_put_failure;
 		if (ipvs_nl_fill_dest_attr(msg, dest))
 			goto nla_put_failure;
-		return ipvs_nl_send_message(msg, ipvs_nl_noop_cb, NULL);
+		return ipvs_nl_send_cmd(msg, IP_VS_SO_SET_DELDEST, svc, dest);
 
 nla_put_failure:
 		nlmsg_free(msg);
@@ -987,6 +1207,21 @@ static int ipvs_dests_parse_cb(struct nl_msg *msg, void *arg)
 }
 #endif	/* LIBIPVS_USE_NL */
 
+/* The [gs]etsockopt interface only returns 32 bit stats */
+static void ipvs_copy_stats(ip_vs_stats_t *stats, const struct ip_vs_stats_user *ustats)
+{
+	stats->conns = ustats->conns;
+	stats->inpkts = ustats->inpkts;
+	stats->outpkts = ustats->outpkts;
+	stats->inbytes = ustats->inbytes;
+	stats->outbytes = ustats->outbytes;
+	stats->cps = ustats->cps;
+	stats->inpps = ustats->inpps;
+	stats->outpps = ustats->outpps;
+	stats->inbps = ustats->inbps;
+	stats->outbps = ustats->outbps;
+}
+
 struct ip_vs_get_dests_app *ipvs_get_dests(ipvs_service_entry_t *svc)
 {
 	struct ip_vs_get_dests_app *d;
@@ -1078,12 +1313,73 @@ ipvs_nl_dest_failure:
 		       sizeof(struct ip_vs_dest_entry));
 		d->user.entrytable[i].af = AF_INET;
 		d->user.entrytable[i].nf_addr.ip = d->user.entrytable[i].user.addr;
+		ipvs_copy_stats(&d->user.entrytable[i].stats, &dk->entrytable[i].stats);
 	}
 	FREE(dk);
 	return d;
 }
 
 
+struct ip_vs_get_services_app *ipvs_get_services(void)
+{
+	struct ip_vs_get_services_app *get;
+	struct ip_vs_get_services *getk;
+	struct ip_vs_getinfo ipvs_info;
+	socklen_t len;
+	unsigned i;
+
+	ipvs_func = ipvs_get_services;
+
+#ifdef LIBIPVS_USE_NL
+	if (try_nl) {
+		struct nl_msg *msg;
+
+		if (!(get = MALLOC(sizeof(*get) + sizeof(ipvs_service_entry_t))))
+			return NULL;
+
+		get->user.num_services = 0;
+
+		msg = ipvs_nl_message(IPVS_CMD_GET_SERVICE, NLM_F_DUMP);
+		if (msg && ipvs_nl_send_message(msg, ipvs_services_parse_cb, &get) == 0)
+			return get;
+
+		FREE(get);
+		return NULL;
+	}
+#endif
+
+	len = sizeof(ipvs_info);
+	if (getsockopt(sockfd, IPPROTO_IP, IP_VS_SO_GET_INFO, (char *)&ipvs_info, &len))
+		return NULL;
+
+	len = (socklen_t)(sizeof(*getk) + sizeof(struct ip_vs_service_entry) * ipvs_info.num_services);
+	if (!(getk = MALLOC(len)))
+		return NULL;
+
+	getk->num_services = ipvs_info.num_services;
+	if (getsockopt(sockfd, IPPROTO_IP, IP_VS_SO_GET_SERVICES, getk, &len) < 0) {
+		FREE(getk);
+		return NULL;
+	}
+
+	if (!(get = MALLOC(sizeof(*get) + sizeof(ipvs_service_entry_t) * getk->num_services))) {
+		FREE(getk);
+		return NULL;
+	}
+
+	get->user.num_services = getk->num_services;
+	for (i = 0; i < getk->num_services; i++) {
+		memcpy(&get->user.entrytable[i].user, &getk->entrytable[i],
+		       sizeof(struct ip_vs_service_entry));
+		get->user.entrytable[i].af = AF_INET;
+		get->user.entrytable[i].nf_addr.ip = get->user.entrytable[i].user.addr;
+		ipvs_copy_stats(&get->user.entrytable[i].stats, &getk->entrytable[i].stats);
+	}
+	FREE(getk);
+
+	return get;
+}
+
 ipvs_service_entry_t *
 ipvs_get_service(__u32 fwmark, __u16 af, __u16 protocol, union nf_inet_addr *addr, __u16 port)
 {
@@ -1168,8 +1464,14 @@ out_err:
 void ipvs_close(void)
 {
 #ifdef LIBIPVS_USE_NL
-	if (try_nl)
+	if (try_nl) {
+		ipvs_batch_flush();
+		if (batch_buf) {
+			FREE(batch_buf);
+			FREE(batch_entries);
+		}
 		return;
+	}
 #endif
 	if (sockfd != -1) {
 		close(sockfd);
@@ -1202,6 +1504,7 @@ const char *ipvs_strerror(int err)
 #ifdef _WITH_SNMP_CHECKER_
 		{ ipvs_get_dests, ESRCH, "No such service" },
 		{ ipvs_get_service, ESRCH, "No such service" },
+		{ ipvs_get_services, ESRCH, "No such service" },
 #endif
 		{ 0, EPERM, "Permission denied (you must be root)" },
 		{ 0, EINVAL, "Invalid operation.  Possibly wrong module version, address not unicast, ..." },
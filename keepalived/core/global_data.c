@@ -33,6 +33,7 @@
 #include "utils.h"
 #include "main.h"
 #include "memory.h"
+#include "script_runner.h"
 #ifdef _WITH_VRRP_
 #include "vrrp.h"
 #include "vrrp_ipaddress.h"
@@ -162,12 +163,17 @@ alloc_global_data(void)
 	new->notify_fifo.fd = -1;
 	new->max_auto_priority = 0;
 	new->min_auto_priority_delay = 1000000;	/* 1 second */
+#ifdef _TIMER_WHEEL_DEFAULT_
+	new->timer_wheel = true;
+#endif
 #ifdef _WITH_VRRP_
 	new->vrrp_notify_fifo.fd = -1;
+	new->vrrp_netlink_monitor_filter = true;
 #if HAVE_DECL_RLIMIT_RTTIME == 1
 	new->vrrp_rlimit_rt = RT_RLIMIT_DEFAULT;
 #endif
 	new->vrrp_rx_bufs_multiples = 3;
+	new->vrrp_rx_batch = VRRP_RX_BATCH_DEFAULT;
 #endif
 #ifdef _WITH_LVS_
 	new->lvs_notify_fifo.fd = -1;
@@ -196,6 +202,9 @@ alloc_global_data(void)
 		new->enable_snmp_checker = true;
 #endif
 	}
+#ifdef _WITH_SNMP_CHECKER_
+	new->lvs_stats_refresh = STATS_REFRESH;
+#endif
 
 	if (snmp_socket)
 		new->snmp_socket = STRDUP(snmp_socket);
@@ -470,6 +479,7 @@ dump_global_data(FILE *fp, data_t * data)
 			    data->shutdown_script->uid,
 			    data->shutdown_script->gid,
 			    data->shutdown_script_timeout);
+	conf_write(fp, " Scheduler timer wheel = %s", data->timer_wheel ? "true" : "false");
 #ifdef _WITH_VRRP_
 	conf_write(fp, " Dynamic interfaces = %s", data->dynamic_interfaces ? "true" : "false");
 	if (data->dynamic_interfaces)
@@ -512,6 +522,9 @@ dump_global_data(FILE *fp, data_t * data)
 	conf_write(fp, " LVS flush = %s", data->lvs_flush ? "true" : "false");
 	conf_write(fp, " LVS flush on stop = %s", data->lvs_flush_onstop == LVS_FLUSH_FULL ? "full" :
 						  data->lvs_flush_onstop == LVS_FLUSH_VS ? "VS" : "disabled");
+#ifdef _WITH_CHECKER_WORKERS_
+	conf_write(fp, " Checker worker threads = %u", data->checker_workers);
+#endif
 #endif
 	if (data->notify_fifo.name) {
 		conf_write(fp, " Global notify fifo = %s, uid:gid %u:%u", data->notify_fifo.name, data->notify_fifo.uid, data->notify_fifo.gid);
@@ -632,6 +645,7 @@ dump_global_data(FILE *fp, data_t * data)
 #ifdef _WITH_BFD_
 	conf_write(fp, " BFD process priority = %d", data->bfd_process_priority);
 	conf_write(fp, " BFD don't swap = %s", data->bfd_no_swap ? "true" : "false");
+	conf_write(fp, " BFD receive timestamps = %s", data->bfd_rx_timestamps ? "true" : "false");
 	conf_write(fp, " BFD realtime priority = %u", data->bfd_realtime_priority);
 	if (CPU_COUNT(&data->bfd_cpu_mask)) {
 		get_process_cpu_affinity_string(&data->bfd_cpu_mask, cpu_str, 63);
@@ -646,6 +660,7 @@ dump_global_data(FILE *fp, data_t * data)
 #endif
 #ifdef _WITH_SNMP_CHECKER_
 	conf_write(fp, " SNMP checker %s", data->enable_snmp_checker ? "enabled" : "disabled");
+	conf_write(fp, " LVS stats refresh = %u", data->lvs_stats_refresh);
 #endif
 #ifdef _WITH_SNMP_RFCV2_
 	conf_write(fp, " SNMP RFCv2 %s", data->enable_snmp_rfcv2 ? "enabled" : "disabled");
@@ -663,11 +678,14 @@ dump_global_data(FILE *fp, data_t * data)
 #endif
 	conf_write(fp, " Script security %s", script_security ? "enabled" : "disabled");
 	conf_write(fp, " Default script uid:gid %u:%u", default_script_uid, default_script_gid);
+	conf_write(fp, " Script runner %s", data->script_runner ? "enabled" : "disabled");
+	dump_script_runner(fp);
 #ifdef _WITH_VRRP_
 	conf_write(fp, " vrrp_netlink_cmd_rcv_bufs = %u", global_data->vrrp_netlink_cmd_rcv_bufs);
 	conf_write(fp, " vrrp_netlink_cmd_rcv_bufs_force = %d", global_data->vrrp_netlink_cmd_rcv_bufs_force);
 	conf_write(fp, " vrrp_netlink_monitor_rcv_bufs = %u", global_data->vrrp_netlink_monitor_rcv_bufs);
 	conf_write(fp, " vrrp_netlink_monitor_rcv_bufs_force = %d", global_data->vrrp_netlink_monitor_rcv_bufs_force);
+	conf_write(fp, " vrrp_netlink_monitor_filter = %s", global_data->vrrp_netlink_monitor_filter ? "true" : "false");
 #ifdef _WITH_CN_PROC_
 	conf_write(fp, " process_monitor_rcv_bufs = %u", global_data->process_monitor_rcv_bufs);
 	conf_write(fp, " process_monitor_rcv_bufs_force = %d", global_data->process_monitor_rcv_bufs_force);
@@ -692,6 +710,7 @@ dump_global_data(FILE *fp, data_t * data)
 	if (buf[0])
 		conf_write(fp, "%s", buf);
 	conf_write(fp, " rx_bufs_multiples = %d", global_data->vrrp_rx_bufs_multiples);
+	conf_write(fp, " rx_batch = %u", global_data->vrrp_rx_batch);
 	conf_write(fp, " umask = 0%o", umask_val);
 	if (global_data->vrrp_startup_delay)
 		conf_write(fp, " vrrp_startup_delay = %g", global_data->vrrp_startup_delay / TIMER_HZ_DOUBLE);
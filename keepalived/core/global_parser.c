@@ -51,6 +51,9 @@
 #include "vrrp_firewall.h"
 #endif
 #include "memory.h"
+#ifdef _WITH_CHECKER_WORKERS_
+#include "check_worker.h"
+#endif
 
 #if HAVE_DECL_CLONE_NEWNET
 #include "namespaces.h"
@@ -338,6 +341,22 @@ shutdown_script_timeout_handler(const vector_t *strvec)
 	startup_shutdown_script_timeout_handler(strvec, false);
 }
 
+static void
+timer_wheel_handler(const vector_t *strvec)
+{
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec,1));
+		if (res < 0) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid value '%s' for global timer_wheel specified", strvec_slot(strvec, 1));
+			return;
+		}
+	}
+
+	global_data->timer_wheel = res;
+}
+
 static void
 max_auto_priority_handler(const vector_t *strvec)
 {
@@ -636,6 +655,25 @@ lvs_flush_onstop_handler(const vector_t *strvec)
 	else
 		report_config_error(CONFIG_GENERAL_ERROR, "Unknown lvs_flush_onstop type %s", strvec_slot(strvec, 1));
 }
+
+#ifdef _WITH_CHECKER_WORKERS_
+static void
+checker_workers_handler(const vector_t *strvec)
+{
+	unsigned workers;
+
+	if (vector_size(strvec) != 2) {
+		report_config_error(CONFIG_GENERAL_ERROR, "checker_workers requires a value");
+		return;
+	}
+	if (!read_unsigned_strvec(strvec, 1, &workers, 0, CHECKER_WORKERS_MAX, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "checker_workers '%s' must be in [0, %d] - ignoring", strvec_slot(strvec, 1), CHECKER_WORKERS_MAX);
+		return;
+	}
+
+	global_data->checker_workers = workers;
+}
+#endif
 #endif
 
 static int
@@ -1312,6 +1350,22 @@ bfd_no_swap_handler(__attribute__((unused)) const vector_t *strvec)
 	global_data->bfd_no_swap = true;
 }
 
+static void
+bfd_rx_timestamps_handler(const vector_t *strvec)
+{
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec,1));
+		if (res < 0) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid value '%s' for global bfd_rx_timestamps specified", strvec_slot(strvec, 1));
+			return;
+		}
+	}
+
+	global_data->bfd_rx_timestamps = res;
+}
+
 static void
 bfd_rt_priority_handler(const vector_t *strvec)
 {
@@ -1404,6 +1458,22 @@ snmp_checker_handler(__attribute__((unused)) const vector_t *strvec)
 {
 	global_data->enable_snmp_checker = true;
 }
+static void
+lvs_stats_refresh_handler(const vector_t *strvec)
+{
+	unsigned refresh;
+
+	if (vector_size(strvec) < 2) {
+		report_config_error(CONFIG_GENERAL_ERROR, "lvs_stats_refresh requires value");
+		return;
+	}
+	if (!read_unsigned_strvec(strvec, 1, &refresh, 1, 3600, true)) {
+		report_config_error(CONFIG_GENERAL_ERROR, "lvs_stats_refresh '%s' must be in [1, 3600] - ignoring", strvec_slot(strvec, 1));
+		return;
+	}
+
+	global_data->lvs_stats_refresh = refresh;
+}
 #endif
 #endif
 #if HAVE_DECL_CLONE_NEWNET
@@ -1504,6 +1574,22 @@ script_security_handler(__attribute__((unused)) const vector_t *strvec)
 	script_security = true;
 }
 
+static void
+script_runner_handler(const vector_t *strvec)
+{
+	int res = true;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec, 1));
+		if (res < 0) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid value '%s' for global script_runner specified", strvec_slot(strvec, 1));
+			return;
+		}
+	}
+
+	global_data->script_runner = res;
+}
+
 static void
 child_wait_handler(const vector_t *strvec)
 {
@@ -1580,6 +1666,25 @@ vrrp_rx_bufs_multiplier_handler(const vector_t *strvec)
 	else
 		global_data->vrrp_rx_bufs_multiples = rx_buf_mult;
 }
+
+static void
+vrrp_rx_batch_handler(const vector_t *strvec)
+{
+	unsigned rx_batch;
+
+	if (!strvec)
+		return;
+
+	if (vector_size(strvec) != 2) {
+		report_config_error(CONFIG_GENERAL_ERROR, "Invalid vrrp_rx_batch");
+		return;
+	}
+
+	if (!read_unsigned_strvec(strvec, 1, &rx_batch, 1, VRRP_RX_BATCH_MAX, false))
+		report_config_error(CONFIG_GENERAL_ERROR, "Invalid vrrp_rx_batch %s", strvec_slot(strvec, 1));
+	else
+		global_data->vrrp_rx_batch = rx_batch;
+}
 #endif
 
 #if defined _WITH_VRRP_ || defined _WITH_LVS_
@@ -1639,6 +1744,25 @@ vrrp_netlink_monitor_rcv_bufs_force_handler(const vector_t *strvec)
 	global_data->vrrp_netlink_monitor_rcv_bufs_force = res;
 }
 
+static void
+vrrp_netlink_monitor_filter_handler(const vector_t *strvec)
+{
+	int res = true;
+
+	if (!strvec)
+		return;
+
+	if (vector_size(strvec) >= 2) {
+		res = check_true_false(strvec_slot(strvec,1));
+		if (res < 0) {
+			report_config_error(CONFIG_GENERAL_ERROR, "Invalid value '%s' for global vrrp_netlink_monitor_filter specified", strvec_slot(strvec, 1));
+			return;
+		}
+	}
+
+	global_data->vrrp_netlink_monitor_filter = res;
+}
+
 static void
 vrrp_netlink_cmd_rcv_bufs_handler(const vector_t *strvec)
 {
@@ -1978,6 +2102,7 @@ init_global_keywords(bool global_active)
 	install_keyword("startup_script_timeout", &startup_script_timeout_handler);
 	install_keyword("shutdown_script", &shutdown_script_handler);
 	install_keyword("shutdown_script_timeout", &shutdown_script_timeout_handler);
+	install_keyword("timer_wheel", &timer_wheel_handler);
 	install_keyword("max_auto_priority", &max_auto_priority_handler);
 	install_keyword("min_auto_priority_delay", &min_auto_priority_delay_handler);
 #ifdef _WITH_VRRP_
@@ -1996,6 +2121,9 @@ init_global_keywords(bool global_active)
 	install_keyword("lvs_timeouts", &lvs_timeouts);
 	install_keyword("lvs_flush", &lvs_flush_handler);
 	install_keyword("lvs_flush_onstop", &lvs_flush_onstop_handler);
+#ifdef _WITH_CHECKER_WORKERS_
+	install_keyword("checker_workers", &checker_workers_handler);
+#endif
 #ifdef _WITH_VRRP_
 	install_keyword("lvs_sync_daemon", &lvs_syncd_handler);
 #endif
@@ -2061,6 +2189,7 @@ init_global_keywords(bool global_active)
 #ifdef _WITH_BFD_
 	install_keyword("bfd_priority", &bfd_prio_handler);
 	install_keyword("bfd_no_swap", &bfd_no_swap_handler);
+	install_keyword("bfd_rx_timestamps", &bfd_rx_timestamps_handler);
 	install_keyword("bfd_rt_priority", &bfd_rt_priority_handler);
 	install_keyword("bfd_cpu_affinity", &bfd_cpu_affinity_handler);
 #if HAVE_DECL_RLIMIT_RTTIME == 1
@@ -2086,6 +2215,7 @@ init_global_keywords(bool global_active)
 #endif
 #ifdef _WITH_SNMP_CHECKER_
 	install_keyword("enable_snmp_checker", &snmp_checker_handler);
+	install_keyword("lvs_stats_refresh", &lvs_stats_refresh_handler);
 #endif
 #endif
 #ifdef _WITH_DBUS_
@@ -2094,11 +2224,13 @@ init_global_keywords(bool global_active)
 #endif
 	install_keyword("script_user", &script_user_handler);
 	install_keyword("enable_script_security", &script_security_handler);
+	install_keyword("script_runner", &script_runner_handler);
 #ifdef _WITH_VRRP_
 	install_keyword("vrrp_netlink_cmd_rcv_bufs", &vrrp_netlink_cmd_rcv_bufs_handler);
 	install_keyword("vrrp_netlink_cmd_rcv_bufs_force", &vrrp_netlink_cmd_rcv_bufs_force_handler);
 	install_keyword("vrrp_netlink_monitor_rcv_bufs", &vrrp_netlink_monitor_rcv_bufs_handler);
 	install_keyword("vrrp_netlink_monitor_rcv_bufs_force", &vrrp_netlink_monitor_rcv_bufs_force_handler);
+	install_keyword("vrrp_netlink_monitor_filter", &vrrp_netlink_monitor_filter_handler);
 #ifdef _WITH_CN_PROC_
 	install_keyword("process_monitor_rcv_bufs", &process_monitor_rcv_bufs_handler);
 	install_keyword("process_monitor_rcv_bufs_force", &process_monitor_rcv_bufs_force_handler);
@@ -2117,6 +2249,7 @@ init_global_keywords(bool global_active)
 #ifdef _WITH_VRRP_
 	install_keyword("vrrp_rx_bufs_policy", &vrrp_rx_bufs_policy_handler);
 	install_keyword("vrrp_rx_bufs_multiplier", &vrrp_rx_bufs_multiplier_handler);
+	install_keyword("vrrp_rx_batch", &vrrp_rx_batch_handler);
 	install_keyword("vrrp_startup_delay", &vrrp_startup_delay_handler);
 	install_keyword("log_unknown_vrids", &vrrp_log_unknown_vrids_handler);
 #endif
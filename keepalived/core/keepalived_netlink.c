@@ -42,6 +42,9 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <linux/if_link.h>
+#ifdef _WITH_VRRP_
+#include <linux/filter.h>
+#endif
 
 #ifdef THREAD_DUMP
 #include "scheduler.h"
@@ -90,6 +93,10 @@ int netlink_error_ignore;	/* If we get this error, ignore it */
 
 /* Static vars */
 static nl_handle_t nl_kernel = { .fd = -1 };	/* Kernel reflection channel */
+#ifdef _WITH_VRRP_
+static unsigned monitor_overflows;		/* ENOBUFS on the monitor socket */
+static bool monitor_resync_needed;
+#endif
 
 #ifdef _NETLINK_TIMERS_
 /* The maximum netlink command we use is RTM_DELRULE.
@@ -1189,6 +1196,21 @@ netlink_if_address_filter(__attribute__((unused)) struct sockaddr_nl *snl, struc
 	return 0;
 }
 
+static void
+netlink_overrun(nl_handle_t *nl)
+{
+	log_message(LOG_INFO, "Netlink: Receive buffer overrun on %s socket - (%s)", nl == &nl_kernel ? "monitor" : "cmd", strerror(ENOBUFS));
+	log_message(LOG_INFO, "  - increase the relevant netlink_rcv_bufs global parameter and/or set force");
+
+#ifdef _WITH_VRRP_
+	if (nl == &nl_kernel) {
+		/* We have lost messages, so will need to reread the state */
+		monitor_overflows++;
+		monitor_resync_needed = true;
+	}
+#endif
+}
+
 /* Our netlink parser */
 static int
 netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
@@ -1222,6 +1244,11 @@ netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 		} while (len < 0 && check_EINTR(errno));
 
 		if (len < 0) {
+			/* An overrun is reported by the first recvmsg() after it occurs */
+			if (errno == ENOBUFS && nl == &nl_kernel) {
+				netlink_overrun(nl);
+				continue;
+			}
 			ret = -1;
 			break;
 		}
@@ -1245,10 +1272,8 @@ netlink_parse_info(int (*filter) (struct sockaddr_nl *, struct nlmsghdr *),
 		if (len < 0) {
 			if (check_EAGAIN(errno))
 				break;
-			if (errno == ENOBUFS) {
-				log_message(LOG_INFO, "Netlink: Receive buffer overrun on %s socket - (%m)", nl == &nl_kernel ? "monitor" : "cmd");
-				log_message(LOG_INFO, "  - increase the relevant netlink_rcv_bufs global parameter and/or set force");
-			}
+			if (errno == ENOBUFS)
+				netlink_overrun(nl);
 			else
 				log_message(LOG_INFO, "Netlink: recvmsg error on %s socket  - %d (%m)", nl == &nl_kernel ? "monitor" : "cmd", errno);
 			continue;
@@ -1444,6 +1469,239 @@ netlink_talk(nl_handle_t *nl, struct nlmsghdr *n)
 
 	return status;
 }
+
+/* Batching of commands on the nl_cmd channel.
+ *
+ * When adding/removing a list of addresses, routes or rules, rather than
+ * waiting for the ACK of each message before sending the next, the requests
+ * are packed into a single buffer, sent with one sendmsg() and then all the
+ * ACKs are read back. Each queued message has a pointer to an int that is set
+ * to 1 when the message is queued and to -1 if the kernel reports an error for
+ * it, so that callers can keep per entry state correct on partial failure. */
+#define NL_BATCH_BUF_SIZE	(32 * 1024)
+#define NL_BATCH_MAX_MSGS	128
+
+typedef struct _nl_batch_entry {
+	uint32_t		seq;
+	uint16_t		type;
+	int			error_ignore;
+	bool			acked;
+	int			*status;
+} nl_batch_entry_t;
+
+static char *nl_batch_buf;
+static size_t nl_batch_len;
+static nl_batch_entry_t *nl_batch_entries;
+static unsigned nl_batch_num;
+static bool nl_batch_active;
+
+bool
+netlink_batch_start(void)
+{
+	if (nl_batch_active)
+		return false;
+
+	if (!nl_batch_buf) {
+		nl_batch_buf = MALLOC(NL_BATCH_BUF_SIZE);
+		nl_batch_entries = MALLOC(NL_BATCH_MAX_MSGS * sizeof(*nl_batch_entries));
+	}
+
+	nl_batch_len = 0;
+	nl_batch_num = 0;
+	nl_batch_active = true;
+
+	return true;
+}
+
+static nl_batch_entry_t *
+netlink_batch_find(uint32_t seq, unsigned *next)
+{
+	unsigned i;
+
+	/* ACKs are normally returned in the order the messages were sent */
+	if (*next < nl_batch_num && nl_batch_entries[*next].seq == seq)
+		return &nl_batch_entries[(*next)++];
+
+	for (i = 0; i < nl_batch_num; i++) {
+		if (nl_batch_entries[i].seq == seq) {
+			*next = i + 1;
+			return &nl_batch_entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void
+netlink_batch_ack(nl_batch_entry_t *entry, const struct nlmsgerr *err)
+{
+	if (!err->error)
+		return;
+
+	/* Mirror what netlink_parse_info() treats as success */
+	if (err->error == -EEXIST &&
+	    (entry->type == RTM_NEWROUTE || entry->type == RTM_NEWADDR))
+		return;
+	if (err->error == -EADDRNOTAVAIL && entry->type == RTM_DELADDR)
+		return;
+
+	if (entry->error_ignore != -err->error)
+		log_message(LOG_INFO,
+		       "Netlink: error: %s(%d), type=%s(%u), seq=%u, pid=%u",
+		       strerror(-err->error), -err->error,
+		       get_nl_msg_type(err->msg.nlmsg_type), err->msg.nlmsg_type,
+		       err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+
+	*entry->status = -1;
+}
+
+/* Send all queued messages with a single sendmsg and drain their ACKs */
+static void
+netlink_batch_send(nl_handle_t *nl)
+{
+	struct sockaddr_nl snl = { .nl_family = AF_NETLINK };
+	struct iovec iov = {
+		.iov_base = nl_batch_buf,
+		.iov_len = nl_batch_len
+	};
+	struct msghdr msg = {
+		.msg_name = &snl,
+		.msg_namelen = sizeof(snl),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	char *buf = NULL;
+	size_t buf_size = 0;
+	unsigned acks_outstanding = nl_batch_num;
+	unsigned next = 0;
+	unsigned i;
+	ssize_t len;
+	struct nlmsghdr *h;
+	nl_batch_entry_t *entry;
+
+	if (!nl_batch_num)
+		return;
+
+	if (sendmsg(nl->fd, &msg, 0) < 0) {
+		log_message(LOG_INFO, "Netlink: sendmsg(%d) batch of %u commands error: %s", nl->fd, nl_batch_num,
+		       strerror(errno));
+		for (i = 0; i < nl_batch_num; i++)
+			*nl_batch_entries[i].status = -1;
+		goto end;
+	}
+
+	while (acks_outstanding) {
+		iov.iov_base = NULL;
+		iov.iov_len = 0;
+		msg.msg_namelen = sizeof(snl);
+		msg.msg_flags = 0;
+
+		/* The kernel processes the whole batch within sendmsg(), so all
+		 * the ACKs are already queued and we need not block here. */
+		do {
+			len = recvmsg(nl->fd, &msg, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+		} while (len < 0 && check_EINTR(errno));
+
+		if (len <= 0) {
+			if (len < 0 && !check_EAGAIN(errno))
+				log_message(LOG_INFO, "Netlink: recvmsg error on cmd socket  - %d (%m)", errno);
+			break;
+		}
+
+		if ((size_t)len > buf_size) {
+			FREE_PTR(buf);
+			buf = MALLOC(len);
+			buf_size = (size_t)len;
+		}
+
+		iov.iov_base = buf;
+		iov.iov_len = buf_size;
+
+		do {
+			len = recvmsg(nl->fd, &msg, MSG_DONTWAIT);
+		} while (len < 0 && check_EINTR(errno));
+
+		if (len <= 0)
+			break;
+
+		for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, (size_t)len); h = NLMSG_NEXT(h, len)) {
+			if (h->nlmsg_type != NLMSG_ERROR) {
+				log_message(LOG_INFO, "Netlink: ignoring message type 0x%04x", h->nlmsg_type);
+				continue;
+			}
+
+			if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+				log_message(LOG_INFO, "Netlink: error: message truncated");
+				continue;
+			}
+
+			if (!(entry = netlink_batch_find(h->nlmsg_seq, &next)) ||
+			    entry->acked)
+				continue;
+
+			entry->acked = true;
+			netlink_batch_ack(entry, NLMSG_DATA(h));
+			acks_outstanding--;
+		}
+	}
+
+	if (acks_outstanding) {
+		/* We can't tell which messages succeeded, so treat the ones we
+		 * have had no ACK for as failed. */
+		log_message(LOG_INFO, "Netlink: %u of %u batched commands not acknowledged", acks_outstanding, nl_batch_num);
+		for (i = 0; i < nl_batch_num; i++) {
+			if (!nl_batch_entries[i].acked)
+				*nl_batch_entries[i].status = -1;
+		}
+	}
+
+	FREE_PTR(buf);
+
+end:
+	nl_batch_len = 0;
+	nl_batch_num = 0;
+}
+
+/* Queue a message on the current batch. If no batch has been started, the message
+ * is sent immediately. *status is set to 1 once queued, and set to -1 if the command fails. */
+void
+netlink_batch_talk(nl_handle_t *nl, struct nlmsghdr *n, int *status)
+{
+	nl_batch_entry_t *entry;
+
+	if (!nl_batch_active || n->nlmsg_len > NL_BATCH_BUF_SIZE) {
+		*status = netlink_talk(nl, n) < 0 ? -1 : 1;
+		return;
+	}
+
+	if (nl_batch_num == NL_BATCH_MAX_MSGS ||
+	    nl_batch_len + NLMSG_ALIGN(n->nlmsg_len) > NL_BATCH_BUF_SIZE)
+		netlink_batch_send(nl);
+
+	n->nlmsg_seq = ++nl->seq;
+	n->nlmsg_flags |= NLM_F_ACK;
+
+	memcpy(nl_batch_buf + nl_batch_len, n, n->nlmsg_len);
+	nl_batch_len += NLMSG_ALIGN(n->nlmsg_len);
+
+	entry = &nl_batch_entries[nl_batch_num++];
+	entry->seq = n->nlmsg_seq;
+	entry->type = n->nlmsg_type;
+	entry->error_ignore = netlink_error_ignore;
+	entry->acked = false;
+	entry->status = status;
+	*status = 1;
+}
+
+void
+netlink_batch_end(void)
+{
+	if (!nl_batch_active)
+		return;
+
+	netlink_batch_send(&nl_cmd);
+	nl_batch_active = false;
+}
 #endif
 
 /* Fetch a specific type of information from netlink kernel */
@@ -1677,8 +1935,8 @@ netlink_if_link_populate(interface_t *ifp, struct rtattr *tb[], struct ifinfomsg
 	name = (char *)RTA_DATA(tb[IFLA_IFNAME]);
 
 	/* Fill the interface structure */
-	strcpy_safe(ifp->ifname, name);
-	ifp->ifindex = (ifindex_t)ifi->ifi_index;
+	if_set_ifname(ifp, name);
+	if_set_ifindex(ifp, (ifindex_t)ifi->ifi_index);
 #ifdef _HAVE_VRRP_VMAC_
 	ifp->if_type = IF_TYPE_STANDARD;
 #endif
@@ -1960,7 +2218,7 @@ netlink_link_filter(__attribute__((unused)) struct sockaddr_nl *snl, struct nlms
 #ifndef _ONE_PROCESS_DEBUG_
 			if (prog_type != PROG_TYPE_VRRP) {
 				ifp->ifi_flags = 0;
-				ifp->ifindex = 0;
+				if_set_ifindex(ifp, 0);
 			} else
 #endif
 				cleanup_lost_interface(ifp);
@@ -2026,7 +2284,7 @@ netlink_link_filter(__attribute__((unused)) struct sockaddr_nl *snl, struct nlms
 #ifndef _ONE_PROCESS_DEBUG_
 				if (prog_type != PROG_TYPE_VRRP) {
 					ifp->ifi_flags = 0;
-					ifp->ifindex = 0;
+					if_set_ifindex(ifp, 0);
 				} else
 #endif
 					cleanup_lost_interface(ifp);
@@ -2266,10 +2524,861 @@ netlink_rule_filter(__attribute__((unused)) struct sockaddr_nl *snl, struct nlms
 #endif
 #endif
 
+#ifdef _WITH_VRRP_
+/* Socket filter for the monitor socket.
+ *
+ * Address messages for interfaces that no vrrp instance, VIP, eVIP or
+ * static address refers to are of no interest to the VRRP process, but
+ * on systems with a lot of interface churn (e.g. container veths) they
+ * can make up most of the messages received. A classic BPF filter is
+ * attached to the monitor socket so that the kernel drops such messages
+ * rather than us having to receive and parse them.
+ *
+ * We list the interfaces to ignore rather than those we want, so that
+ * addresses of interfaces we haven't yet seen the RTM_NEWLINK for are
+ * still delivered. The filter is regenerated whenever interfaces are
+ * added or deleted, and on a reload. Link, route and rule messages are
+ * not filtered. */
+
+static ifindex_t *monitor_ignored_ifindex;	/* Sorted */
+static unsigned monitor_num_ignored;
+static unsigned monitor_filter_ranges;
+static bool monitor_filter_attached;
+static bool monitor_filter_stale;
+
+/* Statistics */
+static uint64_t monitor_msgs_delivered;
+static uint64_t monitor_msgs_discarded;
+static unsigned monitor_filter_updates;
+
+static int
+ifindex_cmp(const void *a, const void *b)
+{
+	ifindex_t ifindex_a = *(const ifindex_t *)a;
+	ifindex_t ifindex_b = *(const ifindex_t *)b;
+
+	return ifindex_a < ifindex_b ? -1 : ifindex_a > ifindex_b;
+}
+
+static bool __attribute__ ((pure))
+monitor_if_ignored(ifindex_t ifindex)
+{
+	if (!monitor_num_ignored)
+		return false;
+
+	return !!bsearch(&ifindex, monitor_ignored_ifindex, monitor_num_ignored, sizeof(*monitor_ignored_ifindex), ifindex_cmp);
+}
+
+static bool
+monitor_filter_wanted(void)
+{
+#if defined _ONE_PROCESS_DEBUG_ && defined _WITH_LVS_
+	/* The checker needs to see all address changes */
+	return false;
+#else
+#ifndef _ONE_PROCESS_DEBUG_
+	if (prog_type != PROG_TYPE_VRRP)
+		return false;
+#endif
+
+	return global_data && global_data->vrrp_netlink_monitor_filter;
+#endif
+}
+
+static void
+monitor_filter_keep_if(const interface_t *ifp, bool *keep)
+{
+	ifindex_t *p;
+
+	if (!ifp || !ifp->ifindex)
+		return;
+
+	p = bsearch(&ifp->ifindex, monitor_ignored_ifindex, monitor_num_ignored, sizeof(*monitor_ignored_ifindex), ifindex_cmp);
+	if (p)
+		keep[p - monitor_ignored_ifindex] = true;
+}
+
+static void
+monitor_filter_keep_addresses(list l, bool *keep)
+{
+	ip_address_t *ipaddr;
+	element e;
+
+	LIST_FOREACH(l, ipaddr, e)
+		monitor_filter_keep_if(ipaddr->ifp, keep);
+}
+
+/* Build the sorted list of interfaces whose address messages we don't want */
+static void
+monitor_filter_set_ignored(void)
+{
+	list if_list = get_if_list();
+	interface_t *ifp;
+	vrrp_t *vrrp;
+	element e;
+	bool *keep;
+	unsigned i, num;
+
+	FREE_PTR(monitor_ignored_ifindex);
+	monitor_num_ignored = 0;
+
+	if (LIST_ISEMPTY(if_list))
+		return;
+
+	monitor_ignored_ifindex = MALLOC(LIST_SIZE(if_list) * sizeof(*monitor_ignored_ifindex));
+	LIST_FOREACH(if_list, ifp, e) {
+		if (!ifp->ifindex ||
+		    !LIST_ISEMPTY(ifp->tracking_vrrp)
+#ifdef _HAVE_VRRP_VMAC_
+		    || ifp->is_ours
+#endif
+				   )
+			continue;
+
+		monitor_ignored_ifindex[monitor_num_ignored++] = ifp->ifindex;
+	}
+
+	if (!monitor_num_ignored)
+		return;
+
+	qsort(monitor_ignored_ifindex, monitor_num_ignored, sizeof(*monitor_ignored_ifindex), ifindex_cmp);
+
+	/* Now remove any interfaces that are referred to by the configuration */
+	keep = MALLOC(monitor_num_ignored * sizeof(*keep));
+	if (vrrp_data) {
+		list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list) {
+			monitor_filter_keep_if(vrrp->ifp, keep);
+			monitor_filter_keep_if(VRRP_CONFIGURED_IFP(vrrp), keep);
+#ifdef _HAVE_VRRP_VMAC_
+			if (vrrp->ifp)
+				monitor_filter_keep_if(vrrp->ifp->base_ifp, keep);
+#endif
+			monitor_filter_keep_addresses(vrrp->vip, keep);
+			monitor_filter_keep_addresses(vrrp->evip, keep);
+		}
+		monitor_filter_keep_addresses(vrrp_data->static_addresses, keep);
+	}
+
+	for (i = 0, num = 0; i < monitor_num_ignored; i++) {
+		if (!keep[i])
+			monitor_ignored_ifindex[num++] = monitor_ignored_ifindex[i];
+	}
+	monitor_num_ignored = num;
+
+	FREE(keep);
+}
+
+static void
+monitor_filter_detach(void)
+{
+	int dummy = 0;
+
+	if (!monitor_filter_attached)
+		return;
+
+	if (setsockopt(nl_kernel.fd, SOL_SOCKET, SO_DETACH_FILTER, &dummy, sizeof(dummy)))
+		log_message(LOG_INFO, "Netlink: failed to detach monitor socket filter - %d (%m)", errno);
+
+	monitor_filter_attached = false;
+	monitor_filter_ranges = 0;
+}
+
+/* Generate the filter program dropping address messages for the sorted
+ * ifindexes in ignored[], and those sent by pid. Instructions are only
+ * stored while there is room for them in insns[max_insns], and the number
+ * of instructions the program needs is returned, so the function can be
+ * called first with insns == NULL to find the size to allocate. */
+#define EMIT(insn)	do { if (len < max_insns) insns[len] = (struct sock_filter)insn; len++; } while (0)
+
+unsigned
+netlink_monitor_filter_build(struct sock_filter *insns, unsigned max_insns, const ifindex_t *ignored, unsigned num_ignored, uint32_t pid, unsigned *num_ranges)
+{
+	unsigned len = 0;
+	unsigned ranges = 0;
+	unsigned i;
+	size_t off_index = NLMSG_HDRLEN + offsetof(struct ifaddrmsg, ifa_index);
+
+	if (!insns)
+		max_insns = 0;
+
+	/* Only address messages are filtered. The fields of the netlink
+	 * message are in host byte order, whereas BPF loads are big endian. */
+	EMIT(BPF_STMT(BPF_LD | BPF_H | BPF_ABS, offsetof(struct nlmsghdr, nlmsg_type)));
+	EMIT(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_NEWADDR), 2, 0));
+	EMIT(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELADDR), 1, 0));
+	EMIT(BPF_STMT(BPF_RET | BPF_K, UINT32_MAX));
+
+	/* Addresses we have changed ourselves are ignored anyway */
+	EMIT(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct nlmsghdr, nlmsg_pid)));
+	EMIT(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pid), 0, 1));
+	EMIT(BPF_STMT(BPF_RET | BPF_K, 0));
+
+	/* Load ifa_index */
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	EMIT(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, off_index + 3));
+	for (i = 3; i-- > 0; ) {
+		EMIT(BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8));
+		EMIT(BPF_STMT(BPF_MISC | BPF_TAX, 0));
+		EMIT(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, off_index + i));
+		EMIT(BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0));
+	}
+#else
+	EMIT(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, off_index));
+#endif
+
+	/* Drop the message if the ifindex is in any of the ranges of
+	 * consecutive ifindexes */
+	for (i = 0; i < num_ignored && ranges < MONITOR_FILTER_MAX_RANGES; ranges++) {
+		ifindex_t low = ignored[i];
+
+		while (++i < num_ignored && ignored[i] == ignored[i - 1] + 1);
+
+		if (ignored[i - 1] == low)
+			EMIT(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, low, 0, 1));
+		else {
+			EMIT(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, low, 0, 2));
+			EMIT(BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, ignored[i - 1], 1, 0));
+		}
+		EMIT(BPF_STMT(BPF_RET | BPF_K, 0));
+	}
+	EMIT(BPF_STMT(BPF_RET | BPF_K, UINT32_MAX));
+
+	if (num_ranges)
+		*num_ranges = ranges;
+
+	return len;
+}
+#undef EMIT
+
+/* Generate and attach the filter for the current set of ignored interfaces */
+static void
+monitor_filter_attach(void)
+{
+	struct sock_filter *insns;
+	struct sock_fprog fprog;
+	unsigned num_ranges;
+	unsigned len;
+
+	if (!monitor_num_ignored) {
+		monitor_filter_detach();
+		return;
+	}
+
+	len = netlink_monitor_filter_build(NULL, 0, monitor_ignored_ifindex, monitor_num_ignored, nl_cmd.nl_pid, NULL);
+	insns = MALLOC(len * sizeof(*insns));
+	netlink_monitor_filter_build(insns, len, monitor_ignored_ifindex, monitor_num_ignored, nl_cmd.nl_pid, &num_ranges);
+
+	fprog.len = (unsigned short)len;
+	fprog.filter = insns;
+
+	if (setsockopt(nl_kernel.fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog))) {
+		log_message(LOG_INFO, "Netlink: failed to attach monitor socket filter - %d (%m)", errno);
+		monitor_filter_attached = false;
+		monitor_filter_ranges = 0;
+	} else {
+		monitor_filter_attached = true;
+		monitor_filter_ranges = num_ranges;
+	}
+
+	FREE(insns);
+}
+
+void
+kernel_netlink_update_monitor_filter(void)
+{
+	monitor_filter_stale = false;
+
+	if (nl_kernel.fd < 0)
+		return;
+
+	if (!monitor_filter_wanted()) {
+		monitor_filter_detach();
+		FREE_PTR(monitor_ignored_ifindex);
+		monitor_num_ignored = 0;
+		return;
+	}
+
+	monitor_filter_set_ignored();
+	monitor_filter_attach();
+	monitor_filter_updates++;
+}
+
+static int
+netlink_if_address_refresh_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(h);
+
+	if (h->nlmsg_type != RTM_NEWADDR ||
+	    h->nlmsg_len < NLMSG_LENGTH(sizeof (struct ifaddrmsg)) ||
+	    !monitor_if_ignored(ifa->ifa_index))
+		return 0;
+
+	return netlink_if_address_filter(snl, h);
+}
+
+/* On a reload, interfaces we were ignoring may now be of interest, but we
+ * won't have seen their address changes, so we read their addresses again.
+ * This is called before the new configuration is read, so there is nothing
+ * tracking the interfaces. */
+static void
+monitor_filter_reload(void)
+{
+	interface_t *ifp;
+	unsigned i;
+
+	monitor_filter_detach();
+
+	if (!monitor_num_ignored)
+		return;
+
+	for (i = 0; i < monitor_num_ignored; i++) {
+		if (!(ifp = if_get_by_ifindex(monitor_ignored_ifindex[i])))
+			continue;
+
+		ifp->sin_addr.s_addr = 0;
+		memset(&ifp->sin6_addr, 0, sizeof(ifp->sin6_addr));
+		free_list_elements(ifp->sin_addr_l);
+		free_list_elements(ifp->sin6_addr_l);
+	}
+
+	if (netlink_request(&nl_cmd, AF_INET, RTM_GETADDR, NULL) >= 0)
+		netlink_parse_info(netlink_if_address_refresh_filter, &nl_cmd, NULL, false);
+	if (netlink_request(&nl_cmd, AF_INET6, RTM_GETADDR, NULL) >= 0)
+		netlink_parse_info(netlink_if_address_refresh_filter, &nl_cmd, NULL, false);
+
+	FREE(monitor_ignored_ifindex);
+	monitor_num_ignored = 0;
+}
+
+/* Resynchronisation after the monitor socket has overflowed.
+ *
+ * Rather than rereading everything, we only reread the links and
+ * addresses of the interfaces we are interested in, and compare them
+ * with what we have recorded, feeding any differences through the
+ * normal link and address filters as though the messages had been
+ * received. This is done a few interfaces at a time, with a short
+ * timer between each step, so that adverts continue to be sent.
+ *
+ * The addresses are dumped per interface if the kernel supports strict
+ * checking of dump requests (Linux 4.20), since otherwise it ignores the
+ * ifindex. Failing that, all the addresses of each family are dumped. */
+#define RESYNC_LINKS_PER_RUN	8
+#define RESYNC_STEP_DELAY	(TIMER_HZ / 1000)
+
+typedef enum {
+	RESYNC_IDLE,
+	RESYNC_LINKS,
+	RESYNC_ADDRS,
+	RESYNC_ADDR_IPV4,
+	RESYNC_ADDR_IPV6,
+	RESYNC_ADDR_DIFF,
+} resync_stage_t;
+
+typedef struct _resync_addr {
+	ifindex_t ifindex;
+	uint32_t family;
+	uint32_t addr[4];
+} resync_addr_t;
+
+static resync_stage_t resync_stage;
+static element resync_e;			/* Next interface to check */
+static thread_ref_t resync_thread;
+static bool resync_link_seen;
+static resync_addr_t *resync_addrs;		/* Addresses seen in the dump */
+static unsigned resync_num_addrs;
+static unsigned resync_addrs_size;
+static unsigned resync_num_ifs;
+static ifindex_t resync_dump_ifindex;		/* Interface being dumped, if filtering */
+static bool resync_dump_unfiltered;		/* The kernel ignored the ifindex */
+static bool resync_no_strict_chk;
+static unsigned monitor_resyncs;
+
+static int
+resync_addr_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, sizeof(resync_addr_t));
+}
+
+static void
+resync_addr_set(resync_addr_t *ra, ifindex_t ifindex, int family, const void *addr)
+{
+	memset(ra, 0, sizeof(*ra));
+	ra->ifindex = ifindex;
+	ra->family = (uint32_t)family;
+	memcpy(ra->addr, addr, family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr));
+}
+
+static bool
+resync_addr_seen(ifindex_t ifindex, int family, const void *addr)
+{
+	resync_addr_t ra;
+
+	if (!resync_num_addrs)
+		return false;
+
+	resync_addr_set(&ra, ifindex, family, addr);
+
+	return !!bsearch(&ra, resync_addrs, resync_num_addrs, sizeof(*resync_addrs), resync_addr_cmp);
+}
+
+static bool __attribute__ ((pure))
+resync_if_wanted(const interface_t *ifp)
+{
+	/* An interface that doesn't exist may have been created */
+	if (!ifp->ifindex)
+		return !LIST_ISEMPTY(ifp->tracking_vrrp);
+
+	return !monitor_if_ignored(ifp->ifindex);
+}
+
+static bool __attribute__ ((pure))
+if_has_address(const interface_t *ifp, int family, const void *addr)
+{
+	element e;
+	struct in_addr *addr_p;
+	struct in6_addr *addr6_p;
+
+	if (family == AF_INET) {
+		if (inaddr_equal(AF_INET, &ifp->sin_addr, addr))
+			return true;
+		LIST_FOREACH(ifp->sin_addr_l, addr_p, e) {
+			if (inaddr_equal(AF_INET, addr_p, addr))
+				return true;
+		}
+	} else {
+		if (inaddr_equal(AF_INET6, &ifp->sin6_addr, addr))
+			return true;
+		LIST_FOREACH(ifp->sin6_addr_l, addr6_p, e) {
+			if (inaddr_equal(AF_INET6, addr6_p, addr))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+static int
+netlink_resync_link_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(h);
+	interface_t *ifp;
+	int ret;
+
+	if (h->nlmsg_type != RTM_NEWLINK ||
+	    h->nlmsg_len < NLMSG_LENGTH(sizeof (struct ifinfomsg)))
+		return 0;
+
+	resync_link_seen = true;
+
+	ifp = if_get_by_ifindex((ifindex_t)ifi->ifi_index);
+	ret = netlink_link_filter(snl, h);
+	if (ifp != if_get_by_ifindex((ifindex_t)ifi->ifi_index))
+		monitor_filter_stale = true;
+
+	return ret;
+}
+
+static void
+resync_link(interface_t *ifp)
+{
+	struct {
+		struct nlmsghdr n;
+		struct ifinfomsg ifi;
+		char buf[64];
+	} req = {
+		.n.nlmsg_len = NLMSG_LENGTH(sizeof req.ifi),
+		.n.nlmsg_flags = NLM_F_REQUEST,
+		.n.nlmsg_type = RTM_GETLINK,
+		.ifi.ifi_family = AF_UNSPEC,
+	};
+	struct sockaddr_nl snl = { .nl_family = AF_NETLINK };
+	ifindex_t ifindex = ifp->ifindex;
+
+	resync_link_seen = false;
+
+	if (!ifindex) {
+		if (netlink_request(&nl_cmd, AF_PACKET, RTM_GETLINK, ifp->ifname) < 0)
+			return;
+	} else {
+		req.n.nlmsg_seq = ++nl_cmd.seq;
+		req.ifi.ifi_index = (int)ifindex;
+#if HAVE_DECL_RTEXT_FILTER_SKIP_STATS
+		addattr32(&req.n, sizeof req, IFLA_EXT_MASK, RTEXT_FILTER_SKIP_STATS);
+#endif
+		if (sendto(nl_cmd.fd, &req, req.n.nlmsg_len, 0, (struct sockaddr *)&snl, sizeof(snl)) < 0) {
+			log_message(LOG_INFO, "Netlink: sendto() failed: %s", strerror(errno));
+			return;
+		}
+	}
+
+	netlink_error_ignore = ENODEV;
+	netlink_parse_info(netlink_resync_link_filter, &nl_cmd, NULL, false);
+	netlink_error_ignore = 0;
+
+	if (resync_link_seen || !ifindex)
+		return;
+
+	/* The interface has gone, so handle it as though we had received the RTM_DELLINK */
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof req.ifi);
+	req.n.nlmsg_type = RTM_DELLINK;
+	req.ifi.ifi_index = (int)ifindex;
+	addattr_l(&req.n, sizeof req, IFLA_IFNAME, ifp->ifname, strlen(ifp->ifname) + 1);
+
+	netlink_link_filter(&snl, &req.n);
+	monitor_filter_stale = true;
+}
+
+static int
+netlink_resync_address_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(h);
+	struct rtattr *tb[IFA_MAX + 1];
+	interface_t *ifp;
+	void *addr;
+
+	if (h->nlmsg_type != RTM_NEWADDR ||
+	    h->nlmsg_len < NLMSG_LENGTH(sizeof (struct ifaddrmsg)) ||
+	    (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6))
+		return 0;
+
+	if (resync_dump_ifindex && ifa->ifa_index != resync_dump_ifindex) {
+		resync_dump_unfiltered = true;
+		return 0;
+	}
+
+	if (!(ifp = if_get_by_ifindex(ifa->ifa_index)) || !resync_if_wanted(ifp))
+		return 0;
+
+	parse_rtattr(tb, IFA_MAX, IFA_RTA(ifa), h->nlmsg_len - NLMSG_LENGTH(sizeof (struct ifaddrmsg)));
+	if (!tb[IFA_LOCAL])
+		tb[IFA_LOCAL] = tb[IFA_ADDRESS];
+	if (!tb[IFA_LOCAL])
+		return 0;
+	addr = RTA_DATA(tb[IFA_LOCAL]);
+
+	/* Record the address for working out what has been deleted */
+	if (resync_num_addrs == resync_addrs_size) {
+		resync_addrs_size *= 2;
+		resync_addrs = REALLOC(resync_addrs, resync_addrs_size * sizeof(*resync_addrs));
+	}
+	resync_addr_set(&resync_addrs[resync_num_addrs++], ifa->ifa_index, ifa->ifa_family, addr);
+
+	if (if_has_address(ifp, ifa->ifa_family, addr))
+		return 0;
+
+	/* We don't know about the address, so it has been added */
+	return netlink_if_address_filter(snl, h);
+}
+
+static void
+resync_del_address(interface_t *ifp, int family, unsigned char scope, const void *addr)
+{
+	struct {
+		struct nlmsghdr n;
+		struct ifaddrmsg ifa;
+		char buf[64];
+	} req = {
+		.n.nlmsg_len = NLMSG_LENGTH(sizeof req.ifa),
+		.n.nlmsg_type = RTM_DELADDR,
+		.ifa.ifa_family = (unsigned char)family,
+		.ifa.ifa_prefixlen = family == AF_INET ? 32 : 128,
+		.ifa.ifa_scope = scope,
+		.ifa.ifa_index = ifp->ifindex,
+	};
+	struct sockaddr_nl snl = { .nl_family = AF_NETLINK };
+
+	addattr_l(&req.n, sizeof req, IFA_LOCAL, addr, family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr));
+
+	netlink_if_address_filter(&snl, &req.n);
+}
+
+static void
+resync_check_deleted(ip_address_t *ipaddr)
+{
+	if (!ipaddr->set || ipaddr->dont_track ||
+	    !ipaddr->ifp || !ipaddr->ifp->ifindex || !resync_if_wanted(ipaddr->ifp))
+		return;
+
+	if (!resync_addr_seen(ipaddr->ifp->ifindex, ipaddr->ifa.ifa_family, &ipaddr->u))
+		resync_del_address(ipaddr->ifp, ipaddr->ifa.ifa_family, ipaddr->ifa.ifa_scope, &ipaddr->u);
+}
+
+/* Anything we have recorded that wasn't in the dump has been deleted */
+static void
+resync_addresses_diff(void)
+{
+	interface_t *ifp;
+	vrrp_t *vrrp;
+	ip_address_t *ipaddr;
+	element e, e1, next;
+	struct in_addr *addr_p;
+	struct in6_addr *addr6_p;
+	struct in_addr addr;
+	struct in6_addr addr6;
+
+	qsort(resync_addrs, resync_num_addrs, sizeof(*resync_addrs), resync_addr_cmp);
+
+	LIST_FOREACH(get_if_list(), ifp, e) {
+		if (!ifp->ifindex || !resync_if_wanted(ifp))
+			continue;
+
+		LIST_FOREACH_NEXT(ifp->sin_addr_l, addr_p, e1, next) {
+			if (!resync_addr_seen(ifp->ifindex, AF_INET, addr_p)) {
+				addr = *addr_p;
+				resync_del_address(ifp, AF_INET, RT_SCOPE_UNIVERSE, &addr);
+			}
+		}
+		if (ifp->sin_addr.s_addr && !resync_addr_seen(ifp->ifindex, AF_INET, &ifp->sin_addr)) {
+			addr = ifp->sin_addr;
+			resync_del_address(ifp, AF_INET, RT_SCOPE_UNIVERSE, &addr);
+		}
+
+		LIST_FOREACH_NEXT(ifp->sin6_addr_l, addr6_p, e1, next) {
+			if (!resync_addr_seen(ifp->ifindex, AF_INET6, addr6_p)) {
+				addr6 = *addr6_p;
+				resync_del_address(ifp, AF_INET6, RT_SCOPE_LINK, &addr6);
+			}
+		}
+		if (ifp->sin6_addr.s6_addr32[0] && !resync_addr_seen(ifp->ifindex, AF_INET6, &ifp->sin6_addr)) {
+			addr6 = ifp->sin6_addr;
+			resync_del_address(ifp, AF_INET6, RT_SCOPE_LINK, &addr6);
+		}
+	}
+
+	/* Our VIPs and static addresses aren't recorded against the interfaces */
+	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list) {
+		if (vrrp->state != VRRP_STATE_MAST)
+			continue;
+
+		LIST_FOREACH(vrrp->vip, ipaddr, e)
+			resync_check_deleted(ipaddr);
+		LIST_FOREACH(vrrp->evip, ipaddr, e)
+			resync_check_deleted(ipaddr);
+	}
+
+	LIST_FOREACH(vrrp_data->static_addresses, ipaddr, e)
+		resync_check_deleted(ipaddr);
+}
+
+static void
+resync_dump_addresses(unsigned char family)
+{
+	if (netlink_request(&nl_cmd, family, RTM_GETADDR, NULL) < 0)
+		return;
+
+	netlink_parse_info(netlink_resync_address_filter, &nl_cmd, NULL, false);
+}
+
+static bool
+resync_set_strict_chk(bool on)
+{
+#ifdef NETLINK_GET_STRICT_CHK
+	int val = on;
+
+	return !setsockopt(nl_cmd.fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK, &val, sizeof(val));
+#else
+	return false;
+#endif
+}
+
+/* Returns false if the kernel didn't filter the dump by ifindex */
+static bool
+resync_dump_if_addresses(interface_t *ifp)
+{
+	struct {
+		struct nlmsghdr n;
+		struct ifaddrmsg ifa;
+	} req = {
+		.n.nlmsg_len = NLMSG_LENGTH(sizeof req.ifa),
+		.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+		.n.nlmsg_type = RTM_GETADDR,
+		.ifa.ifa_family = AF_UNSPEC,
+		.ifa.ifa_index = ifp->ifindex,
+	};
+	struct sockaddr_nl snl = { .nl_family = AF_NETLINK };
+
+	req.n.nlmsg_seq = ++nl_cmd.seq;
+	if (sendto(nl_cmd.fd, &req, req.n.nlmsg_len, 0, (struct sockaddr *)&snl, sizeof(snl)) < 0) {
+		log_message(LOG_INFO, "Netlink: sendto() failed: %s", strerror(errno));
+		return false;
+	}
+
+	resync_dump_ifindex = ifp->ifindex;
+	resync_dump_unfiltered = false;
+	netlink_error_ignore = ENODEV;
+	netlink_parse_info(netlink_resync_address_filter, &nl_cmd, NULL, false);
+	netlink_error_ignore = 0;
+	resync_dump_ifindex = 0;
+
+	return !resync_dump_unfiltered;
+}
+
+static void
+resync_addresses_step(void)
+{
+	interface_t *ifp;
+	unsigned num = 0;
+	bool filtered = true;
+
+	if (!resync_set_strict_chk(true)) {
+		resync_no_strict_chk = true;
+		filtered = false;
+	}
+
+	for (; filtered && resync_e && num < RESYNC_LINKS_PER_RUN; ELEMENT_NEXT(resync_e)) {
+		ifp = ELEMENT_DATA(resync_e);
+		if (!ifp->ifindex || !resync_if_wanted(ifp))
+			continue;
+
+		filtered = resync_dump_if_addresses(ifp);
+		num++;
+	}
+
+	if (!filtered) {
+		/* Start again with dumps of all the addresses */
+		if (!resync_no_strict_chk)
+			log_message(LOG_INFO, "Netlink: kernel does not filter address dumps by interface");
+		resync_no_strict_chk = true;
+		resync_num_addrs = 0;
+		resync_stage = RESYNC_ADDR_IPV4;
+	} else if (!resync_e)
+		resync_stage = RESYNC_ADDR_DIFF;
+
+	resync_set_strict_chk(false);
+}
+
+static int
+netlink_resync_thread(__attribute__((unused)) thread_ref_t thread)
+{
+	interface_t *ifp;
+	unsigned num = 0;
+
+	resync_thread = NULL;
+
+	switch (resync_stage) {
+	case RESYNC_IDLE:
+		return 0;
+	case RESYNC_LINKS:
+		for (; resync_e && num < RESYNC_LINKS_PER_RUN; ELEMENT_NEXT(resync_e)) {
+			ifp = ELEMENT_DATA(resync_e);
+			if (!resync_if_wanted(ifp))
+				continue;
+
+			resync_link(ifp);
+			resync_num_ifs++;
+			num++;
+		}
+		if (!resync_e) {
+			resync_num_addrs = 0;
+			if (resync_no_strict_chk)
+				resync_stage = RESYNC_ADDR_IPV4;
+			else {
+				resync_e = LIST_HEAD(get_if_list());
+				resync_stage = RESYNC_ADDRS;
+			}
+		}
+		break;
+	case RESYNC_ADDRS:
+		resync_addresses_step();
+		break;
+	case RESYNC_ADDR_IPV4:
+		resync_dump_addresses(AF_INET);
+		resync_stage = RESYNC_ADDR_IPV6;
+		break;
+	case RESYNC_ADDR_IPV6:
+		resync_dump_addresses(AF_INET6);
+		resync_stage = RESYNC_ADDR_DIFF;
+		break;
+	case RESYNC_ADDR_DIFF:
+		if (vrrp_data)
+			resync_addresses_diff();
+
+		FREE(resync_addrs);
+		resync_addrs_size = 0;
+		resync_num_addrs = 0;
+		resync_stage = RESYNC_IDLE;
+		monitor_resyncs++;
+
+		log_message(LOG_INFO, "Netlink: resync of %u interface%s after monitor socket overrun complete",
+			    resync_num_ifs, resync_num_ifs == 1 ? "" : "s");
+		break;
+	}
+
+	if (monitor_filter_stale)
+		kernel_netlink_update_monitor_filter();
+
+	if (resync_stage != RESYNC_IDLE)
+		resync_thread = thread_add_timer(master, netlink_resync_thread, NULL, RESYNC_STEP_DELAY);
+
+	return 0;
+}
+
+/* Start, or restart, a resync */
+static void
+kernel_netlink_start_resync(void)
+{
+	monitor_resync_needed = false;
+
+#ifndef _ONE_PROCESS_DEBUG_
+	if (prog_type != PROG_TYPE_VRRP)
+		return;
+#endif
+
+	if (nl_cmd.fd < 0)
+		return;
+
+	log_message(LOG_INFO, "Netlink: %s resync of interfaces after monitor socket overrun",
+		    resync_stage == RESYNC_IDLE ? "starting" : "restarting");
+
+	if (!resync_addrs) {
+		resync_addrs_size = 64;
+		resync_addrs = MALLOC(resync_addrs_size * sizeof(*resync_addrs));
+	}
+	resync_num_addrs = 0;
+	resync_num_ifs = 0;
+	resync_e = LIST_HEAD(get_if_list());
+	resync_stage = RESYNC_LINKS;
+
+	if (!resync_thread)
+		resync_thread = thread_add_timer(master, netlink_resync_thread, NULL, RESYNC_STEP_DELAY);
+}
+
+void
+kernel_netlink_print_stats(FILE *fp, bool clear_stats)
+{
+	fprintf(fp, "Netlink monitor:\n");
+	fprintf(fp, "  Messages received: %" PRIu64 "\n", monitor_msgs_delivered);
+	fprintf(fp, "  Messages for ignored interfaces: %" PRIu64 "\n", monitor_msgs_discarded);
+	fprintf(fp, "  Socket filter: %s\n", monitor_filter_attached ? "attached" : "not attached");
+	fprintf(fp, "    Ignored interfaces: %u\n", monitor_num_ignored);
+	fprintf(fp, "    Ifindex ranges: %u\n", monitor_filter_ranges);
+	fprintf(fp, "    Updates: %u\n", monitor_filter_updates);
+	fprintf(fp, "  Receive buffer overruns: %u\n", monitor_overflows);
+	fprintf(fp, "  Resyncs completed: %u%s\n", monitor_resyncs, resync_stage != RESYNC_IDLE ? " (resync in progress)" : "");
+
+	if (clear_stats) {
+		monitor_msgs_delivered = 0;
+		monitor_msgs_discarded = 0;
+		monitor_filter_updates = 0;
+		monitor_overflows = 0;
+		monitor_resyncs = 0;
+	}
+}
+#endif
+
 /* Netlink kernel message reflection */
 static int
 netlink_broadcast_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 {
+#ifdef _WITH_VRRP_
+	interface_t *ifp;
+	ifindex_t ifindex;
+	int ret;
+
+	monitor_msgs_delivered++;
+#endif
+
 	switch (h->nlmsg_type) {
 	case RTM_NEWLINK:
 	case RTM_DELLINK:
@@ -2282,11 +3391,33 @@ netlink_broadcast_filter(struct sockaddr_nl *snl, struct nlmsghdr *h)
 #ifndef _ONE_PROCESS_DEBUG_
 		if (prog_type == PROG_TYPE_VRRP)
 #endif
-			return netlink_link_filter(snl, h);
+		{
+			if (h->nlmsg_len < NLMSG_LENGTH(sizeof (struct ifinfomsg)))
+				return netlink_link_filter(snl, h);
+
+			/* If an interface has been added, deleted or replaced,
+			 * the monitor socket filter needs updating */
+			ifindex = (ifindex_t)((struct ifinfomsg *)NLMSG_DATA(h))->ifi_index;
+			ifp = if_get_by_ifindex(ifindex);
+			ret = netlink_link_filter(snl, h);
+			if ((h->nlmsg_type == RTM_DELLINK && ifp) || ifp != if_get_by_ifindex(ifindex))
+				monitor_filter_stale = true;
+
+			return ret;
+		}
 #endif
 		break;
 	case RTM_NEWADDR:
 	case RTM_DELADDR:
+#ifdef _WITH_VRRP_
+		/* Messages queued before the filter was last updated, or if
+		 * the filter couldn't be attached */
+		if (h->nlmsg_len >= NLMSG_LENGTH(sizeof (struct ifaddrmsg)) &&
+		    monitor_if_ignored(((struct ifaddrmsg *)NLMSG_DATA(h))->ifa_index)) {
+			monitor_msgs_discarded++;
+			return 0;
+		}
+#endif
 		return netlink_if_address_filter(snl, h);
 		break;
 #ifdef _HAVE_FIB_ROUTING_
@@ -2313,6 +3444,12 @@ kernel_netlink(thread_ref_t thread)
 
 	if (thread->type != THREAD_READ_TIMEOUT)
 		netlink_parse_info(netlink_broadcast_filter, nl, NULL, true);
+#ifdef _WITH_VRRP_
+	if (monitor_resync_needed)
+		kernel_netlink_start_resync();
+	if (monitor_filter_stale)
+		kernel_netlink_update_monitor_filter();
+#endif
 	nl->thread = thread_add_read(master, kernel_netlink, nl, nl->fd,
 				      TIMER_NEVER, false);
 	return 0;
@@ -2326,6 +3463,11 @@ kernel_netlink_poll(void)
 		return;
 
 	netlink_parse_info(netlink_broadcast_filter, &nl_kernel, NULL, true);
+
+	if (monitor_resync_needed)
+		kernel_netlink_start_resync();
+	if (monitor_filter_stale)
+		kernel_netlink_update_monitor_filter();
 }
 #endif
 
@@ -2358,12 +3500,26 @@ void
 kernel_netlink_close_monitor(void)
 {
 	netlink_close(&nl_kernel);
+
+#ifdef _WITH_VRRP_
+	FREE_PTR(monitor_ignored_ifindex);
+	monitor_num_ignored = 0;
+	monitor_filter_attached = false;
+
+	FREE_PTR(resync_addrs);
+	resync_stage = RESYNC_IDLE;
+#endif
 }
 
 void
 kernel_netlink_close_cmd(void)
 {
 	netlink_close(&nl_cmd);
+
+#ifdef _WITH_VRRP_
+	FREE_PTR(nl_batch_buf);
+	FREE_PTR(nl_batch_entries);
+#endif
 }
 
 void
@@ -2387,6 +3543,14 @@ kernel_netlink_init(void)
 	/* If the netlink kernel fd is already open, just register a read thread.
 	 * This will happen at reload. */
 	if (nl_kernel.fd > 0) {
+#ifdef _WITH_VRRP_
+		monitor_filter_reload();
+
+		/* The resync thread will have been cancelled, so start again */
+		resync_thread = NULL;
+		if (resync_stage != RESYNC_IDLE)
+			kernel_netlink_start_resync();
+#endif
 		nl_kernel.thread = thread_add_read(master, kernel_netlink, &nl_kernel, nl_kernel.fd, TIMER_NEVER, false);
 		return;
 	}
@@ -2495,5 +3659,8 @@ void
 register_keepalived_netlink_addresses(void)
 {
 	register_thread_address("kernel_netlink", kernel_netlink);
+#ifdef _WITH_VRRP_
+	register_thread_address("netlink_resync_thread", netlink_resync_thread);
+#endif
 }
 #endif
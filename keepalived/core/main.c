@@ -74,6 +74,7 @@
 #endif
 #ifdef _WITH_BFD_
 #include "bfd_daemon.h"
+#include "bfd_event.h"
 #include "bfd_parser.h"
 #endif
 #include "global_parser.h"
@@ -511,7 +512,7 @@ start_keepalived(__attribute__((unused)) thread_ref_t thread)
 
 #ifdef _WITH_BFD_
 	/* must be opened before vrrp and bfd start */
-	if (!open_bfd_pipes()) {
+	if (!open_bfd_event_channels()) {
 		thread_add_terminate_event(thread->master);
 		return 0;
 	}
@@ -1518,6 +1519,12 @@ usage(const char *prog)
 #ifdef ENABLE_LOG_TO_FILE
 	fprintf(stderr, "  -g, --log-file=FILE          Also log to FILE (default /tmp/keepalived.log)\n");
 	fprintf(stderr, "      --flush-log-file         Flush log file on write\n");
+#endif
+#ifdef _WITH_ASYNC_LOG_
+	fprintf(stderr, "      --log-async[=ENTRIES]    Child processes log via a writer thread (default 1024 queued messages)\n");
+	fprintf(stderr, "      --log-rate-limit=N[/SECS]\n");
+	fprintf(stderr, "                               Async logging writes at most N messages per SECS (default 1) seconds\n");
+	fprintf(stderr, "                               from each logging call, and reports the number suppressed\n");
 #endif
 	fprintf(stderr, "  -G, --no-syslog              Don't log via syslog\n");
 	fprintf(stderr, "  -u, --umask=MASK             umask for file creation (in numeric form)\n");
@@ -1650,6 +1657,11 @@ parse_cmdline(int argc, char **argv)
 	bool bad_option = false;
 	unsigned facility;
 	mode_t new_umask_val;
+#ifdef _WITH_ASYNC_LOG_
+	unsigned log_entries;
+	unsigned rate_burst, rate_interval;
+	char *p;
+#endif
 
 	struct option long_options[] = {
 		{"use-file",		required_argument,	NULL, 'f'},
@@ -1667,6 +1679,10 @@ parse_cmdline(int argc, char **argv)
 		{"log-file",		optional_argument,	NULL, 'g'},
 #ifdef ENABLE_LOG_TO_FILE
 		{"flush-log-file",	no_argument,		NULL,  2 },
+#endif
+#ifdef _WITH_ASYNC_LOG_
+		{"log-async",		optional_argument,	NULL,  8 },
+		{"log-rate-limit",	required_argument,	NULL,  9 },
 #endif
 		{"no-syslog",		no_argument,		NULL, 'G'},
 		{"umask",		required_argument,	NULL, 'u'},
@@ -1831,6 +1847,30 @@ parse_cmdline(int argc, char **argv)
 		case 2:		/* --flush-log-file */
 			set_flush_log_file();
 			break;
+#endif
+#ifdef _WITH_ASYNC_LOG_
+		case 8:		/* --log-async */
+			log_entries = 1024;
+			if (optarg && optarg[0] &&
+			    !read_unsigned(optarg, &log_entries, 16, 1024 * 1024, false)) {
+				fprintf(stderr, "Invalid number of async log entries '%s'\n", optarg);
+				bad_option = true;
+				break;
+			}
+			set_log_async(log_entries);
+			break;
+		case 9:		/* --log-rate-limit */
+			rate_interval = 1;
+			if ((p = strchr(optarg, '/')))
+				*p++ = '\0';
+			if (!read_unsigned(optarg, &rate_burst, 1, 65535, false) ||
+			    (p && !read_unsigned(p, &rate_interval, 1, 3600, false))) {
+				fprintf(stderr, "Invalid log rate limit '%s%s%s'\n", optarg, p ? "/" : "", p ? p : "");
+				bad_option = true;
+				break;
+			}
+			set_log_rate_limit(rate_burst, rate_interval);
+			break;
 #endif
 		case 'G':
 			__set_bit(NO_SYSLOG_BIT, &debug);
@@ -2188,6 +2228,10 @@ keepalived_main(int argc, char **argv)
 
 	global_data = alloc_global_data();
 
+#ifdef _CONFIG_SNAPSHOT_
+	open_config_snapshot();
+#endif
+
 	read_config_file();
 
 	init_global_data(global_data, NULL, false);
@@ -2370,6 +2414,7 @@ keepalived_main(int argc, char **argv)
 
 	/* Create the master thread */
 	master = thread_make_master();
+	thread_set_timer_wheel(master, global_data->timer_wheel);
 
 	/* Signal handling initialization  */
 	signal_init();
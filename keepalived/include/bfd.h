@@ -25,6 +25,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <sys/socket.h>
+#include <time.h>
 
 #include "scheduler.h"
 #include "timer.h"
@@ -65,6 +66,10 @@
 
 #define BFD_TTL_MAX		255
 
+/* Receive latency histogram buckets are <10us, <100us, <1ms, <10ms,
+ * <100ms and longer */
+#define BFD_RX_LATENCY_BUCKETS	6
+
 /*
  * BFD Session
  */
@@ -91,14 +96,19 @@ typedef struct _bfd {
 #endif
 
 	/* Internal variables */
-	int fd_out;		/* Output socket fd */
-	thread_ref_t thread_out; /* Output socket thread */
-	unsigned long sands_out; /* Output thread sands, used for suspend/resume */
+	int fd_out;		/* Output socket fd, shared with other instances */
+	uint16_t src_port;	/* UDP source port, unique to the instance */
+	rb_node_t tx_n;		/* Transmit queue entry */
+	bool tx_queued;		/* Set if in the transmit queue */
+	unsigned long tx_due;	/* Jittered time of next transmission */
+	unsigned long tx_earliest; /* Earliest time next packet may be sent */
+	unsigned long sands_out; /* Time to next transmission, used for suspend/resume */
 	thread_ref_t thread_exp; /* Expire thread */
 	unsigned long sands_exp; /* Expire thread sands, used for suspend/resume */
 	thread_ref_t thread_rst; /* Reset thread */
 	unsigned long sands_rst; /* Reset thread sands, used for suspend/resume */
 	bool send_error;	/* Set if last send had an error */
+	uint32_t event_slot;	/* Index of the instance in the event channels */
 
 	/* State variables */
 	u_char local_state:2;	/* Local state */
@@ -121,6 +131,12 @@ typedef struct _bfd {
 	uint64_t local_detect_time;	/* Local detection time */
 	uint64_t remote_detect_time;	/* Remote detection time */
 	timeval_t last_seen;	/* Time of the last packet received */
+	uint64_t rx_latency_hist[BFD_RX_LATENCY_BUCKETS]; /* Receive to processing latency */
+	uint32_t rx_latency_max; /* Maximum latency, in usecs */
+
+	/* Lookup hash chains */
+	struct _bfd *discr_next;	/* Next in local discriminator bucket */
+	struct _bfd *addr_next;		/* Next in address pair bucket */
 } bfd_t;
 
 /*
@@ -226,6 +242,7 @@ typedef struct _bfdpkt {
 	unsigned int ttl;
 	unsigned int len;
 	const char *buf;
+	struct timespec rx_ts;	/* Kernel receive time, zero if not known */
 } bfdpkt_t;
 
 extern void bfd_update_local_tx_intv(bfd_t *);
@@ -25,14 +25,6 @@
 
 #define PROG_BFD "Keepalived_bfd"
 
-#ifdef _WITH_VRRP_
-extern int bfd_vrrp_event_pipe[2];
-#endif
-#ifdef _WITH_LVS_
-extern int bfd_checker_event_pipe[2];
-#endif
-
-extern bool open_bfd_pipes(void);
 extern int start_bfd_child(void);
 extern void bfd_validate_config(void);
 #ifdef THREAD_DUMP
@@ -29,10 +29,38 @@
 #include "list.h"
 #include "bfd.h"
 
+/* Number of power of 2 buckets in the receive batch size histogram */
+#define BFD_RX_HIST_BUCKETS	6
+
+typedef struct _bfd_tx_sock {
+	int fd;			/* -1 if not open */
+	unsigned sessions;	/* Number of instances using the socket */
+} bfd_tx_sock_t;
+
 typedef struct _bfd_data {
 	list bfd;		/* List of BFD instances */
 	int fd_in;		/* Input socket fd */
 	thread_ref_t thread_in;	/* Input socket thread */
+
+	/* Transmit engine */
+	bfd_tx_sock_t tx_sock[2];	/* IPv4 and IPv6 raw UDP sockets */
+	rb_root_cached_t tx_queue;	/* Instances ordered by tx_due */
+	thread_ref_t thread_out;	/* Single timer for all instances */
+	uint64_t tx_packets;	/* Transmit statistics */
+	uint64_t tx_batches;
+	uint64_t tx_calls;	/* sendmmsg()/sendmsg() calls */
+	uint64_t rx_packets;	/* Receive statistics */
+	uint64_t rx_calls;	/* recvmmsg()/recvmsg() calls */
+	uint64_t rx_full_batches; /* Batches that filled the receive buffers */
+	uint64_t rx_batch_hist[BFD_RX_HIST_BUCKETS]; /* Batch sizes 1, 2-3, 4-7, ... */
+
+	/* Session lookup hash tables, built by bfd_complete_init() */
+	bfd_t **discr_hash;	/* Keyed on local discriminator */
+	bfd_t **addr_hash;	/* Keyed on neighbor/source address pair */
+	unsigned hash_size;	/* Buckets per table, a power of 2 */
+	uint64_t discr_lookups;	/* Lookup statistics */
+	uint64_t addr_lookups;
+	uint64_t hash_probes;	/* Sessions compared during lookups */
 } bfd_data_t;
 
 #define BFD_BUFFER_SIZE 32
@@ -50,10 +78,11 @@ extern void free_bfd_data(bfd_data_t *);
 extern void bfd_complete_init(void);
 extern void alloc_bfd_buffer(void);
 extern void free_bfd_buffer(void);
-extern bfd_t *find_bfd_by_addr(const struct sockaddr_storage *, const struct sockaddr_storage *) __attribute__ ((pure));
-extern bfd_t *find_bfd_by_discr(const uint32_t) __attribute__ ((pure));
+extern bfd_t *find_bfd_by_addr(const struct sockaddr_storage *, const struct sockaddr_storage *);
+extern bfd_t *find_bfd_by_discr(const uint32_t);
 extern bfd_t *find_bfd_by_name(const char *) __attribute__ ((pure));
 extern uint32_t rand_intv(uint32_t, uint32_t);
 extern uint32_t bfd_get_random_discr(bfd_data_t *);
+extern void bfd_set_random_discr(bfd_t *);
 
 #endif				/* _BFD_DATA_H_ */
@@ -23,14 +23,107 @@
 #ifndef _BFD_EVENT_H_
 #define _BFD_EVENT_H_
 
+#include <stdint.h>
+#include <stdio.h>
+
 #include "bfd.h"
+#include "spsc_ring.h"
+
+/* Number of instances the shared slots are first sized for, and the
+ * number of queued notifications each consumer ring can hold. The BFD
+ * process grows the slots when more instances are configured. Since
+ * events are coalesced per instance, a ring smaller than the number of
+ * instances only overflows if very many instances change state at once,
+ * in which case the consumer rescans all instances. */
+#define BFD_EVENT_MIN_SLOTS	256U
+#define BFD_EVENT_RING_SIZE	1024U
+#define BFD_EVENT_NO_SLOT	UINT32_MAX
+#ifndef HAVE_MEMFD_CREATE
+#define BFD_EVENT_MAX_SLOTS	4096U	/* The slots cannot be grown */
+#endif
 
+/* Channel index of each consumer in a slot */
+enum bfd_event_chan_index {
+	BFD_EVENT_VRRP,
+	BFD_EVENT_CHECKER,
+	BFD_EVENT_CHANNELS
+};
+
+/* The event as delivered to the consumer */
 typedef struct _bfd_event {
-	char iname[BFD_INAME_MAX];
 	u_char state;
 	timeval_t sent_time;
 } bfd_event_t;
 
+/* Instance name for a slot, shared by all consumers. Only the BFD
+ * process writes it, and gen is odd while it is being updated. */
+typedef struct _bfd_event_name {
+	uint32_t gen;
+	char iname[BFD_INAME_MAX];
+} bfd_event_name_t;
+
+/* Latest state of an instance for one consumer. pending is set by the
+ * BFD process when it queues the slot index, and cleared by the consumer
+ * when it takes the state, so an index is only in the ring once however
+ * many times the state changes before the consumer runs. */
+typedef struct _bfd_event_state {
+	uint32_t pending;
+	uint32_t state;
+	timeval_t sent_time;
+} bfd_event_state_t;
+
+/* A slot in shared memory. Growing the slots only appends to them, so
+ * slots in use are not moved. */
+typedef struct _bfd_event_slot {
+	bfd_event_name_t name;
+	bfd_event_state_t chan[BFD_EVENT_CHANNELS];
+} bfd_event_slot_t;
+
+/* Per consumer queue in shared memory, followed by the ring of slot indices */
+typedef struct _bfd_event_queue {
+	uint64_t sent;			/* Indices queued */
+	uint64_t coalesced;		/* State changes merged with a pending one */
+	uint64_t overflows;		/* Ring full, consumer told to rescan */
+	uint64_t dropped;		/* State changes of instances without a slot */
+	uint64_t received;		/* Written by the consumer */
+	uint32_t resync;		/* Set on overflow, cleared by the consumer */
+} bfd_event_queue_t;
+
+/* Consumer cache of the tracking object for a slot */
+typedef struct _bfd_event_cache {
+	uint32_t gen;
+	bool valid;
+	void *obj;
+} bfd_event_cache_t;
+
+typedef struct _bfd_event_chan {
+	enum bfd_event_chan_index index;
+	bfd_event_queue_t *queue;
+	spsc_ring_t *ring;
+	int fd;				/* eventfd for wakeups */
+	bfd_event_cache_t *cache;	/* Only used by the consumer */
+	uint32_t cache_size;
+} bfd_event_chan_t;
+
+typedef void *(*bfd_event_lookup_t)(const char *);
+typedef void (*bfd_event_handler_t)(void *, const bfd_event_t *);
+
+#ifdef _WITH_VRRP_
+extern bfd_event_chan_t bfd_vrrp_event_chan;
+#endif
+#ifdef _WITH_LVS_
+extern bfd_event_chan_t bfd_checker_event_chan;
+#endif
+
+extern bool open_bfd_event_channels(void);
+extern void bfd_event_close_channel(bfd_event_chan_t *);
+extern uint32_t bfd_event_alloc_slots(uint32_t);
+extern void bfd_event_set_name(uint32_t, const char *);
+extern void bfd_event_clear_name(uint32_t);
 extern void bfd_event_send(bfd_t *);
+extern void bfd_event_consumer_init(bfd_event_chan_t *);
+extern void bfd_event_consumer_release(bfd_event_chan_t *);
+extern void bfd_event_receive(bfd_event_chan_t *, bfd_event_lookup_t, bfd_event_handler_t);
+extern void dump_bfd_event_channels(FILE *);
 
 #endif				/* _BFD_EVENT_H_ */
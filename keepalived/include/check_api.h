@@ -58,6 +58,13 @@ typedef struct _checker {
 	unsigned			default_retry;		/* number of retries before failing */
 	unsigned long			default_delay_before_retry; /* interval between retries */
 	bool				log_all_failures;	/* Log all failures when checker up */
+	bool				reloaded;		/* Kept, and still running, over a reload */
+#ifdef _WITH_CHECKER_WORKERS_
+	struct _checker_worker		*worker;		/* Worker thread running checker, or NULL */
+	bool				main_thread_only;	/* Checker cannot run in a worker thread */
+	bool				reported_up;		/* Last state reported by the worker */
+	bool				reported_run;		/* The worker has reported a state */
+#endif
 } checker_t;
 
 /* Checkers queue */
@@ -74,6 +81,18 @@ extern list checkers_queue;
 #define CHECKER_NEW_CO() ((conn_opts_t *) MALLOC(sizeof (conn_opts_t)))
 #define FMT_CHK(C) FMT_RS((C)->rs, (C)->vs)
 
+/* is_up and has_run are only updated by the main checker thread. A
+ * checker running in a worker thread uses the state it last reported. */
+#ifdef _WITH_CHECKER_WORKERS_
+#define CHECKER_IS_UP(C) ((C)->worker ? (C)->reported_up : (C)->is_up)
+#define CHECKER_HAS_RUN(C) ((C)->worker ? (C)->reported_run : (C)->has_run)
+#define CHECKER_SET_HAS_RUN(C) do { if ((C)->worker) (C)->reported_run = true; else (C)->has_run = true; } while (0)
+#else
+#define CHECKER_IS_UP(C) ((C)->is_up)
+#define CHECKER_HAS_RUN(C) ((C)->has_run)
+#define CHECKER_SET_HAS_RUN(C) ((C)->has_run = true)
+#endif
+
 #ifdef _CHECKER_DEBUG_
 extern bool do_checker_debug;
 #endif
@@ -95,6 +114,8 @@ extern bool check_conn_opts(conn_opts_t *);
 extern bool compare_conn_opts(const conn_opts_t *, const conn_opts_t *) __attribute__ ((pure));
 extern void dump_checkers_queue(FILE *);
 extern void free_checkers_queue(void);
+extern void park_checker_threads(void);
+extern void unpark_checker_threads(void);
 extern void register_checkers_thread(void);
 extern void install_checkers_keyword(void);
 extern void checker_set_dst_port(struct sockaddr_storage *, uint16_t);
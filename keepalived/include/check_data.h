@@ -43,6 +43,7 @@
 
 /* Daemon dynamic data structure definition */
 #define KEEPALIVED_DEFAULT_DELAY	(60 * TIMER_HZ)
+#define SSL_SESSION_LIFETIME_DEFAULT	300	/* seconds */
 
 /* SSL specific data */
 typedef struct _ssl_data {
@@ -54,6 +55,7 @@ typedef struct _ssl_data {
 	const char			*cafile;
 	const char			*certfile;
 	const char			*keyfile;
+	unsigned			session_lifetime;	/* seconds, 0 to disable resumption */
 } ssl_data_t;
 
 /* Real Server definition */
@@ -186,6 +188,7 @@ typedef struct _virtual_server {
 	int				smtp_alert;	/* Send email on status change */
 	bool				quorum_state_up; /* Reflects result of the last transition done. */
 	bool				reloaded;	/* quorum_state was copied from old config while reloading */
+	uint32_t			config_hash;	/* Hash of the configuration block */
 #if defined(_WITH_SNMP_CHECKER_)
 	/* Statistics */
 	time_t				lastupdated;
@@ -27,7 +27,9 @@
 /* system includes */
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <openssl/md5.h>
+#include <openssl/evp.h>
 #include <openssl/ssl.h>
 #ifdef _WITH_REGEX_CHECK_
 #define PCRE2_CODE_UNIT_WIDTH 8
@@ -42,6 +44,11 @@
 #include "scheduler.h"
 #include "list.h"
 
+#ifndef HAVE_EVP_MD_CTX_NEW
+#define EVP_MD_CTX_new()	EVP_MD_CTX_create()
+#define EVP_MD_CTX_free(ctx)	EVP_MD_CTX_destroy(ctx)
+#endif
+
 typedef enum {
         HTTP_PROTOCOL_1_0,
         HTTP_PROTOCOL_1_0C,
@@ -53,19 +60,38 @@ typedef enum {
 #define HTTP_DEFAULT_STATUS_CODE_MIN	200
 #define HTTP_DEFAULT_STATUS_CODE_MAX	299
 
+/* Chunked transfer coding parser state */
+typedef enum {
+	CHUNK_SIZE,
+	CHUNK_EXT,
+	CHUNK_DATA,
+	CHUNK_DATA_END,
+	CHUNK_TRAILER,
+	CHUNK_DONE,
+	CHUNK_ERROR,
+} http_chunk_state_t;
+
 /* Checker argument structure  */
 /* ssl specific thread arguments defs */
 typedef struct _request {
-	char				*buffer;
+	char				*buffer;	/* Taken from the checker while in use */
+	size_t				buffer_size;
 	const char			*extracted;
 	int				error;
 	int				status_code;
 	size_t				len;
 	SSL				*ssl;
 	BIO				*bio;
-	MD5_CTX				context;
+	EVP_MD_CTX			*context;	/* MD5 of the body if checking digest */
 	size_t				content_len;
 	size_t				rx_bytes;
+	bool				persistent;	/* Track the response framing */
+	bool				reused;		/* Request sent on a kept connection */
+	bool				complete;	/* The whole response has been received */
+	bool				keep_conn;	/* The connection can be reused */
+	bool				chunked;
+	http_chunk_state_t		chunk_state;
+	size_t				chunk_remaining;
 #ifdef _WITH_REGEX_CHECK_
 	bool				regex_matched;
 	size_t				start_offset;	/* Offset into buffer to match from */
@@ -73,6 +99,7 @@ typedef struct _request {
 #ifdef _WITH_REGEX_TIMERS_
 	struct timespec			req_time;
 	unsigned			num_match_calls;
+	unsigned			num_partial_matches;
 #endif
 #endif
 } request_t;
@@ -107,6 +134,13 @@ typedef struct _url {
 #ifndef PCRE2_DONT_USE_JIT
 	bool				regex_use_stack;
 #endif
+#ifdef _WITH_REGEX_TIMERS_
+	struct timespec			regex_time;
+	struct timespec			regex_max_time;	/* Longest time for one check */
+	unsigned			num_match_calls;
+	unsigned			num_partial_matches;
+	unsigned			num_regex_checks;
+#endif
 #endif
 } url_t;
 
@@ -115,6 +149,10 @@ typedef struct _http_checker {
 	element				url_it;		/* current url checked list element */
 	url_t				*failed_url;	/* the url that is currently failing, if any */
 	request_t			*req;		/* GET buffer and SSL args */
+	request_t			*spare_req;	/* Kept for the next connection */
+	char				*buffer;	/* Response buffer, when not in use by req */
+	size_t				buffer_size;
+	char				*request;	/* GET string buffer */
 	list				url;
 	http_protocol_t			http_protocol;
 	const char			*virtualhost;
@@ -122,11 +160,19 @@ typedef struct _http_checker {
 	bool				enable_sni;
 #endif
 	bool				fast_recovery;
+	bool				persistent;	/* Keep the connection open between requests */
+	int				conn_fd;	/* Idle persistent connection, or -1 */
+	uint64_t			connections;
+	uint64_t			conn_reuses;
+	SSL_SESSION			*ssl_session;	/* session to resume on next check */
+	uint64_t			ssl_handshakes;
+	uint64_t			ssl_resumed;
 } http_checker_t;
 
 /* global defs */
 #define GET_BUFFER_LENGTH 2048U
 #define MAX_BUFFER_LENGTH 4096U
+#define REGEX_MAX_BUFFER_LENGTH 65536U	/* Limit for holding a regex partial match */
 #define PROTO_HTTP	0x01
 #define PROTO_SSL	0x02
 
@@ -29,6 +29,7 @@
 
 /* local includes */
 #include "check_data.h"
+#include "check_http.h"
 #include "scheduler.h"
 
 /* Prototypes */
@@ -36,6 +37,8 @@ extern void install_ssl_check_keyword(void);
 extern bool init_ssl_ctx(void);
 extern void clear_ssl(ssl_data_t *);
 extern int ssl_connect(thread_ref_t, int);
+extern void ssl_connected(http_checker_t *);
+extern void ssl_clear_session(http_checker_t *);
 extern int ssl_printerr(int);
 extern bool ssl_send_request(SSL *, const char *, int);
 extern int ssl_read_thread(thread_ref_t);
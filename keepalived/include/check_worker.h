@@ -0,0 +1,64 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        check_worker.c include file.
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2020 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _CHECK_WORKER_H
+#define _CHECK_WORKER_H
+
+#include "config.h"
+
+/* system includes */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/* local includes */
+#include "scheduler.h"
+#include "spsc_ring.h"
+#include "check_api.h"
+
+#define CHECKER_WORKERS_MAX		64
+#define CHECKER_WORKER_RING_SIZE	1024	/* Must be a power of 2 */
+
+/* A checker worker thread. Each worker runs its own scheduler, and
+ * passes checker state changes back to the main checker thread, which
+ * owns the IPVS and quorum state. */
+typedef struct _checker_worker {
+	unsigned			index;
+	pthread_t			thread;
+	bool				running;
+	thread_master_t			*master;
+	int				notify_fd;	/* eventfd, worker -> main thread */
+	int				stop_fd;	/* eventfd, main thread -> worker */
+	spsc_ring_t			*ring;		/* State changes, worker -> main thread */
+	unsigned			num_checkers;
+	uint64_t			state_changes;	/* Written by worker */
+	uint64_t			ring_full;	/* Written by worker */
+} checker_worker_t;
+
+/* Prototypes */
+extern void init_checker_workers(void);
+extern void start_checker_workers(void);
+extern void stop_checker_workers(void);
+extern thread_master_t *checker_thread_master(const checker_t *) __attribute__((pure));
+extern bool checker_worker_queue_state(bool, checker_t *, const char *);
+extern void dump_checker_workers(FILE *);
+
+#endif
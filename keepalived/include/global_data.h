@@ -66,6 +66,9 @@
 #define RX_BUFS_POLICY_MTU		0x01
 #define RX_BUFS_POLICY_ADVERT		0x02
 #define RX_BUFS_SIZE			0x04
+
+#define VRRP_RX_BATCH_DEFAULT		16	/* Adverts read per recvmmsg() */
+#define VRRP_RX_BATCH_MAX		64
 #endif
 
 /* email link list */
@@ -113,6 +116,8 @@ typedef struct _data {
 	unsigned			startup_script_timeout;
 	notify_script_t			*shutdown_script;
 	unsigned			shutdown_script_timeout;
+	bool				timer_wheel;		/* Use scheduler timer wheel */
+	bool				script_runner;		/* Start scripts via the script runner process */
 #ifndef _ONE_PROCESS_DEBUG_
 	const char			*reload_time_file;
 	bool				reload_repeat;
@@ -137,6 +142,9 @@ typedef struct _data {
 #endif
 	bool				lvs_flush;		/* flush any residual LVS config at startup */
 	lvs_flush_t			lvs_flush_onstop;	/* flush any LVS config at shutdown */
+#ifdef _WITH_CHECKER_WORKERS_
+	unsigned			checker_workers;	/* number of checker worker threads */
+#endif
 #endif
 	int				max_auto_priority;
 	unsigned			min_auto_priority_delay;
@@ -200,6 +208,7 @@ typedef struct _data {
 	bool				have_bfd_config;
 	char				bfd_process_priority;
 	bool				bfd_no_swap;
+	bool				bfd_rx_timestamps;	/* Use kernel receive timestamps */
 	unsigned			bfd_realtime_priority;
 	cpu_set_t			bfd_cpu_mask;
 #if HAVE_DECL_RLIMIT_RTTIME == 1
@@ -232,6 +241,7 @@ typedef struct _data {
 #endif
 #ifdef _WITH_LVS_
 	bool				enable_snmp_checker;
+	unsigned			lvs_stats_refresh;	/* seconds between IPVS stats snapshots */
 #endif
 #endif
 #ifdef _WITH_DBUS_
@@ -243,6 +253,7 @@ typedef struct _data {
 	bool				vrrp_netlink_cmd_rcv_bufs_force;
 	unsigned			vrrp_netlink_monitor_rcv_bufs;
 	bool				vrrp_netlink_monitor_rcv_bufs_force;
+	bool				vrrp_netlink_monitor_filter;	/* Attach a socket filter to the monitor socket */
 #ifdef _WITH_CN_PROC_
 	unsigned			process_monitor_rcv_bufs;
 	bool				process_monitor_rcv_bufs_force;
@@ -262,6 +273,7 @@ typedef struct _data {
 	int				vrrp_rx_bufs_policy;
 	size_t				vrrp_rx_bufs_size;
 	int				vrrp_rx_bufs_multiples;
+	unsigned			vrrp_rx_batch;
 	unsigned			vrrp_startup_delay;
 	bool				log_unknown_vrids;
 #endif
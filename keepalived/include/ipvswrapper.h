@@ -66,6 +66,13 @@ extern int ipvs_start(void);
 extern void ipvs_stop(void);
 extern void ipvs_set_timeouts(int, int, int);
 extern void ipvs_flush_cmd(void);
+#ifdef LIBIPVS_USE_NL
+extern void ipvs_batch_begin(void);
+extern int ipvs_batch_end(void);
+#else
+static inline void ipvs_batch_begin(void) {}
+static inline int ipvs_batch_end(void) { return 0; }
+#endif
 extern virtual_server_group_t *ipvs_get_group_by_name(const char *, list) __attribute__ ((pure));
 extern void ipvs_group_sync_entry(virtual_server_t *vs, virtual_server_group_entry_t *vsge);
 extern void ipvs_group_remove_entry(virtual_server_t *, virtual_server_group_entry_t *);
@@ -76,7 +83,7 @@ extern void ipvs_syncd_master(const struct lvs_syncd_config *);
 extern void ipvs_syncd_backup(const struct lvs_syncd_config *);
 #endif
 
-/* Refresh statistics at most every 5 seconds */
+/* By default refresh statistics at most every 5 seconds */
 #define STATS_REFRESH 5
 extern void ipvs_update_stats(virtual_server_t * vs);
 
@@ -48,10 +48,26 @@ rs_iseq(const real_server_t *rs_a, const real_server_t *rs_b)
         return sockstorage_equal(&rs_a->addr, &rs_b->addr);
 }
 
+/* Used on a reload to match the old virtual and real servers with the new ones */
+typedef struct _vs_index vs_index_t;
+typedef struct _rs_index rs_index_t;
+
+typedef struct _rs_matcher {
+	list		new_rs;
+	element		next;		/* Next new rs when pairing by position */
+	rs_index_t	*index;
+} rs_matcher_t;
+
 /* prototypes */
+extern vs_index_t *alloc_vs_index(list);
+extern virtual_server_t *vs_exist(const virtual_server_t *, const vs_index_t *) __attribute__ ((pure));
+extern void rs_matcher_init(rs_matcher_t *, const virtual_server_t *, const virtual_server_t *);
+extern real_server_t *rs_matcher_find(rs_matcher_t *, const real_server_t *);
+extern void rs_matcher_free(rs_matcher_t *);
 extern void update_svr_wgt(int, virtual_server_t *, real_server_t *, bool);
 extern void set_checker_state(checker_t *, bool);
 extern void update_svr_checker_state(bool, checker_t *);
+extern void update_svr_checker_state_alert(bool, checker_t *, const char *);
 extern bool init_services(void);
 extern void clear_services(void);
 extern void set_quorum_states(void);
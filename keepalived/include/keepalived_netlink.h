@@ -31,6 +31,9 @@
 #include <sys/types.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
+#ifdef _WITH_VRRP_
+#include <linux/filter.h>
+#endif
 
 /* local includes */
 #include "scheduler.h"
@@ -54,6 +57,11 @@ typedef struct _nl_handle {
 #define SOL_NETLINK 270
 #endif
 
+#ifdef _WITH_VRRP_
+/* Maximum number of ifindex ranges in the monitor socket filter */
+#define MONITOR_FILTER_MAX_RANGES	1024
+#endif
+
 #define RTA_TAIL(rta)	((struct rtattr *)(((char *) (rta)) + RTA_ALIGN((rta)->rta_len)))
 
 /* Global vars exported */
@@ -130,9 +138,15 @@ rta_addattr64(struct rtattr *rta, size_t maxlen, unsigned short type, uint64_t d
 extern struct rtattr *rta_nest(struct rtattr *, size_t, unsigned short);
 extern size_t rta_nest_end(struct rtattr *, struct rtattr *);
 extern ssize_t netlink_talk(nl_handle_t *, struct nlmsghdr *);
+extern bool netlink_batch_start(void);
+extern void netlink_batch_talk(nl_handle_t *, struct nlmsghdr *, int *);
+extern void netlink_batch_end(void);
 extern int netlink_interface_lookup(char *);
 extern void kernel_netlink_poll(void);
 extern void process_if_status_change(interface_t *);
+extern unsigned netlink_monitor_filter_build(struct sock_filter *, unsigned, const ifindex_t *, unsigned, uint32_t, unsigned *);
+extern void kernel_netlink_update_monitor_filter(void);
+extern void kernel_netlink_print_stats(FILE *, bool);
 #endif
 extern void kernel_netlink_set_recv_bufs(void);
 #ifdef _HAVE_FIB_ROUTING_
@@ -10,6 +10,8 @@
 
 #include "config.h"
 
+#include <stdbool.h>
+
 #include "ip_vs.h"
 
 /*
@@ -32,6 +34,12 @@ typedef struct ip_vs_daemon_app		ipvs_daemon_t;
 typedef struct ip_vs_service_entry_app	ipvs_service_entry_t;
 typedef struct ip_vs_dest_entry_app	ipvs_dest_entry_t;
 
+#ifdef LIBIPVS_USE_NL
+/* Called for each batched command the kernel rejected, with the data
+ * set when the command was queued */
+typedef void (*ipvs_batch_error_fn)(int, ipvs_service_t *, ipvs_dest_t *, int, void *);
+#endif
+
 
 /* init socket and get ipvs info */
 extern int ipvs_init(void);
@@ -68,6 +76,18 @@ extern int ipvs_del_dest(ipvs_service_t *svc, ipvs_dest_t *dest);
 extern int ipvs_set_timeout(ipvs_timeout_t *to);
 #endif
 
+#ifdef LIBIPVS_USE_NL
+/* queue service/dest commands until ipvs_batch_flush(). Returns false
+ * if batching is not available, in which case commands are sent immediately */
+extern bool ipvs_batch_start(ipvs_batch_error_fn);
+
+/* data passed to the error function for commands queued from now on */
+extern void ipvs_batch_set_data(void *);
+
+/* send any queued commands and close the batch */
+extern void ipvs_batch_flush(void);
+#endif
+
 /* start a connection synchronizaiton daemon (master/backup) */
 extern int ipvs_start_daemon(ipvs_daemon_t *dm);
 
@@ -78,6 +98,9 @@ extern int ipvs_stop_daemon(ipvs_daemon_t *dm);
 /* get the destination array of the specified service */
 extern struct ip_vs_get_dests_app *ipvs_get_dests(ipvs_service_entry_t *svc);
 
+/* get all the ipvs service entries */
+extern struct ip_vs_get_services_app *ipvs_get_services(void);
+
 /* get an ipvs service entry */
 extern ipvs_service_entry_t *
 ipvs_get_service(__u32 fwmark, __u16 af, __u16 protocol, union nf_inet_addr *addr, __u16 port);
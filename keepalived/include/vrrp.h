@@ -141,6 +141,7 @@ typedef struct _vrrp_sgroup {
 typedef struct _vrrp_stats {
 	uint64_t	advert_rcvd;
 	uint32_t	advert_sent;
+	uint64_t	advert_superseded;	/* Newer advert for VRID in same rx batch */
 
 	uint32_t	become_master;
 	uint32_t	release_master;
@@ -207,6 +208,7 @@ typedef struct {
 typedef struct _vrrp_t {
 	sa_family_t		family;			/* AF_INET|AF_INET6 */
 	const char		*iname;			/* Instance Name */
+	uint32_t		config_hash;		/* Hash of the configuration block */
 	vrrp_sgroup_t		*sync;			/* Sync group we belong to */
 	vrrp_stats		*stats;			/* Statistics */
 	interface_t		*ifp;			/* Interface we belong to */
@@ -333,6 +335,11 @@ typedef struct _vrrp_t {
 	/* Sending buffer */
 	char			*send_buffer;		/* Allocated send buffer */
 	size_t			send_buffer_size;
+#ifdef HAVE_SENDMMSG
+	char			*unicast_send_buffer;	/* Per unicast peer copies of send_buffer */
+	struct mmsghdr		*unicast_mmsg;		/* Message per unicast peer for sendmmsg */
+	struct iovec		*unicast_iov;
+#endif
 	uint32_t		ipv4_csum;		/* Checksum ip IPv4 pseudo header for VRRPv3 */
 
 #if defined _WITH_VRRP_AUTH_
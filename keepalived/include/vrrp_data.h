@@ -63,6 +63,9 @@ extern vrrp_data_t *vrrp_data;
 extern vrrp_data_t *old_vrrp_data;
 extern char *vrrp_buffer;
 extern size_t vrrp_buffer_len;
+#ifdef HAVE_RECVMMSG
+extern unsigned vrrp_buffer_num;
+#endif
 
 /* prototypes */
 extern void alloc_static_track_group(const char *);
@@ -97,6 +100,8 @@ extern void alloc_vrrp_evip(const vector_t *);
 extern void alloc_vrrp_vroute(const vector_t *);
 extern void alloc_vrrp_vrule(const vector_t *);
 extern void alloc_vrrp_buffer(size_t);
+extern void hold_vrrp_buffer(void);
+extern void release_vrrp_buffer(void);
 extern void free_vrrp_buffer(void);
 extern vrrp_data_t *alloc_vrrp_data(void);
 extern void free_vrrp_data(vrrp_data_t *);
@@ -152,6 +152,8 @@ typedef struct _interface {
 	bool			promote_secondaries;	/* Original value of promote_secondaries to be restored */
 	uint32_t		reset_promote_secondaries; /* Count of how many vrrps have changed promote_secondaries on interface */
 	list			tracking_vrrp;		/* List of tracking_obj_t for vrrp instances tracking this interface */
+	struct _interface	*ifindex_next;		/* Next in ifindex hash bucket */
+	struct _interface	*ifname_next;		/* Next in ifname hash bucket */
 } interface_t;
 
 /* Tracked interface structure definition */
@@ -199,6 +201,8 @@ extern list garp_delay;
 /* prototypes */
 extern interface_t *if_get_by_ifindex(ifindex_t) __attribute__ ((pure));
 extern interface_t *if_get_by_ifname(const char *, if_lookup_t);
+extern void if_set_ifindex(interface_t *, ifindex_t);
+extern void if_set_ifname(interface_t *, const char *);
 extern list get_if_list(void) __attribute__ ((pure));
 extern void reset_interface_queue(void);
 extern void alloc_garp_delay(void);
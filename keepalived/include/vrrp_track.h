@@ -76,6 +76,8 @@ typedef struct _vrrp_script {
 	script_state_t		state;		/* current state of script */
 	script_init_state_t	init_state;	/* current initialisation state of script */
 	bool			insecure;	/* Set if script is run by root, but is non-root modifiable */
+	struct _vrrp_script	*dup_of;	/* Script whose results this identical script shares */
+	struct _vrrp_script	*dup_next;	/* Next script sharing this script's results */
 } vrrp_script_t;
 
 /* Tracked script structure definition */
@@ -171,6 +173,7 @@ extern void free_vrrp_tracked_bfd(void *);
 extern void alloc_track_bfd(const char *, list, const vector_t *);
 #endif
 extern vrrp_script_t *find_script_by_name(const char *) __attribute__ ((pure));
+extern void share_identical_scripts(void);
 extern void update_script_priorities(vrrp_script_t *, bool);
 extern void down_instance(struct _vrrp_t *);
 extern void vrrp_set_effective_priority(struct _vrrp_t *);
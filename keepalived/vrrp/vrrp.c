@@ -68,6 +68,7 @@
 #include "main.h"
 #include "utils.h"
 #include "bitops.h"
+#include "jhash.h"
 #include "keepalived_netlink.h"
 #if !HAVE_DECL_SOCK_CLOEXEC
 #include "old_socket.h"
@@ -1472,7 +1473,106 @@ vrrp_alloc_send_buffer(vrrp_t * vrrp)
 	vrrp->send_buffer_size = vrrp_adv_len(vrrp);
 
 	vrrp->send_buffer = MALLOC(vrrp->send_buffer_size);
+
+#ifdef HAVE_SENDMMSG
+	/* With more than one unicast peer, adverts are sent with a single sendmmsg().
+	 * For IPv4 each peer needs its own copy of the packet, since the destination
+	 * address is in the IP header and, for VRRPv3, the checksum. */
+	if (LIST_SIZE(vrrp->unicast_peer) > 1) {
+		vrrp->unicast_mmsg = MALLOC(LIST_SIZE(vrrp->unicast_peer) * sizeof(*vrrp->unicast_mmsg));
+		vrrp->unicast_iov = MALLOC(LIST_SIZE(vrrp->unicast_peer) * sizeof(*vrrp->unicast_iov));
+		if (vrrp->family == AF_INET)
+			vrrp->unicast_send_buffer = MALLOC(LIST_SIZE(vrrp->unicast_peer) * vrrp->send_buffer_size);
+	}
+#endif
+}
+
+#ifdef HAVE_SENDMMSG
+/* Send an advert to all unicast peers with one sendmmsg() call.
+ * vrrp_update_pkt() must already have been called for the advert.
+ * For IPv4, the per peer packets are copied from send_buffer and only
+ * the destination address, and the VRRPv3 checksum, are adjusted. */
+static void
+vrrp_send_unicast_mmsg(vrrp_t *vrrp, uint8_t prio)
+{
+	struct mmsghdr *mmsg = vrrp->unicast_mmsg;
+	struct iovec *iov = vrrp->unicast_iov;
+	char cbuf[256];
+	bool have_cbuf = false;
+	unicast_peer_t *peer;
+	element e;
+	unsigned num_peers = 0;
+	unsigned sent = 0;
+	int ret;
+	char *pkt;
+	struct iphdr *ip;
+	vrrphdr_t *hd;
+	uint32_t new_daddr;
+
+	LIST_FOREACH(vrrp->unicast_peer, peer, e) {
+		memset(&mmsg[num_peers], 0, sizeof(mmsg[num_peers]));
+
+		if (vrrp->family == AF_INET) {
+			pkt = vrrp->unicast_send_buffer + num_peers * vrrp->send_buffer_size;
+			memcpy(pkt, vrrp->send_buffer, vrrp->send_buffer_size);
+
+			ip = (struct iphdr *)pkt;
+			new_daddr = inet_sockaddrip4(&peer->address);
+			if (ip->daddr != new_daddr) {
+				/* HC' = ~(~HC + ~m + m') - only the destination address word changes */
+				if (vrrp->version == VRRP_VERSION_3
+#ifdef _WITH_UNICAST_CHKSUM_COMPAT_
+				    && vrrp->unicast_chksum_compat < CHKSUM_COMPATIBILITY_MIN_COMPAT
+#endif
+				   ) {
+					hd = (vrrphdr_t *)(pkt + sizeof(struct iphdr));
+					hd->chksum = csum_incremental_update32(hd->chksum, ip->daddr, new_daddr);
+				}
+				ip->daddr = new_daddr;
+			}
+
+			iov[num_peers].iov_base = pkt;
+			mmsg[num_peers].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		} else {
+			/* The kernel computes the IPv6 checksum, so the packet can be shared */
+			iov[num_peers].iov_base = vrrp->send_buffer;
+			mmsg[num_peers].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+
+			if (!have_cbuf) {
+				vrrp_build_ancillary_data(&mmsg[num_peers].msg_hdr, cbuf, &vrrp->saddr, vrrp);
+				have_cbuf = true;
+			} else {
+				mmsg[num_peers].msg_hdr.msg_control = mmsg[0].msg_hdr.msg_control;
+				mmsg[num_peers].msg_hdr.msg_controllen = mmsg[0].msg_hdr.msg_controllen;
+			}
+		}
+
+		iov[num_peers].iov_len = vrrp->send_buffer_size;
+		mmsg[num_peers].msg_hdr.msg_iov = &iov[num_peers];
+		mmsg[num_peers].msg_hdr.msg_iovlen = 1;
+		mmsg[num_peers].msg_hdr.msg_name = &peer->address;
+		num_peers++;
+	}
+
+	/* If a send fails, sendmmsg() returns the number sent before the failure,
+	 * and the next call reports the error for the failing peer. */
+	while (sent < num_peers) {
+		ret = sendmmsg(vrrp->sockets->fd_out, &mmsg[sent], num_peers - sent, 0);
+		if (ret > 0) {
+			sent += (unsigned)ret;
+			continue;
+		}
+
+		if (ret == -1 && check_EINTR(errno))
+			continue;
+
+		if (prio != VRRP_PRIO_STOP || errno != ENETUNREACH || IF_FLAGS_UP(vrrp->ifp))
+			log_message(LOG_INFO, "(%s) Cant send advert to %s (%m)"
+					    , vrrp->iname, inet_sockaddrtos(mmsg[sent].msg_hdr.msg_name));
+		sent++;
+	}
 }
+#endif
 
 /* send VRRP advertisement */
 void
@@ -1506,6 +1606,18 @@ vrrp_send_adv(vrrp_t * vrrp, uint8_t prio)
 		    (prio != VRRP_PRIO_STOP || errno != ENETUNREACH || IF_FLAGS_UP(vrrp->ifp)))
 			log_message(LOG_INFO, "(%s): send advert error %d (%m)", vrrp->iname, errno);
 	}
+#ifdef HAVE_SENDMMSG
+	else if (vrrp->unicast_mmsg
+#ifdef _WITH_VRRP_AUTH_
+		 /* The AH ICV covers the destination address, so must be recalculated per peer */
+		 && vrrp->auth_type != VRRP_AUTH_AH
+#endif
+#ifdef _CHECKSUM_DEBUG_
+		 && !do_checksum_debug
+#endif
+						 )
+		vrrp_send_unicast_mmsg(vrrp, prio);
+#endif
 	else {
 		LIST_FOREACH(vrrp->unicast_peer, peer, e) {
 			if (vrrp->family == AF_INET)
@@ -2363,32 +2475,89 @@ open_vrrp_read_socket(sa_family_t family, int proto, interface_t *ifp, bool unic
 	return fd;
 }
 
-/* Try to find a VRRP instance */
-static vrrp_t * __attribute__ ((pure))
-vrrp_exist(vrrp_t *old_vrrp, list_head_t *l)
+/* On a reload, vrrp instances are matched by VRID, family and interface.
+ * The instances of a configuration are indexed by that key in a hash
+ * table with open addressing. */
+typedef struct _vrrp_index {
+	unsigned mask;
+	vrrp_t *slot[];
+} vrrp_index_t;
+
+static ifindex_t __attribute__ ((pure))
+vrrp_exist_ifindex(const vrrp_t *vrrp)
 {
+#ifdef _HAVE_VRRP_VMAC_
+	if (__test_bit(VRRP_VMAC_BIT, &vrrp->vmac_flags))
+		return vrrp->ifp->base_ifp->ifindex;
+#endif
+
+	return vrrp->ifp->ifindex;
+}
+
+static bool __attribute__ ((pure))
+vrrp_iseq(const vrrp_t *vrrp_a, const vrrp_t *vrrp_b)
+{
+	if (vrrp_a->vrid != vrrp_b->vrid ||
+	    vrrp_a->family != vrrp_b->family)
+		return false;
+
+#ifdef _HAVE_VRRP_VMAC_
+	if (__test_bit(VRRP_VMAC_BIT, &vrrp_a->vmac_flags) != __test_bit(VRRP_VMAC_BIT, &vrrp_b->vmac_flags))
+		return false;
+#endif
+
+	return vrrp_exist_ifindex(vrrp_a) == vrrp_exist_ifindex(vrrp_b);
+}
+
+static unsigned __attribute__ ((pure))
+vrrp_index_slot(const vrrp_index_t *index, const vrrp_t *vrrp)
+{
+	return jhash_3words(vrrp->vrid, vrrp->family, vrrp_exist_ifindex(vrrp), 0) & index->mask;
+}
+
+static vrrp_index_t *
+alloc_vrrp_index(list_head_t *l)
+{
+	vrrp_index_t *index;
 	vrrp_t *vrrp;
+	unsigned size = 4;
+	unsigned num = 0;
+	unsigned slot;
 
-	list_for_each_entry(vrrp, l, e_list) {
-		if (vrrp->vrid != old_vrrp->vrid ||
-		    vrrp->family != old_vrrp->family)
-			continue;
+	list_for_each_entry(vrrp, l, e_list)
+		num++;
+	while (size < num * 2)
+		size <<= 1;
 
-#ifndef _HAVE_VRRP_VMAC_
-		if (vrrp->ifp->ifindex == old_vrrp->ifp->ifindex)
-			return vrrp;
-#else
-		if (__test_bit(VRRP_VMAC_BIT, &vrrp->vmac_flags) != __test_bit(VRRP_VMAC_BIT, &old_vrrp->vmac_flags))
-			continue;
-		if (!__test_bit(VRRP_VMAC_BIT, &vrrp->vmac_flags)) {
-			if (vrrp->ifp->ifindex == old_vrrp->ifp->ifindex)
-				return vrrp;
-			continue;
+	index = MALLOC(sizeof(*index) + size * sizeof(index->slot[0]));
+	index->mask = size - 1;
+
+	/* If two instances match, the first one is found, as before */
+	list_for_each_entry(vrrp, l, e_list) {
+		for (slot = vrrp_index_slot(index, vrrp);
+		     index->slot[slot];
+		     slot = (slot + 1) & index->mask) {
+			if (vrrp_iseq(index->slot[slot], vrrp))
+				break;
 		}
+		if (!index->slot[slot])
+			index->slot[slot] = vrrp;
+	}
 
-		if (vrrp->ifp->base_ifp->ifindex == old_vrrp->ifp->base_ifp->ifindex)
-			return vrrp;
-#endif
+	return index;
+}
+
+/* Try to find a VRRP instance */
+static vrrp_t * __attribute__ ((pure))
+vrrp_exist(const vrrp_t *old_vrrp, const vrrp_index_t *index)
+{
+	unsigned slot;
+
+	for (slot = vrrp_index_slot(index, old_vrrp);
+	     index->slot[slot];
+	     slot = (slot + 1) & index->mask) {
+		if (vrrp_iseq(index->slot[slot], old_vrrp))
+			return index->slot[slot];
 	}
 
 	return NULL;
@@ -3606,6 +3775,7 @@ vrrp_complete_init(void)
 	size_t max_mtu_len = 0;
 	bool have_master, have_backup;
 	vrrp_script_t *scr;
+	vrrp_index_t *vrrp_index = NULL;
 
 	/* Set defaults if not specified, depending on strict mode */
 	if (global_data->vrrp_garp_lower_prio_rep == PARAMETER_UNSET)
@@ -3840,7 +4010,9 @@ vrrp_complete_init(void)
 			/* If we are reloading and the vrrp instance was already
 			 * in fault state, we don't need to notify again */
 			if (reload) {
-				old_vrrp = vrrp_exist(vrrp, &old_vrrp_data->vrrp);
+				if (!vrrp_index)
+					vrrp_index = alloc_vrrp_index(&old_vrrp_data->vrrp);
+				old_vrrp = vrrp_exist(vrrp, vrrp_index);
 				if (old_vrrp && old_vrrp->state == VRRP_STATE_FAULT)
 					continue;
 			}
@@ -3850,9 +4022,11 @@ vrrp_complete_init(void)
 			send_instance_notifies(vrrp);
 		}
 	}
+	FREE_PTR(vrrp_index);
 
 	if (reload) {
 		/* Now step through the old vrrp to set the status on matching new instances */
+		vrrp_index = alloc_vrrp_index(&vrrp_data->vrrp);
 		list_for_each_entry(old_vrrp, &old_vrrp_data->vrrp, e_list) {
 			/* We work out for ourselves if the vrrp instance
 			 * should be in fault state, so it doesn't matter
@@ -3860,7 +4034,7 @@ vrrp_complete_init(void)
 			if (old_vrrp->state == VRRP_STATE_FAULT)
 				continue;
 
-			vrrp = vrrp_exist(old_vrrp, &vrrp_data->vrrp);
+			vrrp = vrrp_exist(old_vrrp, vrrp_index);
 			if (vrrp) {
 				/* If we have detected a fault, don't override it */
 				if (vrrp->state == VRRP_STATE_FAULT || vrrp->num_script_init)
@@ -3870,6 +4044,7 @@ vrrp_complete_init(void)
 				vrrp->wantstate = old_vrrp->state;
 			}
 		}
+		FREE(vrrp_index);
 
 		/* Now see if any sync groups should be master */
 		LIST_FOREACH(vrrp_data->vrrp_sync_group, sgroup, e) {
@@ -3926,6 +4101,8 @@ vrrp_complete_init(void)
 		}
 	}
 
+	share_identical_scripts();
+
 	alloc_vrrp_buffer(max_mtu_len);
 
 	return true;
@@ -4028,6 +4205,10 @@ void
 clear_diff_vrrp(void)
 {
 	vrrp_t *vrrp;
+	vrrp_index_t *vrrp_index;
+	unsigned num_new = 0, num_matched = 0, num_modified = 0, num_removed = 0;
+
+	vrrp_index = alloc_vrrp_index(&vrrp_data->vrrp);
 
 	list_for_each_entry(vrrp, &old_vrrp_data->vrrp, e_list) {
 		vrrp_t *new_vrrp;
@@ -4036,8 +4217,10 @@ clear_diff_vrrp(void)
 		 * Try to find this vrrp in the new conf data
 		 * reloaded.
 		 */
-		new_vrrp = vrrp_exist(vrrp, &vrrp_data->vrrp);
+		new_vrrp = vrrp_exist(vrrp, vrrp_index);
 		if (!new_vrrp) {
+			num_removed++;
+
 			if (vrrp->state != VRRP_STATE_FAULT) {
 				if (vrrp->state == VRRP_STATE_MAST)
 					vrrp_restore_interface(vrrp, true, false);
@@ -4061,6 +4244,12 @@ clear_diff_vrrp(void)
 				dbus_remove_object(vrrp);
 #endif
 		} else {
+			/* The new instance is always used; the hash only tells us
+			 * whether its configuration block was edited. */
+			num_matched++;
+			if (new_vrrp->config_hash != vrrp->config_hash)
+				num_modified++;
+
 			/*
 			 * If this vrrp instance exist in new
 			 * data, then perform a VIP|EVIP diff.
@@ -4106,6 +4295,13 @@ clear_diff_vrrp(void)
 		}
 	}
 
+	FREE(vrrp_index);
+
+	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list)
+		num_new++;
+	log_message(LOG_INFO, "Reload: vrrp instances %u matched (%u modified), %u added, %u removed",
+		    num_matched, num_modified, num_new - num_matched, num_removed);
+
 #ifdef _WITH_FIREWALL_
 //XXX	firewall_close();
 #endif
@@ -72,11 +72,13 @@
 #include "utils.h"
 #include "vrrp_notify.h"
 #include "track_file.h"
+#include "script_runner.h"
 #ifdef _WITH_JSON_
 #include "vrrp_json.h"
 #endif
 #ifdef _WITH_BFD_
 #include "bfd_daemon.h"
+#include "bfd_event.h"
 #endif
 #ifdef _WITH_FIREWALL_
 #include "vrrp_firewall.h"
@@ -241,6 +243,7 @@ vrrp_terminate_phase2(int exit_status)
 #endif
 
 	kernel_netlink_close_cmd();
+	script_runner_stop();
 	thread_destroy_master(master);
 	master = NULL;
 	gratuitous_arp_close();
@@ -274,6 +277,10 @@ vrrp_terminate_phase2(int exit_status)
 	else
 		log_message(LOG_INFO, "Stopped");
 
+#ifdef _WITH_ASYNC_LOG_
+	stop_log_writer();
+#endif
+
 #ifdef ENABLE_LOG_TO_FILE
 	if (log_file_name)
 		close_log_file();
@@ -570,6 +577,14 @@ start_vrrp(data_t *prev_global_data)
 	if (__test_bit(CONFIG_TEST_BIT, &debug))
 		return;
 
+	/* The interfaces we are interested in are now known */
+	kernel_netlink_update_monitor_filter();
+
+	/* Select the scheduler's timer queue implementation */
+	thread_set_timer_wheel(master, global_data->timer_wheel);
+
+	script_runner_init(master, global_data->script_runner);
+
 #ifdef _WITH_LVS_
 	if (!reload && vrrp_ipvs_needed() && !global_data->lvs_syncd.vrrp) {
 		/* If we are running both master and backup, start them now */
@@ -1034,12 +1049,9 @@ start_vrrp_child(void)
 	initialise_debug_options();
 
 #ifdef _WITH_BFD_
-	/* Close the write end of the BFD vrrp event notification pipe */
-	close(bfd_vrrp_event_pipe[1]);
-
 #ifdef _WITH_LVS_
-	close(bfd_checker_event_pipe[0]);
-	close(bfd_checker_event_pipe[1]);
+	/* Close the BFD checker event notification fd */
+	bfd_event_close_channel(&bfd_checker_event_chan);
 #endif
 #endif
 
@@ -1076,6 +1088,10 @@ start_vrrp_child(void)
 
 	free_parent_mallocs_startup(true);
 
+#ifdef _WITH_ASYNC_LOG_
+	start_log_writer();
+#endif
+
 	/* Clear any child finder functions set in parent */
 	set_child_finder_name(NULL);
 
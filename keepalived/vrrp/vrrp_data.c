@@ -56,6 +56,14 @@ vrrp_data_t *vrrp_data = NULL;
 vrrp_data_t *old_vrrp_data = NULL;
 char *vrrp_buffer;
 size_t vrrp_buffer_len;
+#ifdef HAVE_RECVMMSG
+unsigned vrrp_buffer_num;
+#endif
+
+/* Received adverts in vrrp_buffer are being processed, so it cannot be
+ * reallocated until release_vrrp_buffer() is called */
+static bool vrrp_buffer_held;
+static size_t vrrp_buffer_pending_len;
 
 static const char *
 get_state_str(int state)
@@ -249,6 +257,8 @@ dump_vscript(FILE *fp, const void *data)
 	conf_write(fp, "   Rise = %d", vscript->rise);
 	conf_write(fp, "   Fall = %d", vscript->fall);
 	conf_write(fp, "   Insecure = %s", vscript->insecure ? "yes" : "no");
+	if (vscript->dup_of)
+		conf_write(fp, "   Shares results of = %s", vscript->dup_of->sname);
 
 	switch (vscript->init_state) {
 	case SCRIPT_INIT_STATE_INIT:
@@ -430,6 +440,11 @@ free_vrrp(vrrp_t *vrrp)
 	FREE_PTR(vrrp->ipvlan_addr);
 #endif
 	FREE_PTR(vrrp->send_buffer);
+#ifdef HAVE_SENDMMSG
+	FREE_PTR(vrrp->unicast_send_buffer);
+	FREE_PTR(vrrp->unicast_mmsg);
+	FREE_PTR(vrrp->unicast_iov);
+#endif
 	free_notify_script(&vrrp->script_backup);
 	free_notify_script(&vrrp->script_master);
 	free_notify_script(&vrrp->script_fault);
@@ -727,6 +742,7 @@ alloc_vrrp_stats(void)
 	new->packet_len_err = 0;
 	new->advert_rcvd = 0;
 	new->advert_sent = 0;
+	new->advert_superseded = 0;
 	new->advert_interval_err = 0;
 	new->ip_ttl_err = 0;
 	new->pri_zero_rcvd = 0;
@@ -1018,14 +1034,56 @@ alloc_vrrp_process(const char *pname)
 void
 alloc_vrrp_buffer(size_t len)
 {
+	if (vrrp_buffer_held) {
+		if (len > vrrp_buffer_pending_len)
+			vrrp_buffer_pending_len = len;
+		return;
+	}
+
+#ifdef HAVE_RECVMMSG
+	/* vrrp_buffer holds vrrp_rx_batch packets of vrrp_buffer_len each
+	 * so that a batch of adverts can be read with one recvmmsg() */
+	unsigned num = global_data->vrrp_rx_batch;
+
+	if (len <= vrrp_buffer_len && num == vrrp_buffer_num)
+		return;
+
+	if (len < vrrp_buffer_len)
+		len = vrrp_buffer_len;
+#else
+	unsigned num = 1;
+
 	if (len <= vrrp_buffer_len)
 		return;
+#endif
 
 	if (vrrp_buffer)
 		FREE(vrrp_buffer);
 
-	vrrp_buffer = (char *) MALLOC(len);
+	vrrp_buffer = (char *) MALLOC(len * num);
 	vrrp_buffer_len = (vrrp_buffer) ? len : 0;
+#ifdef HAVE_RECVMMSG
+	vrrp_buffer_num = (vrrp_buffer) ? num : 0;
+#endif
+}
+
+void
+hold_vrrp_buffer(void)
+{
+	vrrp_buffer_held = true;
+}
+
+void
+release_vrrp_buffer(void)
+{
+	size_t len = vrrp_buffer_pending_len;
+
+	vrrp_buffer_held = false;
+
+	if (len) {
+		vrrp_buffer_pending_len = 0;
+		alloc_vrrp_buffer(len);
+	}
 }
 
 void
@@ -1039,6 +1097,9 @@ free_vrrp_buffer(void)
 	FREE(vrrp_buffer);
 	vrrp_buffer = NULL;
 	vrrp_buffer_len = 0;
+#ifdef HAVE_RECVMMSG
+	vrrp_buffer_num = 0;
+#endif
 }
 
 vrrp_data_t *
@@ -1160,5 +1221,12 @@ dump_data_vrrp(FILE *fp)
 		dump_list(fp, ifl);
 	}
 
+	if (fp) {
+		dump_mem_slabs(fp);
+#ifdef _WITH_ASYNC_LOG_
+		dump_log_async(fp);
+#endif
+	}
+
 	clear_rt_names();
 }
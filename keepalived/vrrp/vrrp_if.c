@@ -71,10 +71,19 @@
 #ifdef _WITH_FIREWALL_
 #include "vrrp_firewall.h"
 #endif
+#include "jhash.h"
 
 
 /* Local vars */
 static list if_queue;
+
+/* Hash tables indexing if_queue by ifindex and by name. Interfaces
+ * with ifindex 0 (i.e. that don't currently exist) are only in the name
+ * table. The tables are doubled in size as interfaces are added. */
+#define IF_HASH_MIN_SIZE	64
+static interface_t **if_ifindex_hash;
+static interface_t **if_ifname_hash;
+static unsigned if_hash_size;
 #ifdef _WITH_LINKBEAT_
 static struct ifreq ifr;
 static int linkbeat_fd = -1;
@@ -86,6 +95,102 @@ static list old_garp_delay;
 list garp_delay;
 
 /* Helper functions */
+static inline unsigned
+if_ifindex_hashval(ifindex_t ifindex)
+{
+	return jhash_1word(ifindex, 0) & (if_hash_size - 1);
+}
+
+static unsigned
+if_ifname_hashval(const char *ifname)
+{
+	char name[IFNAMSIZ] = "";
+
+	/* Hash a fixed length, zero padded, copy of the name */
+	strncpy(name, ifname, sizeof(name) - 1);
+
+	return jhash(name, sizeof(name), 0) & (if_hash_size - 1);
+}
+
+static void
+if_hash_ifindex(interface_t *ifp)
+{
+	unsigned hash;
+
+	if (!ifp->ifindex)
+		return;
+
+	hash = if_ifindex_hashval(ifp->ifindex);
+	ifp->ifindex_next = if_ifindex_hash[hash];
+	if_ifindex_hash[hash] = ifp;
+}
+
+static void
+if_unhash_ifindex(interface_t *ifp)
+{
+	interface_t **ifpp;
+
+	if (!ifp->ifindex)
+		return;
+
+	for (ifpp = &if_ifindex_hash[if_ifindex_hashval(ifp->ifindex)]; *ifpp; ifpp = &(*ifpp)->ifindex_next) {
+		if (*ifpp == ifp) {
+			*ifpp = ifp->ifindex_next;
+			break;
+		}
+	}
+	ifp->ifindex_next = NULL;
+}
+
+static void
+if_hash_ifname(interface_t *ifp)
+{
+	unsigned hash = if_ifname_hashval(ifp->ifname);
+
+	ifp->ifname_next = if_ifname_hash[hash];
+	if_ifname_hash[hash] = ifp;
+}
+
+static void
+if_unhash_ifname(interface_t *ifp)
+{
+	interface_t **ifpp;
+
+	for (ifpp = &if_ifname_hash[if_ifname_hashval(ifp->ifname)]; *ifpp; ifpp = &(*ifpp)->ifname_next) {
+		if (*ifpp == ifp) {
+			*ifpp = ifp->ifname_next;
+			break;
+		}
+	}
+	ifp->ifname_next = NULL;
+}
+
+/* (Re)build the hash tables with at least twice as many buckets as interfaces */
+static void
+if_rehash(unsigned num_ifs)
+{
+	interface_t *ifp;
+	element e;
+	unsigned size = IF_HASH_MIN_SIZE;
+
+	while (size < 2 * num_ifs)
+		size <<= 1;
+
+	if (size == if_hash_size)
+		return;
+
+	FREE_PTR(if_ifindex_hash);
+	FREE_PTR(if_ifname_hash);
+	if_ifindex_hash = MALLOC(size * sizeof(*if_ifindex_hash));
+	if_ifname_hash = MALLOC(size * sizeof(*if_ifname_hash));
+	if_hash_size = size;
+
+	LIST_FOREACH(if_queue, ifp, e) {
+		if_hash_ifindex(ifp);
+		if_hash_ifname(ifp);
+	}
+}
+
 /* Return interface from interface index */
 interface_t * __attribute__ ((pure))
 if_get_by_ifindex(ifindex_t ifindex)
@@ -96,29 +201,70 @@ if_get_by_ifindex(ifindex_t ifindex)
 	if (LIST_ISEMPTY(if_queue))
 		return NULL;
 
-	for (e = LIST_HEAD(if_queue); e; ELEMENT_NEXT(e)) {
-		ifp = ELEMENT_DATA(e);
+	/* Interfaces that don't exist aren't hashed */
+	if (!ifindex) {
+		LIST_FOREACH(if_queue, ifp, e) {
+			if (!ifp->ifindex)
+				return ifp;
+		}
+		return NULL;
+	}
+
+	for (ifp = if_ifindex_hash[if_ifindex_hashval(ifindex)]; ifp; ifp = ifp->ifindex_next) {
 		if (ifp->ifindex == ifindex)
 			return ifp;
 	}
+
 	return NULL;
 }
 
+/* The ifindex and name of an interface must only be changed by these
+ * functions, so that the hash tables remain consistent */
+void
+if_set_ifindex(interface_t *ifp, ifindex_t ifindex)
+{
+	if (ifp->ifindex == ifindex)
+		return;
+
+	if_unhash_ifindex(ifp);
+	ifp->ifindex = ifindex;
+	if_hash_ifindex(ifp);
+}
+
+void
+if_set_ifname(interface_t *ifp, const char *ifname)
+{
+	if (!strcmp(ifp->ifname, ifname))
+		return;
+
+	if_unhash_ifname(ifp);
+	strcpy_safe(ifp->ifname, ifname);
+	if_hash_ifname(ifp);
+}
+
 static void
 if_add_queue(interface_t * ifp)
 {
 	list_add(if_queue, ifp);
+
+	if (LIST_SIZE(if_queue) * 2 > if_hash_size)
+		if_rehash(LIST_SIZE(if_queue));
+	else {
+		if_hash_ifindex(ifp);
+		if_hash_ifname(ifp);
+	}
 }
 
 interface_t *
 if_get_by_ifname(const char *ifname, if_lookup_t create)
 {
 	interface_t *ifp;
-	element e;
 
-	LIST_FOREACH(if_queue, ifp, e) {
-		if (!strcmp(ifp->ifname, ifname))
-			return ifp;
+	if (if_hash_size) {
+		for (ifp = if_ifname_hash[if_ifname_hashval(ifname)]; ifp; ifp = ifp->ifname_next) {
+			if (!strcmp(ifp->ifname, ifname))
+				return ifp;
+		}
 	}
 
 	if (create == IF_NO_CREATE ||
@@ -771,6 +917,9 @@ free_interface_queue(void)
 {
 	free_list(&if_queue);
 	free_list(&garp_delay);
+	FREE_PTR(if_ifindex_hash);
+	FREE_PTR(if_ifname_hash);
+	if_hash_size = 0;
 }
 
 void
@@ -1330,7 +1479,7 @@ cleanup_lost_interface(interface_t *ifp)
 
 	interface_down(ifp);
 
-	ifp->ifindex = 0;
+	if_set_ifindex(ifp, 0);
 	ifp->ifi_flags = 0;
 #ifdef _HAVE_VRRP_VMAC_
 	if (!ifp->is_ours)
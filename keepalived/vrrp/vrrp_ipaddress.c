@@ -68,9 +68,11 @@ ipaddresstos(char *buf, const ip_address_t *ipaddress)
 	return buf;
 }
 
-/* Add/Delete IP address to a specific interface_t */
-int
-netlink_ipaddress(ip_address_t *ipaddress, int cmd)
+/* Add/Delete IP address to a specific interface_t.
+ * If batch_status is set, the request is queued on the current netlink batch
+ * and *batch_status is updated with the result when the batch is sent. */
+static int
+netlink_ipaddress_cmd(ip_address_t *ipaddress, int cmd, int *batch_status)
 {
 	struct ifa_cacheinfo cinfo;
 	int status = 1;
@@ -184,13 +186,21 @@ netlink_ipaddress(ip_address_t *ipaddress, int cmd)
 #endif
 													     ))
 		netlink_error_ignore = ENODEV;
-	if (netlink_talk(&nl_cmd, &req.n) < 0)
+	if (batch_status)
+		netlink_batch_talk(&nl_cmd, &req.n, batch_status);
+	else if (netlink_talk(&nl_cmd, &req.n) < 0)
 		status = -1;
 	netlink_error_ignore = 0;
 
 	return status;
 }
 
+int
+netlink_ipaddress(ip_address_t *ipaddress, int cmd)
+{
+	return netlink_ipaddress_cmd(ipaddress, cmd, NULL);
+}
+
 /* Add/Delete a list of IP addresses */
 bool
 netlink_iplist(list ip_list, int cmd, bool force)
@@ -198,15 +208,24 @@ netlink_iplist(list ip_list, int cmd, bool force)
 	ip_address_t *ipaddr;
 	element e;
 	bool changed_entries = false;
+	int *status;
+	unsigned i;
 
 	/* No addresses in this list */
 	if (LIST_ISEMPTY(ip_list))
 		return false;
 
+	/* All the commands are sent in a single batch, and the per address
+	 * result is recorded in status[] as the ACKs are read back.
+	 * 0 means not attempted, -1 failed, 1 succeeded. */
+	status = MALLOC(LIST_SIZE(ip_list) * sizeof(*status));
+	netlink_batch_start();
+
 	/*
 	 * If "--dont-release-vrrp" is set then try to release addresses
 	 * that may be there, even if we didn't set them.
 	 */
+	i = 0;
 	LIST_FOREACH (ip_list, ipaddr, e) {
 		if ((cmd == IPADDRESS_ADD && !ipaddr->set) ||
 		    (cmd == IPADDRESS_DEL &&
@@ -216,15 +235,27 @@ netlink_iplist(list ip_list, int cmd, bool force)
 			if (force)
 				netlink_error_ignore = ENODEV;
 
-			if (netlink_ipaddress(ipaddr, cmd) > 0) {
-				ipaddr->set = (cmd == IPADDRESS_ADD);
-				changed_entries = true;
-			}
-			else
-				ipaddr->set = false;
+			status[i] = -1;
+			netlink_ipaddress_cmd(ipaddr, cmd, &status[i]);
 		}
+		i++;
 	}
 
+	netlink_batch_end();
+
+	i = 0;
+	LIST_FOREACH (ip_list, ipaddr, e) {
+		if (status[i] > 0) {
+			ipaddr->set = (cmd == IPADDRESS_ADD);
+			changed_entries = true;
+		}
+		else if (status[i] < 0)
+			ipaddr->set = false;
+		i++;
+	}
+
+	FREE(status);
+
 	return changed_entries;
 }
 
@@ -294,9 +294,11 @@ add_nexthops(ip_route_t *route, struct nlmsghdr *nlh, struct rtmsg *rtm)
 		addattr_l(nlh, sizeof(buf), RTA_MULTIPATH, RTA_DATA(rta), RTA_PAYLOAD(rta));
 }
 
-/* Add/Delete IP route to/from a specific interface */
+/* Add/Delete IP route to/from a specific interface.
+ * If batch_status is set, the request is queued on the current netlink batch
+ * and *batch_status is updated with the result when the batch is sent. */
 static bool
-netlink_route(ip_route_t *iproute, int cmd)
+netlink_route(ip_route_t *iproute, int cmd, int *batch_status)
 {
 	struct {
 		struct nlmsghdr n;
@@ -504,6 +506,11 @@ netlink_route(ip_route_t *iproute, int cmd)
 		log_message(LOG_INFO, "%.*", MAX_LOG_MSG, lbuf+j);
 #endif
 
+	if (batch_status) {
+		netlink_batch_talk(&nl_cmd, &req.n, batch_status);
+		return false;
+	}
+
 	/* This returns ESRCH if the address of via address doesn't exist */
 	/* ENETDOWN if dev p33p1.40 for example is down */
 	if (netlink_talk(&nl_cmd, &req.n) < 0) {
@@ -523,19 +530,37 @@ netlink_rtlist(list rt_list, int cmd)
 {
 	ip_route_t *iproute;
 	element e;
+	int *status;
+	unsigned i;
 
 	/* No routes to add */
 	if (LIST_ISEMPTY(rt_list))
 		return;
 
+	/* See netlink_iplist() */
+	status = MALLOC(LIST_SIZE(rt_list) * sizeof(*status));
+	netlink_batch_start();
+
+	i = 0;
 	LIST_FOREACH(rt_list, iproute, e) {
 		if ((cmd == IPROUTE_DEL) == iproute->set) {
-			if (!netlink_route(iproute, cmd))
-				iproute->set = (cmd == IPROUTE_ADD);
-			else
-				iproute->set = false;
+			status[i] = -1;
+			netlink_route(iproute, cmd, &status[i]);
 		}
+		i++;
 	}
+
+	netlink_batch_end();
+
+	/* After a delete the route is never set, whether it succeeded or not */
+	i = 0;
+	LIST_FOREACH(rt_list, iproute, e) {
+		if (status[i])
+			iproute->set = (status[i] > 0 && cmd == IPROUTE_ADD);
+		i++;
+	}
+
+	FREE(status);
 }
 
 /* Route dump/allocation */
@@ -1839,7 +1864,7 @@ clear_diff_routes(list l, list n)
 			if (!(new_iproute = route_exist(n, iproute))) {
 				log_message(LOG_INFO, "ip route %s/%d ... , no longer exist"
 						    , ipaddresstos(NULL, iproute->dst), iproute->dst->ifa.ifa_prefixlen);
-				netlink_route(iproute, IPROUTE_DEL);
+				netlink_route(iproute, IPROUTE_DEL, NULL);
 			}
 			else {
 				/* There are too many route options to compare to see if the
@@ -1851,9 +1876,9 @@ clear_diff_routes(list l, list n)
 				 * it as not set, and then it will be added later when any new
 				 * routes are added. */
 				netlink_error_ignore = EINVAL;
-				if (netlink_route(new_iproute, IPROUTE_REPLACE)) {
+				if (netlink_route(new_iproute, IPROUTE_REPLACE, NULL)) {
 					netlink_error_ignore = 0;
-					netlink_route(iproute, IPROUTE_DEL);
+					netlink_route(iproute, IPROUTE_DEL, NULL);
 					new_iproute->set = false;
 				} else
 					netlink_error_ignore = 0;
@@ -1874,7 +1899,7 @@ reinstate_static_route(ip_route_t *route)
 {
 	char buf[256];
 
-	route->set = !netlink_route(route, IPROUTE_ADD);
+	route->set = !netlink_route(route, IPROUTE_ADD, NULL);
 
 	format_iproute(route, buf, sizeof(buf));
 	log_message(LOG_INFO, "Restoring deleted static route %s", buf);
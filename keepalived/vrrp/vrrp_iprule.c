@@ -146,9 +146,11 @@ inet_proto_a2n(const char *buf)
 }
 #endif
 
-/* Add/Delete IP rule to/from a specific IP/network */
+/* Add/Delete IP rule to/from a specific IP/network.
+ * If batch_status is set, the request is queued on the current netlink batch
+ * and *batch_status is updated with the result when the batch is sent. */
 static int
-netlink_rule(ip_rule_t *iprule, int cmd)
+netlink_rule(ip_rule_t *iprule, int cmd, int *batch_status)
 {
 	int status = 1;
 	struct {
@@ -274,7 +276,9 @@ netlink_rule(ip_rule_t *iprule, int cmd)
 
 	req.frh.action = iprule->action;
 
-	if (netlink_talk(&nl_cmd, &req.n) < 0)
+	if (batch_status)
+		netlink_batch_talk(&nl_cmd, &req.n, batch_status);
+	else if (netlink_talk(&nl_cmd, &req.n) < 0)
 		status = -1;
 
 	return status;
@@ -285,7 +289,7 @@ reinstate_static_rule(ip_rule_t *rule)
 {
 	char buf[256];
 
-	rule->set = (netlink_rule(rule, IPRULE_ADD) > 0);
+	rule->set = (netlink_rule(rule, IPRULE_ADD, NULL) > 0);
 
 	format_iprule(rule, buf, sizeof(buf));
 	log_message(LOG_INFO, "Restoring deleted static rule %s", buf);
@@ -296,30 +300,46 @@ netlink_rulelist(list rule_list, int cmd, bool force)
 {
 	ip_rule_t *iprule;
 	element e;
+	int *status;
+	unsigned i;
 
 	/* No rules to add */
 	if (LIST_ISEMPTY(rule_list))
 		return;
 
+	/* See netlink_iplist() */
+	status = MALLOC(LIST_SIZE(rule_list) * sizeof(*status));
+	netlink_batch_start();
+
 	/* If force is set, we try to remove all the rules, but the
 	 * rule might not exist. That's not an error, so indicate not
 	 * to report such a situation */
 	if (force && cmd == IPRULE_DEL)
 		netlink_error_ignore = ENOENT;
 
+	i = 0;
 	for (e = LIST_HEAD(rule_list); e; ELEMENT_NEXT(e)) {
 		iprule = ELEMENT_DATA(e);
 		if (force ||
 		    (cmd == IPRULE_ADD && !iprule->set) ||
 		    (cmd == IPRULE_DEL && iprule->set)) {
-			if (netlink_rule(iprule, cmd) > 0)
-				iprule->set = (cmd == IPRULE_ADD);
-			else
-				iprule->set = false;
+			status[i] = -1;
+			netlink_rule(iprule, cmd, &status[i]);
 		}
+		i++;
 	}
 
+	netlink_batch_end();
 	netlink_error_ignore = 0;
+
+	i = 0;
+	LIST_FOREACH(rule_list, iprule, e) {
+		if (status[i])
+			iprule->set = (status[i] > 0 && cmd == IPRULE_ADD);
+		i++;
+	}
+
+	FREE(status);
 }
 
 /* Rule dump/allocation */
@@ -918,7 +938,7 @@ clear_diff_rules(list l, list n)
 					    iprule->to_addr ? to_addr : "");
 			}
 
-			netlink_rule(iprule, IPRULE_DEL);
+			netlink_rule(iprule, IPRULE_DEL, NULL);
 		}
 	}
 }
@@ -232,6 +232,7 @@ vrrp_json_stats_dump(json_writer_t *wr, vrrp_t *vrrp)
 	jsonw_start_object(wr);
 	jsonw_uint_field(wr, "advert_rcvd", stats->advert_rcvd);
 	jsonw_uint_field(wr, "advert_sent", stats->advert_sent);
+	jsonw_uint_field(wr, "advert_superseded", stats->advert_superseded);
 	jsonw_uint_field(wr, "become_master", stats->become_master);
 	jsonw_uint_field(wr, "release_master", stats->release_master);
 	jsonw_uint_field(wr, "packet_len_err", stats->packet_len_err);
@@ -413,6 +413,14 @@ vrrp_handler(const vector_t *strvec)
 
 	alloc_vrrp(iname);
 }
+
+static void
+vrrp_end_handler(void)
+{
+	vrrp_t *vrrp = list_last_entry(&vrrp_data->vrrp, vrrp_t, e_list);
+
+	vrrp->config_hash = get_config_block_hash();
+}
 #ifdef _HAVE_VRRP_VMAC_
 static void
 vrrp_vmac_handler(const vector_t *strvec)
@@ -1730,6 +1738,7 @@ init_vrrp_keywords(bool active)
 
 	/* VRRP Instance mapping */
 	install_keyword_root("vrrp_instance", &vrrp_handler, active);
+	install_sublevel_end_handler(&vrrp_end_handler);
 #ifdef _HAVE_VRRP_VMAC_
 	install_keyword("use_vmac", &vrrp_vmac_handler);
 	install_keyword("vmac_xmit_base", &vrrp_vmac_xmit_base_handler);
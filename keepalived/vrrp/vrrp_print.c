@@ -33,6 +33,7 @@
 #include "vrrp.h"
 #include "vrrp_data.h"
 #include "vrrp_print.h"
+#include "keepalived_netlink.h"
 #include "utils.h"
 
 static const char *dump_file = "/tmp/keepalived.data";
@@ -66,12 +67,14 @@ vrrp_print_stats(bool clear_stats)
 		return;
 	}
 
+	kernel_netlink_print_stats(file, clear_stats);
 
 	list_for_each_entry(vrrp, &vrrp_data->vrrp, e_list) {
 		fprintf(file, "VRRP Instance: %s\n", vrrp->iname);
 		fprintf(file, "  Advertisements:\n");
 		fprintf(file, "    Received: %" PRIu64 "\n", vrrp->stats->advert_rcvd);
 		fprintf(file, "    Sent: %u\n", vrrp->stats->advert_sent);
+		fprintf(file, "    Superseded: %" PRIu64 "\n", vrrp->stats->advert_superseded);
 		fprintf(file, "  Became master: %u\n", vrrp->stats->become_master);
 		fprintf(file, "  Released master: %u\n", vrrp->stats->release_master);
 		fprintf(file, "  Packet Errors:\n");
@@ -78,7 +78,7 @@ bool do_tsm_debug;
 
 /* local variables */
 #ifdef _WITH_BFD_
-static thread_ref_t bfd_thread;		 /* BFD control pipe read thread */
+static thread_ref_t bfd_thread;		 /* BFD event read thread */
 #endif
 
 /* VRRP FSM (Finite State Machine) design.
@@ -329,6 +329,10 @@ vrrp_init_script(list l)
 		else if (vscript->init_state == SCRIPT_INIT_STATE_FAILED)
 			vscript->result = 0; /* assume failed by config */
 
+		/* Identical scripts get their results from the script they duplicate */
+		if (vscript->dup_of)
+			continue;
+
 		thread_add_event(master, vrrp_script_thread, vscript, (int)vscript->interval);
 	}
 }
@@ -376,8 +380,9 @@ vrrp_register_workers(list l)
 	if (!list_empty(&vrrp_data->vrrp)) {
 // TODO - should we only do this if we have track_bfd? Probably not
 		/* Init BFD tracking thread */
+		bfd_event_consumer_init(&bfd_vrrp_event_chan);
 		bfd_thread = thread_add_read(master, vrrp_bfd_thread, NULL,
-					     bfd_vrrp_event_pipe[0], TIMER_NEVER, false);
+					     bfd_vrrp_event_chan.fd, TIMER_NEVER, false);
 	}
 #endif
 
@@ -560,6 +565,8 @@ cancel_vrrp_threads(void)
 		thread_cancel(bfd_thread);
 		bfd_thread = NULL;
 	}
+
+	bfd_event_consumer_release(&bfd_vrrp_event_chan);
 }
 #endif
 
@@ -706,13 +713,19 @@ try_up_instance(vrrp_t *vrrp, bool leaving_init)
 }
 
 #ifdef _WITH_BFD_
+static void *
+vrrp_bfd_lookup(const char *name)
+{
+	return find_vrrp_tracked_bfd_by_name(name);
+}
+
 static void
-vrrp_handle_bfd_event(bfd_event_t * evt)
+vrrp_handle_bfd_event(void *obj, const bfd_event_t *evt)
 {
-	vrrp_tracked_bfd_t *vbfd;
+	vrrp_tracked_bfd_t *vbfd = obj;
 	tracking_obj_t *tbfd;
 	vrrp_t * vrrp;
-	element e, e1;
+	element e;
 	struct timeval cur_time;
 	struct timeval timer_tmp;
 	uint32_t delivery_time;
@@ -723,58 +736,48 @@ vrrp_handle_bfd_event(bfd_event_t * evt)
 		delivery_time = timer_long(timer_tmp);
 		log_message(LOG_INFO, "Received BFD event: instance %s is in"
 			    " state %s (delivered in %" PRIu32 " usec)",
-			    evt->iname, BFD_STATE_STR(evt->state), delivery_time);
+			    vbfd->bname, BFD_STATE_STR(evt->state), delivery_time);
 	}
 
-	LIST_FOREACH(vrrp_data->vrrp_track_bfds, vbfd, e) {
-		if (strcmp(vbfd->bname, evt->iname))
-			continue;
-
-		if ((vbfd->bfd_up && evt->state == BFD_STATE_UP) ||
-		    (!vbfd->bfd_up && evt->state == BFD_STATE_DOWN))
-			continue;
-
-		vbfd->bfd_up = (evt->state == BFD_STATE_UP);
+	if ((vbfd->bfd_up && evt->state == BFD_STATE_UP) ||
+	    (!vbfd->bfd_up && evt->state == BFD_STATE_DOWN))
+		return;
 
-		LIST_FOREACH(vbfd->tracking_vrrp, tbfd, e1) {
-			vrrp = tbfd->obj.vrrp;
+	vbfd->bfd_up = (evt->state == BFD_STATE_UP);
 
-			log_message(LOG_INFO, "VRRP_Instance(%s) Tracked BFD"
-				    " instance %s is %s", vrrp->iname, evt->iname, vbfd->bfd_up ? "UP" : "DOWN");
+	LIST_FOREACH(vbfd->tracking_vrrp, tbfd, e) {
+		vrrp = tbfd->obj.vrrp;
 
-			if (tbfd->weight) {
-				if (vbfd->bfd_up)
-					vrrp->total_priority += abs(tbfd->weight) * tbfd->weight_multiplier;
-				else
-					vrrp->total_priority -= abs(tbfd->weight) * tbfd->weight_multiplier;
-				vrrp_set_effective_priority(vrrp);
-
-				continue;
-			}
+		log_message(LOG_INFO, "VRRP_Instance(%s) Tracked BFD"
+			    " instance %s is %s", vrrp->iname, vbfd->bname, vbfd->bfd_up ? "UP" : "DOWN");
 
-			if (!!vbfd->bfd_up == (tbfd->weight_multiplier == 1))
-				try_up_instance(vrrp, false);
+		if (tbfd->weight) {
+			if (vbfd->bfd_up)
+				vrrp->total_priority += abs(tbfd->weight) * tbfd->weight_multiplier;
 			else
-				down_instance(vrrp);
+				vrrp->total_priority -= abs(tbfd->weight) * tbfd->weight_multiplier;
+			vrrp_set_effective_priority(vrrp);
+
+			continue;
 		}
 
-		break;
+		if (!!vbfd->bfd_up == (tbfd->weight_multiplier == 1))
+			try_up_instance(vrrp, false);
+		else
+			down_instance(vrrp);
 	}
 }
 
 static int
 vrrp_bfd_thread(thread_ref_t thread)
 {
-	bfd_event_t evt;
-
 	bfd_thread = thread_add_read(master, vrrp_bfd_thread, NULL,
 				     thread->u.f.fd, TIMER_NEVER, false);
 
 	if (thread->type != THREAD_READY_READ_FD)
 		return 0;
 
-	while (read(thread->u.f.fd, &evt, sizeof(bfd_event_t)) != -1)
-		vrrp_handle_bfd_event(&evt);
+	bfd_event_receive(&bfd_vrrp_event_chan, vrrp_bfd_lookup, vrrp_handle_bfd_event);
 
 	return 0;
 }
@@ -818,27 +821,133 @@ vrrp_dispatcher_read_timeout(sock_t *sock)
 	return sock->fd_in;
 }
 
+#ifdef _NETWORK_TIMESTAMP_
+#define VRRP_RX_CONTROL_LEN	128
+#else
+#define VRRP_RX_CONTROL_LEN	64
+#endif
+
+/* Process a received advert */
+static void
+vrrp_dispatcher_pkt(sock_t *sock, const vrrphdr_t *hd, char *buf, ssize_t len, struct msghdr *msghdr)
+{
+	vrrp_t *vrrp;
+	vrrp_t vrrp_lookup;
+	int prev_state;
+	struct cmsghdr *cmsg;
+	bool expected_cmsg;
+
+	vrrp_lookup.vrid = hd->vrid;
+	vrrp = rb_search(&sock->rb_vrid, &vrrp_lookup, rb_vrid, vrrp_vrid_cmp);
+
+	/* No instance found => ignore the advert */
+	if (!vrrp) {
+		if (global_data->log_unknown_vrids)
+			log_message(LOG_INFO, "Unknown VRID(%d) received on interface(%s). ignoring..."
+					    , hd->vrid, IF_NAME(sock->ifp));
+		return;
+	}
+
+	if (vrrp->state == VRRP_STATE_FAULT || vrrp->state == VRRP_STATE_INIT) {
+		/* We just ignore a message received when we are in fault state or
+		 * not yet fully initialised */
+		return;
+	}
+
+	/* Save non packet data */
+	vrrp->pkt_saddr = *(struct sockaddr_storage *)msghdr->msg_name;
+	vrrp->hop_limit = -1;           /* Default to not received */
+	vrrp->multicast_pkt = false;
+	for (cmsg = CMSG_FIRSTHDR(msghdr); cmsg; cmsg = CMSG_NXTHDR(msghdr, cmsg)) {
+		expected_cmsg = false;
+		if (cmsg->cmsg_level == IPPROTO_IPV6) {
+			expected_cmsg = true;
+
+#ifdef IPV6_RECVHOPLIMIT
+			if (cmsg->cmsg_type == IPV6_HOPLIMIT &&
+			    cmsg->cmsg_len - sizeof(struct cmsghdr) == sizeof(unsigned int))
+				vrrp->hop_limit = *(unsigned int *)CMSG_DATA(cmsg);
+			else
+#endif
+#ifdef IPV6_RECVPKTINFO
+			if (cmsg->cmsg_type == IPV6_PKTINFO &&
+			    cmsg->cmsg_len - sizeof(struct cmsghdr) == sizeof(struct in6_pktinfo))
+				vrrp->multicast_pkt = IN6_IS_ADDR_MULTICAST(&((struct in6_pktinfo *)CMSG_DATA(cmsg))->ipi6_addr);
+			else
+#endif
+				expected_cmsg = false;
+		}
+#ifdef _NETWORK_TIMESTAMP_
+		else if (do_network_timestamp && cmsg->cmsg_level == SOL_SOCKET) {
+			struct timespec *ts = (void *)CMSG_DATA(cmsg);
+			char time_buf[9];
+
+			expected_cmsg = true;
+			if (cmsg->cmsg_type == SO_TIMESTAMPNS) {
+				strftime(time_buf, sizeof time_buf, "%T", localtime(&ts->tv_sec));
+				log_message(LOG_INFO, "TIMESTAMPNS (socket %d - VRID %u) %s.%9.9ld"
+						    , sock->fd_in, hd->vrid, time_buf, ts->tv_nsec);
+			}
+#if 0
+			if (cmsg->cmsg_type == SO_TIMESTAMP) {
+				struct timeval *tv = (void *)CMSG_DATA(cmsg);
+				log_message(LOG_INFO, "TIMESTAMP message (%d - %u)  %ld.%9.9ld"
+						    , sock->fd_in, hd->vrid, tv->tv_sec, tv->tv_usec);
+			}
+			else if (cmsg->cmsg_type == SO_TIMESTAMPING) {
+				struct timespec *ts = (void *)CMSG_DATA(cmsg);
+				log_message(LOG_INFO, "TIMESTAMPING message (%d - %u)  %ld.%9.9ld, raw %ld.%9.9ld"
+						    , sock->fd_in, hd->vrid, ts->tv_sec, ts->tv_nsec, (ts+2)->tv_sec, (ts+2)->tv_nsec);
+			}
+#endif
+			else
+				expected_cmsg = false;
+		}
+#endif
+
+		if (!expected_cmsg)
+			log_message(LOG_INFO, "fd %d, unexpected control msg len %" PRI_MSG_CONTROLLEN ", level %d, type %d"
+					    , sock->fd_in, cmsg->cmsg_len
+					    , cmsg->cmsg_level, cmsg->cmsg_type);
+	}
+
+	prev_state = vrrp->state;
+
+	if (vrrp->state == VRRP_STATE_BACK)
+		vrrp_state_backup(vrrp, hd, buf, len);
+	else if (vrrp->state == VRRP_STATE_MAST) {
+		if (vrrp_state_master_rx(vrrp, hd, buf, len))
+			vrrp_state_leave_master(vrrp, false);
+	} else
+		log_message(LOG_INFO, "(%s) In dispatcher_read with state %d"
+				    , vrrp->iname, vrrp->state);
+
+
+	/* handle instance synchronization */
+#ifdef _TSM_DEBUG_
+	if (do_tsm_debug)
+		log_message(LOG_INFO, "Read [%s] TSM transition : [%d,%d] Wantstate = [%d]"
+				    , vrrp->iname, prev_state, vrrp->state, vrrp->wantstate);
+#endif
+	VRRP_TSM_HANDLE(prev_state, vrrp);
+
+	/* If we have sent an advert, reset the timer */
+	if (vrrp->state != VRRP_STATE_MAST || !vrrp->lower_prio_no_advert)
+		vrrp_init_instance_sands(vrrp);
+}
+
 /* Handle dispatcher read packet */
 static int
 vrrp_dispatcher_read(sock_t *sock)
 {
-	vrrp_t *vrrp;
 	const vrrphdr_t *hd;
 	ssize_t len = 0;
-	int prev_state = 0;
 	struct sockaddr_storage src_addr = { .ss_family = AF_UNSPEC };
-	vrrp_t vrrp_lookup;
-#ifdef _NETWORK_TIMESTAMP_
-	char control_buf[128];
-#else
-	char control_buf[64];
-#endif
-	struct iovec iovec = { .iov_base = vrrp_buffer, .iov_len = vrrp_buffer_len };
+	char control_buf[VRRP_RX_CONTROL_LEN];
+	struct iovec iovec;
 	struct msghdr msghdr = { .msg_name = &src_addr, .msg_namelen = sizeof(src_addr),
 				 .msg_iov = &iovec, .msg_iovlen = 1,
 				 .msg_control = control_buf, .msg_controllen = sizeof(control_buf) };
-	struct cmsghdr *cmsg;
-	bool expected_cmsg;
 	unsigned eintr_count;
 	unsigned long rx_vrid_map[BIT_WORD(256 + BIT_PER_LONG - 1)] = { 0 };
 	bool terminate_receiving = false;
@@ -851,6 +960,11 @@ vrrp_dispatcher_read(sock_t *sock)
 	 * both configured and unconfigured VRIDs).
 	 * Seems a good tradeoff while simulating */
 	while (!terminate_receiving) {
+		/* vrrp_buffer may have been reallocated while processing
+		 * the previous advert */
+		iovec.iov_base = vrrp_buffer;
+		iovec.iov_len = vrrp_buffer_len;
+
 		/* read & affect received buffer */
 		eintr_count = 0;
 		while ((len = recvmsg(sock->fd_in, &msghdr, MSG_TRUNC | MSG_CTRUNC)) == -1 &&
@@ -916,107 +1030,143 @@ vrrp_dispatcher_read(sock_t *sock)
 		if (__test_and_set_bit(hd->vrid, rx_vrid_map))
 			terminate_receiving = true;
 
-		vrrp_lookup.vrid = hd->vrid;
-		vrrp = rb_search(&sock->rb_vrid, &vrrp_lookup, rb_vrid, vrrp_vrid_cmp);
+		hold_vrrp_buffer();
+		vrrp_dispatcher_pkt(sock, hd, vrrp_buffer, len, &msghdr);
+		release_vrrp_buffer();
+	}
 
-		/* No instance found => ignore the advert */
-		if (!vrrp) {
-			if (global_data->log_unknown_vrids)
-				log_message(LOG_INFO, "Unknown VRID(%d) received on interface(%s). ignoring..."
-						    , hd->vrid, IF_NAME(sock->ifp));
-			continue;
+	return sock->fd_in;
+}
+
+#ifdef HAVE_RECVMMSG
+/* recvmmsg() receive ring. The packet buffers are in vrrp_buffer, and
+ * the iovecs are set up again for each batch, since vrrp_buffer can be
+ * reallocated when an interface's MTU increases. */
+static struct mmsghdr rx_mmsg[VRRP_RX_BATCH_MAX];
+static struct iovec rx_iovec[VRRP_RX_BATCH_MAX];
+static struct sockaddr_storage rx_src_addr[VRRP_RX_BATCH_MAX];
+static char rx_control_buf[VRRP_RX_BATCH_MAX][VRRP_RX_CONTROL_LEN];
+
+/* Handle dispatcher read packets, reading a batch at a time */
+static int
+vrrp_dispatcher_read_batch(sock_t *sock)
+{
+	const vrrphdr_t *hd[VRRP_RX_BATCH_MAX];
+	unsigned long rx_vrid_map[BIT_WORD(256 + BIT_PER_LONG - 1)] = { 0 };
+	unsigned long batch_vrid_map[BIT_WORD(256 + BIT_PER_LONG - 1)];
+	unsigned batch = global_data->vrrp_rx_batch;
+	unsigned eintr_count;
+	unsigned j;
+	int num, i;
+	ssize_t len;
+	struct msghdr *msghdr;
+	vrrp_t *vrrp;
+	vrrp_t vrrp_lookup;
+	bool terminate_receiving = false;
+
+	if (batch > vrrp_buffer_num)
+		batch = vrrp_buffer_num;
+
+	/* As for vrrp_dispatcher_read(), stop once we have received a 2nd advert
+	 * for a VRID, but within a batch only the newest advert for each VRID
+	 * from each source is processed, since an earlier one would be
+	 * immediately overridden. */
+	while (!terminate_receiving) {
+		for (i = 0; i < (int)batch; i++) {
+			rx_iovec[i].iov_base = vrrp_buffer + i * vrrp_buffer_len;
+			rx_iovec[i].iov_len = vrrp_buffer_len;
+
+			msghdr = &rx_mmsg[i].msg_hdr;
+			msghdr->msg_name = &rx_src_addr[i];
+			msghdr->msg_namelen = sizeof(rx_src_addr[i]);
+			msghdr->msg_iov = &rx_iovec[i];
+			msghdr->msg_iovlen = 1;
+			msghdr->msg_control = rx_control_buf[i];
+			msghdr->msg_controllen = sizeof(rx_control_buf[i]);
+			msghdr->msg_flags = 0;
 		}
 
-		if (vrrp->state == VRRP_STATE_FAULT || vrrp->state == VRRP_STATE_INIT) {
-			/* We just ignore a message received when we are in fault state or
-			 * not yet fully initialised */
-			continue;
+		eintr_count = 0;
+		while ((num = recvmmsg(sock->fd_in, rx_mmsg, batch, MSG_TRUNC | MSG_CTRUNC, NULL)) == -1 &&
+		       check_EINTR(errno) && eintr_count++ < 10);
+		if (num <= 0) {
+			if (num < 0 && !check_EAGAIN(errno))
+				log_message(LOG_INFO, "recvmmsg(%d) returned %d (%m)"
+						    , sock->fd_in, errno);
+			break;
 		}
 
-		/* Save non packet data */
-		vrrp->pkt_saddr = src_addr;
-		vrrp->hop_limit = -1;           /* Default to not received */
-		vrrp->multicast_pkt = false;
-		for (cmsg = CMSG_FIRSTHDR(&msghdr); cmsg; cmsg = CMSG_NXTHDR(&msghdr, cmsg)) {
-			expected_cmsg = false;
-			if (cmsg->cmsg_level == IPPROTO_IPV6) {
-				expected_cmsg = true;
+		/* A short read means the socket queue is now empty */
+		if (num < (int)batch)
+			terminate_receiving = true;
 
-#ifdef IPV6_RECVHOPLIMIT
-				if (cmsg->cmsg_type == IPV6_HOPLIMIT &&
-				    cmsg->cmsg_len - sizeof(struct cmsghdr) == sizeof(unsigned int))
-					vrrp->hop_limit = *(unsigned int *)CMSG_DATA(cmsg);
-				else
-#endif
-#ifdef IPV6_RECVPKTINFO
-				if (cmsg->cmsg_type == IPV6_PKTINFO &&
-				    cmsg->cmsg_len - sizeof(struct cmsghdr) == sizeof(struct in6_pktinfo))
-					vrrp->multicast_pkt = IN6_IS_ADDR_MULTICAST(&((struct in6_pktinfo *)CMSG_DATA(cmsg))->ipi6_addr);
-				else
-#endif
-					expected_cmsg = false;
-			}
-#ifdef _NETWORK_TIMESTAMP_
-			else if (do_network_timestamp && cmsg->cmsg_level == SOL_SOCKET) {
-				struct timespec *ts = (void *)CMSG_DATA(cmsg);
-				char time_buf[9];
+		/* Find the newest advert for each VRID and source */
+		memset(batch_vrid_map, 0, sizeof(batch_vrid_map));
+		for (i = 0; i < num; i++) {
+			hd[i] = NULL;
+			len = rx_mmsg[i].msg_len;
+			msghdr = &rx_mmsg[i].msg_hdr;
 
-				expected_cmsg = true;
-				if (cmsg->cmsg_type == SO_TIMESTAMPNS) {
-					strftime(time_buf, sizeof time_buf, "%T", localtime(&ts->tv_sec));
-					log_message(LOG_INFO, "TIMESTAMPNS (socket %d - VRID %u) %s.%9.9ld"
-							    , sock->fd_in, hd->vrid, time_buf, ts->tv_nsec);
-				}
-#if 0
-				if (cmsg->cmsg_type == SO_TIMESTAMP) {
-					struct timeval *tv = (void *)CMSG_DATA(cmsg);
-					log_message(LOG_INFO, "TIMESTAMP message (%d - %u)  %ld.%9.9ld"
-							    , sock->fd_in, hd->vrid, tv->tv_sec, tv->tv_usec);
-				}
-				else if (cmsg->cmsg_type == SO_TIMESTAMPING) {
-					struct timespec *ts = (void *)CMSG_DATA(cmsg);
-					log_message(LOG_INFO, "TIMESTAMPING message (%d - %u)  %ld.%9.9ld, raw %ld.%9.9ld"
-							    , sock->fd_in, hd->vrid, ts->tv_sec, ts->tv_nsec, (ts+2)->tv_sec, (ts+2)->tv_nsec);
-				}
-#endif
-				else
-					expected_cmsg = false;
+			/* Don't attempt to process data if no data received */
+			if (len == 0) {
+				log_message(LOG_INFO, "recvmmsg(%d) returned data length 0", sock->fd_in);
+				continue;
 			}
-#endif
-
-			if (!expected_cmsg)
-				log_message(LOG_INFO, "fd %d, unexpected control msg len %" PRI_MSG_CONTROLLEN ", level %d, type %d"
-						    , sock->fd_in, cmsg->cmsg_len
-						    , cmsg->cmsg_level, cmsg->cmsg_type);
-		}
 
-		prev_state = vrrp->state;
+			if (msghdr->msg_flags & MSG_TRUNC) {
+				log_message(LOG_INFO, "recvmmsg(%d) message truncated from %zd to %zu bytes"
+						    , sock->fd_in, len, vrrp_buffer_len);
+				continue;
+			}
 
-		if (vrrp->state == VRRP_STATE_BACK)
-			vrrp_state_backup(vrrp, hd, vrrp_buffer, len);
-		else if (vrrp->state == VRRP_STATE_MAST) {
-			if (vrrp_state_master_rx(vrrp, hd, vrrp_buffer, len))
-				vrrp_state_leave_master(vrrp, false);
-		} else
-			log_message(LOG_INFO, "(%s) In dispatcher_read with state %d"
-					    , vrrp->iname, vrrp->state);
+			if (msghdr->msg_flags & MSG_CTRUNC) {
+				log_message(LOG_INFO, "recvmmsg(%d), control message truncated from %zu to %" PRI_MSG_CONTROLLEN " bytes"
+						    , sock->fd_in, sizeof(rx_control_buf[i]), msghdr->msg_controllen);
+				msghdr->msg_controllen = 0;
+			}
 
+			/* Check the received data includes at least the IP, possibly
+			 * the AH header and the VRRP header */
+			if (!(hd[i] = vrrp_get_header(sock->family, rx_iovec[i].iov_base, len))) {
+				terminate_receiving = true;
+				continue;
+			}
 
-		/* handle instance synchronization */
-#ifdef _TSM_DEBUG_
-		if (do_tsm_debug)
-			log_message(LOG_INFO, "Read [%s] TSM transition : [%d,%d] Wantstate = [%d]"
-					    , vrrp->iname, prev_state, vrrp->state, vrrp->wantstate);
-#endif
-		VRRP_TSM_HANDLE(prev_state, vrrp);
+			if (__test_and_set_bit(hd[i]->vrid, batch_vrid_map)) {
+				/* An earlier advert for the VRID from the same
+				 * router has been superseded by this one. Adverts
+				 * from other routers must all be processed. */
+				for (j = (unsigned)i; j > 0; j--) {
+					if (hd[j - 1] && hd[j - 1]->vrid == hd[i]->vrid &&
+					    !inet_sockaddrcmp(&rx_src_addr[j - 1], &rx_src_addr[i]))
+						break;
+				}
+				if (j) {
+					vrrp_lookup.vrid = hd[i]->vrid;
+					if ((vrrp = rb_search(&sock->rb_vrid, &vrrp_lookup, rb_vrid, vrrp_vrid_cmp)))
+						vrrp->stats->advert_superseded++;
+					hd[j - 1] = NULL;
+				}
+				terminate_receiving = true;
+			}
+			else if (__test_and_set_bit(hd[i]->vrid, rx_vrid_map))
+				terminate_receiving = true;
+		}
 
-		/* If we have sent an advert, reset the timer */
-		if (vrrp->state != VRRP_STATE_MAST || !vrrp->lower_prio_no_advert)
-			vrrp_init_instance_sands(vrrp);
+		/* Now process the adverts in the order they were received. If
+		 * processing an advert causes vrrp_buffer to be reallocated, that
+		 * must wait until we have finished with the batch. */
+		hold_vrrp_buffer();
+		for (i = 0; i < num; i++) {
+			if (hd[i])
+				vrrp_dispatcher_pkt(sock, hd[i], rx_iovec[i].iov_base, (ssize_t)rx_mmsg[i].msg_len, &rx_mmsg[i].msg_hdr);
+		}
+		release_vrrp_buffer();
 	}
 
 	return sock->fd_in;
 }
+#endif
 
 /* Our read packet dispatcher */
 static int
@@ -1031,6 +1181,10 @@ vrrp_read_dispatcher_thread(thread_ref_t thread)
 	/* Dispatcher state handler */
 	if (thread->type == THREAD_READ_TIMEOUT || sock->fd_in == -1)
 		fd = vrrp_dispatcher_read_timeout(sock);
+#ifdef HAVE_RECVMMSG
+	else if (global_data->vrrp_rx_batch > 1)
+		fd = vrrp_dispatcher_read_batch(sock);
+#endif
 	else
 		fd = vrrp_dispatcher_read(sock);
 
@@ -1074,18 +1228,49 @@ vrrp_script_thread(thread_ref_t thread)
 	return ret;
 }
 
+static void
+vrrp_script_result(vrrp_script_t *vscript, const char *script_exit_type, bool script_success, const char *reason, int reason_code)
+{
+	if (script_success) {
+		if (vscript->result < vscript->rise - 1) {
+			vscript->result++;
+		} else if (vscript->result != vscript->rise + vscript->fall - 1) {
+			if (vscript->result < vscript->rise) {	/* i.e. == vscript->rise - 1 */
+				log_message(LOG_INFO, "VRRP_Script(%s) %s", vscript->sname, script_exit_type);
+				update_script_priorities(vscript, true);
+			}
+			vscript->result = vscript->rise + vscript->fall - 1;
+		}
+	} else {
+		if (vscript->result > vscript->rise) {
+			vscript->result--;
+		} else {
+			if (vscript->result == vscript->rise ||
+			    vscript->init_state == SCRIPT_INIT_STATE_INIT) {
+				if (reason)
+					log_message(LOG_INFO, "VRRP_Script(%s) %s (%s %d)", vscript->sname, script_exit_type, reason, reason_code);
+				else
+					log_message(LOG_INFO, "VRRP_Script(%s) %s", vscript->sname, script_exit_type);
+				update_script_priorities(vscript, false);
+			}
+			vscript->result = 0;
+		}
+	}
+}
+
 static int
 vrrp_script_child_thread(thread_ref_t thread)
 {
 	int wait_status;
 	pid_t pid;
 	vrrp_script_t *vscript = THREAD_ARG(thread);
+	vrrp_script_t *dup;
 	int sig_num;
 	unsigned timeout = 0;
 	const char *script_exit_type = NULL;
 	bool script_success;
 	const char *reason = NULL;
-	int reason_code;
+	int reason_code = 0;
 
 	if (thread->type == THREAD_CHILD_TIMEOUT) {
 		pid = THREAD_CHILD_PID(thread);
@@ -1210,36 +1395,15 @@ vrrp_script_child_thread(thread_ref_t thread)
 		log_message(LOG_INFO, "wait for pid %d exited with exit code 0x%x", THREAD_CHILD_PID(thread), (unsigned)wait_status);
 #endif
 
-	if (script_exit_type) {
-		if (script_success) {
-			if (vscript->result < vscript->rise - 1) {
-				vscript->result++;
-			} else if (vscript->result != vscript->rise + vscript->fall - 1) {
-				if (vscript->result < vscript->rise) {	/* i.e. == vscript->rise - 1 */
-					log_message(LOG_INFO, "VRRP_Script(%s) %s", vscript->sname, script_exit_type);
-					update_script_priorities(vscript, true);
-				}
-				vscript->result = vscript->rise + vscript->fall - 1;
-			}
-		} else {
-			if (vscript->result > vscript->rise) {
-				vscript->result--;
-			} else {
-				if (vscript->result == vscript->rise ||
-				    vscript->init_state == SCRIPT_INIT_STATE_INIT) {
-					if (reason)
-						log_message(LOG_INFO, "VRRP_Script(%s) %s (%s %d)", vscript->sname, script_exit_type, reason, reason_code);
-					else
-						log_message(LOG_INFO, "VRRP_Script(%s) %s", vscript->sname, script_exit_type);
-					update_script_priorities(vscript, false);
-				}
-				vscript->result = 0;
-			}
-		}
+	/* Apply the result to the script and any identical scripts sharing it */
+	for (dup = vscript; dup; dup = dup->dup_next) {
+		if (script_exit_type)
+			vrrp_script_result(dup, script_exit_type, script_success, reason, reason_code);
+		dup->last_status = vscript->last_status;
+		dup->init_state = SCRIPT_INIT_STATE_DONE;
 	}
 
 	vscript->state = SCRIPT_STATE_IDLE;
-	vscript->init_state = SCRIPT_INIT_STATE_DONE;
 
 	return 0;
 }
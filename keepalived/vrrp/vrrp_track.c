@@ -146,6 +146,60 @@ find_script_by_name(const char *name)
 	return NULL;
 }
 
+static bool __attribute__ ((pure))
+same_script_command(const vrrp_script_t *a, const vrrp_script_t *b)
+{
+	const char * const *a_arg, * const *b_arg;
+
+	if (a->interval != b->interval ||
+	    a->timeout != b->timeout ||
+	    a->script.uid != b->script.uid ||
+	    a->script.gid != b->script.gid)
+		return false;
+
+	for (a_arg = a->script.args, b_arg = b->script.args; *a_arg && *b_arg; a_arg++, b_arg++) {
+		if (strcmp(*a_arg, *b_arg))
+			return false;
+	}
+
+	return !*a_arg && !*b_arg;
+}
+
+/* Scripts that run the same command as the same user at the same interval
+ * only need to be executed once; the other scripts take their results from
+ * the first one, applying their own rise, fall and weights. */
+void
+share_identical_scripts(void)
+{
+	element e, e1;
+	vrrp_script_t *scr, *dup, *last;
+	unsigned shared = 0;
+
+	LIST_FOREACH(vrrp_data->vrrp_script, scr, e) {
+		scr->dup_of = NULL;
+		scr->dup_next = NULL;
+	}
+
+	LIST_FOREACH(vrrp_data->vrrp_script, scr, e) {
+		if (scr->dup_of)
+			continue;
+
+		last = scr;
+		LIST_FOREACH_FROM(e->next, dup, e1) {
+			if (dup->dup_of || !same_script_command(scr, dup))
+				continue;
+			dup->dup_of = scr;
+			last->dup_next = dup;
+			last = dup;
+			shared++;
+		}
+	}
+
+	if (shared)
+		log_message(LOG_INFO, "%u track script%s share%s results with identical scripts, saving %u execution%s per interval",
+			    shared, shared == 1 ? "" : "s", shared == 1 ? "s" : "", shared, shared == 1 ? "" : "s");
+}
+
 /* Track script dump */
 void
 dump_track_script(FILE *fp, const void *track_data)
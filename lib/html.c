@@ -23,29 +23,92 @@
 #include "config.h"
 
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <ctype.h>
 
 #include "html.h"
 #include "memory.h"
 
 /* HTTP header tag */
-#define CONTENT_LENGTH	"Content-Length:"
+#define CONTENT_LENGTH	"Content-Length"
+
+/*
+ * Return a pointer to the value of the named header field, and its
+ * length in value_len. size is the length of the headers. Field names
+ * are not case sensitive (rfc7230.3.2).
+ */
+const char *
+extract_header(const char *buffer, size_t size, const char *name, size_t *value_len)
+{
+	const char *end = buffer + size;
+	const char *line, *eol, *val;
+	size_t name_len = strlen(name);
+
+	/* Skip the status line */
+	if (!(line = memchr(buffer, '\n', size)))
+		return NULL;
+
+	for (line++; line < end; line = eol + 1) {
+		if (!(eol = memchr(line, '\n', (size_t)(end - line))))
+			eol = end;
+
+		if ((size_t)(eol - line) <= name_len ||
+		    line[name_len] != ':' ||
+		    strncasecmp(line, name, name_len))
+			continue;
+
+		for (val = line + name_len + 1; val < eol && (*val == ' ' || *val == '\t'); val++);
+		for (; eol > val && isspace((unsigned char)eol[-1]); eol--);
+
+		*value_len = (size_t)(eol - val);
+		return val;
+	}
+
+	return NULL;
+}
+
+/* Return true if the comma separated header field contains token */
+bool
+extract_header_token(const char *buffer, size_t size, const char *name, const char *token)
+{
+	const char *val, *end, *tok_end;
+	size_t len;
+	size_t token_len = strlen(token);
+
+	if (!(val = extract_header(buffer, size, name, &len)))
+		return false;
+
+	for (end = val + len; val < end; val = tok_end + 1) {
+		for (; val < end && (*val == ' ' || *val == '\t'); val++);
+		if (!(tok_end = memchr(val, ',', (size_t)(end - val))))
+			tok_end = end;
+		for (len = (size_t)(tok_end - val); len && (val[len - 1] == ' ' || val[len - 1] == '\t'); len--);
+
+		if (len == token_len && !strncasecmp(val, token, len))
+			return true;
+	}
+
+	return false;
+}
 
 /* Return the http header content length */
 size_t extract_content_length(const char *buffer, size_t size)
 {
-	char *clen = strstr(buffer, CONTENT_LENGTH);
+	const char *clen;
+	size_t clen_len;
 	size_t len;
 	char *end;
 
 	/* Pattern not found */
-	if (!clen || clen > buffer + size)
+	if (!(clen = extract_header(buffer, size, CONTENT_LENGTH, &clen_len)) ||
+	    !clen_len || !isdigit((unsigned char)*clen))
 		return SIZE_MAX;
 
 	/* Content-Length extraction */
-	len = strtoul(clen + strlen(CONTENT_LENGTH), &end, 10);
-	if (*end)
+	len = strtoul(clen, &end, 10);
+	if (end != clen + clen_len)
 		return SIZE_MAX;
 
 	return len;
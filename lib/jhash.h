@@ -0,0 +1,116 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        jhash.h include file.
+ *
+ *              Jenkins hash, from lookup3.c by Bob Jenkins, May 2006,
+ *              Public Domain (http://burtleburtle.net/bob/hash/), as
+ *              used in the Linux kernel.
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2020 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _JHASH_H
+#define _JHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define JHASH_INITVAL		0xdeadbeef
+
+#define jhash_rol32(w, s)	(((w) << (s)) | ((w) >> (32 - (s))))
+
+/* Mix 3 32-bit values reversibly */
+#define __jhash_mix(a, b, c)			\
+{						\
+	a -= c;  a ^= jhash_rol32(c, 4);  c += b;	\
+	b -= a;  b ^= jhash_rol32(a, 6);  a += c;	\
+	c -= b;  c ^= jhash_rol32(b, 8);  b += a;	\
+	a -= c;  a ^= jhash_rol32(c, 16); c += b;	\
+	b -= a;  b ^= jhash_rol32(a, 19); a += c;	\
+	c -= b;  c ^= jhash_rol32(b, 4);  b += a;	\
+}
+
+/* Final mixing of 3 32-bit values (a,b,c) into c */
+#define __jhash_final(a, b, c)			\
+{						\
+	c ^= b; c -= jhash_rol32(b, 14);	\
+	a ^= c; a -= jhash_rol32(c, 11);	\
+	b ^= a; b -= jhash_rol32(a, 25);	\
+	c ^= b; c -= jhash_rol32(b, 16);	\
+	a ^= c; a -= jhash_rol32(c, 4);		\
+	b ^= a; b -= jhash_rol32(a, 14);	\
+	c ^= b; c -= jhash_rol32(b, 24);	\
+}
+
+/* Hash an arbitrary sequence of bytes */
+static inline uint32_t
+jhash(const void *key, size_t length, uint32_t initval)
+{
+	const uint8_t *k = key;
+	uint32_t a, b, c;
+	uint32_t w[3];
+
+	a = b = c = JHASH_INITVAL + (uint32_t)length + initval;
+
+	while (length > 12) {
+		memcpy(w, k, sizeof(w));
+		a += w[0];
+		b += w[1];
+		c += w[2];
+		__jhash_mix(a, b, c);
+		length -= 12;
+		k += 12;
+	}
+
+	if (!length)
+		return c;
+
+	w[0] = w[1] = w[2] = 0;
+	memcpy(w, k, length);
+	a += w[0];
+	b += w[1];
+	c += w[2];
+	__jhash_final(a, b, c);
+
+	return c;
+}
+
+static inline uint32_t
+jhash_3words(uint32_t a, uint32_t b, uint32_t c, uint32_t initval)
+{
+	a += JHASH_INITVAL;
+	b += JHASH_INITVAL;
+	c += initval;
+
+	__jhash_final(a, b, c);
+
+	return c;
+}
+
+static inline uint32_t
+jhash_2words(uint32_t a, uint32_t b, uint32_t initval)
+{
+	return jhash_3words(a, b, 0, initval);
+}
+
+static inline uint32_t
+jhash_1word(uint32_t a, uint32_t initval)
+{
+	return jhash_3words(a, 0, 0, initval);
+}
+
+#endif
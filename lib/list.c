@@ -27,6 +27,9 @@
 #include "list.h"
 #include "memory.h"
 
+/* List elements are only added and removed by the main thread of each process */
+static mem_slab_t element_slab;
+
 /* Multiple list helpers functions */
 list
 alloc_mlist_r(void (*free_func) (void *), void (*dump_func) (FILE *, const void *), size_t size)
@@ -62,7 +65,7 @@ free_melement(list l, void (*free_func) (void *))
 		next = e->next;
 		if (free_func)
 			(*free_func) (e->data);
-		FREE(e);
+		SLAB_FREE(&element_slab, e);
 	}
 }
 
@@ -89,7 +92,10 @@ alloc_list_r(void (*free_func) (void *), void (*dump_func) (FILE *fp, const void
 static element __attribute__ ((malloc))
 alloc_element(void)
 {
-	return (element) MALLOC(sizeof (struct _element));
+	if (!element_slab.name)
+		mem_slab_init(&element_slab, "list element", sizeof (struct _element));
+
+	return (element) SLAB_ALLOC(&element_slab);
 }
 
 static inline void
@@ -157,7 +163,7 @@ list_remove_r(list l, const element e)
 		(*l->free) (e->data);
 
 	__list_remove(l, e);
-	FREE_ONLY(e);
+	SLAB_FREE_ONLY(&element_slab, e);
 }
 
 void
@@ -235,7 +241,7 @@ free_elements(list l)
 		if (l->free)
 			(*l->free) (e->data);
 		l->count--;
-		FREE(e);
+		SLAB_FREE(&element_slab, e);
 	}
 #if 0
 	if (l->count)
@@ -283,7 +289,7 @@ free_list_element_r(list l, const element e)
 	if (l->free)
 		(*l->free) (e->data);
 	l->count--;
-	FREE_ONLY(e);
+	SLAB_FREE_ONLY(&element_slab, e);
 }
 
 void
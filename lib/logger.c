@@ -32,10 +32,22 @@
 #ifndef HAVE_SIGNALFD
 #include <signal.h>
 #endif
+#ifdef _WITH_ASYNC_LOG_
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#endif
 
 #include "logger.h"
 #include "bitops.h"
 #include "utils.h"
+#ifdef _WITH_ASYNC_LOG_
+#include "memory.h"
+#endif
 
 /* Boolean flag - send messages to console as well as syslog */
 static bool log_console = false;
@@ -47,6 +59,59 @@ static FILE *log_file;
 bool always_flush_log_file;
 #endif
 
+#ifdef _WITH_ASYNC_LOG_
+/* Asynchronous logging. Messages are formatted by the logging thread into
+ * a bounded lock-free multi producer/single consumer ring (checker worker
+ * threads log too), and a writer thread drains the ring to the console, log
+ * file and syslog. If the ring is full the message is dropped and counted,
+ * so a slow syslog can never block the caller. */
+typedef struct _log_entry {
+	uint32_t	seq;		/* Ring sequence, see log_ring_push() */
+	int		facility;
+	time_t		time;
+	char		msg[2 * MAX_LOG_MSG + 1];
+} log_entry_t;
+
+/* Per call site rate limiting. This is checked by the logging thread
+ * before the message is formatted or takes a ring slot, so a flooding
+ * call site neither costs the caller formatting time nor crowds other
+ * messages out of the ring. A site is identified by the caller's return
+ * address, the format string and the priority. */
+#define LOG_RATE_SITES		256
+typedef struct _log_rate_site {
+	const void	*caller;
+	const char	*format;
+	int		facility;
+	time_t		window_start;
+	unsigned	count;
+	unsigned	suppressed;
+} log_rate_site_t;
+
+static unsigned log_async_entries;
+static unsigned log_rate_burst;
+static unsigned log_rate_interval;
+
+static log_entry_t *log_ring;
+static uint32_t log_ring_mask;
+static uint32_t log_ring_head;		/* Next slot for producers */
+static uint32_t log_ring_tail;		/* Only used by the writer */
+static int log_writer_fd = -1;
+static bool log_writer_running;
+static bool log_writer_sleeping;
+static bool log_writer_stop;
+static pthread_t log_writer_thread;
+
+static log_rate_site_t log_rate_sites[LOG_RATE_SITES];
+static unsigned log_rate_pending;	/* Sites with unreported suppressed messages */
+static pthread_mutex_t log_rate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t log_async_queued;
+static uint64_t log_async_dropped;
+static uint64_t log_async_written;
+static uint64_t log_async_suppressed;
+static uint64_t log_async_dropped_reported;
+#endif
+
 void
 enable_console_log(void)
 {
@@ -111,6 +176,403 @@ update_log_file_perms(mode_t umask_bits)
 }
 #endif
 
+#ifdef _WITH_ASYNC_LOG_
+static void
+write_log_message(int facility, time_t t, const char *buf)
+{
+	static time_t last_time;
+	static char timestamp[64];
+	struct tm tm;
+
+	if (
+#ifdef ENABLE_LOG_TO_FILE
+	    log_file ||
+#endif
+			(__test_bit(DONT_FORK_BIT, &debug) && log_console)) {
+		/* Only convert the timestamp when the second changes */
+		if (t != last_time) {
+			localtime_r(&t, &tm);
+			strftime(timestamp, sizeof(timestamp), "%c", &tm);
+			last_time = t;
+		}
+
+		if (log_console && __test_bit(DONT_FORK_BIT, &debug))
+			fprintf(stderr, "%s: %s\n", timestamp, buf);
+#ifdef ENABLE_LOG_TO_FILE
+		if (log_file)
+			fprintf(log_file, "%s: %s\n", timestamp, buf);
+#endif
+	}
+
+	if (!__test_bit(NO_SYSLOG_BIT, &debug)) {
+		if (!(facility & LOG_FACMASK))
+			facility |= LOG_USER;
+
+		syslog(facility, "%s", buf);
+	}
+}
+
+static void
+format_log_suppressed(char *buf, size_t len, const log_rate_site_t *rs, time_t now)
+{
+	snprintf(buf, len, "%u log messages suppressed in %lds: \"%s\"",
+		 rs->suppressed, (long)(now - rs->window_start), rs->format);
+}
+
+/* Returns true if the message should be logged. If the site's previous
+ * window had suppressed messages, the report is returned in report. */
+static bool
+log_rate_check(const void *caller, int facility, const char *format, time_t now, char *report, size_t report_len)
+{
+	log_rate_site_t *rs;
+	unsigned i, hash;
+	bool ret = true;
+
+	*report = '\0';
+
+	/* Open addressing on the caller's address. If the table is
+	 * full the message isn't limited. */
+	hash = (unsigned)((((uintptr_t)caller ^ (uintptr_t)format) >> 2) * 2654435761U);
+
+	pthread_mutex_lock(&log_rate_lock);
+
+	for (i = 0; i < LOG_RATE_SITES; i++) {
+		rs = &log_rate_sites[(hash + i) % LOG_RATE_SITES];
+		if (rs->caller == caller && rs->format == format && rs->facility == facility)
+			break;
+		if (!rs->caller) {
+			rs->caller = caller;
+			rs->format = format;
+			rs->facility = facility;
+			rs->window_start = now;
+			break;
+		}
+	}
+
+	if (i < LOG_RATE_SITES) {
+		if (now - rs->window_start >= (time_t)log_rate_interval) {
+			if (rs->suppressed) {
+				format_log_suppressed(report, report_len, rs, now);
+				rs->suppressed = 0;
+				log_rate_pending--;
+			}
+			rs->window_start = now;
+			rs->count = 0;
+		}
+
+		if (++rs->count > log_rate_burst) {
+			if (!rs->suppressed++)
+				log_rate_pending++;
+			ret = false;
+		}
+	}
+
+	pthread_mutex_unlock(&log_rate_lock);
+
+	if (!ret)
+		__atomic_add_fetch(&log_async_suppressed, 1, __ATOMIC_RELAXED);
+
+	return ret;
+}
+
+/* Called by the writer to report suppressed messages for sites whose
+ * window has expired without them logging again */
+static void
+log_rate_flush(time_t now, bool all)
+{
+	char buf[2 * MAX_LOG_MSG + 1];
+	unsigned i;
+	bool found;
+
+	for (i = 0; i < LOG_RATE_SITES; i++) {
+		pthread_mutex_lock(&log_rate_lock);
+		if (!log_rate_pending) {
+			pthread_mutex_unlock(&log_rate_lock);
+			break;
+		}
+		found = log_rate_sites[i].suppressed &&
+			(all || now - log_rate_sites[i].window_start >= (time_t)log_rate_interval);
+		if (found) {
+			format_log_suppressed(buf, sizeof(buf), &log_rate_sites[i], now);
+			log_rate_sites[i].suppressed = 0;
+			log_rate_pending--;
+		}
+		pthread_mutex_unlock(&log_rate_lock);
+
+		if (found)
+			write_log_message(LOG_INFO, now, buf);
+	}
+}
+
+static bool __attribute__ ((format (printf, 3, 0)))
+log_ring_push(int facility, time_t now, const char *format, va_list args)
+{
+	log_entry_t *entry;
+	uint32_t pos = __atomic_load_n(&log_ring_head, __ATOMIC_RELAXED);
+	int32_t diff;
+
+	/* A slot is free for position pos when its seq == pos, and has
+	 * been written when its seq == pos + 1. */
+	for (;;) {
+		entry = &log_ring[pos & log_ring_mask];
+		diff = (int32_t)(__atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE) - pos);
+		if (!diff) {
+			if (__atomic_compare_exchange_n(&log_ring_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0)
+			return false;
+		else
+			pos = __atomic_load_n(&log_ring_head, __ATOMIC_RELAXED);
+	}
+
+	entry->facility = facility;
+	entry->time = now;
+	vsnprintf(entry->msg, sizeof(entry->msg), format, args);
+
+	__atomic_store_n(&entry->seq, pos + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static bool
+log_ring_pop(log_entry_t **entry)
+{
+	*entry = &log_ring[log_ring_tail & log_ring_mask];
+
+	return __atomic_load_n(&(*entry)->seq, __ATOMIC_ACQUIRE) == log_ring_tail + 1;
+}
+
+static void
+log_ring_release(log_entry_t *entry)
+{
+	__atomic_store_n(&entry->seq, log_ring_tail + log_ring_mask + 1, __ATOMIC_RELEASE);
+	log_ring_tail++;
+}
+
+static bool __attribute__ ((format (printf, 3, 4)))
+log_ring_push_fmt(int facility, time_t now, const char *format, ...)
+{
+	va_list args;
+	bool ret;
+
+	va_start(args, format);
+	ret = log_ring_push(facility, now, format, args);
+	va_end(args);
+
+	return ret;
+}
+
+static void __attribute__ ((format (printf, 3, 0)))
+log_async_message(const void *caller, int facility, const char *format, va_list args)
+{
+	uint64_t val = 1;
+	time_t now = time(NULL);
+	char report[2 * MAX_LOG_MSG + 1];
+	bool log_it = true;
+
+	if (log_rate_burst) {
+		log_it = log_rate_check(caller, facility, format, now, report, sizeof(report));
+
+		/* The site's previous window had suppressed messages */
+		if (report[0]) {
+			if (log_ring_push_fmt(LOG_INFO, now, "%s", report))
+				__atomic_add_fetch(&log_async_queued, 1, __ATOMIC_RELAXED);
+			else
+				__atomic_add_fetch(&log_async_dropped, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	if (log_it) {
+		if (!log_ring_push(facility, now, format, args)) {
+			__atomic_add_fetch(&log_async_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+
+		__atomic_add_fetch(&log_async_queued, 1, __ATOMIC_RELAXED);
+	} else if (!report[0])
+		return;
+
+	/* Only wake the writer if it is waiting. We can't log a failure here. */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_exchange_n(&log_writer_sleeping, false, __ATOMIC_SEQ_CST)) {
+		if (write(log_writer_fd, &val, sizeof(val)) == -1) {}
+	}
+}
+
+static void *
+log_writer(__attribute__((unused)) void *arg)
+{
+	log_entry_t *entry, *dummy;
+	struct pollfd pfd = { .fd = log_writer_fd, .events = POLLIN };
+	uint64_t val, dropped;
+	char buf[MAX_LOG_MSG + 1];
+	bool stop;
+
+	for (;;) {
+		while (log_ring_pop(&entry)) {
+			write_log_message(entry->facility, entry->time, entry->msg);
+			log_async_written++;
+			log_ring_release(entry);
+		}
+
+		dropped = __atomic_load_n(&log_async_dropped, __ATOMIC_RELAXED);
+		if (dropped != log_async_dropped_reported) {
+			snprintf(buf, sizeof(buf), "Async logging dropped %" PRIu64 " messages - ring full", dropped - log_async_dropped_reported);
+			write_log_message(LOG_INFO, time(NULL), buf);
+			log_async_dropped_reported = dropped;
+		}
+
+		if (__atomic_load_n(&log_rate_pending, __ATOMIC_RELAXED))
+			log_rate_flush(time(NULL), false);
+
+#ifdef ENABLE_LOG_TO_FILE
+		if (log_file)
+			fflush(log_file);
+#endif
+
+		stop = __atomic_load_n(&log_writer_stop, __ATOMIC_ACQUIRE);
+		if (stop)
+			break;
+
+		/* Recheck the ring after announcing we are going to sleep,
+		 * so that a message pushed meanwhile isn't missed */
+		__atomic_store_n(&log_writer_sleeping, true, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (log_ring_pop(&dummy)) {
+			__atomic_store_n(&log_writer_sleeping, false, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		/* Wake up once a second if there are suppression reports due */
+		if (poll(&pfd, 1, __atomic_load_n(&log_rate_pending, __ATOMIC_RELAXED) ? 1000 : -1) > 0 &&
+		    read(log_writer_fd, &val, sizeof(val)) == -1 && errno != EAGAIN)
+			break;
+	}
+
+	log_rate_flush(time(NULL), true);
+
+	return NULL;
+}
+
+/* A forked child doesn't have the writer thread */
+static void
+log_writer_atfork_child(void)
+{
+	log_writer_running = false;
+}
+
+void
+set_log_async(unsigned entries)
+{
+	uint32_t size = 16;
+
+	/* Round up to a power of 2 */
+	while (size < entries)
+		size <<= 1;
+
+	log_async_entries = size;
+}
+
+void
+set_log_rate_limit(unsigned burst, unsigned interval)
+{
+	log_rate_burst = burst;
+	log_rate_interval = interval;
+}
+
+/* Called in each child process once logging has been set up */
+void
+start_log_writer(void)
+{
+	static bool atfork_registered;
+	sigset_t sigset, cursigset;
+	uint32_t i;
+	int ret;
+
+	if (!log_async_entries || log_writer_running)
+		return;
+
+	if ((log_writer_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		log_message(LOG_INFO, "Unable to create async log eventfd - %d (%m)", errno);
+		return;
+	}
+
+	log_ring = MALLOC(log_async_entries * sizeof(*log_ring));
+	log_ring_mask = log_async_entries - 1;
+	for (i = 0; i < log_async_entries; i++)
+		log_ring[i].seq = i;
+	log_ring_head = log_ring_tail = 0;
+	log_writer_stop = false;
+	log_writer_sleeping = false;
+	log_async_queued = log_async_dropped = log_async_written = 0;
+	log_async_suppressed = log_async_dropped_reported = 0;
+	memset(log_rate_sites, 0, sizeof(log_rate_sites));
+	log_rate_pending = 0;
+
+	if (!atfork_registered) {
+		pthread_atfork(NULL, NULL, log_writer_atfork_child);
+		atfork_registered = true;
+	}
+
+	/* The writer mustn't handle any signals */
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_SETMASK, &sigset, &cursigset);
+	ret = pthread_create(&log_writer_thread, NULL, log_writer, NULL);
+	pthread_sigmask(SIG_SETMASK, &cursigset, NULL);
+
+	if (ret) {
+		log_message(LOG_INFO, "Unable to start async log writer - %d", ret);
+		FREE_PTR(log_ring);
+		close(log_writer_fd);
+		log_writer_fd = -1;
+		return;
+	}
+
+	__atomic_store_n(&log_writer_running, true, __ATOMIC_RELEASE);
+}
+
+/* Write out any queued messages, and revert to synchronous logging */
+void
+stop_log_writer(void)
+{
+	uint64_t val = 1;
+
+	if (!log_writer_running)
+		return;
+
+	__atomic_store_n(&log_writer_running, false, __ATOMIC_RELEASE);
+	__atomic_store_n(&log_writer_stop, true, __ATOMIC_RELEASE);
+	if (write(log_writer_fd, &val, sizeof(val)) == -1)
+		syslog(LOG_INFO, "Async log writer stop write error - %d (%m)", errno);
+	pthread_join(log_writer_thread, NULL);
+
+	if (__test_bit(LOG_DETAIL_BIT, &debug))
+		log_message(LOG_INFO, "Async logging: %" PRIu64 " queued, %" PRIu64 " written, %" PRIu64 " suppressed, %" PRIu64 " dropped"
+				    , log_async_queued, log_async_written, log_async_suppressed, log_async_dropped);
+
+	close(log_writer_fd);
+	log_writer_fd = -1;
+	FREE_PTR(log_ring);
+}
+
+void
+dump_log_async(FILE *fp)
+{
+	if (!log_writer_running)
+		return;
+
+	conf_write(fp, "------< Async logging >------");
+	conf_write(fp, " Ring entries = %u", log_async_entries);
+	if (log_rate_burst)
+		conf_write(fp, " Rate limit = %u per %us per site", log_rate_burst, log_rate_interval);
+	conf_write(fp, " Queued = %" PRIu64 ", written = %" PRIu64 ", suppressed = %" PRIu64 ", dropped = %" PRIu64
+		     , __atomic_load_n(&log_async_queued, __ATOMIC_RELAXED)
+		     , __atomic_load_n(&log_async_written, __ATOMIC_RELAXED)
+		     , __atomic_load_n(&log_async_suppressed, __ATOMIC_RELAXED)
+		     , __atomic_load_n(&log_async_dropped, __ATOMIC_RELAXED));
+}
+#endif
+
 #ifndef HAVE_SIGNALFD
 static inline bool
 block_signals(sigset_t *cur_set)
@@ -132,8 +594,9 @@ block_signals(sigset_t *cur_set)
 }
 #endif
 
-void
-vlog_message(int facility, const char* format, va_list args)
+/* caller identifies the logging call site for rate limiting */
+static void __attribute__ ((format (printf, 3, 0)))
+vlog_message_from(__attribute__((unused)) const void *caller, int facility, const char* format, va_list args)
 {
 #ifndef HAVE_SIGNALFD
 	sigset_t cur_set;
@@ -147,6 +610,13 @@ vlog_message(int facility, const char* format, va_list args)
 	if (__test_bit(CONFIG_TEST_BIT, &debug))
 		return;
 
+#ifdef _WITH_ASYNC_LOG_
+	if (__atomic_load_n(&log_writer_running, __ATOMIC_ACQUIRE)) {
+		log_async_message(caller, facility, format, args);
+		return;
+	}
+#endif
+
 #if !HAVE_VSYSLOG
 	vsnprintf(buf, sizeof(buf), format, args);
 #endif
@@ -215,13 +685,19 @@ vlog_message(int facility, const char* format, va_list args)
 #endif
 }
 
+void
+vlog_message(int facility, const char* format, va_list args)
+{
+	vlog_message_from(__builtin_return_address(0), facility, format, args);
+}
+
 void
 log_message(const int facility, const char *format, ...)
 {
 	va_list args;
 
 	va_start(args, format);
-	vlog_message(facility, format, args);
+	vlog_message_from(__builtin_return_address(0), facility, format, args);
 	va_end(args);
 }
 
@@ -236,7 +712,7 @@ conf_write(FILE *fp, const char *format, ...)
 		fprintf(fp, "\n");
 	}
 	else
-		vlog_message(LOG_INFO, format, args);
+		vlog_message_from(__builtin_return_address(0), LOG_INFO, format, args);
 
 	va_end(args);
 }
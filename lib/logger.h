@@ -44,6 +44,13 @@ extern void open_log_file(const char *, const char *, const char *, const char *
 extern void flush_log_file(void);
 extern void update_log_file_perms(mode_t);
 #endif
+#ifdef _WITH_ASYNC_LOG_
+extern void set_log_async(unsigned);
+extern void set_log_rate_limit(unsigned, unsigned);
+extern void start_log_writer(void);
+extern void stop_log_writer(void);
+extern void dump_log_async(FILE *);
+#endif
 extern void vlog_message(int facility, const char* format, va_list args)
 	__attribute__ ((format (printf, 2, 0)));
 extern void log_message(int priority, const char* format, ...)
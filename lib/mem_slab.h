@@ -0,0 +1,47 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        mem_slab.h include file.
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2020 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _MEM_SLAB_H
+#define _MEM_SLAB_H
+
+#include <stddef.h>
+
+/* This is separate from memory.h so that it can be included by headers
+ * that are used before the SNMP headers, which redefine FREE. */
+
+/* Fixed size object cache. Objects are carved out of chunks which are
+ * only returned to the heap when the slab is destroyed, so frequently
+ * allocated objects don't fragment the heap. A slab must only be used
+ * by one thread. */
+typedef struct _mem_slab {
+	const char		*name;
+	size_t			obj_size;
+	unsigned		objs_per_chunk;
+	void			*free_objs;	/* Linked through the first word of each object */
+	void			*chunks;	/* Linked through the first word of each chunk */
+	unsigned long		num_chunks;
+	unsigned long		live;
+	unsigned long		peak;
+	unsigned long		total;
+	struct _mem_slab	*next;		/* Registered slabs, for dumping */
+	struct _mem_slab	*prev;
+} mem_slab_t;
+
+#endif
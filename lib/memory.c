@@ -720,3 +720,154 @@ update_mem_check_log_perms(mode_t umask_bits)
 		fchmod(fileno(log_op), (S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH) & ~umask_bits);
 }
 #endif
+
+/*
+ * Slab allocator for fixed size objects
+ */
+#define MEM_SLAB_CHUNK_SIZE	16384
+#define MEM_SLAB_MIN_OBJS	8
+#define MEM_SLAB_ALIGN		(2 * sizeof(void *))
+
+/* All initialised slabs, for dump_mem_slabs() */
+static mem_slab_t *mem_slabs;
+
+void
+mem_slab_init(mem_slab_t *slab, const char *name, size_t size)
+{
+	slab->name = name;
+	slab->obj_size = (size + MEM_SLAB_ALIGN - 1) & ~(MEM_SLAB_ALIGN - 1);
+	slab->objs_per_chunk = (unsigned)((MEM_SLAB_CHUNK_SIZE - MEM_SLAB_ALIGN) / slab->obj_size);
+	if (slab->objs_per_chunk < MEM_SLAB_MIN_OBJS)
+		slab->objs_per_chunk = MEM_SLAB_MIN_OBJS;
+	slab->free_objs = NULL;
+	slab->chunks = NULL;
+	slab->num_chunks = 0;
+	slab->live = 0;
+	slab->peak = 0;
+	slab->total = 0;
+
+	slab->prev = NULL;
+	slab->next = mem_slabs;
+	if (mem_slabs)
+		mem_slabs->prev = slab;
+	mem_slabs = slab;
+}
+
+/* The chunks are only freed if all the objects have been returned */
+void
+mem_slab_destroy(mem_slab_t *slab)
+{
+	void *chunk;
+
+	if (!slab->name)
+		return;
+
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		mem_slabs = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+
+	if (slab->live)
+		log_message(LOG_INFO, "slab %s destroyed with %lu objects in use", slab->name, slab->live);
+	else {
+		while ((chunk = slab->chunks)) {
+			slab->chunks = *(void **)chunk;
+			free(chunk);
+		}
+	}
+
+	slab->name = NULL;
+	slab->free_objs = NULL;
+	slab->chunks = NULL;
+}
+
+static inline void
+mem_slab_count_alloc(mem_slab_t *slab)
+{
+	slab->total++;
+	if (++slab->live > slab->peak)
+		slab->peak = slab->live;
+}
+
+#ifdef _MEM_CHECK_
+void *
+keepalived_slab_alloc(mem_slab_t *slab, const char *file, const char *function, int line)
+{
+	mem_slab_count_alloc(slab);
+
+	return keepalived_malloc_common(slab->obj_size, file, function, line, "slab");
+}
+
+void
+keepalived_slab_free(mem_slab_t *slab, void *obj, const char *file, const char *function, int line)
+{
+	if (obj)
+		slab->live--;
+
+	keepalived_free_realloc_common(obj, 0, file, function, line, false);
+}
+#else
+static void
+mem_slab_grow(mem_slab_t *slab)
+{
+	char *chunk, *obj;
+	unsigned i;
+
+	chunk = xalloc(MEM_SLAB_ALIGN + slab->objs_per_chunk * slab->obj_size);
+	*(void **)chunk = slab->chunks;
+	slab->chunks = chunk;
+	slab->num_chunks++;
+
+	/* Link the objects so that they are handed out in address order */
+	for (i = slab->objs_per_chunk; i > 0; i--) {
+		obj = chunk + MEM_SLAB_ALIGN + (i - 1) * slab->obj_size;
+		*(void **)obj = slab->free_objs;
+		slab->free_objs = obj;
+	}
+}
+
+void *
+slab_alloc(mem_slab_t *slab)
+{
+	void *obj;
+
+	if (!slab->free_objs)
+		mem_slab_grow(slab);
+
+	obj = slab->free_objs;
+	slab->free_objs = *(void **)obj;
+	memset(obj, 0, slab->obj_size);
+
+	mem_slab_count_alloc(slab);
+
+	return obj;
+}
+
+void
+slab_free(mem_slab_t *slab, void *obj)
+{
+	if (!obj)
+		return;
+
+	*(void **)obj = slab->free_objs;
+	slab->free_objs = obj;
+	slab->live--;
+}
+#endif
+
+void
+dump_mem_slabs(FILE *fp)
+{
+	const mem_slab_t *slab;
+
+	if (!mem_slabs)
+		return;
+
+	conf_write(fp, "------< Memory slabs >------");
+	for (slab = mem_slabs; slab; slab = slab->next)
+		conf_write(fp, " %s: object size %zu, %lu chunks of %u objects, live = %lu, peak = %lu, total = %lu",
+			   slab->name, slab->obj_size, slab->num_chunks, slab->objs_per_chunk,
+			   slab->live, slab->peak, slab->total);
+}
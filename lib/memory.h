@@ -35,6 +35,9 @@
 #include <stdlib.h>
 #endif
 #include <stdbool.h>
+#include <stdio.h>
+
+#include "mem_slab.h"
 
 /* Local defines */
 #ifdef _MEM_CHECK_
@@ -77,6 +80,20 @@ extern void skip_mem_dump(void);
 extern void enable_mem_log_termination(void);
 
 extern void update_mem_check_log_perms(mode_t);
+
+/* With memory checking, slab objects are allocated individually so that
+ * each one is tracked, but the slab counters are still maintained */
+#define SLAB_ALLOC(s)	( keepalived_slab_alloc((s), \
+		      (__FILE__), (__func__), (__LINE__)) )
+#define SLAB_FREE(s,p)	( keepalived_slab_free((s), (p), \
+		      (__FILE__), (__func__), (__LINE__)), \
+		       (p) = NULL )
+#define SLAB_FREE_ONLY(s,p) ( keepalived_slab_free((s), (p), \
+		      (__FILE__), (__func__), (__LINE__)))
+
+extern void *keepalived_slab_alloc(mem_slab_t *, const char *, const char *, int)
+		__attribute__((malloc));
+extern void keepalived_slab_free(mem_slab_t *, void *, const char *, const char *, int);
 #else
 
 extern void *zalloc(unsigned long size);
@@ -88,6 +105,12 @@ extern void *zalloc(unsigned long size);
 #define STRDUP(p)    (strdup(p))
 #define STRNDUP(p,n) (strndup((p),(n)))
 
+#define SLAB_ALLOC(s)	(slab_alloc(s))
+#define SLAB_FREE(s,p)	(slab_free((s), (p)), (p) = NULL)
+#define SLAB_FREE_ONLY(s,p) (slab_free((s), (p)))
+
+extern void *slab_alloc(mem_slab_t *) __attribute__((malloc));
+extern void slab_free(mem_slab_t *, void *);
 #endif
 
 /* Common defines */
@@ -103,4 +126,8 @@ typedef union _ptr_hack {
 #define PMALLOC(p)	{ p = MALLOC(sizeof(*p)); }
 #define FREE_PTR(p)	{ if (p) { FREE(p);} }
 #define FREE_CONST_PTR(p) { if (p) { FREE_CONST(p);} }
+
+extern void mem_slab_init(mem_slab_t *, const char *, size_t);
+extern void mem_slab_destroy(mem_slab_t *);
+extern void dump_mem_slabs(FILE *);
 #endif
@@ -43,6 +43,7 @@
 #include "parser.h"
 #include "keepalived_magic.h"
 #include "scheduler.h"
+#include "script_runner.h"
 
 
 /* Default user/group for script execution */
@@ -356,12 +357,14 @@ system_call(const notify_script_t* script)
 	exit(0);
 }
 
-/* Execute external script/program */
+/* Fork a child to run a script. If func is set, it is run when the
+ * script terminates or the timer expires. */
 int
-notify_exec(const notify_script_t *script)
+fork_script(thread_master_t *m, thread_func_t func, void *arg, unsigned long timer, const notify_script_t *script)
 {
 	pid_t pid;
 
+	/* Daemonization to not degrade our scheduling timer */
 #ifdef ENABLE_LOG_TO_FILE
 	if (log_file_name)
 		flush_log_file();
@@ -377,66 +380,60 @@ notify_exec(const notify_script_t *script)
 
 	if (pid) {
 		/* parent process */
+		if (func) {
+			thread_add_child(m, func, arg, pid, timer);
+#ifdef _SCRIPT_DEBUG_
+			if (do_script_debug)
+				log_message(LOG_INFO, "Running script with pid %d, timer %lu.%6.6lu", pid, timer / TIMER_HZ, timer % TIMER_HZ);
+#endif
+		}
 		return 0;
 	}
 
+	/* Child process */
 #ifdef _MEM_CHECK_
 	skip_mem_dump();
 #endif
 
 	system_call(script);
 
-	/* We should never get here */
-	exit(0);
+	exit(0); /* Script errors aren't server errors */
 }
 
+/* Execute external script/program */
 int
-system_call_script(thread_master_t *m, int (*func) (thread_ref_t), void * arg, unsigned long timer, notify_script_t* script)
+notify_exec(const notify_script_t *script)
 {
-	pid_t pid;
-
-	/* Daemonization to not degrade our scheduling timer */
-#ifdef ENABLE_LOG_TO_FILE
-	if (log_file_name)
-		flush_log_file();
-#endif
-
-	pid = local_fork();
-
-	if (pid < 0) {
-		/* fork error */
-		log_message(LOG_INFO, "Failed fork process");
-		return -1;
-	}
-
-	if (pid) {
-		/* parent process */
-		thread_add_child(m, func, arg, pid, timer);
-#ifdef _SCRIPT_DEBUG_
-		if (do_script_debug)
-			log_message(LOG_INFO, "Running script with pid %d, timer %lu.%6.6lu", pid, timer / TIMER_HZ, timer % TIMER_HZ);
-#endif
+	/* The runner reaps the script, we don't need its exit status */
+	if (script_runner_active() &&
+	    script_runner_run(master, NULL, NULL, 0, script))
 		return 0;
-	}
 
-	/* Child process */
-#ifdef _MEM_CHECK_
-	skip_mem_dump();
-#endif
+	return fork_script(master, NULL, NULL, 0, script);
+}
 
-	system_call(script);
+int
+system_call_script(thread_master_t *m, int (*func) (thread_ref_t), void * arg, unsigned long timer, notify_script_t* script)
+{
+	/* The runner can only be used from the main thread */
+	if (m == master && script_runner_active() &&
+	    script_runner_run(m, func, arg, timer, script))
+		return 0;
 
-	exit(0); /* Script errors aren't server errors */
+	return fork_script(m, func, arg, timer, script);
 }
 
 int
 child_killed_thread(thread_ref_t thread)
 {
 	thread_master_t *m = thread->master;
+	pid_t pgid;
 
-	/* If the child didn't die, then force it */
-	if (thread->type == THREAD_CHILD_TIMEOUT)
-		kill(-getpgid(thread->u.c.pid), SIGKILL);
+	/* If the child didn't die, then force it. If getpgid() fails the
+	 * child has gone, and kill(1, ...) must not be called. */
+	if (thread->type == THREAD_CHILD_TIMEOUT &&
+	    (pgid = getpgid(thread->u.c.pid)) != -1)
+		kill(-pgid, SIGKILL);
 
 	/* If all children have died, we can now complete the
 	 * termination process */
@@ -446,11 +443,35 @@ child_killed_thread(thread_ref_t thread)
 	return 0;
 }
 
+/* Signal the script a child thread is waiting for, and its children */
+static void
+script_kill_pgid(thread_ref_t thread, pid_t p_pgid, int signo)
+{
+	pid_t c_pgid;
+
+	/* The child has already terminated */
+	if ((c_pgid = getpgid(thread->u.c.pid)) == -1)
+		return;
+
+	if (c_pgid != p_pgid)
+		kill(-c_pgid, signo);
+	else {
+		log_message(LOG_INFO, "Child process %d in our process group %d", c_pgid, p_pgid);
+		kill(thread->u.c.pid, signo);
+	}
+}
+
+void
+script_kill(thread_ref_t thread, int signo)
+{
+	script_kill_pgid(thread, getpgid(0), signo);
+}
+
 void
 script_killall(thread_master_t *m, int signo, bool requeue)
 {
 	thread_t *thread;
-	pid_t p_pgid, c_pgid;
+	pid_t p_pgid;
 #ifndef HAVE_SIGNALFD
 	sigset_t old_set, child_wait;
 
@@ -464,15 +485,8 @@ script_killall(thread_master_t *m, int signo, bool requeue)
 
 	p_pgid = getpgid(0);
 
-	rb_for_each_entry_cached(thread, &m->child, n) {
-		c_pgid = getpgid(thread->u.c.pid);
-		if (c_pgid != p_pgid)
-			kill(-c_pgid, signo);
-		else {
-			log_message(LOG_INFO, "Child process %d in our process group %d", c_pgid, p_pgid);
-			kill(thread->u.c.pid, signo);
-		}
-	}
+	rb_for_each_entry_cached(thread, &m->child, n)
+		script_kill_pgid(thread, p_pgid, signo);
 
 	/* We want to timeout the killed children in 1 second */
 	if (requeue && signo != SIGKILL)
@@ -1232,5 +1246,6 @@ void
 register_notify_addresses(void)
 {
 	register_thread_address("child_killed_thread", child_killed_thread);
+	register_script_runner_addresses();
 }
 #endif
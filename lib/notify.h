@@ -96,9 +96,11 @@ extern const char *cmd_str_r(const notify_script_t *, char *, size_t);
 extern const char *cmd_str(const notify_script_t *);
 extern void notify_fifo_open(notify_fifo_t*, notify_fifo_t*, int (*)(thread_ref_t), const char *);
 extern void notify_fifo_close(notify_fifo_t*, notify_fifo_t*);
+extern int fork_script(thread_master_t *, thread_func_t, void *, unsigned long, const notify_script_t *);
 extern int system_call_script(thread_master_t *, int (*)(thread_ref_t), void *, unsigned long, notify_script_t *);
 extern int notify_exec(const notify_script_t *);
 extern int child_killed_thread(thread_ref_t);
+extern void script_kill(thread_ref_t, int);
 extern void script_killall(thread_master_t *, int, bool);
 extern unsigned check_script_secure(notify_script_t *, magic_t);
 extern unsigned check_notify_script_secure(notify_script_t **, magic_t);
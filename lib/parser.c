@@ -41,6 +41,10 @@
 #include <stdarg.h>
 #include <math.h>
 #include <inttypes.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#include <sys/uio.h>
+#endif
 
 #include "parser.h"
 #include "memory.h"
@@ -51,6 +55,7 @@
 #include "list.h"
 #include "bitops.h"
 #include "utils.h"
+#include "jhash.h"
 
 
 #define DEF_LINE_END	"\n"
@@ -85,6 +90,34 @@ typedef struct _seq {
 	const char *text;
 } seq_t;
 
+#ifdef _CONFIG_SNAPSHOT_
+/* The configuration snapshot is written by the parent process after it has
+ * read the configuration, and is read by the child processes instead of the
+ * configuration files. It holds every line returned by read_line(), i.e. after
+ * includes, definitions, ~SEQs and @config_id have been processed, together
+ * with the file name, line number and working directory the line was read
+ * with. All references are offsets into the string table, so the snapshot
+ * can be read at any address. */
+#define CONFIG_SNAPSHOT_MAGIC	0x4b41434eU	/* "KACN" */
+#define CONFIG_SNAPSHOT_VERSION	1
+#define CONFIG_SNAPSHOT_NO_STR	UINT32_MAX
+
+typedef struct _config_snapshot_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_lines;
+	uint32_t strtab_len;
+	uint64_t size;
+} config_snapshot_hdr_t;
+
+typedef struct _config_snapshot_line {
+	uint32_t file;		/* Only set if the file name is to be reported */
+	uint32_t dir;
+	uint32_t line_no;
+	uint32_t text;
+} config_snapshot_line_t;
+#endif
+
 
 /* global vars */
 vector_t *keywords;
@@ -99,6 +132,8 @@ bool do_dump_keywords;
 
 /* local vars */
 static vector_t *current_keywords;
+static keyword_hash_t *keywords_hash;
+static keyword_hash_t *current_keywords_hash;
 static FILE *current_stream;
 static const char *current_file_name;
 static size_t current_file_line_no;
@@ -115,6 +150,31 @@ static list seq_list;	/* List of seq_t */
 /* Parameter definitions */
 static list defs;
 
+#ifdef _CONFIG_SNAPSHOT_
+static int config_snapshot_fd = -1;
+
+/* Used by the parent when recording the snapshot */
+static bool snapshot_recording;
+static bool snapshot_dir_changed;
+static config_snapshot_line_t *snapshot_lines;
+static uint32_t snapshot_num_lines;
+static uint32_t snapshot_max_lines;
+static char *snapshot_strtab;
+static uint32_t snapshot_strtab_len;
+static uint32_t snapshot_strtab_size;
+static uint32_t snapshot_file = CONFIG_SNAPSHOT_NO_STR;
+static uint32_t snapshot_dir = CONFIG_SNAPSHOT_NO_STR;
+
+/* Used by the children when reading the snapshot */
+static bool snapshot_replay;
+static char *replay_buf;
+static const config_snapshot_line_t *replay_lines;
+static const char *replay_strtab;
+static uint32_t replay_num_lines;
+static uint32_t replay_next_line;
+static uint32_t replay_dir;
+#endif
+
 /* Forward declarations for recursion */
 static bool read_line(char *, size_t);
 static bool replace_param(char *, size_t, char const **);
@@ -515,6 +575,68 @@ dump_keywords(vector_t *keydump, int level, FILE *fp)
 }
 #endif
 
+/* jhash() of a string. This is the only caller of jhash(), so that
+ * it can be inlined. */
+static uint32_t __attribute__ ((noinline))
+string_jhash(const char *str, uint32_t initval)
+{
+	return jhash(str, strlen(str), initval);
+}
+
+/* Each level of keywords is put in a hash table with open addressing, so that
+ * process_stream() doesn't have to compare the line with every keyword.
+ * keyword_hash_slot() returns the slot of the keyword, or the empty slot
+ * where it would be added. */
+static unsigned int
+keyword_hash_slot(const keyword_hash_t *hash, const char *str)
+{
+	unsigned int slot;
+
+	for (slot = string_jhash(str, 0) & hash->mask;
+	     hash->slot[slot];
+	     slot = (slot + 1) & hash->mask) {
+		if (!strcmp(hash->slot[slot]->string, str))
+			break;
+	}
+
+	return slot;
+}
+
+static keyword_hash_t *
+alloc_keyword_hash(vector_t *keywords_vec)
+{
+	keyword_hash_t *hash;
+	keyword_t *keyword_vec;
+	unsigned int size = 4;
+	unsigned int i, slot;
+
+	while (size < vector_size(keywords_vec) * 2)
+		size <<= 1;
+
+	hash = MALLOC(sizeof(*hash) + size * sizeof(hash->slot[0]));
+	hash->mask = size - 1;
+
+	for (i = 0; i < vector_size(keywords_vec); i++) {
+		keyword_vec = vector_slot(keywords_vec, i);
+
+		/* If a keyword is installed more than once, the first one is used */
+		slot = keyword_hash_slot(hash, keyword_vec->string);
+		if (!hash->slot[slot])
+			hash->slot[slot] = keyword_vec;
+
+		if (keyword_vec->sub)
+			keyword_vec->sub_hash = alloc_keyword_hash(keyword_vec->sub);
+	}
+
+	return hash;
+}
+
+static inline keyword_t *
+find_keyword(const keyword_hash_t *hash, const char *str)
+{
+	return hash->slot[keyword_hash_slot(hash, str)];
+}
+
 static void
 free_keywords(vector_t *keywords_vec)
 {
@@ -525,6 +647,7 @@ free_keywords(vector_t *keywords_vec)
 		keyword_vec = vector_slot(keywords_vec, i);
 		if (keyword_vec->sub)
 			free_keywords(keyword_vec->sub);
+		FREE_PTR(keyword_vec->sub_hash);
 		FREE(keyword_vec);
 	}
 	vector_free(keywords_vec);
@@ -955,9 +1078,24 @@ dump_definitions(void)
 /* recursive configuration stream handler */
 static int kw_level;
 static int block_depth;
+static uint32_t config_block_hash;
+
+/* The lines of each root level block are hashed, so that on a reload it
+ * can be seen which blocks have changed */
+static void
+hash_config_line(const char *buf)
+{
+	config_block_hash = string_jhash(buf, config_block_hash);
+}
+
+uint32_t
+get_config_block_hash(void)
+{
+	return config_block_hash;
+}
 
 static bool
-process_stream(vector_t *keywords_vec, int need_bob)
+process_stream(vector_t *keywords_vec, keyword_hash_t *hash, int need_bob)
 {
 	unsigned int i;
 	keyword_t *keyword_vec;
@@ -965,13 +1103,19 @@ process_stream(vector_t *keywords_vec, int need_bob)
 	char *buf;
 	vector_t *strvec;
 	vector_t *prev_keywords = current_keywords;
+	keyword_hash_t *prev_keywords_hash = current_keywords_hash;
 	current_keywords = keywords_vec;
+	current_keywords_hash = hash;
 	int bob_needed = 0;
 	bool ret_err = false;
 	bool ret;
 
 	buf = MALLOC(MAXBUF);
 	while (read_line(buf, MAXBUF)) {
+		if (!kw_level)
+			config_block_hash = 0;
+		hash_config_line(buf);
+
 		strvec = alloc_strvec(buf);
 
 		if (!strvec)
@@ -1036,64 +1180,59 @@ process_stream(vector_t *keywords_vec, int need_bob)
 			break;
 		}
 
-		for (i = 0; i < vector_size(keywords_vec); i++) {
-			keyword_vec = vector_slot(keywords_vec, i);
-
-			if (!strcmp(keyword_vec->string, str)) {
-				if (!keyword_vec->active) {
-					if (!strcmp(vector_slot(strvec, vector_size(strvec)-1), BOB))
-						skip_sublevel = 1;
-					else
-						skip_sublevel = -1;
-
-					/* Sometimes a process wants to know if another process
-					 * has any of a type of configuration. For example, there
-					 * is no point starting the VRRP process of there are no
-					 * vrrp instances, and so the parent process would be
-					 * interested in that. */
-					if (keyword_vec->handler)
-						(*keyword_vec->handler)(NULL);
-				}
+		if ((keyword_vec = find_keyword(hash, str))) {
+			if (!keyword_vec->active) {
+				if (!strcmp(vector_slot(strvec, vector_size(strvec)-1), BOB))
+					skip_sublevel = 1;
+				else
+					skip_sublevel = -1;
+
+				/* Sometimes a process wants to know if another process
+				 * has any of a type of configuration. For example, there
+				 * is no point starting the VRRP process of there are no
+				 * vrrp instances, and so the parent process would be
+				 * interested in that. */
+				if (keyword_vec->handler)
+					(*keyword_vec->handler)(NULL);
+			}
 
-				/* There is an inconsistency here. 'static_ipaddress' for example
-				 * does not have sub levels, but needs a '{' */
-				if (keyword_vec->sub) {
-					/* Remove a trailing '{' */
-					char *bob = vector_slot(strvec, vector_size(strvec)-1) ;
-					if (!strcmp(bob, BOB)) {
-						vector_unset(strvec, vector_size(strvec)-1);
-						FREE(bob);
-						bob_needed = 0;
-					}
-					else
-						bob_needed = 1;
+			/* There is an inconsistency here. 'static_ipaddress' for example
+			 * does not have sub levels, but needs a '{' */
+			if (keyword_vec->sub) {
+				/* Remove a trailing '{' */
+				char *bob = vector_slot(strvec, vector_size(strvec)-1) ;
+				if (!strcmp(bob, BOB)) {
+					vector_unset(strvec, vector_size(strvec)-1);
+					FREE(bob);
+					bob_needed = 0;
 				}
+				else
+					bob_needed = 1;
+			}
 
-				if (keyword_vec->active && keyword_vec->handler) {
-					buf_extern = buf;	/* In case the raw line wants to be accessed */
-					(*keyword_vec->handler) (strvec);
-				}
+			if (keyword_vec->active && keyword_vec->handler) {
+				buf_extern = buf;	/* In case the raw line wants to be accessed */
+				(*keyword_vec->handler) (strvec);
+			}
 
-				if (keyword_vec->sub) {
-					kw_level++;
-					ret = process_stream(keyword_vec->sub, bob_needed);
-					kw_level--;
+			if (keyword_vec->sub) {
+				kw_level++;
+				ret = process_stream(keyword_vec->sub, keyword_vec->sub_hash, bob_needed);
+				kw_level--;
 
-					/* We mustn't run any close handler if the block was skipped */
-					if (!ret && keyword_vec->active && keyword_vec->sub_close_handler)
-						(*keyword_vec->sub_close_handler) ();
-				}
-				break;
+				/* We mustn't run any close handler if the block was skipped */
+				if (!ret && keyword_vec->active && keyword_vec->sub_close_handler)
+					(*keyword_vec->sub_close_handler) ();
 			}
 		}
-
-		if (i >= vector_size(keywords_vec))
+		else
 			report_config_error(CONFIG_UNKNOWN_KEYWORD, "Unknown keyword '%s'", str);
 
 		free_strvec(strvec);
 	}
 
 	current_keywords = prev_keywords;
+	current_keywords_hash = prev_keywords_hash;
 	FREE(buf);
 	return ret_err;
 }
@@ -1174,7 +1313,10 @@ read_conf_file(const char *conf_file)
 			free(confpath);
 		}
 
-		process_stream(current_keywords, 0);
+#ifdef _CONFIG_SNAPSHOT_
+		snapshot_dir_changed = true;
+#endif
+		process_stream(current_keywords, current_keywords_hash, 0);
 		fclose(stream);
 
 		free_list(&seq_list);
@@ -1187,6 +1329,9 @@ read_conf_file(const char *conf_file)
 			if (res)
 				return true;
 		}
+#ifdef _CONFIG_SNAPSHOT_
+		snapshot_dir_changed = true;
+#endif
 	}
 
 	globfree(&globbuf);
@@ -1662,6 +1807,269 @@ free_parser_data(void)
 		free_list(&multiline_stack);
 }
 
+#ifdef _CONFIG_SNAPSHOT_
+void
+open_config_snapshot(void)
+{
+	if (config_snapshot_fd != -1)
+		return;
+
+	config_snapshot_fd = memfd_create("keepalived_config", MFD_CLOEXEC);
+	if (config_snapshot_fd == -1)
+		log_message(LOG_INFO, "Unable to create configuration snapshot (%d) - %m", errno);
+}
+
+static void
+snapshot_start_recording(void)
+{
+	snapshot_max_lines = 1024;
+	snapshot_lines = MALLOC(snapshot_max_lines * sizeof(*snapshot_lines));
+	snapshot_num_lines = 0;
+	snapshot_strtab_size = 64 * 1024;
+	snapshot_strtab = MALLOC(snapshot_strtab_size);
+	snapshot_strtab_len = 0;
+	snapshot_file = CONFIG_SNAPSHOT_NO_STR;
+	snapshot_dir = CONFIG_SNAPSHOT_NO_STR;
+	snapshot_dir_changed = true;
+	snapshot_recording = true;
+}
+
+static void
+snapshot_stop_recording(void)
+{
+	FREE_PTR(snapshot_lines);
+	FREE_PTR(snapshot_strtab);
+	snapshot_recording = false;
+}
+
+static uint32_t
+snapshot_add_str(const char *str)
+{
+	size_t len = strlen(str) + 1;
+	uint32_t ofs;
+
+	if (snapshot_strtab_len + len > snapshot_strtab_size) {
+		if (snapshot_strtab_size >= UINT32_MAX / 4) {
+			log_message(LOG_INFO, "Configuration too large for snapshot");
+			snapshot_stop_recording();
+			return CONFIG_SNAPSHOT_NO_STR;
+		}
+
+		do {
+			snapshot_strtab_size *= 2;
+		} while (snapshot_strtab_len + len > snapshot_strtab_size);
+		snapshot_strtab = REALLOC(snapshot_strtab, snapshot_strtab_size);
+	}
+
+	ofs = snapshot_strtab_len;
+	memcpy(snapshot_strtab + ofs, str, len);
+	snapshot_strtab_len += len;
+
+	return ofs;
+}
+
+static void
+snapshot_record_line(const char *buf)
+{
+	config_snapshot_line_t *line;
+	char *cwd;
+
+	/* The working directory only changes when a file is opened or closed */
+	if (snapshot_dir_changed) {
+		snapshot_dir_changed = false;
+		if ((cwd = getcwd(NULL, 0))) {
+			if (snapshot_dir == CONFIG_SNAPSHOT_NO_STR ||
+			    strcmp(snapshot_strtab + snapshot_dir, cwd))
+				snapshot_dir = snapshot_add_str(cwd);
+			free(cwd);
+		} else
+			snapshot_dir = CONFIG_SNAPSHOT_NO_STR;
+
+		if (!snapshot_recording)
+			return;
+	}
+
+	if (!current_file_name)
+		snapshot_file = CONFIG_SNAPSHOT_NO_STR;
+	else if (snapshot_file == CONFIG_SNAPSHOT_NO_STR ||
+		 strcmp(snapshot_strtab + snapshot_file, current_file_name)) {
+		snapshot_file = snapshot_add_str(current_file_name);
+		if (!snapshot_recording)
+			return;
+	}
+
+	if (snapshot_num_lines == snapshot_max_lines) {
+		snapshot_max_lines *= 2;
+		snapshot_lines = REALLOC(snapshot_lines, snapshot_max_lines * sizeof(*snapshot_lines));
+	}
+
+	line = &snapshot_lines[snapshot_num_lines];
+	line->text = snapshot_add_str(buf);
+	if (!snapshot_recording)
+		return;
+	line->file = snapshot_file;
+	line->dir = snapshot_dir;
+	line->line_no = (uint32_t)current_file_line_no;
+	snapshot_num_lines++;
+}
+
+/* Write the recorded snapshot. If anything goes wrong the snapshot is left
+ * empty, and the children will read the configuration files themselves. */
+static void
+snapshot_write(bool complete)
+{
+	config_snapshot_hdr_t hdr;
+	struct iovec iov[3];
+	ssize_t len;
+
+	if (ftruncate(config_snapshot_fd, 0) == -1) {
+		log_message(LOG_INFO, "Unable to truncate configuration snapshot (%d) - %m", errno);
+		return;
+	}
+
+	if (!complete)
+		return;
+
+	hdr.magic = CONFIG_SNAPSHOT_MAGIC;
+	hdr.version = CONFIG_SNAPSHOT_VERSION;
+	hdr.num_lines = snapshot_num_lines;
+	hdr.strtab_len = snapshot_strtab_len;
+	hdr.size = sizeof(hdr) + snapshot_num_lines * sizeof(*snapshot_lines) + snapshot_strtab_len;
+
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = snapshot_lines;
+	iov[1].iov_len = snapshot_num_lines * sizeof(*snapshot_lines);
+	iov[2].iov_base = snapshot_strtab;
+	iov[2].iov_len = snapshot_strtab_len;
+
+	len = pwritev(config_snapshot_fd, iov, 3, 0);
+	if (len != (ssize_t)hdr.size) {
+		log_message(LOG_INFO, "Unable to write configuration snapshot (%d) - %m", errno);
+		if (ftruncate(config_snapshot_fd, 0)) {
+			/* We don't care */
+		}
+	}
+}
+
+static bool
+snapshot_load(void)
+{
+	config_snapshot_hdr_t hdr;
+	struct stat stb;
+	uint32_t i;
+	const config_snapshot_line_t *line;
+
+	if (fstat(config_snapshot_fd, &stb) ||
+	    (size_t)stb.st_size < sizeof(hdr))
+		return false;
+
+	if (pread(config_snapshot_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	    hdr.magic != CONFIG_SNAPSHOT_MAGIC ||
+	    hdr.version != CONFIG_SNAPSHOT_VERSION ||
+	    hdr.size != (uint64_t)stb.st_size ||
+	    hdr.size != sizeof(hdr) + (uint64_t)hdr.num_lines * sizeof(*replay_lines) + hdr.strtab_len ||
+	    !hdr.strtab_len) {
+		log_message(LOG_INFO, "Configuration snapshot is invalid - reading configuration files");
+		return false;
+	}
+
+	replay_buf = MALLOC(hdr.size);
+	if (pread(config_snapshot_fd, replay_buf, hdr.size, 0) != (ssize_t)hdr.size) {
+		log_message(LOG_INFO, "Unable to read configuration snapshot (%d) - %m", errno);
+		FREE_PTR(replay_buf);
+		return false;
+	}
+
+	replay_lines = (const void *)(replay_buf + sizeof(hdr));
+	replay_strtab = replay_buf + sizeof(hdr) + hdr.num_lines * sizeof(*replay_lines);
+	replay_num_lines = hdr.num_lines;
+
+	/* Make sure all the offsets are within a terminated string table, so that
+	 * the parent having been part way through writing a new snapshot cannot
+	 * cause us problems */
+	if (replay_strtab[hdr.strtab_len - 1] != '\0') {
+		log_message(LOG_INFO, "Configuration snapshot is corrupt - reading configuration files");
+		FREE_PTR(replay_buf);
+		return false;
+	}
+	for (i = 0, line = replay_lines; i < replay_num_lines; i++, line++) {
+		if (line->text >= hdr.strtab_len ||
+		    strlen(replay_strtab + line->text) >= MAXBUF ||
+		    (line->file != CONFIG_SNAPSHOT_NO_STR && line->file >= hdr.strtab_len) ||
+		    (line->dir != CONFIG_SNAPSHOT_NO_STR && line->dir >= hdr.strtab_len)) {
+			log_message(LOG_INFO, "Configuration snapshot is corrupt - reading configuration files");
+			FREE_PTR(replay_buf);
+			return false;
+		}
+	}
+
+	replay_next_line = 0;
+	replay_dir = CONFIG_SNAPSHOT_NO_STR;
+
+	log_message(LOG_INFO, "Reading configuration from snapshot (%" PRIu32 " lines).", replay_num_lines);
+
+	return true;
+}
+
+static bool
+snapshot_read_line(char *buf, size_t size)
+{
+	const config_snapshot_line_t *line;
+	size_t len;
+
+	if (replay_next_line >= replay_num_lines) {
+		buf[0] = '\0';
+		return false;
+	}
+
+	line = &replay_lines[replay_next_line++];
+
+	/* Handlers may resolve relative paths, so use the directory the line was read in */
+	if (line->dir != replay_dir && line->dir != CONFIG_SNAPSHOT_NO_STR) {
+		if (chdir(replay_strtab + line->dir) < 0)
+			log_message(LOG_INFO, "chdir(%s) error (%s)", replay_strtab + line->dir, strerror(errno));
+		replay_dir = line->dir;
+	}
+
+	current_file_name = line->file == CONFIG_SNAPSHOT_NO_STR ? NULL : replay_strtab + line->file;
+	current_file_line_no = line->line_no;
+
+	len = strlen(replay_strtab + line->text);
+	if (len >= size)
+		len = size - 1;
+	memcpy(buf, replay_strtab + line->text, len);
+	buf[len] = '\0';
+
+#ifdef _PARSER_DEBUG_
+	if (do_parser_debug)
+		log_message(LOG_INFO, "read_line(snapshot): '%s'", buf);
+#endif
+
+	return true;
+}
+
+static void
+read_conf_snapshot(void)
+{
+	int curdir_fd;
+
+	curdir_fd = open(".", O_RDONLY | O_DIRECTORY);
+
+	process_stream(current_keywords, current_keywords_hash, 0);
+
+	if (curdir_fd != -1) {
+		if (fchdir(curdir_fd))
+			log_message(LOG_INFO, "Failed to restore previous directory after reading snapshot");
+		close(curdir_fd);
+	}
+
+	current_file_name = NULL;
+	FREE_PTR(replay_buf);
+	snapshot_replay = false;
+}
+#endif
+
 /* decomment() removes comments, the escaping of comment start characters,
  * and leading and trailing whitespace, including whitespace before a
  * terminating \ character */
@@ -1738,6 +2146,11 @@ read_line(char *buf, size_t size)
 	size_t skip;
 	char *p;
 
+#ifdef _CONFIG_SNAPSHOT_
+	if (snapshot_replay)
+		return snapshot_read_line(buf, size);
+#endif
+
 	config_id_len = config_id ? strlen(config_id) : 0;
 	do {
 		if (line_residue) {
@@ -1982,6 +2395,11 @@ read_line(char *buf, size_t size)
 		log_message(LOG_INFO, "read_line(%d): '%s'", block_depth, buf);
 #endif
 
+#ifdef _CONFIG_SNAPSHOT_
+	if (snapshot_recording && !eof && buf[0])
+		snapshot_record_line(buf);
+#endif
+
 	return !eof;
 }
 
@@ -2016,8 +2434,11 @@ alloc_value_block(void (*alloc_func) (const vector_t *), const vector_t *strvec)
 	while (first_vec || read_line(buf, MAXBUF)) {
 		if (first_vec)
 			vec = first_vec;
-		else if (!(vec = alloc_strvec(buf)))
-			continue;
+		else {
+			hash_config_line(buf);
+			if (!(vec = alloc_strvec(buf)))
+				continue;
+		}
 
 		if (!first_vec) {
 			if (need_bob) {
@@ -2131,10 +2552,38 @@ void skip_block(bool need_block_start)
 		skip_sublevel = 1;
 }
 
+static const char *
+parse_process_name(void)
+{
+#ifndef _ONE_PROCESS_DEBUG_
+	switch (prog_type) {
+	case PROG_TYPE_PARENT:
+		return "parent";
+#ifdef _WITH_VRRP_
+	case PROG_TYPE_VRRP:
+		return "vrrp";
+#endif
+#ifdef _WITH_LVS_
+	case PROG_TYPE_CHECKER:
+		return "checker";
+#endif
+#ifdef _WITH_BFD_
+	case PROG_TYPE_BFD:
+		return "bfd";
+#endif
+	}
+#endif
+
+	return "main";
+}
+
 /* Data initialization */
 void
 init_data(const char *conf_file, const vector_t * (*init_keywords) (void))
 {
+	struct timespec parse_start, parse_end;
+	long parse_usecs;
+
 	/* A parent process or previous config load may have left these set */
 	block_depth = 0;
 	kw_level = 0;
@@ -2161,14 +2610,47 @@ init_data(const char *conf_file, const vector_t * (*init_keywords) (void))
 
 	/* Stream handling */
 	current_keywords = keywords;
+	keywords_hash = alloc_keyword_hash(keywords);
+	current_keywords_hash = keywords_hash;
 
 	current_file_name = NULL;
 	current_file_line_no = 0;
 
+	clock_gettime(CLOCK_MONOTONIC, &parse_start);
+
 	register_null_strvec_handler(null_strvec);
-	read_conf_file(conf_file);
+#ifdef _CONFIG_SNAPSHOT_
+	/* The parent records the configuration it reads, and the children then
+	 * use that rather than reading and expanding the files themselves */
+	if (config_snapshot_fd != -1) {
+		if (prog_type == PROG_TYPE_PARENT)
+			snapshot_start_recording();
+		else
+			snapshot_replay = snapshot_load();
+	}
+
+	if (snapshot_replay)
+		read_conf_snapshot();
+	else
+#endif
+		read_conf_file(conf_file);
 	unregister_null_strvec_handler();
 
+	if (__test_bit(CONFIG_TEST_BIT, &debug)) {
+		clock_gettime(CLOCK_MONOTONIC, &parse_end);
+		parse_usecs = (parse_end.tv_sec - parse_start.tv_sec) * 1000000L +
+			      (parse_end.tv_nsec - parse_start.tv_nsec) / 1000;
+		fprintf(stderr, "Configuration parsed by %s process in %ld.%06ld seconds\n",
+			parse_process_name(), parse_usecs / 1000000, parse_usecs % 1000000);
+	}
+
+#ifdef _CONFIG_SNAPSHOT_
+	if (config_snapshot_fd != -1 && prog_type == PROG_TYPE_PARENT) {
+		snapshot_write(snapshot_recording);
+		snapshot_stop_recording();
+	}
+#endif
+
 	/* Report if there are missing '}'s. If there are missing '{'s it will already have been reported */
 	if (block_depth > 0)
 		report_config_error(CONFIG_MISSING_EOB, "There are %d missing '%s's or extra '%s's", block_depth, EOB, BOB);
@@ -2181,6 +2663,8 @@ init_data(const char *conf_file, const vector_t * (*init_keywords) (void))
 	endpwent();
 
 	free_keywords(keywords);
+	FREE(keywords_hash);
+	current_keywords_hash = NULL;
 	free_parser_data();
 #ifdef _WITH_VRRP_
 	clear_rt_names();
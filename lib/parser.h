@@ -39,6 +39,11 @@
 /* Maximum config line length */
 #define MAXBUF	1024
 
+/* The parent process passes the expanded configuration to its children */
+#if defined HAVE_MEMFD_CREATE && !defined _ONE_PROCESS_DEBUG_
+#define _CONFIG_SNAPSHOT_
+#endif
+
 /* Maximum time read_timer can read - in micro-seconds */
 #define TIMER_MAXIMUM (ULONG_MAX)
 
@@ -72,10 +77,17 @@ typedef struct _keyword {
 	const char *string;
 	void (*handler) (const vector_t *);
 	vector_t *sub;
+	struct _keyword_hash *sub_hash;
 	void (*sub_close_handler) (void);
 	bool active;
 } keyword_t;
 
+/* Hash table of the keywords of one level, built once they are installed */
+typedef struct _keyword_hash {
+	unsigned mask;
+	keyword_t *slot[];
+} keyword_hash_t;
+
 /* global vars exported */
 extern vector_t *keywords;
 extern const char *config_id;
@@ -133,6 +145,10 @@ extern void alloc_value_block(void (*alloc_func) (const vector_t *), const vecto
 extern bool read_timer(const vector_t *, size_t, unsigned long *, unsigned long, unsigned long, bool);
 extern int check_true_false(const char *) __attribute__ ((pure));
 extern void skip_block(bool);
+extern uint32_t get_config_block_hash(void) __attribute__ ((pure));
 extern void init_data(const char *, const vector_t * (*init_keywords) (void));
+#ifdef _CONFIG_SNAPSHOT_
+extern void open_config_snapshot(void);
+#endif
 
 #endif
@@ -43,6 +43,7 @@
 #include <sys/utsname.h>
 #include <linux/version.h>
 #include <sched.h>
+#include <inttypes.h>
 
 #include "scheduler.h"
 #include "memory.h"
@@ -214,11 +215,244 @@ set_extra_threads_debug(void (*func)(void))
 }
 #endif
 
+/* Timer wheel helpers */
+#define TIMER_WHEEL_MASK	(TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_OVERFLOW	TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_NEVER	(TIMER_WHEEL_LEVELS + 1)
+
+static inline uint64_t
+timer_wheel_tick(const timeval_t *tv)
+{
+	return ((uint64_t)tv->tv_sec * TIMER_HZ + (uint64_t)tv->tv_usec) / TIMER_WHEEL_TICK;
+}
+
+void
+timer_wheel_init(timer_wheel_t *w, const timeval_t *now)
+{
+	unsigned level, slot;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+			INIT_LIST_HEAD(&w->slots[level][slot]);
+		w->count[level] = 0;
+	}
+	INIT_LIST_HEAD(&w->overflow);
+	INIT_LIST_HEAD(&w->never);
+	w->num_overflow = 0;
+	w->tick = timer_wheel_tick(now);
+	w->next_expiry_valid = false;
+}
+
+static void
+timer_wheel_insert(timer_wheel_t *w, thread_t *thread)
+{
+	uint64_t tick, diff;
+	unsigned level;
+
+	if (thread->sands.tv_sec == TIMER_DISABLED) {
+		thread->wheel_level = TIMER_WHEEL_NEVER;
+		list_add_tail(&thread->e_list, &w->never);
+		return;
+	}
+
+	/* Anything already due goes in the slot for the current tick */
+	tick = timer_wheel_tick(&thread->sands);
+	if (tick < w->tick)
+		tick = w->tick;
+
+	/* The level is the most significant group of bits in which the
+	 * expiry tick differs from the current tick */
+	diff = tick ^ w->tick;
+	if (diff >> (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) {
+		thread->wheel_level = TIMER_WHEEL_OVERFLOW;
+		list_add_tail(&thread->e_list, &w->overflow);
+		w->num_overflow++;
+		return;
+	}
+
+	for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+		if (diff >> (level * TIMER_WHEEL_BITS))
+			break;
+	}
+
+	thread->wheel_level = level;
+	list_add_tail(&thread->e_list, &w->slots[level][(tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK]);
+	w->count[level]++;
+}
+
+void
+timer_wheel_add(timer_wheel_t *w, thread_t *thread)
+{
+	timer_wheel_insert(w, thread);
+
+	if (w->next_expiry_valid &&
+	    thread->sands.tv_sec != TIMER_DISABLED &&
+	    timercmp(&thread->sands, &w->next_expiry, <))
+		w->next_expiry = thread->sands;
+}
+
+void
+timer_wheel_del(timer_wheel_t *w, thread_t *thread)
+{
+	list_head_del(&thread->e_list);
+
+	if (thread->wheel_level < TIMER_WHEEL_LEVELS)
+		w->count[thread->wheel_level]--;
+	else if (thread->wheel_level == TIMER_WHEEL_OVERFLOW)
+		w->num_overflow--;
+
+	if (w->next_expiry_valid &&
+	    timercmp(&thread->sands, &w->next_expiry, ==))
+		w->next_expiry_valid = false;
+}
+
+/* Redistribute the threads in a slot to lower levels */
+static void
+timer_wheel_cascade_slot(timer_wheel_t *w, list_head_t *slot, unsigned *count)
+{
+	thread_t *thread, *thread_tmp;
+	list_head_t l;
+
+	INIT_LIST_HEAD(&l);
+	list_splice_init(slot, &l);
+
+	list_for_each_entry_safe(thread, thread_tmp, &l, e_list) {
+		list_head_del(&thread->e_list);
+		(*count)--;
+		timer_wheel_insert(w, thread);
+	}
+}
+
+/* Called when the current tick has just reached a slot boundary */
+static void
+timer_wheel_cascade(timer_wheel_t *w)
+{
+	unsigned level;
+
+	for (level = 1; level <= TIMER_WHEEL_LEVELS; level++) {
+		if (w->tick & ((UINT64_C(1) << (level * TIMER_WHEEL_BITS)) - 1))
+			break;
+	}
+
+	if (level > TIMER_WHEEL_LEVELS)
+		timer_wheel_cascade_slot(w, &w->overflow, &w->num_overflow);
+
+	while (--level > 0) {
+		if (level < TIMER_WHEEL_LEVELS)
+			timer_wheel_cascade_slot(w, &w->slots[level][(w->tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK], &w->count[level]);
+	}
+}
+
+/* Move all threads due at or before now onto the expired list */
+void
+timer_wheel_expire(timer_wheel_t *w, const timeval_t *now, list_head_t *expired)
+{
+	uint64_t now_tick = timer_wheel_tick(now);
+	uint64_t next;
+	list_head_t *slot;
+	thread_t *thread, *thread_tmp;
+	unsigned level;
+
+	w->next_expiry_valid = false;
+
+	while (w->tick <= now_tick) {
+		slot = &w->slots[0][w->tick & TIMER_WHEEL_MASK];
+		list_for_each_entry_safe(thread, thread_tmp, slot, e_list) {
+			if (timercmp(&thread->sands, now, >))
+				continue;
+			list_head_del(&thread->e_list);
+			w->count[0]--;
+			list_add_tail(&thread->e_list, expired);
+		}
+
+		if (w->tick == now_tick)
+			break;
+
+		/* Skip directly to the next boundary of the lowest level
+		 * which has any threads queued */
+		for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+			if (w->count[level])
+				break;
+		}
+
+		if (level == TIMER_WHEEL_LEVELS && !w->num_overflow) {
+			w->tick = now_tick;
+			continue;
+		}
+
+		next = ((w->tick >> (level * TIMER_WHEEL_BITS)) + 1) << (level * TIMER_WHEEL_BITS);
+		if (next > now_tick) {
+			w->tick = now_tick;
+			continue;
+		}
+
+		w->tick = next;
+		if (!(w->tick & TIMER_WHEEL_MASK))
+			timer_wheel_cascade(w);
+	}
+}
+
+/* Returns false if there are no timers */
+bool
+timer_wheel_next_expiry(timer_wheel_t *w, timeval_t *expiry)
+{
+	thread_t *thread;
+	list_head_t *l = NULL;
+	unsigned level, slot;
+	bool found = false;
+
+	if (w->next_expiry_valid) {
+		*expiry = w->next_expiry;
+		return true;
+	}
+
+	/* The lowest non-empty slot of the lowest level holds the earliest timer */
+	for (level = 0; level < TIMER_WHEEL_LEVELS && !l; level++) {
+		if (!w->count[level])
+			continue;
+		slot = (w->tick >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+		for (; slot < TIMER_WHEEL_SLOTS; slot++) {
+			if (!list_empty(&w->slots[level][slot])) {
+				l = &w->slots[level][slot];
+				break;
+			}
+		}
+	}
+
+	if (!l && w->num_overflow)
+		l = &w->overflow;
+
+	if (!l)
+		return false;
+
+	list_for_each_entry(thread, l, e_list) {
+		if (!found || timercmp(&thread->sands, &w->next_expiry, <)) {
+			w->next_expiry = thread->sands;
+			found = true;
+		}
+	}
+
+	w->next_expiry_valid = true;
+	*expiry = w->next_expiry;
+
+	return true;
+}
+
+/* Remove a waiting thread from its queue */
+static inline void
+thread_queue_del(thread_master_t *m, rb_root_cached_t *root, thread_t *thread)
+{
+	if (m->timer_wheel && root != &m->child)
+		timer_wheel_del(m->timer_wheel, thread);
+	else
+		rb_erase_cached(&thread->n, root);
+}
+
 /* Move ready thread into ready queue */
 static int
 thread_move_ready(thread_master_t *m, rb_root_cached_t *root, thread_t *thread, int type)
 {
-	rb_erase_cached(&thread->n, root);
+	thread_queue_del(m, root, thread);
 	INIT_LIST_HEAD(&thread->e_list);
 	list_add_tail(&thread->e_list, &m->ready);
 	if (thread->type != THREAD_TIMER_SHUTDOWN)
@@ -272,9 +506,14 @@ thread_set_timer(thread_master_t *m)
 
 	/* Prepare timer */
 	timerclear(&timer_wait_time);
-	thread_update_timer(&m->timer, &timer_wait_time);
-	thread_update_timer(&m->write, &timer_wait_time);
-	thread_update_timer(&m->read, &timer_wait_time);
+	if (m->timer_wheel) {
+		if (!timer_wheel_next_expiry(m->timer_wheel, &timer_wait_time))
+			timerclear(&timer_wait_time);
+	} else {
+		thread_update_timer(&m->timer, &timer_wait_time);
+		thread_update_timer(&m->write, &timer_wait_time);
+		thread_update_timer(&m->read, &timer_wait_time);
+	}
 	thread_update_timer(&m->child, &timer_wait_time);
 
 	if (timerisset(&timer_wait_time)) {
@@ -318,6 +557,32 @@ thread_set_timer(thread_master_t *m)
 	return timer_wait_time;
 }
 
+static void
+thread_wheel_move_ready(thread_master_t *m)
+{
+	thread_t *thread, *thread_tmp;
+	list_head_t expired;
+
+	INIT_LIST_HEAD(&expired);
+	timer_wheel_expire(m->timer_wheel, &time_now, &expired);
+
+	list_for_each_entry_safe(thread, thread_tmp, &expired, e_list) {
+		list_head_del(&thread->e_list);
+
+		if (thread->type == THREAD_READ) {
+			thread->event->read = NULL;
+			thread->type = THREAD_READ_TIMEOUT;
+		} else if (thread->type == THREAD_WRITE) {
+			thread->event->write = NULL;
+			thread->type = THREAD_WRITE_TIMEOUT;
+		} else if (thread->type == THREAD_TIMER)
+			thread->type = THREAD_READY;
+
+		INIT_LIST_HEAD(&thread->e_list);
+		list_add_tail(&thread->e_list, &m->ready);
+	}
+}
+
 static int
 thread_timerfd_handler(thread_ref_t thread)
 {
@@ -330,9 +595,13 @@ thread_timerfd_handler(thread_ref_t thread)
 		log_message(LOG_ERR, "scheduler: Error reading on timerfd fd:%d (%m)", m->timer_fd);
 
 	/* Read, Write, Timer, Child thread. */
-	thread_rb_move_ready(m, &m->read, THREAD_READ_TIMEOUT);
-	thread_rb_move_ready(m, &m->write, THREAD_WRITE_TIMEOUT);
-	thread_rb_move_ready(m, &m->timer, THREAD_READY);
+	if (m->timer_wheel)
+		thread_wheel_move_ready(m);
+	else {
+		thread_rb_move_ready(m, &m->read, THREAD_READ_TIMEOUT);
+		thread_rb_move_ready(m, &m->write, THREAD_WRITE_TIMEOUT);
+		thread_rb_move_ready(m, &m->timer, THREAD_READY);
+	}
 	thread_rb_move_ready(m, &m->child, THREAD_CHILD_TIMEOUT);
 
 	/* Register next timerfd thread */
@@ -544,12 +813,12 @@ thread_event_new(thread_master_t *m, int fd)
 {
 	thread_event_t *event;
 
-	event = (thread_event_t *) MALLOC(sizeof(thread_event_t));
+	event = (thread_event_t *) SLAB_ALLOC(&m->event_slab);
 	if (!event)
 		return NULL;
 
 	if (thread_events_resize(m, 1) < 0) {
-		FREE(event);
+		SLAB_FREE(&m->event_slab, event);
 		return NULL;
 	}
 
@@ -622,7 +891,7 @@ thread_event_cancel(const thread_t *thread_cp)
 	rb_erase(&event->n, &m->io_events);
 	if (event == m->current_event)
 		m->current_event = NULL;
-	FREE(thread->event);
+	SLAB_FREE(&m->event_slab, thread->event);
 	return 0;
 }
 
@@ -658,8 +927,8 @@ thread_event_del(const thread_t *thread_cp, unsigned flag)
 }
 
 /* Make thread master. */
-thread_master_t *
-thread_make_master(void)
+static thread_master_t *
+thread_master_new(bool with_signals)
 {
 	thread_master_t *new;
 
@@ -693,7 +962,8 @@ thread_make_master(void)
 #endif
 	INIT_LIST_HEAD(&new->ready);
 	INIT_LIST_HEAD(&new->unuse);
-
+	mem_slab_init(&new->thread_slab, with_signals ? "thread" : "worker thread", sizeof(thread_t));
+	mem_slab_init(&new->event_slab, with_signals ? "thread_event" : "worker thread_event", sizeof(thread_event_t));
 
 	/* Register timerfd thread */
 	new->timer_fd = timerfd_create(CLOCK_MONOTONIC,
@@ -705,6 +975,8 @@ thread_make_master(void)
 										  );
 	if (new->timer_fd < 0) {
 		log_message(LOG_ERR, "scheduler: Cant create timerfd (%m)");
+		mem_slab_destroy(&new->thread_slab);
+		mem_slab_destroy(&new->event_slab);
 		FREE(new);
 		return NULL;
 	}
@@ -717,15 +989,31 @@ thread_make_master(void)
 		log_message(LOG_INFO, "Unable to set CLOEXEC on timer_fd - %d (%m)", errno);
 #endif
 
-	new->signal_fd = signal_handler_init();
+	new->signal_fd = with_signals ? signal_handler_init() : -1;
+	new->child_status_fd = -1;
 
 	new->timer_thread = thread_add_read(new, thread_timerfd_handler, NULL, new->timer_fd, TIMER_NEVER, false);
 
-	add_signal_read_thread(new);
+	if (with_signals)
+		add_signal_read_thread(new);
 
 	return new;
 }
 
+thread_master_t *
+thread_make_master(void)
+{
+	return thread_master_new(true);
+}
+
+/* A master for a thread other than the main thread, which must not
+ * handle signals */
+thread_master_t *
+thread_make_worker_master(void)
+{
+	return thread_master_new(false);
+}
+
 #ifdef THREAD_DUMP
 static const char *
 timer_delay(timeval_t sands)
@@ -784,6 +1072,28 @@ thread_list_dump(const list_head_t *l, const char *list_type, FILE *fp)
 	conf_write(fp, "----[ End list_dump ]----");
 }
 
+static void
+thread_wheel_dump(const timer_wheel_t *w, FILE *fp)
+{
+	char name[32];
+	unsigned level, slot;
+
+	conf_write(fp, "----[ Begin timer wheel dump, tick %" PRIu64 " ]----", w->tick);
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		if (!w->count[level])
+			continue;
+		for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+			if (list_empty(&w->slots[level][slot]))
+				continue;
+			snprintf(name, sizeof(name), "wheel %u/%u", level, slot);
+			thread_list_dump(&w->slots[level][slot], name, fp);
+		}
+	}
+	thread_list_dump(&w->overflow, "wheel overflow", fp);
+	thread_list_dump(&w->never, "wheel never", fp);
+	conf_write(fp, "----[ End timer wheel dump ]----");
+}
+
 static void
 event_rb_dump(const rb_root_t *root, const char *tree, FILE *fp)
 {
@@ -801,10 +1111,15 @@ event_rb_dump(const rb_root_t *root, const char *tree, FILE *fp)
 void
 dump_thread_data(const thread_master_t *m, FILE *fp)
 {
-	thread_rb_dump(&m->read, "read", fp);
-	thread_rb_dump(&m->write, "write", fp);
+	if (m->timer_wheel)
+		thread_wheel_dump(m->timer_wheel, fp);
+	else {
+		thread_rb_dump(&m->read, "read", fp);
+		thread_rb_dump(&m->write, "write", fp);
+	}
 	thread_rb_dump(&m->child, "child", fp);
-	thread_rb_dump(&m->timer, "timer", fp);
+	if (!m->timer_wheel)
+		thread_rb_dump(&m->timer, "timer", fp);
 	thread_list_dump(&m->event, "event", fp);
 	thread_list_dump(&m->ready, "ready", fp);
 #ifdef USE_SIGNAL_THREADS
@@ -818,6 +1133,97 @@ dump_thread_data(const thread_master_t *m, FILE *fp)
 /* declare thread_timer_cmp() for rbtree compares */
 RB_TIMER_CMP(thread);
 
+/* Add a waiting thread to its queue */
+static inline void
+thread_queue_add(thread_master_t *m, rb_root_cached_t *root, thread_t *thread)
+{
+	if (m->timer_wheel && root != &m->child)
+		timer_wheel_add(m->timer_wheel, thread);
+	else
+		rb_insert_sort_cached(root, thread, n, thread_timer_cmp);
+}
+
+/* Requeue a waiting thread with a new timeout. The thread must be removed
+ * from the timer wheel before its timeout is changed, so that the cached
+ * earliest timeout is invalidated if it was this thread's. */
+static inline void
+thread_queue_move(thread_master_t *m, rb_root_cached_t *root, thread_t *thread, const timeval_t *sands)
+{
+	if (m->timer_wheel && root != &m->child) {
+		timer_wheel_del(m->timer_wheel, thread);
+		thread->sands = *sands;
+		timer_wheel_add(m->timer_wheel, thread);
+	} else {
+		thread->sands = *sands;
+		rb_move_cached(root, thread, n, thread_timer_cmp);
+	}
+}
+
+static rb_root_cached_t *
+thread_type_root(thread_master_t *m, const thread_t *thread)
+{
+	if (thread->type == THREAD_READ)
+		return &m->read;
+	if (thread->type == THREAD_WRITE)
+		return &m->write;
+	return &m->timer;
+}
+
+static void
+thread_wheel_to_rb(thread_master_t *m, list_head_t *l)
+{
+	thread_t *thread, *thread_tmp;
+
+	list_for_each_entry_safe(thread, thread_tmp, l, e_list) {
+		list_head_del(&thread->e_list);
+		rb_insert_sort_cached(thread_type_root(m, thread), thread, n, thread_timer_cmp);
+	}
+}
+
+/* Switch the read, write and timer queues between the rb trees and
+ * the timer wheel, moving any threads already queued. */
+void
+thread_set_timer_wheel(thread_master_t *m, bool enable)
+{
+	rb_root_cached_t *roots[] = { &m->read, &m->write, &m->timer };
+	timer_wheel_t *w;
+	thread_t *thread, *thread_tmp;
+	unsigned i, slot;
+
+	if (enable == !!m->timer_wheel)
+		return;
+
+	if (enable) {
+		set_time_now();
+		w = MALLOC(sizeof(*w));
+		timer_wheel_init(w, &time_now);
+
+		for (i = 0; i < sizeof(roots) / sizeof(roots[0]); i++) {
+			rb_for_each_entry_safe_cached(thread, thread_tmp, roots[i], n) {
+				rb_erase_cached(&thread->n, roots[i]);
+				timer_wheel_add(w, thread);
+			}
+		}
+
+		m->timer_wheel = w;
+		return;
+	}
+
+	w = m->timer_wheel;
+	m->timer_wheel = NULL;
+
+	for (i = 0; i < TIMER_WHEEL_LEVELS; i++) {
+		if (!w->count[i])
+			continue;
+		for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+			thread_wheel_to_rb(m, &w->slots[i][slot]);
+	}
+	thread_wheel_to_rb(m, &w->overflow);
+	thread_wheel_to_rb(m, &w->never);
+
+	FREE(w);
+}
+
 /* Free all unused thread. */
 static void
 thread_clean_unuse(thread_master_t * m)
@@ -829,7 +1235,7 @@ thread_clean_unuse(thread_master_t * m)
 		list_head_del(&thread->e_list);
 
 		/* free the thread */
-		FREE(thread);
+		SLAB_FREE(&m->thread_slab, thread);
 		m->alloc--;
 	}
 
@@ -864,6 +1270,32 @@ thread_destroy_list(thread_master_t *m, list_head_t *l)
 	}
 }
 
+/* Move a thread that has been removed from its queue to the unuse queue */
+static void
+thread_destroy(thread_master_t *m, thread_t *thread)
+{
+	if (thread->type == THREAD_READ ||
+	    thread->type == THREAD_WRITE ||
+	    thread->type == THREAD_READY_READ_FD ||
+	    thread->type == THREAD_READY_WRITE_FD ||
+	    thread->type == THREAD_READ_TIMEOUT ||
+	    thread->type == THREAD_WRITE_TIMEOUT ||
+	    thread->type == THREAD_READ_ERROR ||
+	    thread->type == THREAD_WRITE_ERROR) {
+		/* Do we have a thread_event, and does it need deleting? */
+		if (thread->type == THREAD_READ)
+			thread_del_read(thread);
+		else if (thread->type == THREAD_WRITE)
+			thread_del_write(thread);
+
+		/* Do we have a file descriptor that needs closing ? */
+		if (thread->u.f.close_on_reload)
+			thread_close_fd(thread);
+	}
+
+	thread_add_unuse(m, thread);
+}
+
 static void
 thread_destroy_rb(thread_master_t *m, rb_root_cached_t *root)
 {
@@ -871,27 +1303,7 @@ thread_destroy_rb(thread_master_t *m, rb_root_cached_t *root)
 
 	rb_for_each_entry_safe_cached(thread, thread_tmp, root, n) {
 		rb_erase_cached(&thread->n, root);
-
-		if (thread->type == THREAD_READ ||
-		    thread->type == THREAD_WRITE ||
-		    thread->type == THREAD_READY_READ_FD ||
-		    thread->type == THREAD_READY_WRITE_FD ||
-		    thread->type == THREAD_READ_TIMEOUT ||
-		    thread->type == THREAD_WRITE_TIMEOUT ||
-		    thread->type == THREAD_READ_ERROR ||
-		    thread->type == THREAD_WRITE_ERROR) {
-			/* Do we have a thread_event, and does it need deleting? */
-			if (thread->type == THREAD_READ)
-				thread_del_read(thread);
-			else if (thread->type == THREAD_WRITE)
-				thread_del_write(thread);
-
-			/* Do we have a file descriptor that needs closing ? */
-			if (thread->u.f.close_on_reload)
-				thread_close_fd(thread);
-		}
-
-		thread_add_unuse(m, thread);
+		thread_destroy(m, thread);
 	}
 }
 
@@ -899,6 +1311,9 @@ thread_destroy_rb(thread_master_t *m, rb_root_cached_t *root)
 void
 thread_cleanup_master(thread_master_t * m)
 {
+	/* Put any timer wheel threads back on the rb trees for destroying */
+	thread_set_timer_wheel(m, false);
+
 	/* Unuse current thread lists */
 	m->current_event = NULL;
 	thread_destroy_rb(m, &m->read);
@@ -933,6 +1348,97 @@ thread_cleanup_master(thread_master_t * m)
 #endif
 }
 
+/* Used when reloading. The threads for which match() returns true are
+ * removed from their queues and put on the parked list, so that they
+ * survive thread_cleanup_master(). Their file descriptors stay open, and
+ * any epoll events stay registered. */
+void
+thread_park(thread_master_t *m, bool (*match)(thread_ref_t), list_head_t *parked)
+{
+	rb_root_cached_t *roots[] = { &m->read, &m->write, &m->timer, &m->child };
+	list_head_t *lists[] = { &m->event, &m->ready };
+	thread_t *thread, *thread_tmp;
+	unsigned i;
+
+	/* Put any timer wheel threads back on the rb trees */
+	thread_set_timer_wheel(m, false);
+
+	for (i = 0; i < sizeof(roots) / sizeof(roots[0]); i++) {
+		rb_for_each_entry_safe_cached(thread, thread_tmp, roots[i], n) {
+			if (!match(thread))
+				continue;
+
+			rb_erase_cached(&thread->n, roots[i]);
+			if (thread->type == THREAD_CHILD)
+				rb_erase(&thread->rb_data, &m->child_pid);
+			INIT_LIST_HEAD(&thread->e_list);
+			list_add_tail(&thread->e_list, parked);
+		}
+	}
+
+	for (i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+		list_for_each_entry_safe(thread, thread_tmp, lists[i], e_list) {
+			if (!match(thread))
+				continue;
+
+			/* A timed out child hasn't been reaped yet */
+			if (thread->type == THREAD_CHILD_TIMEOUT)
+				rb_erase(&thread->rb_data, &m->child_pid);
+			list_head_del(&thread->e_list);
+			list_add_tail(&thread->e_list, parked);
+		}
+	}
+}
+
+/* Requeue the parked threads for which keep() returns true, as they were
+ * before being parked, and destroy the others as thread_cleanup_master()
+ * would have done. */
+void
+thread_unpark(thread_master_t *m, list_head_t *parked, bool (*keep)(thread_ref_t))
+{
+	thread_t *thread, *thread_tmp;
+	int num_events = 0;
+
+	list_for_each_entry_safe(thread, thread_tmp, parked, e_list) {
+		list_head_del(&thread->e_list);
+		INIT_LIST_HEAD(&thread->e_list);
+
+		if (!keep(thread)) {
+			thread_destroy(m, thread);
+			continue;
+		}
+
+		if (thread->event)
+			num_events++;
+
+		switch (thread->type) {
+		case THREAD_READ:
+		case THREAD_WRITE:
+		case THREAD_TIMER:
+		case THREAD_TIMER_SHUTDOWN:
+			thread_queue_add(m, thread_type_root(m, thread), thread);
+			break;
+		case THREAD_CHILD:
+			rb_insert_sort_cached(&m->child, thread, n, thread_timer_cmp);
+			rb_insert_sort(&m->child_pid, thread, rb_data, thread_child_pid_cmp);
+			break;
+		case THREAD_EVENT:
+			list_add_tail(&thread->e_list, &m->event);
+			break;
+		default:
+			if (thread->type == THREAD_CHILD_TIMEOUT)
+				rb_insert_sort(&m->child_pid, thread, rb_data, thread_child_pid_cmp);
+			list_add_tail(&thread->e_list, &m->ready);
+			break;
+		}
+	}
+
+	thread_clean_unuse(m);
+
+	/* thread_cleanup_master() stopped counting the events of the kept threads */
+	thread_events_resize(m, num_events);
+}
+
 /* Stop thread scheduler. */
 void
 thread_destroy_master(thread_master_t * m)
@@ -950,6 +1456,9 @@ thread_destroy_master(thread_master_t * m)
 
 	thread_cleanup_master(m);
 
+	mem_slab_destroy(&m->thread_slab);
+	mem_slab_destroy(&m->event_slab);
+
 	FREE(m);
 }
 
@@ -983,7 +1492,7 @@ thread_new(thread_master_t *m)
 	/* If one thread is already allocated return it */
 	new = thread_trim_head(&m->unuse);
 	if (!new) {
-		new = (thread_t *)MALLOC(sizeof(thread_t));
+		new = (thread_t *)SLAB_ALLOC(&m->thread_slab);
 		m->alloc++;
 	}
 
@@ -1042,7 +1551,7 @@ thread_add_read_sands(thread_master_t *m, thread_func_t func, void *arg, int fd,
 	thread->sands = *sands;
 
 	/* Sort the thread. */
-	rb_insert_sort_cached(&m->read, thread, n, thread_timer_cmp);
+	thread_queue_add(m, &m->read, thread);
 
 	return thread;
 }
@@ -1107,9 +1616,7 @@ thread_read_requeue(thread_master_t *m, int fd, const timeval_t *new_sands)
 		return;
 	}
 
-	thread->sands = *new_sands;
-
-	rb_move_cached(&thread->master->read, thread, n, thread_timer_cmp);
+	thread_queue_move(thread->master, &thread->master->read, thread, new_sands);
 }
 
 void
@@ -1174,7 +1681,7 @@ thread_add_write(thread_master_t *m, thread_func_t func, void *arg, int fd, unsi
 	}
 
 	/* Sort the thread. */
-	rb_insert_sort_cached(&m->write, thread, n, thread_timer_cmp);
+	thread_queue_add(m, &m->write, thread);
 
 	return thread;
 }
@@ -1230,7 +1737,7 @@ thread_add_timer(thread_master_t *m, thread_func_t func, void *arg, unsigned lon
 	}
 
 	/* Sort by timeval. */
-	rb_insert_sort_cached(&m->timer, thread, n, thread_timer_cmp);
+	thread_queue_add(m, &m->timer, thread);
 
 	return thread;
 }
@@ -1252,9 +1759,7 @@ timer_thread_update_timeout(thread_ref_t thread_cp, unsigned long timer)
 	if (timercmp(&thread->sands, &sands, ==))
 		return;
 
-	thread->sands = sands;
-
-	rb_move_cached(&thread->master->timer, thread, n, thread_timer_cmp);
+	thread_queue_move(thread->master, &thread->master->timer, thread, &sands);
 }
 
 thread_ref_t
@@ -1413,14 +1918,14 @@ thread_cancel(thread_ref_t thread_cp)
 	switch (thread->type) {
 	case THREAD_READ:
 		thread_event_del(thread, THREAD_FL_EPOLL_READ_BIT);
-		rb_erase_cached(&thread->n, &m->read);
+		thread_queue_del(m, &m->read, thread);
 		break;
 	case THREAD_WRITE:
 		thread_event_del(thread, THREAD_FL_EPOLL_WRITE_BIT);
-		rb_erase_cached(&thread->n, &m->write);
+		thread_queue_del(m, &m->write, thread);
 		break;
 	case THREAD_TIMER:
-		rb_erase_cached(&thread->n, &m->timer);
+		thread_queue_del(m, &m->timer, thread);
 		break;
 	case THREAD_CHILD:
 		/* Does this need to kill the child, or is that the
@@ -1462,6 +1967,21 @@ void
 thread_cancel_read(thread_master_t *m, int fd)
 {
 	thread_t *thread, *thread_tmp;
+	thread_event_t *event;
+
+	if (m->timer_wheel) {
+		event = thread_event_get(m, fd);
+		if (!event || !event->read || event->read->type != THREAD_READ)
+			return;
+
+		thread = event->read;
+		if (event->write) {
+			thread_cancel(event->write);
+			event->write = NULL;
+		}
+		thread_cancel(thread);
+		return;
+	}
 
 	rb_for_each_entry_safe_cached(thread, thread_tmp, &m->read, n) {
 		if (thread->u.f.fd == fd) {
@@ -1668,7 +2188,7 @@ thread_fetch_next_queue(thread_master_t *m)
 
 	do {
 #ifdef _WITH_SNMP_
-		if (snmp_running)
+		if (snmp_running && m == master)
 			snmp_epoll_info(m);
 #endif
 
@@ -1857,8 +2377,9 @@ process_threads(thread_master_t *m)
 #endif
 
 		/* If we are shutting down, only process relevant thread types.
-		 * We only want timer and signal fd, and don't want inotify, vrrp socket,
-		 * snmp_read, bfd_receiver, bfd pipe in vrrp/check, dbus pipe or netlink fds. */
+		 * We only want timer, signal and child status fds, and don't want
+		 * inotify, vrrp socket, snmp_read, bfd_receiver, bfd pipe in
+		 * vrrp/check, dbus pipe or netlink fds. */
 		if (!(thread = thread_trim_head(thread_list)))
 			continue;
 
@@ -1876,7 +2397,8 @@ process_threads(thread_master_t *m)
 		    ((thread->type == THREAD_READY_READ_FD ||
 		      thread->type == THREAD_READY_WRITE_FD) &&
 		     (thread->u.f.fd == m->timer_fd ||
-		      thread->u.f.fd == m->signal_fd
+		      thread->u.f.fd == m->signal_fd ||
+		      thread->u.f.fd == m->child_status_fd
 #ifdef _WITH_SNMP_
 		      || FD_ISSET(thread->u.f.fd, &m->snmp_fdset)
 #endif
@@ -1915,7 +2437,7 @@ process_threads(thread_master_t *m)
 	}
 }
 
-static void
+void
 process_child_termination(pid_t pid, int status)
 {
 	thread_master_t * m = master;
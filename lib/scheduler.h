@@ -26,6 +26,7 @@
 /* system includes */
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <sys/timerfd.h>
 #ifdef _WITH_SNMP_
@@ -36,6 +37,7 @@
 #include "list.h"
 #include "list_head.h"
 #include "rbtree.h"
+#include "mem_slab.h"
 
 /* Thread types. */
 typedef enum {
@@ -104,8 +106,9 @@ struct _thread {
 
 	union {
 		rb_node_t n;
-		list_head_t e_list;
+		list_head_t e_list;	/* Also timer wheel slot if using timer wheel */
 	};
+	unsigned char wheel_level;	/* Timer wheel level, if using timer wheel */
 
 	rb_node_t rb_data;		/* PID or fd/vrid */
 };
@@ -120,6 +123,26 @@ typedef struct _thread_event {
 	rb_node_t		n;
 } thread_event_t;
 
+/* Hierarchical timer wheel. If enabled, this replaces the read, write
+ * and timer rb trees, giving O(1) insertion and cancellation of timeouts.
+ * Each level has TIMER_WHEEL_SLOTS slots, and each slot at level n
+ * covers TIMER_WHEEL_SLOTS^n ticks of TIMER_WHEEL_TICK usecs. */
+#define TIMER_WHEEL_BITS	8
+#define TIMER_WHEEL_SLOTS	(1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS	4
+#define TIMER_WHEEL_TICK	1000		/* 1 millisecond */
+
+typedef struct _timer_wheel {
+	list_head_t		slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	unsigned		count[TIMER_WHEEL_LEVELS];
+	list_head_t		overflow;	/* Beyond the range of the top level */
+	list_head_t		never;		/* Threads with no timeout */
+	unsigned		num_overflow;
+	uint64_t		tick;		/* Next tick to process */
+	timeval_t		next_expiry;	/* Cached earliest timeout */
+	bool			next_expiry_valid;
+} timer_wheel_t;
+
 /* Master of the threads. */
 typedef struct _thread_master {
 	rb_root_cached_t	read;
@@ -149,10 +172,14 @@ typedef struct _thread_master {
 	/* timer related */
 	int			timer_fd;
 	thread_ref_t		timer_thread;
+	timer_wheel_t		*timer_wheel;
 
 	/* signal related */
 	int			signal_fd;
 
+	/* child related */
+	int			child_status_fd;	/* Exit statuses of children, read while shutting down */
+
 #ifdef _WITH_SNMP_
 	/* snmp related */
 	thread_ref_t		snmp_timer_thread;
@@ -160,6 +187,10 @@ typedef struct _thread_master {
 	fd_set			snmp_fdset;
 #endif
 
+	/* Object caches */
+	mem_slab_t		thread_slab;
+	mem_slab_t		event_slab;
+
 	/* Local data */
 	unsigned long		alloc;
 	unsigned long		id;
@@ -227,12 +258,21 @@ extern void log_command_line(unsigned);
 extern bool report_child_status(int, pid_t, const char *);
 #endif
 extern thread_master_t *thread_make_master(void);
+extern thread_master_t *thread_make_worker_master(void);
 extern thread_ref_t thread_add_terminate_event(thread_master_t *);
 extern thread_ref_t thread_add_start_terminate_event(thread_master_t *, thread_func_t);
 #ifdef THREAD_DUMP
 extern void dump_thread_data(const thread_master_t *, FILE *);
 #endif
 extern void thread_cleanup_master(thread_master_t *);
+extern void thread_park(thread_master_t *, bool (*)(thread_ref_t), list_head_t *);
+extern void thread_unpark(thread_master_t *, list_head_t *, bool (*)(thread_ref_t));
+extern void thread_set_timer_wheel(thread_master_t *, bool);
+extern void timer_wheel_init(timer_wheel_t *, const timeval_t *);
+extern void timer_wheel_add(timer_wheel_t *, thread_t *);
+extern void timer_wheel_del(timer_wheel_t *, thread_t *);
+extern void timer_wheel_expire(timer_wheel_t *, const timeval_t *, list_head_t *);
+extern bool timer_wheel_next_expiry(timer_wheel_t *, timeval_t *);
 extern void thread_destroy_master(thread_master_t *);
 extern thread_ref_t thread_add_read_sands(thread_master_t *, thread_func_t, void *, int, const timeval_t *, bool);
 extern thread_ref_t thread_add_read(thread_master_t *, thread_func_t, void *, int, unsigned long, bool);
@@ -254,6 +294,7 @@ extern int snmp_timeout_thread(thread_ref_t);
 extern void snmp_epoll_reset(thread_master_t *);
 #endif
 extern void process_threads(thread_master_t *);
+extern void process_child_termination(pid_t, int);
 extern void thread_child_handler(void *, int);
 extern void thread_add_base_threads(thread_master_t *, bool);
 extern void launch_thread_scheduler(thread_master_t *);
@@ -0,0 +1,779 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Script runner. A long lived helper process, forked once,
+ *              which starts scripts on behalf of the VRRP and checker
+ *              processes using vfork(), so that the page tables of a
+ *              large keepalived process don't have to be copied for
+ *              every script run. The pid of each script is returned,
+ *              and exit statuses are streamed back, so that the script
+ *              is timed out and killed exactly as if we had forked it.
+ *              A script is not reaped by the runner until keepalived
+ *              has processed its exit status, so that its pid can't be
+ *              reused while keepalived might still signal it.
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2020 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <dirent.h>
+#include <grp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "script_runner.h"
+#include "logger.h"
+#include "memory.h"
+#include "list_head.h"
+#include "process.h"
+#include "signals.h"
+#include "utils.h"
+
+/* musl libc doesn't define the following */
+#ifndef	W_EXITCODE
+#define	W_EXITCODE(ret, sig)	((ret) << 8 | (sig))
+#endif
+#ifndef	WCOREFLAG
+#define	WCOREFLAG		((int32_t)WCOREDUMP(0xffffffff))
+#endif
+
+#define SCRIPT_RUNNER_MAX_REQ	8192
+#define SCRIPT_RUNNER_MAX_ARGS	256
+#define SCRIPT_RUNNER_TIMEOUT	TIMER_HZ	/* Time for the runner to start a script */
+
+enum script_runner_req_type {
+	SCRIPT_RUNNER_RUN,
+	SCRIPT_RUNNER_REAP,
+};
+
+/* A request to run a script, or to reap one whose exit status has been
+ * processed. For SCRIPT_RUNNER_RUN, num_args NUL terminated strings follow */
+typedef struct _script_runner_req {
+	int		type;
+	pid_t		pid;		/* for SCRIPT_RUNNER_REAP */
+	int		flags;
+	int		num_args;
+	uid_t		uid;
+	gid_t		gid;
+	char		args[];
+} script_runner_req_t;
+
+enum script_runner_msg_type {
+	SCRIPT_RUNNER_STARTED,
+	SCRIPT_RUNNER_EXITED,
+};
+
+/* What failed when starting a script */
+enum script_runner_fail {
+	SCRIPT_RUNNER_OK,
+	SCRIPT_RUNNER_FORK,
+	SCRIPT_RUNNER_SETGID,
+	SCRIPT_RUNNER_SETGROUPS,
+	SCRIPT_RUNNER_SETUID,
+	SCRIPT_RUNNER_EXEC,
+};
+
+typedef struct _script_runner_msg {
+	int		type;
+	pid_t		pid;
+	int		status;		/* wait status for SCRIPT_RUNNER_EXITED */
+	int		failed;		/* enum script_runner_fail */
+	int		error;		/* errno of the failure */
+} script_runner_msg_t;
+
+typedef union {
+	script_runner_req_t	req;
+	char			buf[SCRIPT_RUNNER_MAX_REQ];
+} script_runner_req_buf_t;
+
+/* A script the runner has been asked to start, and then is running */
+typedef struct _runner_script {
+	const notify_script_t	*script;	/* NULL if the requester has gone */
+	thread_func_t		func;		/* NULL for notify scripts */
+	void			*arg;
+	unsigned long		timer;
+	timeval_t		sent;
+	pid_t			pid;
+	bool			exited;		/* The runner hasn't been told to reap it */
+
+	/* Linking */
+	list_head_t		e_list;
+} runner_script_t;
+
+/* A script started by the runner process */
+typedef struct _runner_child {
+	pid_t		pid;
+	bool		exited;		/* Exit status sent, awaiting SCRIPT_RUNNER_REAP */
+} runner_child_t;
+
+/* Used in the keepalived process */
+static int runner_fd = -1;
+static pid_t runner_pid;
+static thread_ref_t runner_thread;
+static uint64_t runner_scripts;
+static uint64_t runner_fallbacks;
+static list_head_t runner_pending = LIST_HEAD_INIT(runner_pending);	/* Awaiting STARTED, in request order */
+static list_head_t runner_running = LIST_HEAD_INIT(runner_running);	/* Awaiting EXITED or the REAP being sent */
+
+/* Used in the runner process. The vfork()ed child writes the details
+ * of any failure here, since it shares our memory. */
+static sigset_t runner_sigmask;
+static volatile int spawn_failed;
+static volatile int spawn_errno;
+static volatile sig_atomic_t child_exited;
+static runner_child_t *runner_children;
+static unsigned runner_num_children;
+static unsigned runner_max_children;
+
+static int script_runner_read_thread(thread_ref_t);
+
+static void
+script_runner_sigchld(__attribute__((unused)) int sig)
+{
+	/* Interrupts ppoll() */
+	child_exited = true;
+}
+
+/* Close everything we have inherited other than the standard fds and our socket */
+static void
+close_other_fds(int keep_fd)
+{
+	DIR *dir;
+	struct dirent *ent;
+	int fd;
+
+	if (!(dir = opendir("/proc/self/fd")))
+		return;
+
+	while ((ent = readdir(dir))) {
+		fd = atoi(ent->d_name);
+		if (fd > STDERR_FILENO && fd != keep_fd && fd != dirfd(dir))
+			close(fd);
+	}
+
+	closedir(dir);
+}
+
+/* Runs in the vfork()ed child. Since it shares the runner's memory it
+ * must only make system calls, and must not log. */
+static void __attribute__ ((noreturn))
+script_runner_exec(const script_runner_req_t *req, const char **args)
+{
+	union non_const_args nargs;
+
+	sigprocmask(SIG_SETMASK, &runner_sigmask, NULL);
+
+	/* Ensure we receive SIGTERM if the runner dies */
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+	/* Drop our privileges if configured */
+	if (req->gid) {
+		if (setgid(req->gid)) {
+			spawn_failed = SCRIPT_RUNNER_SETGID;
+			spawn_errno = errno;
+			_exit(0);
+		}
+
+		/* Clear any extra supplementary groups */
+		if (setgroups(1, &req->gid)) {
+			spawn_failed = SCRIPT_RUNNER_SETGROUPS;
+			spawn_errno = errno;
+			_exit(0);
+		}
+	}
+
+	if (req->uid && setuid(req->uid)) {
+		spawn_failed = SCRIPT_RUNNER_SETUID;
+		spawn_errno = errno;
+		_exit(0);
+	}
+
+	/* Move us into our own process group, so if the script needs to be killed
+	 * all its child processes will also be killed. */
+	setpgid(0, 0);
+
+	nargs.args = args;
+	execve(args[0], nargs.execve_args, environ);
+
+	spawn_failed = SCRIPT_RUNNER_EXEC;
+	spawn_errno = errno;
+	_exit(0);
+}
+
+static void
+script_runner_spawn(int fd, const script_runner_req_t *req, size_t len)
+{
+	static const char *args[SCRIPT_RUNNER_MAX_ARGS + 1];
+	script_runner_msg_t msg = { .type = SCRIPT_RUNNER_STARTED };
+	const char *p = req->args, *end = (const char *)req + len;
+	int i;
+
+	for (i = 0; i < req->num_args && i < SCRIPT_RUNNER_MAX_ARGS && p < end; i++) {
+		args[i] = p;
+		p += strnlen(p, (size_t)(end - p)) + 1;
+	}
+	args[i] = NULL;
+
+	if (!i || p > end) {
+		msg.pid = -1;
+		msg.failed = SCRIPT_RUNNER_EXEC;
+		msg.error = EINVAL;
+	} else {
+		spawn_failed = SCRIPT_RUNNER_OK;
+		spawn_errno = 0;
+
+		msg.pid = vfork();
+		if (!msg.pid)
+			script_runner_exec(req, args);
+
+		if (msg.pid == -1) {
+			msg.failed = SCRIPT_RUNNER_FORK;
+			msg.error = errno;
+		} else {
+			msg.failed = spawn_failed;
+			msg.error = spawn_errno;
+
+			if (runner_num_children == runner_max_children) {
+				runner_max_children = runner_max_children ? runner_max_children * 2 : 64;
+				runner_children = REALLOC(runner_children, runner_max_children * sizeof(*runner_children));
+			}
+			runner_children[runner_num_children].pid = msg.pid;
+			runner_children[runner_num_children++].exited = false;
+		}
+	}
+
+	if (send(fd, &msg, sizeof(msg), MSG_NOSIGNAL) == -1)
+		_exit(0);
+}
+
+/* Report the exit status of scripts that have terminated, but leave them
+ * as zombies, so that their pids aren't reused */
+static void
+script_runner_exited(int fd)
+{
+	script_runner_msg_t msg = { .type = SCRIPT_RUNNER_EXITED };
+	runner_child_t *child;
+	siginfo_t info;
+	unsigned i;
+
+	for (i = 0; i < runner_num_children; i++) {
+		child = &runner_children[i];
+		if (child->exited)
+			continue;
+
+		info.si_pid = 0;
+		if (waitid(P_PID, (id_t)child->pid, &info, WEXITED | WNOHANG | WNOWAIT) || info.si_pid != child->pid)
+			continue;
+
+		child->exited = true;
+		msg.pid = child->pid;
+		if (info.si_code == CLD_EXITED)
+			msg.status = W_EXITCODE(info.si_status, 0);
+		else
+			msg.status = info.si_status | (info.si_code == CLD_DUMPED ? WCOREFLAG : 0);
+
+		if (send(fd, &msg, sizeof(msg), MSG_NOSIGNAL) == -1)
+			_exit(0);
+	}
+}
+
+/* keepalived has processed the exit status, so the pid can now be released */
+static void
+script_runner_reap(pid_t pid)
+{
+	unsigned i;
+
+	for (i = 0; i < runner_num_children; i++) {
+		if (runner_children[i].pid != pid)
+			continue;
+
+		if (runner_children[i].exited) {
+			waitpid(pid, NULL, WNOHANG);
+			runner_children[i] = runner_children[--runner_num_children];
+		}
+		return;
+	}
+}
+
+/* The main loop of the runner process. It exits when the keepalived
+ * process closes its end of the socket, or terminates. */
+static void __attribute__ ((noreturn))
+script_runner_main(int fd)
+{
+	static script_runner_req_buf_t req_buf;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	struct sigaction sa = { .sa_handler = script_runner_sigchld };
+	sigset_t chld_set;
+	ssize_t len;
+
+	prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+	/* The runner doesn't log, so drop the syslog connection before
+	 * closing the fds so that it can't be written to a reused fd */
+	closelog();
+	close_other_fds(fd);
+
+	signal_handler_script();
+	set_std_fd(false);
+
+	/* SIGCHLD is only delivered while waiting in ppoll() */
+	sigemptyset(&chld_set);
+	sigaddset(&chld_set, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &chld_set, &runner_sigmask);
+	sigaction(SIGCHLD, &sa, NULL);
+
+	for (;;) {
+		if (ppoll(&pfd, 1, NULL, &runner_sigmask) > 0) {
+			len = recv(fd, &req_buf, sizeof(req_buf), MSG_DONTWAIT);
+			if (len == 0 || (len == -1 && !check_EAGAIN(errno) && !check_EINTR(errno)))
+				_exit(0);
+
+			if (len >= (ssize_t)sizeof(req_buf.req)) {
+				if (req_buf.req.type == SCRIPT_RUNNER_REAP)
+					script_runner_reap(req_buf.req.pid);
+				else
+					script_runner_spawn(fd, &req_buf.req, (size_t)len);
+			}
+		}
+
+		if (child_exited) {
+			child_exited = false;
+			script_runner_exited(fd);
+		}
+	}
+}
+
+bool
+script_runner_active(void)
+{
+	return runner_fd != -1;
+}
+
+/* thread is the runner's read thread if we are called from it, so that
+ * its event can be released with the socket */
+static void
+script_runner_close(thread_ref_t thread)
+{
+	if (runner_fd == -1)
+		return;
+
+	/* The runner exits when its socket is closed, and is reaped by our
+	 * SIGCHLD handler. Any scripts it is running are sent SIGTERM. */
+	if (master && master->child_status_fd == runner_fd)
+		master->child_status_fd = -1;
+	if (thread)
+		thread_close_fd(thread);
+	else
+		close(runner_fd);
+	runner_fd = -1;
+	runner_pid = 0;
+}
+
+/* The timeout of a script runs from when it was requested */
+static unsigned long
+script_runner_timer_left(const runner_script_t *rs)
+{
+	timeval_t elapsed;
+	unsigned long elapsed_long;
+
+	timersub(&time_now, &rs->sent, &elapsed);
+	if (elapsed.tv_sec < 0)
+		return rs->timer;
+
+	elapsed_long = timer_long(elapsed);
+
+	return elapsed_long < rs->timer ? rs->timer - elapsed_long : 1;
+}
+
+/* Fork a script ourselves that the runner was asked to start */
+static void
+script_runner_fork(runner_script_t *rs)
+{
+
+	if (!rs->script)
+		return;
+
+	runner_fallbacks++;
+
+	if (!rs->func) {
+		fork_script(master, NULL, NULL, 0, rs->script);
+		return;
+	}
+
+	fork_script(master, rs->func, rs->arg, script_runner_timer_left(rs), rs->script);
+}
+
+/* The runner has terminated or is not responding. Scripts it had not
+ * started are forked by us, and scripts it was running are reported as
+ * killed, since they are sent SIGTERM when the runner exits and will be
+ * reaped by someone else. */
+static void
+script_runner_failed(thread_ref_t thread)
+{
+	runner_script_t *rs, *rs_tmp;
+
+	if (runner_thread) {
+		thread_cancel(runner_thread);
+		runner_thread = NULL;
+	}
+
+	script_runner_close(thread);
+
+	set_time_now();
+	list_for_each_entry_safe(rs, rs_tmp, &runner_running, e_list) {
+		list_head_del(&rs->e_list);
+		if (!rs->exited)
+			process_child_termination(rs->pid, W_EXITCODE(0, SIGKILL));
+		FREE(rs);
+	}
+
+	list_for_each_entry_safe(rs, rs_tmp, &runner_pending, e_list) {
+		list_head_del(&rs->e_list);
+		script_runner_fork(rs);
+		FREE(rs);
+	}
+}
+
+static void
+script_runner_started(const script_runner_msg_t *msg)
+{
+	runner_script_t *rs;
+
+	if (list_empty(&runner_pending))
+		return;
+
+	rs = list_first_entry(&runner_pending, runner_script_t, e_list);
+	list_head_del(&rs->e_list);
+
+	if (msg->failed == SCRIPT_RUNNER_FORK) {
+		errno = msg->error;
+		log_message(LOG_INFO, "Script runner failed fork process (%m) - forking script");
+		script_runner_fork(rs);
+		FREE(rs);
+		return;
+	}
+
+	/* Report failures as they would have been reported by the child */
+	if (rs->script) {
+		errno = msg->error;
+		switch (msg->failed) {
+		case SCRIPT_RUNNER_SETGID:
+			log_message(LOG_ALERT, "Couldn't setgid: %u (%m)", rs->script->gid);
+			break;
+		case SCRIPT_RUNNER_SETGROUPS:
+			log_message(LOG_ALERT, "Couldn't setgroups: %u (%m)", rs->script->gid);
+			break;
+		case SCRIPT_RUNNER_SETUID:
+			log_message(LOG_ALERT, "Couldn't setuid: %u (%m)", rs->script->uid);
+			break;
+		case SCRIPT_RUNNER_EXEC:
+			log_message(LOG_ALERT, "Error exec-ing command '%s', error %d: %m", rs->script->args[0], msg->error);
+			break;
+		}
+	}
+
+	if (msg->pid == -1) {
+		FREE(rs);
+		return;
+	}
+
+	runner_scripts++;
+	rs->pid = msg->pid;
+	list_add_tail(&rs->e_list, &runner_running);
+
+	if (!rs->func)
+		return;
+
+	thread_add_child(master, rs->func, rs->arg, rs->pid, script_runner_timer_left(rs));
+#ifdef _SCRIPT_DEBUG_
+	if (do_script_debug)
+		log_message(LOG_INFO, "Running script with pid %d via script runner, timer %lu.%6.6lu", rs->pid, rs->timer / TIMER_HZ, rs->timer % TIMER_HZ);
+#endif
+}
+
+static void
+script_runner_exited_msg(const script_runner_msg_t *msg)
+{
+	runner_script_t *rs;
+
+	process_child_termination(msg->pid, msg->status);
+
+	list_for_each_entry(rs, &runner_running, e_list) {
+		if (rs->pid == msg->pid) {
+			rs->exited = true;
+			break;
+		}
+	}
+}
+
+/* Tell the runner it can reap scripts whose exit status we have processed.
+ * Any we can't tell it about now are retried after the next message. */
+static void
+script_runner_send_reaps(void)
+{
+	script_runner_req_t req = { .type = SCRIPT_RUNNER_REAP };
+	runner_script_t *rs, *rs_tmp;
+
+	list_for_each_entry_safe(rs, rs_tmp, &runner_running, e_list) {
+		if (!rs->exited)
+			continue;
+
+		req.pid = rs->pid;
+		if (send(runner_fd, &req, sizeof(req), MSG_DONTWAIT | MSG_NOSIGNAL) != sizeof(req))
+			return;
+
+		list_head_del(&rs->e_list);
+		FREE(rs);
+	}
+}
+
+/* The read thread times out if the runner doesn't start the oldest
+ * requested script in time */
+static void
+script_runner_add_read_thread(thread_master_t *m)
+{
+	timeval_t sands;
+
+	if (list_empty(&runner_pending)) {
+		sands.tv_sec = TIMER_DISABLED;
+		sands.tv_usec = 0;
+	} else
+		sands = timer_add_long(list_first_entry(&runner_pending, runner_script_t, e_list)->sent, SCRIPT_RUNNER_TIMEOUT);
+
+	runner_thread = thread_add_read_sands(m, script_runner_read_thread, NULL, runner_fd, &sands, false);
+
+	/* The exit statuses are needed to complete a shutdown */
+	m->child_status_fd = runner_fd;
+}
+
+static int
+script_runner_read_thread(thread_ref_t thread)
+{
+	script_runner_msg_t msg;
+	runner_script_t *rs;
+	ssize_t len;
+
+	runner_thread = NULL;
+
+	if (thread->type == THREAD_READ_TIMEOUT) {
+		log_message(LOG_INFO, "Script runner (pid %d) not responding - stopping it", runner_pid);
+
+		/* The scripts it is running haven't been reaped yet, so their pids are still theirs */
+		list_for_each_entry(rs, &runner_running, e_list) {
+			if (!rs->exited)
+				kill(-rs->pid, SIGKILL);
+		}
+		kill(runner_pid, SIGKILL);
+		script_runner_failed(thread);
+		return 0;
+	}
+
+	set_time_now();
+	while ((len = recv(runner_fd, &msg, sizeof(msg), MSG_DONTWAIT)) > 0) {
+		if (len != sizeof(msg))
+			continue;
+		if (msg.type == SCRIPT_RUNNER_STARTED)
+			script_runner_started(&msg);
+		else if (msg.type == SCRIPT_RUNNER_EXITED)
+			script_runner_exited_msg(&msg);
+	}
+
+	if (len == 0 || (!check_EAGAIN(errno) && !check_EINTR(errno))) {
+		log_message(LOG_INFO, "Script runner (pid %d) has terminated", runner_pid);
+		script_runner_failed(thread);
+		return 0;
+	}
+
+	script_runner_send_reaps();
+
+	script_runner_add_read_thread(thread->master);
+
+	return 0;
+}
+
+/* Ask the runner to start a script. Returns true if the request has been
+ * sent, in which case the child thread is added when the runner reports
+ * the pid of the script, or false if the caller should fork the script
+ * itself. func is NULL for a script whose exit status isn't needed.
+ * Scripts that need to be run via system() are not handled by the runner. */
+bool
+script_runner_run(thread_master_t *m, thread_func_t func, void *arg, unsigned long timer, const notify_script_t *script)
+{
+	static script_runner_req_buf_t req_buf;
+	script_runner_req_t *req = &req_buf.req;
+	runner_script_t *rs;
+	size_t len = sizeof(*req), arg_len;
+	bool first;
+	int i;
+
+	if (runner_fd == -1 ||
+	    !(script->flags & SC_EXECABLE) ||
+	    script->num_args > SCRIPT_RUNNER_MAX_ARGS)
+		goto fallback;
+
+	req->type = SCRIPT_RUNNER_RUN;
+	req->flags = script->flags;
+	req->num_args = script->num_args;
+	req->uid = script->uid;
+	req->gid = script->gid;
+	for (i = 0; i < script->num_args; i++) {
+		arg_len = strlen(script->args[i]) + 1;
+		if (len + arg_len > sizeof(req_buf))
+			goto fallback;
+		memcpy(req_buf.buf + len, script->args[i], arg_len);
+		len += arg_len;
+	}
+
+	if (send(runner_fd, req, len, MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)len) {
+		log_message(LOG_INFO, "Script runner send error - %d (%m)", errno);
+		goto fallback;
+	}
+
+	PMALLOC(rs);
+	INIT_LIST_HEAD(&rs->e_list);
+	rs->script = script;
+	rs->func = func;
+	rs->arg = arg;
+	rs->timer = timer;
+	rs->sent = timer_now();
+
+	first = list_empty(&runner_pending);
+	list_add_tail(&rs->e_list, &runner_pending);
+
+	/* Start timing the runner's response */
+	if (first && runner_thread) {
+		timeval_t sands = timer_add_long(rs->sent, SCRIPT_RUNNER_TIMEOUT);
+		thread_requeue_read(m, runner_fd, &sands);
+	}
+
+	return true;
+
+  fallback:
+	runner_fallbacks++;
+
+	return false;
+}
+
+/* Called when (re)starting the process, after any previous threads have
+ * been cleaned up. The runner is kept across reloads. */
+void
+script_runner_init(thread_master_t *m, bool enable)
+{
+	int fds[2];
+	pid_t pid;
+
+	runner_script_t *rs;
+
+	runner_thread = NULL;
+
+	/* The threads of any previous configuration have gone, so scripts
+	 * still to be started by the runner have no-one to report to */
+	list_for_each_entry(rs, &runner_pending, e_list) {
+		rs->script = NULL;
+		rs->func = NULL;
+	}
+
+	if (!enable) {
+		script_runner_stop();
+		return;
+	}
+
+	if (runner_fd == -1) {
+		if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds)) {
+			log_message(LOG_INFO, "Unable to create script runner socket - %d (%m)", errno);
+			return;
+		}
+
+#ifdef ENABLE_LOG_TO_FILE
+		if (log_file_name)
+			flush_log_file();
+#endif
+
+		pid = local_fork();
+		if (pid < 0) {
+			log_message(LOG_INFO, "Unable to fork script runner - %d (%m)", errno);
+			close(fds[0]);
+			close(fds[1]);
+			return;
+		}
+
+		if (!pid) {
+#ifdef _MEM_CHECK_
+			skip_mem_dump();
+#endif
+			close(fds[0]);
+			script_runner_main(fds[1]);
+		}
+
+		close(fds[1]);
+		runner_fd = fds[0];
+		runner_pid = pid;
+		runner_scripts = runner_fallbacks = 0;
+
+		log_message(LOG_INFO, "Started script runner (pid %d)", pid);
+	}
+
+	script_runner_add_read_thread(m);
+}
+
+void
+script_runner_stop(void)
+{
+	runner_script_t *rs, *rs_tmp;
+
+	if (runner_thread) {
+		thread_cancel(runner_thread);
+		runner_thread = NULL;
+	}
+
+	script_runner_close(NULL);
+
+	list_for_each_entry_safe(rs, rs_tmp, &runner_pending, e_list) {
+		list_head_del(&rs->e_list);
+		FREE(rs);
+	}
+	list_for_each_entry_safe(rs, rs_tmp, &runner_running, e_list) {
+		list_head_del(&rs->e_list);
+		FREE(rs);
+	}
+}
+
+void
+dump_script_runner(FILE *fp)
+{
+	if (runner_fd == -1)
+		return;
+
+	conf_write(fp, " Script runner pid = %d, %" PRIu64 " scripts run, %" PRIu64 " run locally", runner_pid, runner_scripts, runner_fallbacks);
+}
+
+#ifdef THREAD_DUMP
+void
+register_script_runner_addresses(void)
+{
+	register_thread_address("script_runner_read_thread", script_runner_read_thread);
+}
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        script_runner.c include file.
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2020 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _SCRIPT_RUNNER_H
+#define _SCRIPT_RUNNER_H
+
+/* system includes */
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* application includes */
+#include "scheduler.h"
+#include "notify.h"
+
+/* prototypes */
+extern bool script_runner_active(void) __attribute__ ((pure));
+extern bool script_runner_run(thread_master_t *, thread_func_t, void *, unsigned long, const notify_script_t *);
+extern void script_runner_init(thread_master_t *, bool);
+extern void script_runner_stop(void);
+extern void dump_script_runner(FILE *);
+#ifdef THREAD_DUMP
+extern void register_script_runner_addresses(void);
+#endif
+
+#endif
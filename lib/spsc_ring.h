@@ -0,0 +1,103 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        spsc_ring.h include file.
+ *
+ *              Lock-free single producer/single consumer ring of fixed
+ *              size entries. The ring is self contained, so it can be
+ *              placed in memory shared between threads or processes.
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2020 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#ifndef _SPSC_RING_H
+#define _SPSC_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define SPSC_RING_CACHELINE	64
+
+/* head and tail are kept on separate cache lines by padding rather than
+ * by alignment attributes, since the ring is allocated by MALLOC or mmap
+ * which don't guarantee more than 16 byte alignment. */
+typedef struct _spsc_ring {
+	uint32_t	num_entries;	/* Must be a power of 2 */
+	uint32_t	entry_size;
+	char		pad0[SPSC_RING_CACHELINE - 2 * sizeof(uint32_t)];
+	uint32_t	head;		/* Only written by producer */
+	char		pad1[SPSC_RING_CACHELINE - sizeof(uint32_t)];
+	uint32_t	tail;		/* Only written by consumer */
+	char		pad2[SPSC_RING_CACHELINE - sizeof(uint32_t)];
+	unsigned char	data[];
+} spsc_ring_t;
+
+/* Number of bytes needed for a ring */
+static inline size_t
+spsc_ring_size(uint32_t num_entries, uint32_t entry_size)
+{
+	return sizeof(spsc_ring_t) + (size_t)num_entries * entry_size;
+}
+
+static inline void
+spsc_ring_init(spsc_ring_t *ring, uint32_t num_entries, uint32_t entry_size)
+{
+	ring->num_entries = num_entries;
+	ring->entry_size = entry_size;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+/* Returns false if the ring is full */
+static inline bool
+spsc_ring_push(spsc_ring_t *ring, const void *entry)
+{
+	uint32_t head = ring->head;
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail >= ring->num_entries)
+		return false;
+
+	memcpy(ring->data + (size_t)(head & (ring->num_entries - 1)) * ring->entry_size, entry, ring->entry_size);
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/* Returns false if the ring is empty */
+static inline bool
+spsc_ring_pop(spsc_ring_t *ring, void *entry)
+{
+	uint32_t tail = ring->tail;
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	if (head == tail)
+		return false;
+
+	memcpy(entry, ring->data + (size_t)(tail & (ring->num_entries - 1)) * ring->entry_size, ring->entry_size);
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static inline bool
+spsc_ring_empty(spsc_ring_t *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail;
+}
+
+#endif
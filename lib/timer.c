@@ -33,8 +33,9 @@
 #include "logger.h"
 #endif
 
-/* time_now holds current time */
-timeval_t time_now;
+/* time_now holds current time. It is per thread since checker
+ * worker threads run their own schedulers. */
+__thread timeval_t time_now;
 #ifdef _TIMER_CHECK_
 static timeval_t last_time;
 bool do_timer_check;
@@ -31,7 +31,7 @@
 typedef struct timeval timeval_t;
 
 /* Global vars */
-extern timeval_t time_now;
+extern __thread timeval_t time_now;
 
 #ifdef _TIMER_CHECK_
 extern bool do_timer_check;
@@ -400,7 +400,7 @@ in_csum(const uint16_t *addr, size_t len, uint32_t csum, uint32_t *acc)
 const char *
 inet_ntop2(uint32_t ip)
 {
-	static char buf[16];
+	static __thread char buf[16];
 	const unsigned char *bytep;
 
 	bytep = (const unsigned char *)&ip;
@@ -640,7 +640,7 @@ inet_sockaddrtos2(const struct sockaddr_storage *addr, char *addr_str)
 const char *
 inet_sockaddrtos(const struct sockaddr_storage *addr)
 {
-	static char addr_str[INET6_ADDRSTRLEN];
+	static __thread char addr_str[INET6_ADDRSTRLEN];
 	inet_sockaddrtos2(addr, addr_str);
 	return addr_str;
 }
@@ -675,7 +675,7 @@ const char *
 inet_sockaddrtopair(const struct sockaddr_storage *addr)
 {
 	char addr_str[INET6_ADDRSTRLEN];
-	static char ret[sizeof(addr_str) + 8];	/* '[' + addr_str + ']' + ':' + 'nnnnn' */
+	static __thread char ret[sizeof(addr_str) + 8];	/* '[' + addr_str + ']' + ':' + 'nnnnn' */
 
 	inet_sockaddrtos2(addr, addr_str);
 	snprintf(ret, sizeof(ret), "[%s]:%d"
@@ -703,7 +703,7 @@ inet_sockaddrtotrio_r(const struct sockaddr_storage *addr, uint16_t proto, char
 const char *
 inet_sockaddrtotrio(const struct sockaddr_storage *addr, uint16_t proto)
 {
-	static char ret[SOCKADDRTRIO_STR_LEN];
+	static __thread char ret[SOCKADDRTRIO_STR_LEN];
 
 	inet_sockaddrtotrio_r(addr, proto, ret);
 
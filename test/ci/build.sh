@@ -8,3 +8,4 @@ echo Configuring with: $KEEPALIVED_CONFIG_ARGS
 }
 
 make
+make check
@@ -0,0 +1,252 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Unit test of the netlink monitor socket filter generation.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2017 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <endian.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "keepalived_netlink.h"
+
+#define OWN_PID		4242
+#define GUARD		8
+
+static unsigned failures;
+
+#define FAIL(...)	do { printf(__VA_ARGS__); putchar('\n'); failures++; } while (0)
+
+/* Just enough of a classic BPF interpreter to run the programs we generate */
+static uint32_t
+run_filter(const struct sock_filter *insns, unsigned len, const uint8_t *pkt, size_t pkt_len)
+{
+	uint32_t a = 0, x = 0;
+	unsigned pc;
+
+	for (pc = 0; pc < len; pc++) {
+		const struct sock_filter *f = &insns[pc];
+
+		switch (f->code) {
+		case BPF_LD | BPF_W | BPF_ABS:
+			if (f->k + 4 > pkt_len)
+				return 0;
+			a = (uint32_t)pkt[f->k] << 24 | (uint32_t)pkt[f->k + 1] << 16 | (uint32_t)pkt[f->k + 2] << 8 | pkt[f->k + 3];
+			break;
+		case BPF_LD | BPF_H | BPF_ABS:
+			if (f->k + 2 > pkt_len)
+				return 0;
+			a = (uint32_t)pkt[f->k] << 8 | pkt[f->k + 1];
+			break;
+		case BPF_LD | BPF_B | BPF_ABS:
+			if (f->k + 1 > pkt_len)
+				return 0;
+			a = pkt[f->k];
+			break;
+		case BPF_ALU | BPF_LSH | BPF_K:
+			a <<= f->k;
+			break;
+		case BPF_ALU | BPF_OR | BPF_X:
+			a |= x;
+			break;
+		case BPF_MISC | BPF_TAX:
+			x = a;
+			break;
+		case BPF_JMP | BPF_JEQ | BPF_K:
+			pc += a == f->k ? f->jt : f->jf;
+			break;
+		case BPF_JMP | BPF_JGE | BPF_K:
+			pc += a >= f->k ? f->jt : f->jf;
+			break;
+		case BPF_JMP | BPF_JGT | BPF_K:
+			pc += a > f->k ? f->jt : f->jf;
+			break;
+		case BPF_RET | BPF_K:
+			return f->k;
+		default:
+			FAIL("Unexpected BPF instruction 0x%x at %u", f->code, pc);
+			return 0;
+		}
+	}
+
+	FAIL("Filter program fell off the end");
+	return 0;
+}
+
+static bool
+filter_accepts(const struct sock_filter *insns, unsigned len, uint16_t type, uint32_t pid, ifindex_t ifindex)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct ifaddrmsg ifa;
+	} msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.nlh.nlmsg_len = sizeof(msg);
+	msg.nlh.nlmsg_type = type;
+	msg.nlh.nlmsg_pid = pid;
+	msg.ifa.ifa_index = ifindex;
+
+	return run_filter(insns, len, (const uint8_t *)&msg, sizeof(msg)) != 0;
+}
+
+static bool __attribute__ ((pure))
+is_ignored(const ifindex_t *ignored, unsigned num_ignored, ifindex_t ifindex)
+{
+	unsigned i;
+
+	for (i = 0; i < num_ignored; i++) {
+		if (ignored[i] == ifindex)
+			return true;
+	}
+
+	return false;
+}
+
+static void
+test_filter(const char *name, const ifindex_t *ignored, unsigned num_ignored)
+{
+	unsigned single = 0, multi = 0;
+	unsigned expected_len, expected_ranges;
+	unsigned len, ranges, i, j;
+	struct sock_filter *insns;
+	struct sock_filter guard;
+	struct sock_fprog fprog;
+	ifindex_t max_ifindex = 0;
+	ifindex_t max_filtered = 0;
+	int fd;
+
+	/* Work out independently how long the program should be */
+	for (i = 0; i < num_ignored && single + multi < MONITOR_FILTER_MAX_RANGES; ) {
+		for (j = i + 1; j < num_ignored && ignored[j] == ignored[j - 1] + 1; j++);
+		if (j - i == 1)
+			single++;
+		else
+			multi++;
+		max_filtered = ignored[j - 1];
+		i = j;
+	}
+	expected_ranges = single + multi;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	expected_len = 7 + 13 + 2 * single + 3 * multi + 1;
+#else
+	expected_len = 7 + 1 + 2 * single + 3 * multi + 1;
+#endif
+
+	len = netlink_monitor_filter_build(NULL, 0, ignored, num_ignored, OWN_PID, NULL);
+	if (len != expected_len)
+		FAIL("%s: program length %u, expected %u", name, len, expected_len);
+
+	/* Build into a buffer of exactly the size requested, followed by guard
+	 * instructions that must not be overwritten */
+	insns = malloc((len + GUARD) * sizeof(*insns));
+	memset(&guard, 0xa5, sizeof(guard));
+	for (i = 0; i < len + GUARD; i++)
+		insns[i] = guard;
+
+	if (netlink_monitor_filter_build(insns, len, ignored, num_ignored, OWN_PID, &ranges) != len)
+		FAIL("%s: second build returned a different length", name);
+	if (ranges != expected_ranges)
+		FAIL("%s: %u ranges, expected %u", name, ranges, expected_ranges);
+	for (i = len; i < len + GUARD; i++) {
+		if (memcmp(&insns[i], &guard, sizeof(guard))) {
+			FAIL("%s: instruction %u written beyond the %u allocated", name, i, len);
+			break;
+		}
+	}
+
+	/* A buffer that is too short must not be overrun either */
+	for (i = 0; i < len + GUARD; i++)
+		insns[i] = guard;
+	netlink_monitor_filter_build(insns, len - 1, ignored, num_ignored, OWN_PID, NULL);
+	if (memcmp(&insns[len - 1], &guard, sizeof(guard)))
+		FAIL("%s: short buffer overrun", name);
+	netlink_monitor_filter_build(insns, len, ignored, num_ignored, OWN_PID, NULL);
+
+	/* Check the program does what it should */
+	for (i = 0; i < num_ignored; i++) {
+		if (ignored[i] > max_ifindex)
+			max_ifindex = ignored[i];
+	}
+	for (i = 0; i <= max_ifindex + 2; i++) {
+		/* Only the first MONITOR_FILTER_MAX_RANGES ranges are filtered */
+		bool want_drop = is_ignored(ignored, num_ignored, i) && i <= max_filtered;
+
+		if (filter_accepts(insns, len, RTM_NEWADDR, 0, i) == want_drop)
+			FAIL("%s: RTM_NEWADDR for ifindex %u %s", name, i, want_drop ? "accepted" : "dropped");
+		if (filter_accepts(insns, len, RTM_DELADDR, 0, i) == want_drop)
+			FAIL("%s: RTM_DELADDR for ifindex %u %s", name, i, want_drop ? "accepted" : "dropped");
+		if (!filter_accepts(insns, len, RTM_NEWLINK, 0, i))
+			FAIL("%s: RTM_NEWLINK for ifindex %u dropped", name, i);
+		if (filter_accepts(insns, len, RTM_NEWADDR, OWN_PID, i))
+			FAIL("%s: RTM_NEWADDR from own pid accepted", name);
+	}
+
+	/* Let the kernel validate the program */
+	if ((fd = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE)) >= 0) {
+		fprog.len = (unsigned short)len;
+		fprog.filter = insns;
+		if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)))
+			FAIL("%s: kernel rejected filter - %m", name);
+		close(fd);
+	}
+
+	free(insns);
+}
+
+int
+main(__attribute__((unused)) int argc, __attribute__((unused)) char **argv)
+{
+	static const ifindex_t one_single[] = { 3 };
+	static const ifindex_t one_multi[] = { 1, 2 };
+	static const ifindex_t all_multi[] = { 1, 2, 4, 5, 6, 9, 10 };
+	static const ifindex_t all_single[] = { 2, 4, 6, 8 };
+	static const ifindex_t mixed[] = { 1, 3, 4, 5, 7, 10, 11 };
+	ifindex_t *many;
+	unsigned i;
+
+	test_filter("single ifindex", one_single, sizeof(one_single) / sizeof(one_single[0]));
+	test_filter("one multi-ifindex range", one_multi, sizeof(one_multi) / sizeof(one_multi[0]));
+	test_filter("multi-ifindex ranges", all_multi, sizeof(all_multi) / sizeof(all_multi[0]));
+	test_filter("single ifindex ranges", all_single, sizeof(all_single) / sizeof(all_single[0]));
+	test_filter("mixed ranges", mixed, sizeof(mixed) / sizeof(mixed[0]));
+
+	/* More ranges than the filter will hold, all multi-ifindex */
+	many = malloc(2 * (MONITOR_FILTER_MAX_RANGES + 10) * sizeof(*many));
+	for (i = 0; i < MONITOR_FILTER_MAX_RANGES + 10; i++) {
+		many[2 * i] = 3 * i + 1;
+		many[2 * i + 1] = 3 * i + 2;
+	}
+	test_filter("too many ranges", many, 2 * (MONITOR_FILTER_MAX_RANGES + 10));
+	free(many);
+
+	if (failures) {
+		printf("%u failures\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
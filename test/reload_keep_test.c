@@ -0,0 +1,227 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Unit test of keeping unchanged virtual servers, and the
+ *              threads of their checkers, over a reload.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2017 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include "check_api.h"
+#include "check_data.h"
+#include "ipwrapper.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "memory.h"
+#include "list.h"
+
+static unsigned failures;
+
+#define FAIL(...)	do { printf(__VA_ARGS__); putchar('\n'); failures++; } while (0)
+
+static int
+test_checker_thread(__attribute__((unused)) thread_ref_t thread)
+{
+	return 0;
+}
+
+static int
+other_thread(__attribute__((unused)) thread_ref_t thread)
+{
+	return 0;
+}
+
+static bool
+compare_test_checker(__attribute__((unused)) const checker_t *old_c, __attribute__((unused)) const checker_t *new_c)
+{
+	return true;
+}
+
+static void
+free_test_checker(checker_t *checker)
+{
+	FREE(checker);
+}
+
+static void
+dump_test_checker(__attribute__((unused)) FILE *fp, __attribute__((unused)) const checker_t *checker)
+{
+}
+
+/* Each virtual server has one real server, with one checker */
+static checker_t *
+add_vs(const char *ip, uint32_t config_hash)
+{
+	virtual_server_t *vs;
+	real_server_t *rs;
+
+	alloc_vs(ip, "80");
+	vs = LIST_TAIL_DATA(check_data->vs);
+	vs->config_hash = config_hash;
+
+	alloc_rs("192.168.0.1", "80");
+	rs = LIST_TAIL_DATA(vs->rs);
+
+	/* As though it has been running */
+	vs->alive = true;
+	rs->alive = true;
+	rs->set = true;
+
+	return queue_checker(free_test_checker, dump_test_checker, test_checker_thread,
+			     compare_test_checker, NULL, NULL, false);
+}
+
+static void
+load_config(uint32_t hash_a, uint32_t hash_b, checker_t **checker_a, checker_t **checker_b)
+{
+	check_data = alloc_check_data();
+	init_checkers_queue();
+
+	*checker_a = add_vs("10.0.0.1", hash_a);
+	*checker_b = add_vs("10.0.0.2", hash_b);
+}
+
+static void
+test_reload(bool timer_wheel)
+{
+	checker_t *checker_a, *checker_b, *new_checker_a, *new_checker_b;
+	virtual_server_t *vs_a;
+	thread_ref_t thread_a;
+	thread_t *thread;
+	unsigned long id_a;
+	timeval_t sands_a;
+	list old_checkers_queue;
+	const char *wheel_str = timer_wheel ? "timer wheel" : "rb tree";
+	unsigned num_timers = 0;
+	int fds[2];
+
+	master = thread_make_worker_master();
+	thread_set_timer_wheel(master, timer_wheel);
+
+	load_config(1, 2, &checker_a, &checker_b);
+	checker_a->has_run = true;
+	checker_b->has_run = true;
+	vs_a = checker_a->vs;
+
+	/* The first checker is waiting to run again, and the second is
+	 * waiting for a reply */
+	if (pipe(fds)) {
+		FAIL("%s: pipe failed", wheel_str);
+		return;
+	}
+	thread_a = thread_add_timer(master, test_checker_thread, checker_a, 5 * TIMER_HZ);
+	thread_add_read(master, test_checker_thread, checker_b, fds[0], 3 * TIMER_HZ, true);
+	thread_add_timer(master, other_thread, NULL, TIMER_HZ);
+	id_a = thread_a->id;
+	sands_a = thread_a->sands;
+
+	/* As reload_check_thread() does */
+	park_checker_threads();
+	thread_cleanup_master(master);
+
+	old_checkers_queue = checkers_queue;
+	checkers_queue = NULL;
+	old_check_data = check_data;
+	check_data = NULL;
+
+	/* Only the block of the second virtual server has changed */
+	load_config(1, 3, &new_checker_a, &new_checker_b);
+
+	/* As start_check() does */
+	thread_set_timer_wheel(master, timer_wheel);
+	clear_diff_services(old_checkers_queue);
+	unpark_checker_threads();
+
+	/* The first virtual server, and its checker, are the old ones */
+	if (LIST_HEAD_DATA(check_data->vs) != vs_a)
+		FAIL("%s: unchanged vs not kept", wheel_str);
+	if (LIST_HEAD_DATA(checkers_queue) != checker_a)
+		FAIL("%s: checker of unchanged vs not kept", wheel_str);
+	if (!checker_a->reloaded)
+		FAIL("%s: kept checker would be launched again", wheel_str);
+	if (!checker_a->rs->reloaded)
+		FAIL("%s: rs of kept vs not marked as reloaded", wheel_str);
+	if (LIST_HEAD_DATA(old_checkers_queue) != new_checker_a)
+		FAIL("%s: new checker of unchanged vs not freed with the old ones", wheel_str);
+
+	/* The second virtual server is rebuilt */
+	if (LIST_TAIL_DATA(check_data->vs) != new_checker_b->vs)
+		FAIL("%s: changed vs not replaced", wheel_str);
+	if (LIST_TAIL_DATA(checkers_queue) != new_checker_b)
+		FAIL("%s: checker of changed vs not replaced", wheel_str);
+	if (new_checker_b->reloaded)
+		FAIL("%s: checker of changed vs would not be launched", wheel_str);
+	if (!new_checker_b->rs->alive || !new_checker_b->has_run)
+		FAIL("%s: state of changed vs not carried over", wheel_str);
+
+	/* The old checker's read thread has gone, with its socket */
+	if (fcntl(fds[0], F_GETFD) != -1 || errno != EBADF) {
+		FAIL("%s: fd of dropped checker thread not closed", wheel_str);
+		close(fds[0]);
+	}
+	close(fds[1]);
+
+	/* The kept checker's timer is still running, as it was */
+	thread_set_timer_wheel(master, false);
+	rb_for_each_entry_cached(thread, &master->timer, n) {
+		num_timers++;
+		if (thread != thread_a || thread->id != id_a)
+			FAIL("%s: unexpected timer thread %lu", wheel_str, thread->id);
+		else if (thread->arg != checker_a || thread->type != THREAD_TIMER)
+			FAIL("%s: kept thread changed", wheel_str);
+		else if (timercmp(&thread->sands, &sands_a, !=))
+			FAIL("%s: kept thread timer changed", wheel_str);
+	}
+	if (num_timers != 1)
+		FAIL("%s: %u timer threads, expected 1", wheel_str, num_timers);
+	if (!RB_EMPTY_ROOT(&master->read.rb_root))
+		FAIL("%s: read thread of dropped checker not destroyed", wheel_str);
+
+	/* As reload_check_thread() does once the new configuration is running */
+	free_check_data(old_check_data);
+	old_check_data = NULL;
+	free_list(&old_checkers_queue);
+
+	free_check_data(check_data);
+	check_data = NULL;
+	free_checkers_queue();
+	thread_destroy_master(master);
+	master = NULL;
+}
+
+int
+main(__attribute__((unused)) int argc, __attribute__((unused)) char **argv)
+{
+	test_reload(false);
+	test_reload(true);
+
+	if (failures) {
+		printf("%u failures\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Unit test of matching virtual and real servers on a reload.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2017 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "ipwrapper.h"
+#include "memory.h"
+#include "list.h"
+
+#define NUM_GROUPS	40
+
+static unsigned failures;
+
+#define FAIL(...)	do { printf(__VA_ARGS__); putchar('\n'); failures++; } while (0)
+
+static void
+set_addr(struct sockaddr_storage *addr, const char *ip, uint16_t port)
+{
+	memset(addr, 0, sizeof(*addr));
+
+	if (strchr(ip, ':')) {
+		struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)addr;
+
+		addr6->sin6_family = AF_INET6;
+		addr6->sin6_port = htons(port);
+		inet_pton(AF_INET6, ip, &addr6->sin6_addr);
+	} else {
+		struct sockaddr_in *addr4 = (struct sockaddr_in *)addr;
+
+		addr4->sin_family = AF_INET;
+		addr4->sin_port = htons(port);
+		inet_pton(AF_INET, ip, &addr4->sin_addr);
+	}
+}
+
+static virtual_server_t *
+new_vs(list l, const char *vsgname, const char *ip, uint16_t port, uint32_t fwmark)
+{
+	virtual_server_t *vs = MALLOC(sizeof(*vs));
+
+	vs->vsgname = vsgname;
+	vs->vfwmark = fwmark;
+	vs->service_type = IPPROTO_TCP;
+	if (ip)
+		set_addr(&vs->addr, ip, port);
+	else
+		((struct sockaddr_in *)&vs->addr)->sin_port = htons(port);
+	vs->af = vs->addr.ss_family ? vs->addr.ss_family : AF_INET;
+	vs->rs = alloc_list(NULL, NULL);
+	list_add(l, vs);
+
+	return vs;
+}
+
+static real_server_t *
+new_rs(virtual_server_t *vs, const char *ip, uint16_t port)
+{
+	real_server_t *rs = MALLOC(sizeof(*rs));
+
+	set_addr(&rs->addr, ip, port);
+	list_add(vs->rs, rs);
+
+	return rs;
+}
+
+static void
+free_vs_list(list *l)
+{
+	virtual_server_t *vs;
+	real_server_t *rs;
+	element e, e1;
+
+	LIST_FOREACH(*l, vs, e) {
+		LIST_FOREACH(vs->rs, rs, e1)
+			FREE(rs);
+		free_list(&vs->rs);
+		FREE(vs);
+	}
+	free_list(l);
+}
+
+static void
+check_vs(const char *name, const vs_index_t *index, const virtual_server_t *old_vs, const virtual_server_t *expected)
+{
+	const virtual_server_t *found = vs_exist(old_vs, index);
+
+	if (found != expected)
+		FAIL("%s: matched %p, expected %p", name, (const void *)found, (const void *)expected);
+}
+
+static void
+test_vs_match(void)
+{
+	list old_l = alloc_list(NULL, NULL);
+	list new_l = alloc_list(NULL, NULL);
+	virtual_server_t *old_a, *old_g1, *old_g9, *old_fw, *old_fw6, *old_gone;
+	virtual_server_t *new_a, *new_a_dup, *new_g1, *new_g1_port, *new_fw;
+	virtual_server_t *old_groups[NUM_GROUPS], *new_groups[NUM_GROUPS];
+	vs_index_t *index;
+	char names[NUM_GROUPS][16];
+	unsigned i;
+
+	old_a = new_vs(old_l, NULL, "10.0.0.1", 80, 0);
+	old_g1 = new_vs(old_l, "g1", NULL, 80, 0);
+	old_g9 = new_vs(old_l, "g9", NULL, 80, 0);
+	old_fw = new_vs(old_l, NULL, NULL, 0, 5);
+	old_fw6 = new_vs(old_l, NULL, NULL, 0, 5);
+	old_fw6->af = AF_INET6;
+	old_gone = new_vs(old_l, NULL, "10.0.0.2", 80, 0);
+
+	/* The same virtual server under a different group comes first, with the
+	 * same port, and so the same hash */
+	new_vs(new_l, "g2", NULL, 80, 0);
+	new_g1_port = new_vs(new_l, "g1", NULL, 443, 0);
+	new_g1 = new_vs(new_l, "g1", NULL, 80, 0);
+	new_fw = new_vs(new_l, NULL, NULL, 0, 5);
+	new_a = new_vs(new_l, NULL, "10.0.0.1", 80, 0);
+	new_a_dup = new_vs(new_l, NULL, "10.0.0.1", 80, 0);
+	new_vs(new_l, NULL, "10.0.0.1", 81, 0);
+	new_vs(new_l, NULL, "fe80::1", 80, 0);
+
+	/* Lots of groups with the same port, so that the index has to probe */
+	for (i = 0; i < NUM_GROUPS; i++) {
+		snprintf(names[i], sizeof(names[i]), "grp%u", i);
+		old_groups[i] = new_vs(old_l, names[i], NULL, 8080, 0);
+	}
+	for (i = NUM_GROUPS; i-- > 0; )
+		new_groups[i] = new_vs(new_l, names[i], NULL, 8080, 0);
+
+	index = alloc_vs_index(new_l);
+
+	check_vs("plain vs", index, old_a, new_a);
+	check_vs("vs under a different group", index, old_g1, new_g1);
+	check_vs("group no longer exists", index, old_g9, NULL);
+	check_vs("fwmark vs", index, old_fw, new_fw);
+	check_vs("fwmark vs of other family", index, old_fw6, NULL);
+	check_vs("removed vs", index, old_gone, NULL);
+	for (i = 0; i < NUM_GROUPS; i++)
+		check_vs(names[i], index, old_groups[i], new_groups[i]);
+
+	/* Duplicate identities match the first one in the new configuration */
+	if (vs_exist(new_a_dup, index) != new_a)
+		FAIL("duplicate vs: did not match first one");
+	if (vs_exist(new_g1_port, index) != new_g1_port)
+		FAIL("group vs on other port: not matched");
+
+	FREE(index);
+	free_vs_list(&old_l);
+	free_vs_list(&new_l);
+}
+
+/* Old and new real servers are given as address lists, and expect[i] is the
+ * position in the new list that old real server i should match, or -1 */
+static void
+check_rs(const char *name, const char * const *old_ips, unsigned num_old,
+	 const char * const *new_ips, unsigned num_new,
+	 bool same_hash, const int *expect)
+{
+	list old_l = alloc_list(NULL, NULL);
+	list new_l = alloc_list(NULL, NULL);
+	virtual_server_t *old_vs, *new_vs_p;
+	real_server_t **new_rs_p;
+	real_server_t *rs, *found;
+	rs_matcher_t matcher;
+	element e;
+	unsigned i;
+
+	old_vs = new_vs(old_l, NULL, "10.0.0.1", 80, 0);
+	new_vs_p = new_vs(new_l, NULL, "10.0.0.1", 80, 0);
+	old_vs->config_hash = 0x1234;
+	new_vs_p->config_hash = same_hash ? 0x1234 : 0x5678;
+
+	new_rs_p = MALLOC(num_new * sizeof(*new_rs_p));
+	for (i = 0; i < num_old; i++)
+		new_rs(old_vs, old_ips[i], 80);
+	for (i = 0; i < num_new; i++)
+		new_rs_p[i] = new_rs(new_vs_p, new_ips[i], 80);
+
+	rs_matcher_init(&matcher, old_vs, new_vs_p);
+	i = 0;
+	LIST_FOREACH(old_vs->rs, rs, e) {
+		found = rs_matcher_find(&matcher, rs);
+		if (expect[i] < 0 ? found != NULL : found != new_rs_p[expect[i]])
+			FAIL("%s: old rs %u (%s) matched wrongly", name, i, old_ips[i]);
+		i++;
+	}
+	rs_matcher_free(&matcher);
+
+	FREE(new_rs_p);
+	free_vs_list(&old_l);
+	free_vs_list(&new_l);
+}
+
+static void
+test_rs_match(void)
+{
+	static const char * const abc[] = { "192.168.0.1", "192.168.0.2", "192.168.0.3" };
+	static const char * const cab[] = { "192.168.0.3", "192.168.0.1", "192.168.0.2" };
+	static const char * const ac[] = { "192.168.0.1", "192.168.0.3" };
+	static const char * const aab[] = { "192.168.0.1", "192.168.0.1", "192.168.0.2" };
+	static const char * const baa[] = { "192.168.0.2", "192.168.0.1", "192.168.0.1" };
+	static const char * const v6[] = { "2001:db8::1", "192.168.0.1", "2001:db8::2" };
+	static const int in_order[] = { 0, 1, 2 };
+	static const int reordered[] = { 1, 2, 0 };
+	static const int one_removed[] = { 0, -1, 1 };
+	static const int dup_first[] = { 0, 0, 2 };
+	static const int dup_reordered[] = { 1, 1, 0 };
+	static const int v6_from_abc[] = { 1, -1, -1 };
+
+	check_rs("unchanged block", abc, 3, abc, 3, true, in_order);
+	check_rs("changed block", abc, 3, abc, 3, false, in_order);
+	check_rs("reordered, identical hash", abc, 3, cab, 3, true, reordered);
+	check_rs("reordered, changed block", abc, 3, cab, 3, false, reordered);
+	check_rs("rs removed, identical hash", abc, 3, ac, 2, true, one_removed);
+
+	/* With the same block, duplicates are paired by position */
+	check_rs("duplicates, identical hash", aab, 3, aab, 3, true, in_order);
+
+	/* Otherwise duplicates match the first one, as a list search would */
+	check_rs("duplicates, changed block", aab, 3, aab, 3, false, dup_first);
+	check_rs("duplicates reordered, identical hash", aab, 3, baa, 3, true, dup_reordered);
+	check_rs("mixed families", abc, 3, v6, 3, true, v6_from_abc);
+}
+
+int
+main(__attribute__((unused)) int argc, __attribute__((unused)) char **argv)
+{
+	test_vs_match();
+	test_rs_match();
+
+	if (failures) {
+		printf("%u failures\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,270 @@
+/*
+ * Soft:        Keepalived is a failover program for the LVS project
+ *              <www.linuxvirtualserver.org>. It monitor & manipulate
+ *              a loadbalanced server pool using multi-layer checks.
+ *
+ * Part:        Unit test and benchmark of the scheduler timer wheel.
+ *
+ * Author:      Alexandre Cassen, <acassen@linux-vs.org>
+ *
+ *              This program is distributed in the hope that it will be useful,
+ *              but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *              MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *              See the GNU General Public License for more details.
+ *
+ *              This program is free software; you can redistribute it and/or
+ *              modify it under the terms of the GNU General Public License
+ *              as published by the Free Software Foundation; either version
+ *              2 of the License, or (at your option) any later version.
+ *
+ * Copyright (C) 2001-2017 Alexandre Cassen, <acassen@gmail.com>
+ */
+
+/* Run with no arguments by "make check". To compare the cost of the rb tree
+ * and timer wheel timer queues with a different number of timers, run
+ * timer_wheel_test TIMERS. */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "scheduler.h"
+#include "timer.h"
+#include "memory.h"
+#include "parser.h"
+
+#define DEFAULT_TIMERS	100000
+#define SPREAD		(60 * TIMER_HZ)		/* Timers are spread over 60 seconds */
+#define STEP		(TIMER_HZ / 1000)	/* and expired in 1 millisecond steps */
+
+static unsigned failures;
+
+#define FAIL(...)	do { printf(__VA_ARGS__); putchar('\n'); failures++; } while (0)
+
+/* declare thread_timer_cmp() for rbtree compares */
+RB_TIMER_CMP(thread);
+
+static uint64_t
+benchmark_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* Every timer must expire in the first step at or after its timeout */
+static void
+check_expired(const char *name, const thread_t *thread, unsigned index, const timeval_t *now, bool *expired_flag)
+{
+	timeval_t latest = timer_add_long(thread->sands, STEP);
+
+	if (expired_flag[index])
+		FAIL("%s: timer %u expired twice", name, index);
+	expired_flag[index] = true;
+
+	if (timercmp(&thread->sands, now, >))
+		FAIL("%s: timer %u expired early", name, index);
+	else if (!timercmp(now, &latest, <))
+		FAIL("%s: timer %u expired late", name, index);
+}
+
+/* Each timer is queued, has its timeout updated once, and is then expired
+ * by advancing the time. Every tenth timer is cancelled instead, and a few
+ * extra timers are disabled or beyond the range of the wheel, and so must
+ * never expire. */
+static void
+run_queue(unsigned num, bool use_wheel)
+{
+	const char *name = use_wheel ? "timer wheel" : "rb tree";
+	unsigned num_extra = num / 100 + 2;
+	unsigned num_cancelled = 0;
+	thread_t *threads, *thread, *thread_tmp;
+	timeval_t *sands, *new_sands;
+	bool *expired_flag;
+	timeval_t base, now, end;
+	rb_root_cached_t root = RB_ROOT_CACHED;
+	timer_wheel_t *w = NULL;
+	list_head_t expired;
+	uint64_t start, t_insert, t_move, t_expire;
+	unsigned i, done;
+
+	threads = MALLOC((num + num_extra) * sizeof(*threads));
+	sands = MALLOC(num * sizeof(*sands));
+	new_sands = MALLOC(num * sizeof(*new_sands));
+	expired_flag = MALLOC((num + num_extra) * sizeof(*expired_flag));
+
+	set_time_now();
+	base = time_now;
+	srandom(1);
+	for (i = 0; i < num; i++) {
+		sands[i] = timer_add_long(base, (unsigned long)random() % SPREAD);
+		new_sands[i] = timer_add_long(base, (unsigned long)random() % SPREAD);
+	}
+
+	if (use_wheel) {
+		w = MALLOC(sizeof(*w));
+		timer_wheel_init(w, &base);
+	}
+
+	start = benchmark_ns();
+	for (i = 0; i < num; i++) {
+		thread = &threads[i];
+		thread->sands = sands[i];
+		if (use_wheel)
+			timer_wheel_add(w, thread);
+		else
+			rb_insert_sort_cached(&root, thread, n, thread_timer_cmp);
+	}
+	t_insert = benchmark_ns() - start;
+
+	start = benchmark_ns();
+	for (i = 0; i < num; i++) {
+		thread = &threads[i];
+		if (use_wheel)
+			timer_wheel_del(w, thread);
+		thread->sands = new_sands[i];
+		if (use_wheel)
+			timer_wheel_add(w, thread);
+		else
+			rb_move_cached(&root, thread, n, thread_timer_cmp);
+	}
+	t_move = benchmark_ns() - start;
+
+	/* These don't count towards the benchmark */
+	for (i = num; i < num + num_extra; i++) {
+		thread = &threads[i];
+		if (i & 1)
+			thread->sands.tv_sec = TIMER_DISABLED;
+		else
+			thread->sands = timer_add_long(base, (unsigned long)TIMER_HZ * 60 * 60 * 24 * 60);
+		thread->sands.tv_usec = 0;
+		if (use_wheel)
+			timer_wheel_add(w, thread);
+		else
+			rb_insert_sort_cached(&root, thread, n, thread_timer_cmp);
+	}
+	for (i = 0; i < num; i += 10) {
+		thread = &threads[i];
+		if (use_wheel)
+			timer_wheel_del(w, thread);
+		else
+			rb_erase_cached(&thread->n, &root);
+		expired_flag[i] = true;
+		num_cancelled++;
+	}
+
+	end = timer_add_long(base, SPREAD + STEP);
+	start = benchmark_ns();
+	for (now = base, done = 0; done < num - num_cancelled; now = timer_add_long(now, STEP)) {
+		if (timercmp(&now, &end, >)) {
+			FAIL("%s: only %u of %u timers expired", name, done, num - num_cancelled);
+			break;
+		}
+
+		if (use_wheel) {
+			INIT_LIST_HEAD(&expired);
+			timer_wheel_expire(w, &now, &expired);
+			list_for_each_entry_safe(thread, thread_tmp, &expired, e_list) {
+				list_head_del(&thread->e_list);
+				check_expired(name, thread, (unsigned)(thread - threads), &now, expired_flag);
+				done++;
+			}
+		} else {
+			rb_for_each_entry_safe_cached(thread, thread_tmp, &root, n) {
+				if (timercmp(&thread->sands, &now, >))
+					break;
+				rb_erase_cached(&thread->n, &root);
+				check_expired(name, thread, (unsigned)(thread - threads), &now, expired_flag);
+				done++;
+			}
+		}
+	}
+	t_expire = benchmark_ns() - start;
+
+	/* Nothing else may expire, however far the time moves on */
+	if (use_wheel) {
+		now = timer_add_long(base, (unsigned long)TIMER_HZ * 60 * 60 * 24);
+		INIT_LIST_HEAD(&expired);
+		timer_wheel_expire(w, &now, &expired);
+		list_for_each_entry(thread, &expired, e_list)
+			FAIL("%s: timer %u expired after a day", name, (unsigned)(thread - threads));
+	}
+
+	printf("  %-12s %10.1f %10.1f %10.1f\n", name,
+		(double)t_insert / num, (double)t_move / num, (double)t_expire / num);
+
+	FREE(threads);
+	FREE(sands);
+	FREE(new_sands);
+	FREE(expired_flag);
+	FREE_PTR(w);
+}
+
+static int
+dummy_thread(__attribute__((unused)) thread_ref_t thread)
+{
+	return 0;
+}
+
+/* Moving the earliest timer later must not leave its old timeout cached
+ * as the time of the next expiry */
+static void
+check_move(const char *name, bool use_wheel)
+{
+	thread_master_t *m = thread_make_worker_master();
+	thread_ref_t first, second;
+	timeval_t expiry;
+
+	if (use_wheel)
+		thread_set_timer_wheel(m, true);
+
+	first = thread_add_timer(m, dummy_thread, NULL, TIMER_HZ);
+	second = thread_add_timer(m, dummy_thread, NULL, 2 * TIMER_HZ);
+
+	if (use_wheel) {
+		if (!timer_wheel_next_expiry(m->timer_wheel, &expiry) || timercmp(&expiry, &first->sands, !=))
+			FAIL("%s: first timer not the next to expire", name);
+
+		timer_thread_update_timeout(first, 3 * TIMER_HZ);
+		if (!timer_wheel_next_expiry(m->timer_wheel, &expiry) || timercmp(&expiry, &second->sands, !=))
+			FAIL("%s: moved timer still cached as the next to expire", name);
+	} else {
+		timer_thread_update_timeout(first, 3 * TIMER_HZ);
+		if (rb_entry_safe(rb_first_cached(&m->timer), thread_t, n) != second)
+			FAIL("%s: moved timer still first in the queue", name);
+	}
+
+	thread_destroy_master(m);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned num = DEFAULT_TIMERS;
+
+	if (argc > 1 && !read_unsigned(argv[1], &num, 1, 10000000, false)) {
+		fprintf(stderr, "Invalid number of timers '%s'\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	printf("Timer queue benchmark, %u timers (ns per timer)\n", num);
+	printf("  %-12s %10s %10s %10s\n", "", "insert", "update", "expire");
+
+	run_queue(num, false);
+	run_queue(num, true);
+
+	check_move("rb tree", false);
+	check_move("timer wheel", true);
+
+	if (failures) {
+		printf("%u failures\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}